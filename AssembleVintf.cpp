@@ -14,24 +14,36 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory_resource>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 
 #include <aidl/metadata.h>
 #include <android-base/file.h>
 #include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <libvts_vintf_test_common/common.h>
 #include <vintf/AssembleVintf.h>
 #include <vintf/KernelConfigParser.h>
 #include <vintf/parse_string.h>
 #include <vintf/parse_xml.h>
+#include "KernelRequirementTable.h"
+#include "XmlPullParser.h"
 #include "constants-private.h"
 #include "utils.h"
 
@@ -44,6 +56,52 @@ static const std::string gConfigPrefix = "android-base-";
 static const std::string gConfigSuffix = ".config";
 static const std::string gBaseConfig = "android-base.config";
 
+static const std::string kFingerprintHeader = "assemble_vintf fingerprint 1\n";
+static const std::string kEnvDependencyPrefix = "env:";
+static const std::string kAidlMetadataDependency = "aidl-metadata";
+static const std::string kAidlUseUnfrozenDependency = "aidl-use-unfrozen";
+
+// Call func(0), ..., func(count - 1) on up to one thread per core, including the calling
+// thread. Calls may run in any order; |func| must not write to shared state.
+static void parallelFor(size_t count, const std::function<void(size_t)>& func) {
+    size_t numThreads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+static std::string hashToString(uint64_t hash) {
+    return base::StringPrintf("%016" PRIx64, hash);
+}
+
+// Name of the root element of |xml|, or empty if the document does not start with one.
+// Only the beginning of the document is read.
+static std::string_view rootElementName(std::string_view xml) {
+    details::XmlPullParser parser(xml);
+    while (true) {
+        switch (parser.next()) {
+            case details::XmlPullParser::Event::START_ELEMENT:
+                return parser.name();
+            case details::XmlPullParser::Event::TEXT:
+            case details::XmlPullParser::Event::OTHER:
+                continue;
+            default:
+                return {};
+        }
+    }
+}
+
 // An input stream with a name.
 // The input stream may be an actual file, or a stringstream for testing.
 // It takes ownership on the istream.
@@ -61,6 +119,66 @@ class NamedIstream {
     std::unique_ptr<std::istream> mStream;
 };
 
+// Entries are keyed by content (and file name, which parsed schemas record), so a file that
+// changes between jobs, e.g. the output of an earlier job, is parsed again. Only successfully
+// parsed inputs are cached.
+class AssembleVintfCacheImpl : public AssembleVintfCache {
+   public:
+    size_t hits() const override { return mHits; }
+
+    // Parse |xml|, the content of |fileName|, into |schema|.
+    template <typename Schema>
+    bool fromXml(Schema* schema, const std::string& fileName, const std::string& xml,
+                 std::string* error) {
+        auto& entries = schemas(schema);
+        std::pair<std::string, std::string> key{fileName, xml};
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                *schema = it->second;
+                ++mHits;
+                return true;
+            }
+        }
+        schema->setFileName(fileName);
+        if (!::android::vintf::fromXml(schema, xml, error)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        entries.emplace(std::move(key), *schema);
+        return true;
+    }
+
+    bool getKernelConfigs(const std::string& content, std::vector<KernelConfig>* out) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mKernelConfigs.find(content);
+        if (it == mKernelConfigs.end()) {
+            return false;
+        }
+        *out = it->second;
+        ++mHits;
+        return true;
+    }
+
+    void addKernelConfigs(const std::string& content, const std::vector<KernelConfig>& configs) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mKernelConfigs.emplace(content, configs);
+    }
+
+   private:
+    using Key = std::pair<std::string /* file name */, std::string /* content */>;
+
+    std::map<Key, HalManifest>& schemas(HalManifest*) { return mManifests; }
+    std::map<Key, CompatibilityMatrix>& schemas(CompatibilityMatrix*) { return mMatrices; }
+
+    std::mutex mMutex;
+    std::map<Key, HalManifest> mManifests;
+    std::map<Key, CompatibilityMatrix> mMatrices;
+    std::map<std::string /* content */, std::vector<KernelConfig>> mKernelConfigs;
+    std::atomic<size_t> mHits = 0;
+};
+
 /**
  * Slurps the device manifest file and add build time flag to it.
  */
@@ -68,12 +186,24 @@ class AssembleVintfImpl : public AssembleVintf {
     using Condition = std::unique_ptr<KernelConfig>;
     using ConditionedConfig = std::pair<Condition, std::vector<KernelConfig> /* configs */>;
 
+    // Arguments of setPreviousFingerprint().
+    struct PreviousRun {
+        std::string fingerprint;
+        std::string output;
+        std::string kernelTable;
+    };
+
    public:
     void setFakeAidlMetadata(const std::vector<AidlInterfaceMetadata>& metadata) override {
         mFakeAidlMetadata = metadata;
     }
 
     std::vector<AidlInterfaceMetadata> getAidlMetadata() const {
+        trackDependency(kAidlMetadataDependency);
+        return getAidlMetadataUntracked();
+    }
+
+    std::vector<AidlInterfaceMetadata> getAidlMetadataUntracked() const {
         if (!mFakeAidlMetadata.empty()) {
             return mFakeAidlMetadata;
         } else {
@@ -86,6 +216,11 @@ class AssembleVintfImpl : public AssembleVintf {
     }
 
     bool getAidlUseUnfrozen() const {
+        trackDependency(kAidlUseUnfrozenDependency);
+        return getAidlUseUnfrozenUntracked();
+    }
+
+    bool getAidlUseUnfrozenUntracked() const {
         if (mFakeAidlUseUnfrozen.has_value()) {
             return *mFakeAidlUseUnfrozen;
         } else {
@@ -99,7 +234,16 @@ class AssembleVintfImpl : public AssembleVintf {
 
     void setFakeEnv(const std::string& key, const std::string& value) { mFakeEnv[key] = value; }
 
+    void setCache(std::shared_ptr<AssembleVintfCache> cache) override {
+        mCache = std::static_pointer_cast<AssembleVintfCacheImpl>(std::move(cache));
+    }
+
     std::string getEnv(const std::string& key) const {
+        trackDependency(kEnvDependencyPrefix + key);
+        return getEnvUntracked(key);
+    }
+
+    std::string getEnvUntracked(const std::string& key) const {
         auto it = mFakeEnv.find(key);
         if (it != mFakeEnv.end()) {
             return it->second;
@@ -194,6 +338,17 @@ class AssembleVintfImpl : public AssembleVintf {
         return ss.str();
     }
 
+    // Parse |xml|, the content of |fileName|, into |schema|, using mCache if it is set.
+    template <typename Schema>
+    bool parseInput(Schema* schema, const std::string& fileName, const std::string& xml,
+                    std::string* error) const {
+        if (mCache != nullptr) {
+            return mCache->fromXml(schema, fileName, xml, error);
+        }
+        schema->setFileName(fileName);
+        return fromXml(schema, xml, error);
+    }
+
     // Return true if name of file is "android-base.config". This file must be specified
     // exactly once for each kernel version. These requirements do not have any conditions.
     static bool isCommonConfig(const std::string& path) {
@@ -218,7 +373,7 @@ class AssembleVintfImpl : public AssembleVintf {
     }
 
     // nullptr on any error, otherwise the condition.
-    Condition generateCondition(const std::string& path) {
+    static Condition generateCondition(const std::string& path, std::ostream& errors) {
         if (!isConditionalConfig(path)) {
             return nullptr;
         }
@@ -237,39 +392,55 @@ class AssembleVintfImpl : public AssembleVintf {
                 sub[i] = toupper(sub[i]);
                 continue;
             }
-            err() << "'" << fname << "' (in " << path
-                  << ") is not a valid kernel config file name. Must match regex: "
-                  << "android-base(-[0-9a-zA-Z-]+)?\\" << gConfigSuffix << std::endl;
+            errors << "'" << fname << "' (in " << path
+                   << ") is not a valid kernel config file name. Must match regex: "
+                   << "android-base(-[0-9a-zA-Z-]+)?\\" << gConfigSuffix << std::endl;
             return nullptr;
         }
         sub.insert(0, "CONFIG_");
         return std::make_unique<KernelConfig>(std::move(sub), Tristate::YES);
     }
 
-    bool parseFileForKernelConfigs(std::basic_istream<char>& stream,
-                                   std::vector<KernelConfig>* out) {
+    static bool parseFileForKernelConfigs(std::basic_istream<char>& stream,
+                                          std::vector<KernelConfig>* out, std::ostream& errors,
+                                          AssembleVintfCacheImpl* cache) {
+        std::string content = read(stream);
+        std::vector<KernelConfig> configs;
+        if (cache != nullptr && cache->getKernelConfigs(content, &configs)) {
+            out->insert(out->end(), std::make_move_iterator(configs.begin()),
+                        std::make_move_iterator(configs.end()));
+            return true;
+        }
+
         KernelConfigParser parser(true /* processComments */, true /* relaxedFormat */);
-        status_t status = parser.processAndFinish(read(stream));
+        status_t status = parser.processAndFinish(content);
         if (status != OK) {
-            err() << parser.error();
+            errors << parser.error();
             return false;
         }
 
         for (auto& configPair : parser.configs()) {
-            out->push_back({});
-            KernelConfig& config = out->back();
+            configs.push_back({});
+            KernelConfig& config = configs.back();
             config.first = std::move(configPair.first);
             if (!parseKernelConfigTypedValue(configPair.second, &config.second)) {
-                err() << "Unknown value type for key = '" << config.first << "', value = '"
-                      << configPair.second << "'\n";
+                errors << "Unknown value type for key = '" << config.first << "', value = '"
+                       << configPair.second << "'\n";
                 return false;
             }
         }
+        if (cache != nullptr) {
+            cache->addKernelConfigs(content, configs);
+        }
+        out->insert(out->end(), std::make_move_iterator(configs.begin()),
+                    std::make_move_iterator(configs.end()));
         return true;
     }
 
-    bool parseFilesForKernelConfigs(std::vector<NamedIstream>* streams,
-                                    std::vector<ConditionedConfig>* out) {
+    // Errors are written to |errors| so that kernel versions can be parsed in parallel.
+    static bool parseFilesForKernelConfigs(std::vector<NamedIstream>* streams,
+                                           std::vector<ConditionedConfig>* out,
+                                           std::ostream& errors, AssembleVintfCacheImpl* cache) {
         out->clear();
         ConditionedConfig commonConfig;
         bool foundCommonConfig = false;
@@ -277,31 +448,33 @@ class AssembleVintfImpl : public AssembleVintf {
 
         for (auto& namedStream : *streams) {
             if (isCommonConfig(namedStream.name()) || isExtraCommonConfig(namedStream.name())) {
-                if (!parseFileForKernelConfigs(namedStream.stream(), &commonConfig.second)) {
-                    err() << "Failed to generate common configs for file " << namedStream.name();
+                if (!parseFileForKernelConfigs(namedStream.stream(), &commonConfig.second, errors,
+                                               cache)) {
+                    errors << "Failed to generate common configs for file " << namedStream.name();
                     ret = false;
                 }
                 if (isCommonConfig(namedStream.name())) {
                     foundCommonConfig = true;
                 }
             } else {
-                Condition condition = generateCondition(namedStream.name());
+                Condition condition = generateCondition(namedStream.name(), errors);
                 if (condition == nullptr) {
-                    err() << "Failed to generate conditional configs for file "
-                          << namedStream.name();
+                    errors << "Failed to generate conditional configs for file "
+                           << namedStream.name();
                     ret = false;
                 }
 
                 std::vector<KernelConfig> kernelConfigs;
-                if ((ret &= parseFileForKernelConfigs(namedStream.stream(), &kernelConfigs)))
+                if ((ret &= parseFileForKernelConfigs(namedStream.stream(), &kernelConfigs, errors,
+                                                      cache)))
                     out->emplace_back(std::move(condition), std::move(kernelConfigs));
             }
         }
 
         if (!foundCommonConfig) {
-            err() << "No " << gBaseConfig << " is found in these paths:" << std::endl;
+            errors << "No " << gBaseConfig << " is found in these paths:" << std::endl;
             for (auto& namedStream : *streams) {
-                err() << "    " << namedStream.name() << std::endl;
+                errors << "    " << namedStream.name() << std::endl;
             }
             ret = false;
         }
@@ -310,11 +483,31 @@ class AssembleVintfImpl : public AssembleVintf {
         return ret;
     }
 
-    std::basic_ostream<char>& out() const { return mOutRef == nullptr ? std::cout : *mOutRef; }
+    // Output is buffered until flushOutput() so that the fingerprint can cover it.
+    std::basic_ostream<char>& out() const { return mOutBuffer; }
+
+    void flushOutput() {
+        std::string output = mOutBuffer.str();
+        mOutBuffer.str("");
+        mOutputHash = details::fnv1a(output, mOutputHash);
+        auto& stream = mOutRef == nullptr ? std::cout : *mOutRef;
+        stream << output;
+        stream.flush();
+    }
     std::basic_ostream<char>& err() const override {
         return mErrRef == nullptr ? std::cerr : *mErrRef;
     }
 
+    // Only framework compatibility matrices have kernel requirements.
+    bool checkKernelTableSupported(bool isFrameworkMatrix) const {
+        if (mKernelTableOut != nullptr && !isFrameworkMatrix) {
+            err() << "Error: --kernel-table requires a framework compatibility matrix output."
+                  << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     // If -c is provided, check it.
     bool checkDualFile(const HalManifest& manifest, const CompatibilityMatrix& matrix) {
         if (getBooleanFlag("PRODUCT_ENFORCE_VINTF_MANIFEST")) {
@@ -640,12 +833,14 @@ class AssembleVintfImpl : public AssembleVintf {
         } else {
             out() << toXml(*halManifest, mSerializeFlags);
         }
-        out().flush();
+        flushOutput();
+        if (!checkKernelTableSupported(false /* isFrameworkMatrix */)) {
+            return false;
+        }
 
         if (mCheckFile.hasStream()) {
             CompatibilityMatrix checkMatrix;
-            checkMatrix.setFileName(mCheckFile.name());
-            if (!fromXml(&checkMatrix, read(mCheckFile.stream()), &error)) {
+            if (!parseInput(&checkMatrix, mCheckFile.name(), read(mCheckFile.stream()), &error)) {
                 err() << "Cannot parse check file as a compatibility matrix: " << error
                       << std::endl;
                 return false;
@@ -660,13 +855,38 @@ class AssembleVintfImpl : public AssembleVintf {
 
     // Parse --kernel arguments and write to output matrix.
     bool assembleFrameworkCompatibilityMatrixKernels(CompatibilityMatrix* matrix) {
-        for (auto& pair : mKernels) {
+        // Kernel versions are parsed in parallel, then added in order. Errors are reported
+        // as if they were parsed one by one, stopping at the first failure.
+        struct ParsedKernel {
+            KernelVersion version;
+            std::vector<NamedIstream>* streams;
             std::vector<ConditionedConfig> conditionedConfigs;
-            if (!parseFilesForKernelConfigs(&pair.second, &conditionedConfigs)) {
+            std::ostringstream errors;
+            bool ok = false;
+        };
+        std::vector<ParsedKernel> parsedKernels(mKernels.size());
+        auto kernelIt = mKernels.begin();
+        for (auto& parsedKernel : parsedKernels) {
+            parsedKernel.version = kernelIt->first;
+            parsedKernel.streams = &kernelIt->second;
+            ++kernelIt;
+        }
+        AssembleVintfCacheImpl* cache = mCache.get();
+        parallelFor(parsedKernels.size(), [&parsedKernels, cache](size_t i) {
+            auto& parsedKernel = parsedKernels[i];
+            parsedKernel.ok =
+                parseFilesForKernelConfigs(parsedKernel.streams, &parsedKernel.conditionedConfigs,
+                                           parsedKernel.errors, cache);
+        });
+
+        for (auto& parsedKernel : parsedKernels) {
+            err() << parsedKernel.errors.str();
+            if (!parsedKernel.ok) {
                 return false;
             }
-            for (ConditionedConfig& conditionedConfig : conditionedConfigs) {
-                MatrixKernel kernel(KernelVersion{pair.first}, std::move(conditionedConfig.second));
+            for (ConditionedConfig& conditionedConfig : parsedKernel.conditionedConfigs) {
+                MatrixKernel kernel(KernelVersion{parsedKernel.version},
+                                    std::move(conditionedConfig.second));
                 if (conditionedConfig.first != nullptr)
                     kernel.mConditions.push_back(std::move(*conditionedConfig.first));
                 std::string error;
@@ -697,8 +917,8 @@ class AssembleVintfImpl : public AssembleVintf {
 
         if (mCheckFile.hasStream()) {
             checkManifest = std::make_unique<HalManifest>();
-            checkManifest->setFileName(mCheckFile.name());
-            if (!fromXml(checkManifest.get(), read(mCheckFile.stream()), &error)) {
+            if (!parseInput(checkManifest.get(), mCheckFile.name(), read(mCheckFile.stream()),
+                            &error)) {
                 err() << "Cannot parse check file as a HAL manifest: " << error << std::endl;
                 return false;
             }
@@ -793,7 +1013,18 @@ class AssembleVintfImpl : public AssembleVintf {
         }
         outputInputs(*matrices);
         out() << toXml(*matrix, mSerializeFlags);
-        out().flush();
+        if (mKernelTableOut != nullptr && matrix->type() == SchemaType::FRAMEWORK) {
+            // The output buffer holds the whole output file, which the table records a hash of.
+            std::string table = details::KernelRequirementTable::write(
+                matrix->framework.mKernels, mSerializeFlags, mOutBuffer.str());
+            mKernelTableHash = details::fnv1a(table);
+            *mKernelTableOut << table;
+            mKernelTableOut->flush();
+        }
+        flushOutput();
+        if (!checkKernelTableSupported(matrix->type() == SchemaType::FRAMEWORK)) {
+            return false;
+        }
 
         if (checkManifest != nullptr && !checkDualFile(*checkManifest, *matrix)) {
             return false;
@@ -803,23 +1034,46 @@ class AssembleVintfImpl : public AssembleVintf {
     }
 
     enum AssembleStatus { SUCCESS, FAIL_AND_EXIT, TRY_NEXT };
+
+    void resetInFiles() {
+        for (auto& inFile : mInFiles) {
+            inFile.stream().clear();
+            inFile.stream().seekg(0);
+        }
+    }
+
+    // |contents| holds the content of each of mInFiles.
     template <typename Schema, typename AssembleFunc>
     AssembleStatus tryAssemble(const std::string& schemaName, AssembleFunc assemble,
-                               std::string* error) {
+                               const std::vector<std::string>& contents, std::string* error) {
+        // The first file is the base. The others are merged into it or into a new object and
+        // then dropped, so each is allocated from its own arena; they are parsed in parallel.
+        std::vector<std::pmr::monotonic_buffer_resource> arenas(mInFiles.size() - 1);
         std::vector<Schema> schemas;
-        Schema schema;
-        schema.setFileName(mInFiles.front().name());
-        if (!fromXml(&schema, read(mInFiles.front().stream()), error)) {
+        schemas.reserve(mInFiles.size());
+        schemas.emplace_back();
+        for (auto& arena : arenas) {
+            schemas.emplace_back(&arena);
+        }
+        if (!parseInput(&schemas.front(), mInFiles.front().name(), contents.front(), error)) {
             return TRY_NEXT;
         }
-        auto firstType = schema.type();
-        schemas.emplace_back(std::move(schema));
+        auto firstType = schemas.front().type();
+
+        // Parse the other files in parallel, then check them in order so that the first
+        // invalid file is reported.
+        std::vector<std::string> errors(mInFiles.size());
+        std::vector<char> parsed(mInFiles.size(), true);
+        parallelFor(mInFiles.size() - 1, [&](size_t i) {
+            parsed[i + 1] = parseInput(&schemas[i + 1], mInFiles[i + 1].name(), contents[i + 1],
+                                       &errors[i + 1]);
+        });
 
-        for (auto it = mInFiles.begin() + 1; it != mInFiles.end(); ++it) {
-            Schema additionalSchema;
-            const std::string& fileName = it->name();
-            additionalSchema.setFileName(fileName);
-            if (!fromXml(&additionalSchema, read(it->stream()), error)) {
+        for (size_t i = 1; i < mInFiles.size(); ++i) {
+            const Schema& additionalSchema = schemas[i];
+            const std::string& fileName = mInFiles[i].name();
+            if (!parsed[i]) {
+                *error = errors[i];
                 err() << "File \"" << fileName << "\" is not a valid " << firstType << " "
                       << schemaName << " (but the first file is a valid " << firstType << " "
                       << schemaName << "). Error: " << *error << std::endl;
@@ -831,35 +1085,180 @@ class AssembleVintfImpl : public AssembleVintf {
                       << " is expected)." << std::endl;
                 return FAIL_AND_EXIT;
             }
-
-            schemas.emplace_back(std::move(additionalSchema));
         }
         return assemble(&schemas) ? SUCCESS : FAIL_AND_EXIT;
     }
 
+    // Read the rest of |stream| without moving its read position.
+    static std::string peek(std::istream& stream) {
+        auto pos = stream.tellg();
+        std::string content = read(stream);
+        stream.clear();
+        stream.seekg(pos);
+        return content;
+    }
+
+    // Fingerprint of everything assemble() reads, except for environment variables and AIDL
+    // metadata, which are recorded as dependencies while assembling.
+    std::string inputFingerprint(const std::vector<std::string>& contents) {
+        std::string fingerprint = kFingerprintHeader;
+        for (const auto& option : mOptions) {
+            fingerprint += "option " + option + "\n";
+        }
+        for (size_t i = 0; i < mInFiles.size(); ++i) {
+            fingerprint += "input " + hashToString(details::fnv1a(contents[i])) + " " +
+                           mInFiles[i].name() + "\n";
+        }
+        if (mCheckFile.hasStream()) {
+            fingerprint += "check " + hashToString(details::fnv1a(peek(mCheckFile.stream()))) +
+                           " " + mCheckFile.name() + "\n";
+        }
+        for (auto& [version, streams] : mKernels) {
+            for (auto& namedStream : streams) {
+                fingerprint += "kernel " + to_string(version) + " " +
+                               hashToString(details::fnv1a(peek(namedStream.stream()))) + " " +
+                               namedStream.name() + "\n";
+            }
+        }
+        return fingerprint;
+    }
+
+    void trackDependency(const std::string& key) const { mDependencies.insert(key); }
+
+    std::string dependencyValue(const std::string& key) const {
+        if (key == kAidlUseUnfrozenDependency) {
+            return getAidlUseUnfrozenUntracked() ? "true" : "false";
+        }
+        if (key == kAidlMetadataDependency) {
+            std::string value;
+            for (const auto& metadata : getAidlMetadataUntracked()) {
+                value += metadata.name + ";" + base::Join(metadata.types, ",") + ";" +
+                         metadata.stability + ";" + base::Join(metadata.hashes, ",") + ";" +
+                         base::Join(metadata.versions, ",") + ";" +
+                         std::to_string(metadata.has_development) +
+                         std::to_string(metadata.use_unfrozen) + "\n";
+            }
+            return value;
+        }
+        // kEnvDependencyPrefix
+        return getEnvUntracked(key.substr(kEnvDependencyPrefix.size()));
+    }
+
+    // Whether |previous| was computed from the same |inputFingerprint| and the environment
+    // variables it depends on are unchanged, and neither the output nor the kernel table was
+    // modified since.
+    bool matchesPreviousFingerprint(const std::string& inputFingerprint,
+                                    const PreviousRun& previousRun) const {
+        const std::string& previous = previousRun.fingerprint;
+        if (!base::StartsWith(previous, inputFingerprint)) {
+            return false;
+        }
+        bool hasOutput = false;
+        bool hasKernelTable = false;
+        for (const auto& line :
+             base::Split(previous.substr(inputFingerprint.size()), "\n")) {
+            if (line.empty()) continue;
+            auto tokens = base::Split(line, " ");
+            if (tokens.size() == 3 && tokens[0] == "dependency") {
+                if (tokens[1] != hashToString(details::fnv1a(dependencyValue(tokens[2])))) {
+                    return false;
+                }
+            } else if (tokens.size() == 2 && tokens[0] == "output") {
+                if (tokens[1] != hashToString(details::fnv1a(previousRun.output))) {
+                    return false;
+                }
+                hasOutput = true;
+            } else if (tokens.size() == 2 && tokens[0] == "output-kernel-table") {
+                if (tokens[1] != hashToString(details::fnv1a(previousRun.kernelTable))) {
+                    return false;
+                }
+                hasKernelTable = true;
+            } else {
+                return false;
+            }
+        }
+        return hasOutput && hasKernelTable == (mKernelTableOut != nullptr);
+    }
+
     bool assemble() override {
-        using std::placeholders::_1;
         if (mInFiles.empty()) {
             err() << "Missing input file." << std::endl;
             return false;
         }
 
-        std::string manifestError;
-        auto status = tryAssemble<HalManifest>(
-            "manifest", std::bind(&AssembleVintfImpl::assembleHalManifest, this, _1),
-            &manifestError);
-        if (status == SUCCESS) return true;
-        if (status == FAIL_AND_EXIT) return false;
-
+        // Each file is read once and parsed only as the schema its root element names.
         resetInFiles();
+        std::vector<std::string> contents;
+        contents.reserve(mInFiles.size());
+        for (auto& inFile : mInFiles) {
+            contents.push_back(read(inFile.stream()));
+        }
+
+        mSkipped = false;
+        mDependencies.clear();
+        mOutputHash = details::fnv1a("");
+        mKernelTableHash = details::fnv1a("");
+        std::string fingerprint = inputFingerprint(contents);
+        if (mPreviousRun.has_value() && matchesPreviousFingerprint(fingerprint, *mPreviousRun)) {
+            mFingerprint = mPreviousRun->fingerprint;
+            mSkipped = true;
+            return true;
+        }
+
+        bool success = assembleContents(contents);
+        if (!mOutBuffer.str().empty()) {
+            flushOutput();
+        }
+
+        for (const auto& key : mDependencies) {
+            fingerprint += "dependency " + hashToString(details::fnv1a(dependencyValue(key))) +
+                           " " + key + "\n";
+        }
+        fingerprint += "output " + hashToString(mOutputHash) + "\n";
+        if (mKernelTableOut != nullptr) {
+            fingerprint += "output-kernel-table " + hashToString(mKernelTableHash) + "\n";
+        }
+        mFingerprint = std::move(fingerprint);
+        return success;
+    }
+
+    void setPreviousFingerprint(const std::string& fingerprint, const std::string& output,
+                                const std::string& kernelTable) override {
+        mPreviousRun = PreviousRun{fingerprint, output, kernelTable};
+    }
+
+    std::string fingerprint() const override { return mFingerprint; }
+
+    bool skipped() const override { return mSkipped; }
+
+    bool assembleContents(const std::vector<std::string>& contents) {
+        using std::placeholders::_1;
+        bool isMatrix = rootElementName(contents.front()) == "compatibility-matrix";
+
+        std::string manifestError;
+        AssembleStatus status;
+        if (!isMatrix) {
+            status = tryAssemble<HalManifest>(
+                "manifest", std::bind(&AssembleVintfImpl::assembleHalManifest, this, _1),
+                contents, &manifestError);
+            if (status == SUCCESS) return true;
+            if (status == FAIL_AND_EXIT) return false;
+        }
 
         std::string matrixError;
         status = tryAssemble<CompatibilityMatrix>(
             "compatibility matrix",
-            std::bind(&AssembleVintfImpl::assembleCompatibilityMatrix, this, _1), &matrixError);
+            std::bind(&AssembleVintfImpl::assembleCompatibilityMatrix, this, _1), contents,
+            &matrixError);
         if (status == SUCCESS) return true;
         if (status == FAIL_AND_EXIT) return false;
 
+        if (isMatrix) {
+            // Only needed for the message below.
+            HalManifest manifest;
+            parseInput(&manifest, mInFiles.front().name(), contents.front(), &manifestError);
+        }
+
         err() << "Input file has unknown format." << std::endl
               << "Error when attempting to convert to manifest: " << manifestError << std::endl
               << "Error when attempting to convert to compatibility matrix: " << matrixError
@@ -882,6 +1281,12 @@ class AssembleVintfImpl : public AssembleVintf {
         return it->stream();
     }
 
+    std::ostream& setKernelTableOutputStream(Ostream&& out) override {
+        mKernelTableOut = std::move(out);
+        mOptions.push_back("kernel-table");
+        return *mKernelTableOut;
+    }
+
     std::istream& setCheckInputStream(const std::string& name, Istream&& in) override {
         mCheckFile = NamedIstream(name, std::move(in));
         return mCheckFile.stream();
@@ -898,15 +1303,11 @@ class AssembleVintfImpl : public AssembleVintf {
         return it->stream();
     }
 
-    void resetInFiles() {
-        for (auto& inFile : mInFiles) {
-            inFile.stream().clear();
-            inFile.stream().seekg(0);
-        }
+    void setOutputMatrix() override {
+        mOutputMatrix = true;
+        mOptions.push_back("output-matrix");
     }
 
-    void setOutputMatrix() override { mOutputMatrix = true; }
-
     bool setHalsOnly() override {
         if (mHasSetHalsOnlyFlag) {
             err() << "Error: Cannot set --hals-only with --no-hals." << std::endl;
@@ -916,6 +1317,7 @@ class AssembleVintfImpl : public AssembleVintf {
         // does not interfere with this (except --no-hals).
         mSerializeFlags = SerializeFlags::HALS_ONLY;
         mHasSetHalsOnlyFlag = true;
+        mOptions.push_back("hals-only");
         return true;
     }
 
@@ -926,12 +1328,14 @@ class AssembleVintfImpl : public AssembleVintf {
         }
         mSerializeFlags = mSerializeFlags.disableHals();
         mHasSetHalsOnlyFlag = true;
+        mOptions.push_back("no-hals");
         return true;
     }
 
     bool setNoKernelRequirements() override {
         mSerializeFlags = mSerializeFlags.disableKernelConfigs().disableKernelMinorRevision();
         mCheckFlags = mCheckFlags.disableKernel();
+        mOptions.push_back("no-kernel-requirements");
         return true;
     }
 
@@ -939,6 +1343,7 @@ class AssembleVintfImpl : public AssembleVintf {
     std::vector<NamedIstream> mInFiles;
     Ostream mOutRef;
     Ostream mErrRef;
+    Ostream mKernelTableOut;
     NamedIstream mCheckFile;
     bool mOutputMatrix = false;
     bool mHasSetHalsOnlyFlag = false;
@@ -948,6 +1353,17 @@ class AssembleVintfImpl : public AssembleVintf {
     std::vector<AidlInterfaceMetadata> mFakeAidlMetadata;
     std::optional<bool> mFakeAidlUseUnfrozen;
     CheckFlags::Type mCheckFlags = CheckFlags::DEFAULT;
+    std::shared_ptr<AssembleVintfCacheImpl> mCache;
+    mutable std::ostringstream mOutBuffer;
+    uint64_t mOutputHash = 0;
+    uint64_t mKernelTableHash = 0;
+    // Options that change the output, in the order they are set.
+    std::vector<std::string> mOptions;
+    // Environment variables and AIDL metadata read by the last assemble().
+    mutable std::set<std::string> mDependencies;
+    std::optional<PreviousRun> mPreviousRun;
+    std::string mFingerprint;
+    bool mSkipped = false;
 };
 
 bool AssembleVintf::openOutFile(const std::string& path) {
@@ -955,6 +1371,12 @@ bool AssembleVintf::openOutFile(const std::string& path) {
         .is_open();
 }
 
+bool AssembleVintf::openKernelTableFile(const std::string& path) {
+    return static_cast<std::ofstream&>(
+               setKernelTableOutputStream(std::make_unique<std::ofstream>(path)))
+        .is_open();
+}
+
 bool AssembleVintf::openInFile(const std::string& path) {
     return static_cast<std::ifstream&>(addInputStream(path, std::make_unique<std::ifstream>(path)))
         .is_open();
@@ -998,5 +1420,9 @@ std::unique_ptr<AssembleVintf> AssembleVintf::newInstance() {
     return std::make_unique<AssembleVintfImpl>();
 }
 
+std::shared_ptr<AssembleVintfCache> AssembleVintfCache::newInstance() {
+    return std::make_shared<AssembleVintfCacheImpl>();
+}
+
 }  // namespace vintf
 }  // namespace android
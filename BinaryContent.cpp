@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vintf/BinaryContent.h>
+
+#include <vector>
+
+namespace android {
+namespace vintf {
+
+BinaryContentWriter::BinaryContentWriter(std::ostream& out) : mOut(out) {
+    mOut.write(kBinaryContentMagic.data(), kBinaryContentMagic.size());
+    mOut.put(static_cast<char>(kBinaryContentVersion));
+}
+
+void BinaryContentWriter::beginObject(std::string_view name) {
+    writeTag('o', name);
+}
+
+void BinaryContentWriter::endObject() {
+    mOut.put('O');
+}
+
+void BinaryContentWriter::beginArray(std::string_view name) {
+    writeTag('a', name);
+}
+
+void BinaryContentWriter::endArray() {
+    mOut.put('A');
+}
+
+void BinaryContentWriter::visitString(std::string_view name, std::string_view value) {
+    writeTag('s', name);
+    writeString(value);
+}
+
+void BinaryContentWriter::visitUint(std::string_view name, uint64_t value) {
+    writeTag('u', name);
+    writeUint(value);
+}
+
+void BinaryContentWriter::visitBool(std::string_view name, bool value) {
+    writeTag('b', name);
+    mOut.put(value ? 1 : 0);
+}
+
+void BinaryContentWriter::writeTag(char tag, std::string_view name) {
+    mOut.put(tag);
+    writeString(name);
+}
+
+void BinaryContentWriter::writeString(std::string_view s) {
+    writeUint(s.size());
+    mOut.write(s.data(), s.size());
+}
+
+void BinaryContentWriter::writeUint(uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        mOut.put(static_cast<char>(value != 0 ? byte | 0x80 : byte));
+    } while (value != 0);
+}
+
+namespace {
+
+class BinaryContentReader {
+   public:
+    BinaryContentReader(std::string_view data, ContentVisitor* visitor, std::string* error)
+        : mData(data), mVisitor(visitor), mError(error) {}
+
+    bool read() {
+        if (mData.substr(0, kBinaryContentMagic.size()) != kBinaryContentMagic) {
+            return fail("Not binary VINTF content");
+        }
+        mPos = kBinaryContentMagic.size();
+        uint8_t version;
+        if (!readByte(&version)) return false;
+        if (version != kBinaryContentVersion) {
+            return fail("Unsupported binary VINTF content version " + std::to_string(version));
+        }
+        while (mPos < mData.size()) {
+            if (!readRecord()) return false;
+        }
+        if (!mOpen.empty()) return fail("Unterminated object or array at end of content");
+        return true;
+    }
+
+   private:
+    bool readRecord() {
+        size_t start = mPos;
+        uint8_t tag;
+        if (!readByte(&tag)) return false;
+        if (tag == 'O' || tag == 'A') {
+            char open = tag == 'O' ? 'o' : 'a';
+            if (mOpen.empty() || mOpen.back() != open) {
+                return fail("Unbalanced end tag at offset " + std::to_string(start));
+            }
+            mOpen.pop_back();
+            tag == 'O' ? mVisitor->endObject() : mVisitor->endArray();
+            return true;
+        }
+        if (std::string_view("oasub").find(static_cast<char>(tag)) == std::string_view::npos) {
+            return fail("Unknown tag " + std::to_string(tag) + " at offset " +
+                        std::to_string(start));
+        }
+        std::string_view name;
+        if (!readString(&name)) return false;
+        switch (tag) {
+            case 'o': {
+                mOpen.push_back('o');
+                mVisitor->beginObject(name);
+                break;
+            }
+            case 'a': {
+                mOpen.push_back('a');
+                mVisitor->beginArray(name);
+                break;
+            }
+            case 's': {
+                std::string_view value;
+                if (!readString(&value)) return false;
+                mVisitor->visitString(name, value);
+                break;
+            }
+            case 'u': {
+                uint64_t value;
+                if (!readUint(&value)) return false;
+                mVisitor->visitUint(name, value);
+                break;
+            }
+            case 'b': {
+                uint8_t value;
+                if (!readByte(&value)) return false;
+                if (value > 1) return fail("Invalid bool at offset " + std::to_string(start));
+                mVisitor->visitBool(name, value != 0);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool readByte(uint8_t* out) {
+        if (mPos >= mData.size()) return fail("Truncated binary VINTF content");
+        *out = static_cast<uint8_t>(mData[mPos++]);
+        return true;
+    }
+
+    bool readUint(uint64_t* out) {
+        *out = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            uint8_t byte;
+            if (!readByte(&byte)) return false;
+            uint64_t bits = byte & 0x7f;
+            if (shift >= 64 || (shift == 63 && bits > 1)) {
+                return fail("Integer overflow at offset " + std::to_string(mPos - 1));
+            }
+            *out |= bits << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+    }
+
+    bool readString(std::string_view* out) {
+        uint64_t size;
+        if (!readUint(&size)) return false;
+        if (size > mData.size() - mPos) return fail("Truncated binary VINTF content");
+        *out = mData.substr(mPos, size);
+        mPos += size;
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        if (mError) *mError = message;
+        return false;
+    }
+
+    std::string_view mData;
+    size_t mPos = 0;
+    ContentVisitor* mVisitor;
+    std::string* mError;
+    // 'o' or 'a' for each object or array that has not been ended yet.
+    std::vector<char> mOpen;
+};
+
+}  // namespace
+
+bool readBinaryContent(std::string_view data, ContentVisitor* visitor, std::string* error) {
+    return BinaryContentReader(data, visitor, error).read();
+}
+
+}  // namespace vintf
+}  // namespace android
@@ -16,12 +16,14 @@
 
 #include "CompatibilityMatrix.h"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 
+#include "KernelRequirementIndex.h"
 #include "parse_string.h"
 #include "parse_xml.h"
 #include "utils.h"
@@ -57,6 +59,7 @@ bool CompatibilityMatrix::addKernel(MatrixKernel&& kernel, std::string* error) {
         kernel.setSourceMatrixLevel(level());
     }
 
+    framework.mKernelIndex.reset();
     auto it = framework.mKernels.begin();
     for (; it != framework.mKernels.end(); ++it) {
         if (it->getSourceMatrixLevel() != kernel.getSourceMatrixLevel()) {
@@ -150,6 +153,13 @@ std::string CompatibilityMatrix::getXmlSchemaPath(const std::string& xmlFileName
 //   to "this") that contains only interface/instance.
 MatrixHal* CompatibilityMatrix::splitInstance(MatrixHal* existingHal, const std::string& interface,
                                               const std::string& instanceOrPattern, bool isRegex) {
+    // Fast path for the common case where existingHal does not mention interface/instance.
+    auto intfIt = existingHal->interfaces.find(interface);
+    if (intfIt == existingHal->interfaces.end() ||
+        !intfIt->second.hasInstance(instanceOrPattern, isRegex)) {
+        return nullptr;
+    }
+
     bool found = false;
     bool foundOthers = false;
     existingHal->forEachInstance([&](const auto& matrixInstance) {
@@ -178,11 +188,15 @@ MatrixHal* CompatibilityMatrix::splitInstance(MatrixHal* existingHal, const std:
     }
 
     existingHal->removeInstance(interface, instanceOrPattern, isRegex);
-    MatrixHal copy = *existingHal;
-    copy.clearInstances();
-    copy.insertInstance(interface, instanceOrPattern, isRegex);
 
-    return addInternal(std::move(copy));
+    // Copy everything but the instances, which would be cleared from the copy anyway.
+    auto interfaces = std::move(existingHal->interfaces);
+    MatrixHal split = *existingHal;
+    existingHal->interfaces = std::move(interfaces);
+    split.interfaces.clear();
+    split.insertInstance(interface, instanceOrPattern, isRegex);
+
+    return addInternal(std::move(split));
 }
 
 // Add all package@other_version::interface/instance as an optional instance.
@@ -199,42 +213,38 @@ bool CompatibilityMatrix::addAllHalsAsOptional(CompatibilityMatrix* other, std::
         const std::string& name = halEntry.first;
         MatrixHal& halToAdd = halEntry.second;
 
-        std::set<std::pair<std::string, std::string>> insertedInstances;
-        std::set<std::pair<std::string, std::string>> insertedRegex;
         auto existingHals = getHals(name);
 
-        halToAdd.forEachInstance([&](const std::vector<VersionRange>& versionRanges,
-                                     const std::string& interface,
-                                     const std::string& instanceOrPattern, bool isRegex) {
-            for (auto* existingHal : existingHals) {
-                // Ignore HALs with different format.
-                if (halToAdd.format != existingHal->format) {
-                    continue;
-                }
-
-                MatrixHal* splitInstance =
-                    this->splitInstance(existingHal, interface, instanceOrPattern, isRegex);
-                if (splitInstance != nullptr) {
-                    splitInstance->updatableViaApex |= halToAdd.updatableViaApex;
-                    splitInstance->insertVersionRanges(versionRanges);
-                    if (isRegex) {
-                        insertedRegex.insert(std::make_pair(interface, instanceOrPattern));
-                    } else {
-                        insertedInstances.insert(std::make_pair(interface, instanceOrPattern));
+        // Instances that are split out of existing HALs are not added again below.
+        for (auto intfIt = halToAdd.interfaces.begin(); intfIt != halToAdd.interfaces.end();) {
+            const std::string& interface = intfIt->first;
+            size_t removed = intfIt->second.removeInstancesIf(
+                [&](const std::string& instanceOrPattern, bool isRegex) {
+                    bool inserted = false;
+                    for (auto* existingHal : existingHals) {
+                        // Ignore HALs with different format.
+                        if (halToAdd.format != existingHal->format) {
+                            continue;
+                        }
+
+                        MatrixHal* splitInstance = this->splitInstance(existingHal, interface,
+                                                                       instanceOrPattern, isRegex);
+                        if (splitInstance != nullptr) {
+                            splitInstance->updatableViaApex |= halToAdd.updatableViaApex;
+                            splitInstance->insertVersionRanges(halToAdd.versionRanges);
+                            inserted = true;
+                        }
                     }
-                }
+                    return inserted;
+                });
+            if (removed > 0 && !intfIt->second.hasAnyInstance()) {
+                intfIt = halToAdd.interfaces.erase(intfIt);
+            } else {
+                ++intfIt;
             }
-            return true;
-        });
-
-        // Add the remaining instances.
-        for (const auto& entry : insertedInstances) {
-            halToAdd.removeInstance(entry.first, entry.second, false /* isRegex */);
-        }
-        for (const auto& entry : insertedRegex) {
-            halToAdd.removeInstance(entry.first, entry.second, true /* isRegex */);
         }
 
+        // Add the remaining instances.
         if (halToAdd.instancesCount() > 0) {
             halToAdd.setOptional(true);
             if (!add(std::move(halToAdd))) {
@@ -269,6 +279,7 @@ bool CompatibilityMatrix::addAllXmlFilesAsOptional(CompatibilityMatrix* other, s
 
 // Merge Kernel. See KernelInfo::getMatchedKernelRequirements for details on compatibility checks.
 bool CompatibilityMatrix::addAllKernels(CompatibilityMatrix* other, std::string* error) {
+    other->framework.mKernelIndex.reset();
     for (MatrixKernel& kernel : other->framework.mKernels) {
         if (kernel.getSourceMatrixLevel() == Level::UNSPECIFIED) {
             kernel.setSourceMatrixLevel(other->level());
@@ -334,60 +345,114 @@ bool operator==(const CompatibilityMatrix &lft, const CompatibilityMatrix &rgt)
              lft.framework.mAvbMetaVersion == rgt.framework.mAvbMetaVersion));
 }
 
-std::unique_ptr<CompatibilityMatrix> CompatibilityMatrix::combine(
-    Level deviceLevel, Level kernelLevel, std::vector<CompatibilityMatrix>* matrices,
-    std::string* error) {
-    // Check type.
-    for (const auto& e : *matrices) {
-        if (e.type() != SchemaType::FRAMEWORK) {
-            if (error) {
-                *error = "File \"" + e.fileName() + "\" is not a framework compatibility matrix.";
-                return nullptr;
-            }
+CompatibilityMatrix::Combiner::Combiner(Level deviceLevel, Level kernelLevel)
+    : mDeviceLevel(deviceLevel), mKernelLevel(kernelLevel) {}
+
+bool CompatibilityMatrix::Combiner::checkType(const CompatibilityMatrix& fragment,
+                                              std::string* error) const {
+    if (fragment.type() != SchemaType::FRAMEWORK) {
+        if (error) {
+            *error =
+                "File \"" + fragment.fileName() + "\" is not a framework compatibility matrix.";
         }
+        return false;
     }
+    return true;
+}
 
+bool CompatibilityMatrix::Combiner::addUnowned(CompatibilityMatrix* fragment, std::string*) {
     // Matrices with unspecified (empty) level are auto-filled with deviceLevel.
-    for (auto& e : *matrices) {
-        if (e.level() == Level::UNSPECIFIED) {
-            e.mLevel = deviceLevel;
+    if (fragment->level() == Level::UNSPECIFIED) {
+        fragment->mLevel = mDeviceLevel;
+    }
+    mFragments.push_back(fragment);
+    return true;
+}
+
+bool CompatibilityMatrix::Combiner::add(CompatibilityMatrix&& fragment, std::string* error) {
+    if (!checkType(fragment, error)) {
+        return false;
+    }
+    if (fragment.level() == Level::UNSPECIFIED) {
+        fragment.mLevel = mDeviceLevel;
+    }
+    if (fragment.level() < mDeviceLevel) {
+        // Only <kernel>s of these fragments are used, if any.
+        if (mKernelLevel == Level::UNSPECIFIED || fragment.level() < mKernelLevel) {
+            return true;
         }
+        auto& kernelsOnly = mOwned.emplace_back();
+        kernelsOnly.mLevel = fragment.level();
+        kernelsOnly.setFileName(fragment.fileName());
+        kernelsOnly.framework.mKernels = std::move(fragment.framework.mKernels);
+        fragment.framework.mKernelIndex.reset();
+        return addUnowned(&kernelsOnly, error);
     }
+    return addUnowned(&mOwned.emplace_back(std::move(fragment)), error);
+}
 
+std::unique_ptr<CompatibilityMatrix> CompatibilityMatrix::Combiner::combine(std::string* error) {
     // Add from low to high FCM version so that optional <kernel> requirements are added correctly.
     // See comment in addAllAsOptional.
-    std::sort(matrices->begin(), matrices->end(),
-              [](const auto& x, const auto& y) { return x.level() < y.level(); });
+    std::stable_sort(mFragments.begin(), mFragments.end(),
+                     [](const auto* x, const auto* y) { return x->level() < y->level(); });
 
     auto baseMatrix = std::make_unique<CompatibilityMatrix>();
-    baseMatrix->mLevel = deviceLevel;
+    baseMatrix->mLevel = mDeviceLevel;
     baseMatrix->mType = SchemaType::FRAMEWORK;
 
     std::vector<std::string> parsedFiles;
-    for (auto& e : *matrices) {
+    for (auto* e : mFragments) {
         bool success = false;
-        if (e.level() < deviceLevel) {
-            if (kernelLevel == Level::UNSPECIFIED) continue;
-            if (e.level() < kernelLevel) continue;
-            success = baseMatrix->addAllKernels(&e, error);
-        } else if (e.level() == deviceLevel) {
-            success = baseMatrix->addAll(&e, error);
+        if (e->level() < mDeviceLevel) {
+            if (mKernelLevel == Level::UNSPECIFIED) continue;
+            if (e->level() < mKernelLevel) continue;
+            success = baseMatrix->addAllKernels(e, error);
+        } else if (e->level() == mDeviceLevel) {
+            success = baseMatrix->addAll(e, error);
         } else {
-            success = baseMatrix->addAllAsOptional(&e, error);
+            success = baseMatrix->addAllAsOptional(e, error);
         }
         if (!success) {
             if (error) {
-                *error = "Conflict when merging \"" + e.fileName() + "\": " + *error + "\n" +
+                *error = "Conflict when merging \"" + e->fileName() + "\": " + *error + "\n" +
                          "Previous files:\n" + base::Join(parsedFiles, "\n");
             }
             return nullptr;
         }
-        parsedFiles.push_back(e.fileName());
+        parsedFiles.push_back(e->fileName());
     }
 
     return baseMatrix;
 }
 
+std::unique_ptr<CompatibilityMatrix> CompatibilityMatrix::combine(
+    Level deviceLevel, Level kernelLevel, std::vector<CompatibilityMatrix>* matrices,
+    std::string* error) {
+    Combiner combiner(deviceLevel, kernelLevel);
+    // Check type.
+    for (const auto& e : *matrices) {
+        if (!combiner.checkType(e, error) && error) {
+            return nullptr;
+        }
+    }
+    for (auto& e : *matrices) {
+        combiner.addUnowned(&e, error);
+    }
+
+    auto combined = combiner.combine(error);
+
+    // Leave matrices in the order they were combined, which is shown to users of assemble_vintf.
+    std::vector<CompatibilityMatrix> sorted;
+    sorted.reserve(matrices->size());
+    for (auto* e : combiner.mFragments) {
+        sorted.push_back(std::move(*e));
+    }
+    *matrices = std::move(sorted);
+
+    return combined;
+}
+
 std::unique_ptr<CompatibilityMatrix> CompatibilityMatrix::combineDeviceMatrices(
     std::vector<CompatibilityMatrix>* matrices, std::string* error) {
     auto baseMatrix = std::make_unique<CompatibilityMatrix>();
@@ -484,5 +549,9 @@ KernelVersion CompatibilityMatrix::getLatestKernelMinLts() const {
     return maxIt->minLts();
 }
 
+const details::KernelRequirementIndex& CompatibilityMatrix::kernelRequirementIndex() const {
+    return framework.mKernelIndex.get(framework.mKernels);
+}
+
 } // namespace vintf
 } // namespace android
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vintf/ContentVisitor.h>
+
+#include <vintf/CompatibilityMatrix.h>
+#include <vintf/HalManifest.h>
+#include <vintf/parse_string.h>
+
+namespace android {
+namespace vintf {
+
+namespace {
+
+std::string versionString(HalFormat format, const Version& version) {
+    return format == HalFormat::AIDL ? aidlVersionToString(version) : to_string(version);
+}
+
+std::string versionRangeString(HalFormat format, const VersionRange& range) {
+    return format == HalFormat::AIDL ? aidlVersionRangeToString(range) : to_string(range);
+}
+
+void visitLevel(std::string_view name, Level level, ContentVisitor* visitor) {
+    if (level != Level::UNSPECIFIED) visitor->visitString(name, to_string(level));
+}
+
+void visitOptionalString(std::string_view name, const std::optional<std::string>& value,
+                         ContentVisitor* visitor) {
+    if (value.has_value()) visitor->visitString(name, *value);
+}
+
+void visitStrings(std::string_view name, const std::set<std::string>& values,
+                  ContentVisitor* visitor) {
+    visitor->beginArray(name);
+    for (const auto& value : values) visitor->visitString("", value);
+    visitor->endArray();
+}
+
+void visitTransportArch(const TransportArch& transportArch, ContentVisitor* visitor) {
+    if (transportArch.transport == Transport::EMPTY) return;
+    visitor->beginObject("transport");
+    visitor->visitString("name", to_string(transportArch.transport));
+    if (transportArch.arch != Arch::ARCH_EMPTY) {
+        visitor->visitString("arch", to_string(transportArch.arch));
+    }
+    visitOptionalString("ip", transportArch.ip, visitor);
+    if (transportArch.port.has_value()) visitor->visitUint("port", *transportArch.port);
+    visitor->endObject();
+}
+
+template <typename XmlFileType, typename VisitAttributes>
+void visitXmlFiles(const XmlFileGroup<XmlFileType>& group, ContentVisitor* visitor,
+                   VisitAttributes&& visitAttributes) {
+    visitor->beginArray("xmlfiles");
+    for (const XmlFileType& xmlFile : group.getXmlFiles()) {
+        visitor->beginObject("");
+        visitor->visitString("name", xmlFile.name());
+        visitAttributes(xmlFile);
+        if (!xmlFile.overriddenPath().empty()) {
+            visitor->visitString("path", xmlFile.overriddenPath());
+        }
+        visitor->endObject();
+    }
+    visitor->endArray();
+}
+
+}  // namespace
+
+namespace details {
+
+// Walks the private members of HalManifest and CompatibilityMatrix for visitContent().
+class ContentWalker {
+   public:
+    static void walk(const HalManifest& manifest, ContentVisitor* visitor);
+    static void walk(const CompatibilityMatrix& matrix, ContentVisitor* visitor);
+
+   private:
+    static void walk(const ManifestHal& hal, ContentVisitor* visitor);
+    static void walk(const MatrixHal& hal, ContentVisitor* visitor);
+    static void walk(const KernelInfo& kernel, ContentVisitor* visitor);
+    static void walk(const MatrixKernel& kernel, ContentVisitor* visitor);
+    static void walk(std::string_view name, const std::vector<KernelConfig>& configs,
+                     ContentVisitor* visitor);
+};
+
+void ContentWalker::walk(const HalManifest& manifest, ContentVisitor* visitor) {
+    visitor->beginObject("manifest");
+    visitor->visitString("type", to_string(manifest.type()));
+    visitLevel("target-level", manifest.level(), visitor);
+
+    visitor->beginArray("hals");
+    for (const ManifestHal& hal : manifest.getHals()) {
+        walk(hal, visitor);
+    }
+    visitor->endArray();
+
+    if (manifest.type() == SchemaType::DEVICE) {
+        visitor->beginObject("sepolicy");
+        visitor->visitString("version", to_string(manifest.device.mSepolicyVersion));
+        visitor->endObject();
+        if (manifest.device.mKernel.has_value()) {
+            walk(*manifest.device.mKernel, visitor);
+        }
+    } else {
+        visitor->beginArray("vendor-ndks");
+        for (const VendorNdk& vendorNdk : manifest.framework.mVendorNdks) {
+            visitor->beginObject("");
+            visitor->visitString("version", vendorNdk.version());
+            visitStrings("libraries", vendorNdk.libraries(), visitor);
+            visitor->endObject();
+        }
+        visitor->endArray();
+        visitStrings("system-sdk", manifest.framework.mSystemSdk.versions(), visitor);
+    }
+
+    visitXmlFiles(manifest, visitor, [visitor](const ManifestXmlFile& xmlFile) {
+        visitor->visitString("version", to_string(xmlFile.version()));
+    });
+    visitor->endObject();
+}
+
+void ContentWalker::walk(const ManifestHal& hal, ContentVisitor* visitor) {
+    visitor->beginObject("");
+    visitor->visitString("format", to_string(hal.format));
+    visitor->visitString("name", hal.name);
+    visitTransportArch(hal.transportArch, visitor);
+    if (!hal.versions.empty()) {
+        visitor->beginArray("versions");
+        for (const Version& version : hal.versions) {
+            visitor->visitString("", versionString(hal.format, version));
+        }
+        visitor->endArray();
+    }
+    if (hal.isOverride()) visitor->visitBool("override", true);
+    visitOptionalString("updatable-via-apex", hal.updatableViaApex(), visitor);
+    if (hal.updatableViaSystem()) visitor->visitBool("updatable-via-system", true);
+    visitOptionalString("accessor", hal.accessor(), visitor);
+    visitLevel("max-level", hal.getMaxLevel(), visitor);
+    visitLevel("min-level", hal.getMinLevel(), visitor);
+
+    visitor->beginArray("instances");
+    hal.forEachInstance([&](const ManifestInstance& e) {
+        visitor->beginObject("");
+        visitor->visitString("version", versionString(e.format(), e.version()));
+        if (!e.interface().empty()) visitor->visitString("interface", e.interface());
+        visitor->visitString("instance", e.instance());
+        visitor->endObject();
+        return true;
+    });
+    visitor->endArray();
+    visitor->endObject();
+}
+
+void ContentWalker::walk(const KernelInfo& kernel, ContentVisitor* visitor) {
+    visitor->beginObject("kernel");
+    visitor->visitString("version", to_string(kernel.version()));
+    visitLevel("target-level", kernel.level(), visitor);
+    visitor->beginArray("configs");
+    for (const auto& [key, value] : kernel.configs()) {
+        visitor->beginObject("");
+        visitor->visitString("key", key);
+        visitor->visitString("value", value);
+        visitor->endObject();
+    }
+    visitor->endArray();
+    visitor->endObject();
+}
+
+void ContentWalker::walk(const CompatibilityMatrix& matrix, ContentVisitor* visitor) {
+    visitor->beginObject("compatibility-matrix");
+    visitor->visitString("type", to_string(matrix.type()));
+    visitLevel("level", matrix.level(), visitor);
+
+    visitor->beginArray("hals");
+    for (const MatrixHal& hal : matrix.getHals()) {
+        walk(hal, visitor);
+    }
+    visitor->endArray();
+
+    if (matrix.type() == SchemaType::FRAMEWORK) {
+        visitor->beginArray("kernels");
+        for (const MatrixKernel& kernel : matrix.framework.mKernels) {
+            walk(kernel, visitor);
+        }
+        visitor->endArray();
+
+        const Sepolicy& sepolicy = matrix.framework.mSepolicy;
+        visitor->beginObject("sepolicy");
+        visitor->visitUint("kernel-sepolicy-version", sepolicy.kernelSepolicyVersion());
+        visitor->beginArray("sepolicy-versions");
+        for (const SepolicyVersionRange& range : sepolicy.sepolicyVersions()) {
+            visitor->visitString("", to_string(range));
+        }
+        visitor->endArray();
+        visitor->endObject();
+
+        visitor->beginObject("avb");
+        visitor->visitString("vbmeta-version", to_string(matrix.framework.mAvbMetaVersion));
+        visitor->endObject();
+    } else {
+        const VendorNdk& vendorNdk = matrix.device.mVendorNdk;
+        if (!vendorNdk.version().empty()) {
+            visitor->beginObject("vendor-ndk");
+            visitor->visitString("version", vendorNdk.version());
+            visitStrings("libraries", vendorNdk.libraries(), visitor);
+            visitor->endObject();
+        }
+        visitStrings("system-sdk", matrix.device.mSystemSdk.versions(), visitor);
+    }
+
+    visitXmlFiles(matrix, visitor, [visitor](const MatrixXmlFile& xmlFile) {
+        visitor->visitString("format", to_string(xmlFile.format()));
+        visitor->visitBool("optional", xmlFile.optional());
+        visitor->visitString("version", to_string(xmlFile.versionRange()));
+    });
+    visitor->endObject();
+}
+
+void ContentWalker::walk(const MatrixHal& hal, ContentVisitor* visitor) {
+    visitor->beginObject("");
+    visitor->visitString("format", to_string(hal.format));
+    visitor->visitString("name", hal.name);
+    visitor->visitBool("optional", hal.optional);
+    if (hal.updatableViaApex) visitor->visitBool("updatable-via-apex", true);
+    visitor->beginArray("versions");
+    for (const VersionRange& range : hal.versionRanges) {
+        visitor->visitString("", versionRangeString(hal.format, range));
+    }
+    visitor->endArray();
+
+    visitor->beginArray("instances");
+    hal.forEachInstance([&](const MatrixInstance& e) {
+        visitor->beginObject("");
+        visitor->visitString("version", versionRangeString(e.format(), e.versionRange()));
+        if (!e.interface().empty()) visitor->visitString("interface", e.interface());
+        if (e.isRegex()) {
+            visitor->visitString("regex-instance", e.regexPattern());
+        } else {
+            visitor->visitString("instance", e.exactInstance());
+        }
+        visitor->endObject();
+        return true;
+    });
+    visitor->endArray();
+    visitor->endObject();
+}
+
+void ContentWalker::walk(const MatrixKernel& kernel, ContentVisitor* visitor) {
+    visitor->beginObject("");
+    visitor->visitString("version", to_string(kernel.minLts()));
+    visitLevel("level", kernel.getSourceMatrixLevel(), visitor);
+    if (!kernel.conditions().empty()) {
+        walk("conditions", kernel.conditions(), visitor);
+    }
+    walk("configs", kernel.configs(), visitor);
+    visitor->endObject();
+}
+
+void ContentWalker::walk(std::string_view name, const std::vector<KernelConfig>& configs,
+                         ContentVisitor* visitor) {
+    visitor->beginArray(name);
+    for (const auto& [key, value] : configs) {
+        visitor->beginObject("");
+        visitor->visitString("key", key);
+        visitor->visitString("type", to_string(value.mType));
+        visitor->visitString("value", to_string(value));
+        visitor->endObject();
+    }
+    visitor->endArray();
+}
+
+}  // namespace details
+
+void visitContent(const HalManifest& manifest, ContentVisitor* visitor) {
+    details::ContentWalker::walk(manifest, visitor);
+}
+
+void visitContent(const CompatibilityMatrix& matrix, ContentVisitor* visitor) {
+    details::ContentWalker::walk(matrix, visitor);
+}
+
+}  // namespace vintf
+}  // namespace android
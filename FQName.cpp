@@ -19,14 +19,18 @@
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
+#include <charconv>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <sstream>
 
 namespace android::vintf::details {
 
 FQName::FQName() : mIsIdentifier(false) {}
 
-bool FQName::parse(const std::string& s, FQName* into) {
+bool FQName::parse(std::string_view s, FQName* into) {
     return into->setTo(s);
 }
 
@@ -36,20 +40,6 @@ FQName::FQName(const std::string& package, const std::string& version, const std
     CHECK(setTo(package, majorVer, minorVer, name)) << string();
 }
 
-bool FQName::setTo(const std::string& package, size_t majorVer, size_t minorVer,
-                   const std::string& name) {
-    mPackage = package;
-    mMajor = majorVer;
-    mMinor = minorVer;
-    mName = name;
-
-    FQName other;
-    if (!parse(string(), &other)) return false;
-    if ((*this) != other) return false;
-    mIsIdentifier = other.isIdentifier();
-    return true;
-}
-
 bool FQName::isIdentifier() const {
     return mIsIdentifier;
 }
@@ -98,12 +88,22 @@ static const char* eatNumber(const char* l, const char* end) {
     return l;
 }
 
-bool FQName::setTo(const std::string& s) {
-    clear();
+// Parse [1-9][0-9]*|0 from |s|, which eatNumber() has already accepted.
+static bool parseNumber(std::string_view s, size_t* out) {
+    size_t value = 0;
+    for (char c : s) {
+        size_t digit = c - '0';
+        if (value > (std::numeric_limits<size_t>::max() - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+    *out = value;
+    return true;
+}
 
+bool FQName::parse(std::string_view s, Components* out) {
     if (s.empty()) return false;
 
-    const char* l = s.c_str();
+    const char* l = s.data();
     const char* end = l + s.size();
     // android.hardware.foo@10.12::IFoo.Type
     // S                   ES ES E S        E
@@ -115,9 +115,9 @@ bool FQName::setTo(const std::string& s) {
         const char* start = nullptr;
         const char* end = nullptr;
 
-        std::string string() {
-            if (start == nullptr) return std::string();
-            return std::string(start, end - start);
+        std::string_view view() const {
+            if (start == nullptr) return {};
+            return std::string_view(start, end - start);
         }
     };
     StartEnd package, major, minor, name;
@@ -159,23 +159,64 @@ bool FQName::setTo(const std::string& s) {
         package.start = package.end = nullptr;
     }
 
-    // failures after this goto fail to clear
-    mName = name.string();
-    mPackage = package.string();
+    *out = Components{};
+    out->name = name.view();
+    out->package = package.view();
 
     if (major.start != nullptr) {
-        if (!parseVersion(major.string(), minor.string(), &mMajor, &mMinor)) goto fail;
-    } else if (mPackage.empty() && name.end == eatIdent(name.start, name.end)) {
+        if (!parseNumber(major.view(), &out->major) || !parseNumber(minor.view(), &out->minor)) {
+            LOG(ERROR) << "numbers in " << major.view() << "." << minor.view()
+                       << " are out of range.";
+            return false;
+        }
+    } else if (out->package.empty() && name.end == eatIdent(name.start, name.end)) {
         // major.start == nullptr
-        mIsIdentifier = true;
+        out->isIdentifier = true;
     }
 
-    if (!mPackage.empty() && version().empty()) goto fail;
+    // A package requires a version. Note that a zero major version means no version.
+    if (!out->package.empty() && out->major == 0) return false;
 
     return true;
-fail:
-    clear();
-    return false;
+}
+
+bool FQName::setTo(const std::string& package, size_t majorVer, size_t minorVer,
+                   const std::string& name) {
+    mPackage = package;
+    mMajor = majorVer;
+    mMinor = minorVer;
+    mName = name;
+
+    // Fast path for package@major.minor[::name], which is always valid if the package and
+    // the name are.
+    auto isPackage = [](const std::string& str) {
+        return eatPackage(str.data(), str.data() + str.size()) == str.data() + str.size();
+    };
+    if (!mPackage.empty() && mMajor > 0 && isPackage(mPackage) &&
+        (mName.empty() || isPackage(mName))) {
+        mIsIdentifier = false;
+        return true;
+    }
+
+    FQName other;
+    if (!parse(string(), &other)) return false;
+    if ((*this) != other) return false;
+    mIsIdentifier = other.isIdentifier();
+    return true;
+}
+
+bool FQName::setTo(std::string_view s) {
+    Components components;
+    if (!parse(s, &components)) {
+        clear();
+        return false;
+    }
+    mIsIdentifier = components.isIdentifier;
+    mPackage.assign(components.package);
+    mMajor = components.major;
+    mMinor = components.minor;
+    mName.assign(components.name);
+    return true;
 }
 
 const std::string& FQName::package() const {
@@ -189,11 +230,6 @@ std::string FQName::version() const {
     return std::to_string(mMajor) + "." + std::to_string(mMinor);
 }
 
-std::string FQName::atVersion() const {
-    std::string v = version();
-    return v.empty() ? "" : ("@" + v);
-}
-
 void FQName::clear() {
     mIsIdentifier = false;
     mPackage.clear();
@@ -245,9 +281,14 @@ const std::string& FQName::name() const {
 std::string FQName::string() const {
     std::string out;
     out.append(mPackage);
-    out.append(atVersion());
+    if (hasVersion()) {
+        out.append("@");
+        out.append(std::to_string(mMajor));
+        out.append(".");
+        out.append(std::to_string(mMinor));
+    }
     if (!mName.empty()) {
-        if (!mPackage.empty() || !version().empty()) {
+        if (!mPackage.empty() || hasVersion()) {
             out.append("::");
         }
         out.append(mName);
@@ -256,12 +297,90 @@ std::string FQName::string() const {
     return out;
 }
 
+namespace {
+
+// Pieces of a string, compared as if they were concatenated.
+class StringPieces {
+   public:
+    StringPieces() = default;
+    StringPieces(const StringPieces&) = delete;
+    StringPieces& operator=(const StringPieces&) = delete;
+
+    void append(std::string_view piece) {
+        if (piece.empty()) return;
+        CHECK(mSize < std::size(mPieces));
+        mPieces[mSize++] = piece;
+    }
+    void append(size_t number, char (&buffer)[std::numeric_limits<size_t>::digits10 + 1]) {
+        auto result = std::to_chars(std::begin(buffer), std::end(buffer), number);
+        append(std::string_view(buffer, result.ptr - buffer));
+    }
+
+    // Same as std::string::compare on the concatenations.
+    int compare(const StringPieces& other) const {
+        size_t i = 0, j = 0, offset = 0, otherOffset = 0;
+        while (true) {
+            while (i < mSize && offset == mPieces[i].size()) {
+                ++i;
+                offset = 0;
+            }
+            while (j < other.mSize && otherOffset == other.mPieces[j].size()) {
+                ++j;
+                otherOffset = 0;
+            }
+            if (i == mSize || j == other.mSize) {
+                return (i == mSize ? 0 : 1) - (j == other.mSize ? 0 : 1);
+            }
+            size_t n = std::min(mPieces[i].size() - offset, other.mPieces[j].size() - otherOffset);
+            int c = memcmp(mPieces[i].data() + offset, other.mPieces[j].data() + otherOffset, n);
+            if (c != 0) return c;
+            offset += n;
+            otherOffset += n;
+        }
+    }
+
+   private:
+    // package, @, major, ., minor, ::, name and up to two pieces of suffix.
+    std::string_view mPieces[9];
+    size_t mSize = 0;
+};
+
+}  // namespace
+
+int FQName::compare(const FQName& other, std::initializer_list<std::string_view> suffix,
+                    std::initializer_list<std::string_view> otherSuffix) const {
+    char digits[4][std::numeric_limits<size_t>::digits10 + 1];
+    auto toPieces = [&digits](const FQName& fqName, std::initializer_list<std::string_view> end,
+                              size_t digitsIndex, StringPieces* pieces) {
+        // Same as string().
+        pieces->append(fqName.mPackage);
+        if (fqName.hasVersion()) {
+            pieces->append("@");
+            pieces->append(fqName.mMajor, digits[digitsIndex]);
+            pieces->append(".");
+            pieces->append(fqName.mMinor, digits[digitsIndex + 1]);
+        }
+        if (!fqName.mName.empty()) {
+            if (!fqName.mPackage.empty() || fqName.hasVersion()) {
+                pieces->append("::");
+            }
+            pieces->append(fqName.mName);
+        }
+        CHECK(end.size() <= 2);
+        for (std::string_view piece : end) pieces->append(piece);
+    };
+    StringPieces pieces, otherPieces;
+    toPieces(*this, suffix, 0, &pieces);
+    toPieces(other, otherSuffix, 2, &otherPieces);
+    return pieces.compare(otherPieces);
+}
+
 bool FQName::operator<(const FQName& other) const {
-    return string() < other.string();
+    return compare(other) < 0;
 }
 
 bool FQName::operator==(const FQName& other) const {
-    return string() == other.string();
+    return compare(other) == 0;
 }
 
 bool FQName::operator!=(const FQName& other) const {
@@ -278,10 +397,6 @@ FQName FQName::getPackageAndVersion() const {
     return FQName(package(), version(), "");
 }
 
-std::vector<std::string> FQName::getPackageComponents() const {
-    return base::Split(package(), ".");
-}
-
 bool FQName::hasVersion() const {
     return mMajor > 0;
 }
@@ -303,20 +418,13 @@ size_t FQName::getPackageMinorVersion() const {
 }
 
 bool FQName::inPackage(const std::string& package) const {
-    std::vector<std::string> components = getPackageComponents();
-    std::vector<std::string> inComponents = base::Split(package, ".");
-
-    if (inComponents.size() > components.size()) {
+    // Same as comparing components separated by '.', given that mPackage has no empty
+    // components.
+    std::string_view self = mPackage;
+    if (self.substr(0, package.size()) != package) {
         return false;
     }
-
-    for (size_t i = 0; i < inComponents.size(); i++) {
-        if (inComponents[i] != components[i]) {
-            return false;
-        }
-    }
-
-    return true;
+    return self.size() == package.size() || self[package.size()] == '.';
 }
 
 }  // namespace android::vintf::details
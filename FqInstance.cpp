@@ -48,8 +48,9 @@ bool FqInstance::hasVersion() const {
     return mFqName.hasVersion();
 }
 
-std::string FqInstance::getInterface() const {
-    return hasInterface() ? mFqName.getInterfaceName() : "";
+const std::string& FqInstance::getInterface() const {
+    static const std::string kEmpty;
+    return hasInterface() ? mFqName.getInterfaceName() : kEmpty;
 }
 
 bool FqInstance::hasInterface() const {
@@ -94,10 +95,14 @@ bool FqInstance::isValid() const {
     return false;
 }
 
-bool FqInstance::setTo(const std::string& s) {
+bool FqInstance::setTo(std::string_view s) {
     auto pos = s.find(INSTANCE_SEP);
     if (!mFqName.setTo(s.substr(0, pos))) return false;
-    mInstance = pos == std::string::npos ? std::string{} : s.substr(pos + 1);
+    if (pos == std::string_view::npos) {
+        mInstance.clear();
+    } else {
+        mInstance.assign(s.substr(pos + 1));
+    }
 
     return isValid();
 }
@@ -124,12 +129,20 @@ std::string FqInstance::string() const {
     return ret;
 }
 
+// Same as comparing string()s.
+static int compare(const FQName& fqName, const std::string& instance, const FQName& otherFqName,
+                   const std::string& otherInstance) {
+    std::string_view sep(&INSTANCE_SEP, 1);
+    return fqName.compare(otherFqName, {instance.empty() ? "" : sep, instance},
+                          {otherInstance.empty() ? "" : sep, otherInstance});
+}
+
 bool FqInstance::operator<(const FqInstance& other) const {
-    return string() < other.string();
+    return compare(mFqName, mInstance, other.mFqName, other.mInstance) < 0;
 }
 
 bool FqInstance::operator==(const FqInstance& other) const {
-    return string() == other.string();
+    return compare(mFqName, mInstance, other.mFqName, other.mInstance) == 0;
 }
 
 bool FqInstance::operator!=(const FqInstance& other) const {
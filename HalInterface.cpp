@@ -52,6 +52,11 @@ bool HalInterface::hasAnyInstance() const {
     return found;
 }
 
+bool HalInterface::hasInstance(const std::string& instanceOrPattern, bool isRegex) const {
+    const auto& set = isRegex ? mRegexes : mInstances;
+    return set.find(instanceOrPattern) != set.end();
+}
+
 bool HalInterface::insertInstance(const std::string& instanceOrPattern, bool isRegex) {
     if (isRegex) {
         return mRegexes.insert(instanceOrPattern).second;
@@ -68,5 +73,22 @@ bool HalInterface::removeInstance(const std::string& instanceOrPattern, bool isR
     }
 }
 
+size_t HalInterface::removeInstancesIf(
+    const std::function<bool(const std::string& instanceOrPattern, bool isRegex)>& predicate) {
+    size_t removed = 0;
+    for (bool isRegex : {false, true}) {
+        auto& set = isRegex ? mRegexes : mInstances;
+        for (auto it = set.begin(); it != set.end();) {
+            if (predicate(*it, isRegex)) {
+                it = set.erase(it);
+                ++removed;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
 } // namespace vintf
 } // namespace android
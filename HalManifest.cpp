@@ -23,10 +23,12 @@
 
 #include <mutex>
 #include <set>
+#include <utility>
 
 #include <android-base/strings.h>
 
 #include "CompatibilityMatrix.h"
+#include "ProvidedInstances.h"
 #include "constants-private.h"
 #include "constants.h"
 #include "parse_string.h"
@@ -41,7 +43,7 @@ using details::InstancesOfVersion;
 using details::mergeField;
 
 // Check <version> tag for all <hal> with the same name.
-bool HalManifest::shouldAdd(const ManifestHal& hal, std::string* error) const {
+bool HalManifest::shouldAdd(const ManifestHal& hal, std::string* error) {
     if (!hal.isValid(error)) {
         if (error) {
             error->insert(0, "HAL '" + hal.name + "' is not valid: ");
@@ -60,30 +62,30 @@ bool HalManifest::shouldAdd(const ManifestHal& hal, std::string* error) const {
     return addingConflictingFqInstance(hal, error);
 }
 
-bool HalManifest::addingConflictingMajorVersion(const ManifestHal& hal, std::string* error) const {
+bool HalManifest::addingConflictingMajorVersion(const ManifestHal& hal, std::string* error) {
     // Skip checking for AIDL HALs because they all contain kFakeAidlMajorVersion.
     if (hal.format == HalFormat::AIDL) {
         return true;
     }
 
-    auto existingHals = mHals.equal_range(hal.name);
-    std::map<size_t, std::tuple<const ManifestHal*, Version>> existing;
-    for (auto it = existingHals.first; it != existingHals.second; ++it) {
-        const ManifestHal& existingHal = it->second;
-        for (const auto& v : existingHal.versions) {
-            // Assume integrity on existingHals, so no check on emplace().second
-            existing.emplace(v.majorVer, std::make_tuple(&existingHal, v));
-        }
-    }
+    const ConflictIndex::Entry& indexed = getConflictIndexEntry(hal.name);
+    // Versions of |hal| itself.
+    std::map<size_t, Version> adding;
     bool success = true;
     for (const auto& v : hal.versions) {
-        auto&& [existingIt, inserted] = existing.emplace(v.majorVer, std::make_tuple(&hal, v));
-        if (inserted) {
-            continue;
+        const ManifestHal* existingHal = &hal;
+        Version existingVersion;
+        if (auto it = indexed.majorVersions.find(v.majorVer); it != indexed.majorVersions.end()) {
+            std::tie(existingHal, existingVersion) = it->second;
+        } else {
+            auto&& [addingIt, inserted] = adding.emplace(v.majorVer, v);
+            if (inserted) {
+                continue;
+            }
+            existingVersion = addingIt->second;
         }
         success = false;
         if (error) {
-            auto&& [existingHal, existingVersion] = existingIt->second;
             *error = "Conflicting major version: " + to_string(existingVersion);
             if (!existingHal->fileName().empty()) {
                 *error += " (from " + existingHal->fileName() + ")";
@@ -100,38 +102,38 @@ bool HalManifest::addingConflictingMajorVersion(const ManifestHal& hal, std::str
     return success;
 }
 
-bool HalManifest::addingConflictingFqInstance(const ManifestHal& halToAdd,
-                                              std::string* error) const {
+// Key of |manifestInstance| in ConflictIndex::Entry::fqInstances.
+static FqInstance conflictKey(const ManifestInstance& manifestInstance) {
+    auto versionZero = manifestInstance.version().withMinor(0);
+    return manifestInstance.withVersion(versionZero).getFqInstance();
+}
+
+// Return the first instance of |hal| that satisfies |predicate|. Assumes it exists.
+template <typename Predicate>
+static ManifestInstance findInstance(const ManifestHal& hal, Predicate predicate) {
+    std::optional<ManifestInstance> ret;
+    hal.forEachInstance([&](const auto& manifestInstance) {
+        if (!predicate(manifestInstance)) {
+            return true;  // continue
+        }
+        ret = manifestInstance;
+        return false;  // break
+    });
+    CHECK(ret.has_value()) << "Indexed instance of " << hal.name << " is missing";
+    return *ret;
+}
+
+bool HalManifest::addingConflictingFqInstance(const ManifestHal& halToAdd, std::string* error) {
     if (mSourceMetaVersion < kMetaVersionNoHalInterfaceInstance) {
         return true;
     }
 
-    auto existingHals = mHals.equal_range(halToAdd.name);
-
-    // Key: FqInstance with minor version 0
-    // Value: original HAL and FqInstance
-    std::map<FqInstance, std::tuple<const ManifestHal*, ManifestInstance>> existing;
-    std::map<std::string, std::tuple<const ManifestHal*, ManifestInstance>> existingAccessors;
-    for (auto it = existingHals.first; it != existingHals.second; ++it) {
-        const ManifestHal& existingHal = it->second;
-        bool success = existingHal.forEachInstance(
-            [&existingHal, &existing, &existingAccessors](const auto& manifestInstance) {
-                auto versionZero = manifestInstance.version().withMinor(0);
-                auto key = manifestInstance.withVersion(versionZero).getFqInstance();
-                // Assume integrity on existingHals, so no check on emplace().second
-                existing.emplace(key, std::make_tuple(&existingHal, manifestInstance));
-                if (auto accessor = manifestInstance.accessor(); accessor.has_value()) {
-                    existingAccessors.emplace(accessor.value(),
-                                              std::make_tuple(&existingHal, manifestInstance));
-                }
-                return true;  // continue
-            });
-        if (!success) {
-            return false;
-        }
-    }
-    return halToAdd.forEachInstance([&halToAdd, &existing, &existingAccessors,
-                                     &error](const auto& manifestInstanceToAdd) {
+    const ConflictIndex::Entry& indexed = getConflictIndexEntry(halToAdd.name);
+
+    // Instances of |halToAdd| itself, with the same keys as ConflictIndex::Entry.
+    std::map<FqInstance, ManifestInstance> adding;
+    std::map<std::string, ManifestInstance> addingAccessors;
+    return halToAdd.forEachInstance([&](const auto& manifestInstanceToAdd) {
         auto constructErrorMessage = [&halToAdd, &manifestInstanceToAdd](
                                          const auto& existingManifestInstance,
                                          const auto& existingHal) {
@@ -146,15 +148,21 @@ bool HalManifest::addingConflictingFqInstance(const ManifestHal& halToAdd,
             return errorMsg;
         };
 
-        auto versionZero = manifestInstanceToAdd.version().withMinor(0);
-        auto key = manifestInstanceToAdd.withVersion(versionZero).getFqInstance();
+        auto key = conflictKey(manifestInstanceToAdd);
 
         // Check duplicate FqInstance.
-        auto&& [existingIt, inserted] =
-            existing.emplace(key, std::make_tuple(&halToAdd, manifestInstanceToAdd));
-        if (!inserted) {
+        std::optional<std::tuple<const ManifestHal*, ManifestInstance>> conflict;
+        if (auto it = indexed.fqInstances.find(key); it != indexed.fqInstances.end()) {
+            conflict.emplace(it->second, findInstance(*it->second, [&key](const auto& e) {
+                                 return conflictKey(e) == key;
+                             }));
+        } else if (auto&& [addingIt, inserted] = adding.emplace(key, manifestInstanceToAdd);
+                   !inserted) {
+            conflict.emplace(&halToAdd, addingIt->second);
+        }
+        if (conflict.has_value()) {
             if (error) {
-                auto&& [existingHal, existingManifestInstance] = existingIt->second;
+                auto&& [existingHal, existingManifestInstance] = *conflict;
                 *error = "Conflicting FqInstance: ";
                 *error += constructErrorMessage(existingManifestInstance, existingHal);
                 *error +=
@@ -164,17 +172,24 @@ bool HalManifest::addingConflictingFqInstance(const ManifestHal& halToAdd,
         }
 
         // Check duplicate accessor.
-        auto accessor = manifestInstanceToAdd.accessor();
+        const auto& accessor = manifestInstanceToAdd.accessor();
         if (!accessor.has_value()) {
             return true;
         }
-        auto&& [existingAccessorIt, insertedAccessor] = existingAccessors.emplace(
-            accessor.value(), std::make_tuple(&halToAdd, manifestInstanceToAdd));
-        if (insertedAccessor) {
+        if (auto it = indexed.accessors.find(*accessor); it != indexed.accessors.end()) {
+            conflict.emplace(it->second, findInstance(*it->second, [&accessor](const auto& e) {
+                                 return e.accessor() == accessor;
+                             }));
+        } else if (auto&& [addingIt, inserted] =
+                       addingAccessors.emplace(*accessor, manifestInstanceToAdd);
+                   !inserted) {
+            conflict.emplace(&halToAdd, addingIt->second);
+        }
+        if (!conflict.has_value()) {
             return true;
         }
         if (error) {
-            auto&& [existingHal, existingManifestInstance] = existingAccessorIt->second;
+            auto&& [existingHal, existingManifestInstance] = *conflict;
             *error = "Conflicting Accessor: ";
             *error += constructErrorMessage(existingManifestInstance, existingHal);
             *error +=
@@ -185,6 +200,70 @@ bool HalManifest::addingConflictingFqInstance(const ManifestHal& halToAdd,
     });
 }
 
+const HalManifest::ConflictIndex::Entry& HalManifest::getConflictIndexEntry(
+    const std::string& name) {
+    if (!mConflictIndex.valid) {
+        mConflictIndex.clear();
+        // Iterate const HALs so that mConflictIndex is not invalidated.
+        for (const ManifestHal& hal : std::as_const(*this).getHals()) {
+            indexHal(hal);
+        }
+        mConflictIndex.valid = true;
+    } else if (mConflictIndex.stale.count(name) > 0) {
+        reindexHals(name);
+    }
+    static const ConflictIndex::Entry kEmptyEntry;
+    auto it = mConflictIndex.entries.find(name);
+    return it == mConflictIndex.entries.end() ? kEmptyEntry : it->second;
+}
+
+void HalManifest::indexHal(const ManifestHal& hal) {
+    ConflictIndex::Entry& entry = mConflictIndex.entries[hal.name];
+    for (const auto& v : hal.versions) {
+        entry.majorVersions.emplace(v.majorVer, std::make_pair(&hal, v));
+    }
+    hal.forEachInstance([&](const auto& manifestInstance) {
+        entry.fqInstances.emplace(conflictKey(manifestInstance), &hal);
+        if (const auto& accessor = manifestInstance.accessor(); accessor.has_value()) {
+            entry.accessors.emplace(*accessor, &hal);
+        }
+        return true;  // continue
+    });
+}
+
+std::vector<ManifestHal*> HalManifest::getHals(const std::string& name) {
+    if (mConflictIndex.valid) {
+        mConflictIndex.stale.insert(name);
+    }
+    return HalGroup::getHals(name);
+}
+
+ManifestHal* HalManifest::getAnyHal(const std::string& name) {
+    if (mConflictIndex.valid) {
+        mConflictIndex.stale.insert(name);
+    }
+    return HalGroup::getAnyHal(name);
+}
+
+HalManifest::HalIterable HalManifest::getHals() {
+    mConflictIndex.clear();
+    return HalGroup::getHals();
+}
+
+void HalManifest::removeHalsIf(const std::function<bool(const ManifestHal&)>& shouldRemove) {
+    std::set<std::string> removedNames;
+    HalGroup::removeHalsIf([&](const ManifestHal& hal) {
+        if (!shouldRemove(hal)) {
+            return false;
+        }
+        removedNames.insert(hal.getName());
+        return true;
+    });
+    for (const auto& name : removedNames) {
+        reindexHals(name);
+    }
+}
+
 // Remove elements from "list" if p(element) returns true.
 template <typename List, typename Predicate>
 static void removeIf(List& list, Predicate predicate) {
@@ -198,21 +277,41 @@ static void removeIf(List& list, Predicate predicate) {
 }
 
 void HalManifest::removeHals(const std::string& name, size_t majorVer) {
-    removeIf(mHals, [&name, majorVer](auto& existingHalPair) {
-        auto& existingHal = existingHalPair.second;
-        if (existingHal.name != name) {
-            return false;
-        }
+    removeHals(name, std::set<size_t>{majorVer});
+}
+
+void HalManifest::removeHals(const std::string& name, const std::set<size_t>& majorVers) {
+    auto hasMajorVer = [&majorVers](const auto& version) {
+        return majorVers.find(version.majorVer) != majorVers.end();
+    };
+    auto range = mHals.equal_range(name);
+    for (auto it = range.first; it != range.second;) {
+        auto& existingHal = it->second;
         auto& existingVersions = existingHal.versions;
-        removeIf(existingVersions, [majorVer](const auto& existingVersion) {
-            return existingVersion.majorVer == majorVer;
-        });
+        removeIf(existingVersions, hasMajorVer);
         auto& existingManifestInstances = existingHal.mManifestInstances;
-        removeIf(existingManifestInstances, [majorVer](const auto& existingManifestInstance) {
-            return existingManifestInstance.version().majorVer == majorVer;
+        removeIf(existingManifestInstances, [&hasMajorVer](const auto& existingManifestInstance) {
+            return hasMajorVer(existingManifestInstance.version());
         });
-        return existingVersions.empty() && existingManifestInstances.empty();
-    });
+        if (existingVersions.empty() && existingManifestInstances.empty()) {
+            it = mHals.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    reindexHals(name);
+}
+
+void HalManifest::reindexHals(const std::string& name) {
+    if (!mConflictIndex.valid) {
+        return;
+    }
+    mConflictIndex.entries.erase(name);
+    mConflictIndex.stale.erase(name);
+    auto range = mHals.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+        indexHal(it->second);
+    }
 }
 
 bool HalManifest::add(ManifestHal&& halToAdd, std::string* error) {
@@ -221,23 +320,31 @@ bool HalManifest::add(ManifestHal&& halToAdd, std::string* error) {
             // Special syntax when there are no instances at all. Remove all existing HALs
             // with the given name.
             mHals.erase(halToAdd.name);
+            reindexHals(halToAdd.name);
         }
+        // Collect major versions first so that existing HALs are pruned in one pass.
+        std::set<size_t> majorVers;
         // If there are <version> tags, remove all existing major versions that causes a conflict.
         for (const Version& versionToAdd : halToAdd.versions) {
-            removeHals(halToAdd.name, versionToAdd.majorVer);
+            majorVers.insert(versionToAdd.majorVer);
         }
         // If there are <fqname> tags, remove all existing major versions that causes a conflict.
-        halToAdd.forEachInstance([this, &halToAdd](const auto& manifestInstanceToAdd) {
-            removeHals(halToAdd.name, manifestInstanceToAdd.version().majorVer);
+        halToAdd.forEachInstance([&majorVers](const auto& manifestInstanceToAdd) {
+            majorVers.insert(manifestInstanceToAdd.version().majorVer);
             return true;  // continue
         });
+        removeHals(halToAdd.name, majorVers);
     }
 
     if (!shouldAdd(halToAdd, error)) {
         return false;
     }
 
-    CHECK(addInternal(std::move(halToAdd)) != nullptr);
+    const ManifestHal* added = addInternal(std::move(halToAdd));
+    CHECK(added != nullptr);
+    if (mConflictIndex.valid) {
+        indexHal(*added);
+    }
     return true;
 }
 
@@ -250,6 +357,7 @@ bool HalManifest::addAllHals(HalManifest* other, std::string* error) {
             return false;
         }
     }
+    other->mConflictIndex.clear();
     other->mHals.clear();
     return true;
 }
@@ -352,38 +460,55 @@ void multilineIndent(std::ostream& os, size_t indent, const Container& lines) {
     }
 }
 
+bool HalManifest::isHalCompatible(const MatrixHal& matrixHal) const {
+    details::ProvidedInstances providedInstances;
+    std::set<Version> versions;
+    for (const ManifestHal* manifestHal : getHals(matrixHal.name)) {
+        providedInstances.add(*manifestHal);
+        manifestHal->appendAllVersions(&versions);
+    }
+    return matrixHal.isCompatible(providedInstances, versions);
+}
+
+std::string HalManifest::describeIncompatibleHal(const MatrixHal& matrixHal) const {
+    std::set<std::string> manifestInstanceDesc;
+    std::set<Version> versions;
+    for (const ManifestHal* manifestHal : getHals(matrixHal.name)) {
+        manifestHal->forEachInstance([&](const auto& manifestInstance) {
+            manifestInstanceDesc.insert(manifestInstance.descriptionWithoutPackage());
+            return true;
+        });
+        manifestHal->appendAllVersions(&versions);
+    }
+
+    std::ostringstream oss;
+    oss << matrixHal.name << ":\n    required: ";
+    multilineIndent(oss, 8, android::vintf::expandInstances(matrixHal));
+    oss << "\n    provided: ";
+    if (manifestInstanceDesc.empty()) {
+        multilineIndent(oss, 8, versions);
+    } else {
+        multilineIndent(oss, 8, manifestInstanceDesc);
+    }
+    return oss.str();
+}
+
+bool HalManifest::hasIncompatibleHals(const CompatibilityMatrix& mat) const {
+    for (const MatrixHal& matrixHal : mat.getHals()) {
+        if (!matrixHal.optional && !isHalCompatible(matrixHal)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // For each hal in mat, there must be a hal in manifest that supports this.
+// Descriptions are only rendered for HALs that are incompatible.
 std::vector<std::string> HalManifest::checkIncompatibleHals(const CompatibilityMatrix& mat) const {
     std::vector<std::string> ret;
-    for (const MatrixHal &matrixHal : mat.getHals()) {
-        if (matrixHal.optional) {
-            continue;
-        }
-
-        std::set<FqInstance> manifestInstances;
-        std::set<std::string> manifestInstanceDesc;
-        std::set<Version> versions;
-        for (const ManifestHal* manifestHal : getHals(matrixHal.name)) {
-            manifestHal->forEachInstance([&](const auto& manifestInstance) {
-                manifestInstances.insert(manifestInstance.getFqInstance());
-                manifestInstanceDesc.insert(manifestInstance.descriptionWithoutPackage());
-                return true;
-            });
-            manifestHal->appendAllVersions(&versions);
-        }
-
-        if (!matrixHal.isCompatible(manifestInstances, versions)) {
-            std::ostringstream oss;
-            oss << matrixHal.name << ":\n    required: ";
-            multilineIndent(oss, 8, android::vintf::expandInstances(matrixHal));
-            oss << "\n    provided: ";
-            if (manifestInstances.empty()) {
-                multilineIndent(oss, 8, versions);
-            } else {
-                multilineIndent(oss, 8, manifestInstanceDesc);
-            }
-
-            ret.insert(ret.end(), oss.str());
+    for (const MatrixHal& matrixHal : mat.getHals()) {
+        if (!matrixHal.optional && !isHalCompatible(matrixHal)) {
+            ret.push_back(describeIncompatibleHal(matrixHal));
         }
     }
     return ret;
@@ -502,9 +627,9 @@ bool HalManifest::checkCompatibility(const CompatibilityMatrix& mat, std::string
         }
         return false;
     }
-    auto incompatibleHals = checkIncompatibleHals(mat);
-    if (!incompatibleHals.empty()) {
+    if (hasIncompatibleHals(mat)) {
         if (error != nullptr) {
+            auto incompatibleHals = checkIncompatibleHals(mat);
             *error = "HALs incompatible.";
             if (mat.level() != Level::UNSPECIFIED)
                 *error += " Matrix level = " + to_string(mat.level()) + ".";
@@ -549,7 +674,7 @@ bool HalManifest::checkCompatibility(const CompatibilityMatrix& mat, std::string
         Level kernelTagLevel = kernel()->level();
         if (flags.isKernelEnabled() && shouldCheckKernelCompatibility() &&
             kernel()
-                ->getMatchedKernelRequirements(mat.framework.mKernels, kernelTagLevel, error)
+                ->getMatchedKernelRequirements(mat.kernelRequirementIndex(), kernelTagLevel, error)
                 .empty()) {
             return false;
         }
@@ -574,12 +699,12 @@ CompatibilityMatrix HalManifest::generateCompatibleMatrix(bool optional) const {
             return true;
         }
 
-        matrix.add(MatrixHal{
-            .format = e.format(),
-            .name = e.package(),
-            .versionRanges = {VersionRange{e.version().majorVer, e.version().minorVer}},
-            .optional = optional,
-            .interfaces = {{e.interface(), HalInterface{e.interface(), {e.instance()}}}}});
+        matrix.add(MatrixHal{e.format(),
+                             e.package(),
+                             {VersionRange{e.version().majorVer, e.version().minorVer}},
+                             optional,
+                             false /* updatableViaApex */,
+                             {{e.interface(), HalInterface{e.interface(), {e.instance()}}}}});
         return true;
     });
     if (mType == SchemaType::FRAMEWORK) {
@@ -734,10 +859,9 @@ bool HalManifest::hasNativeInstance(const std::string& package, const std::strin
 
 bool HalManifest::insertInstance(const FqInstance& fqInstance, Transport transport, Arch arch,
                                  HalFormat format, std::string* error) {
-    for (ManifestHal& hal : getHals()) {
-        if (hal.name == fqInstance.getPackage() && hal.format == format &&
-            hal.transport() == transport && hal.arch() == arch) {
-            return hal.insertInstance(fqInstance, error);
+    for (ManifestHal* hal : getHals(fqInstance.getPackage())) {
+        if (hal->format == format && hal->transport() == transport && hal->arch() == arch) {
+            return hal->insertInstance(fqInstance, error);
         }
     }
 
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <json/json.h>
+#include <vintf/ContentVisitor.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace vintf {
+namespace details {
+
+// Builds a Json::Value from the visited content. The outermost object is the root; its name
+// is ignored. Header-only so that libvintf itself does not depend on jsoncpp.
+class JsonContentVisitor : public ContentVisitor {
+   public:
+    const Json::Value& root() const { return mRoot; }
+
+    void beginObject(std::string_view name) override {
+        mStack.push_back(&add(name, Json::Value(Json::objectValue)));
+    }
+    void endObject() override { mStack.pop_back(); }
+    void beginArray(std::string_view name) override {
+        mStack.push_back(&add(name, Json::Value(Json::arrayValue)));
+    }
+    void endArray() override { mStack.pop_back(); }
+    void visitString(std::string_view name, std::string_view value) override {
+        add(name, Json::Value(std::string(value)));
+    }
+    void visitUint(std::string_view name, uint64_t value) override {
+        add(name, Json::Value(static_cast<Json::UInt64>(value)));
+    }
+    void visitBool(std::string_view name, bool value) override { add(name, Json::Value(value)); }
+
+   private:
+    Json::Value& add(std::string_view name, Json::Value&& value) {
+        if (mStack.empty()) return mRoot = std::move(value);
+        Json::Value* parent = mStack.back();
+        if (parent->isArray()) return parent->append(std::move(value));
+        return (*parent)[std::string(name)] = std::move(value);
+    }
+
+    Json::Value mRoot;
+    std::vector<Json::Value*> mStack;
+};
+
+}  // namespace details
+}  // namespace vintf
+}  // namespace android
@@ -15,6 +15,7 @@
  */
 #include "KernelInfo.h"
 
+#include "KernelRequirementIndex.h"
 #include "parse_string.h"
 #include "parse_xml.h"
 #include "parse_xml_internal.h"
@@ -74,45 +75,54 @@ bool KernelInfo::matchKernelVersion(const KernelVersion& minLts) const {
 
 std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
     const std::vector<MatrixKernel>& kernels, Level kernelLevel, std::string* error) const {
-    std::map<Level, std::vector<const MatrixKernel*>> kernelsForLevel;
-    for (const MatrixKernel& matrixKernel : kernels) {
-        const auto& minLts = matrixKernel.minLts();
-        auto matrixKernelLevel = matrixKernel.getSourceMatrixLevel();
+    // Only the branch of this kernel is looked up.
+    return getMatchedKernelRequirements(
+        details::KernelRequirementIndex(kernels, mVersion.dropMinor()), kernelLevel, error);
+}
 
-        // Filter out kernels with different x.y.
-        if (mVersion.dropMinor() != minLts.dropMinor()) {
-            continue;
-        }
+std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
+    const details::KernelRequirementIndex& index, Level kernelLevel, std::string* error) const {
+    using LevelRequirements = details::KernelRequirementIndex::LevelRequirements;
 
-        // Check matrix kernel level
+    // Only kernels with the same x.y are considered.
+    const auto* branch = index.find(mVersion);
 
-        // Use legacy behavior when kernel FCM version is not specified. Blindly add all of them
-        // here. The correct one (with smallest matrixKernelLevel) will be picked later.
-        if (kernelLevel == Level::UNSPECIFIED) {
-            kernelsForLevel[matrixKernelLevel].push_back(&matrixKernel);
-            continue;
-        }
+    // Kernel requirements for each level, in ascending order of levels.
+    std::vector<const LevelRequirements*> kernelsForLevel;
+    if (branch != nullptr) {
+        for (const LevelRequirements& levelRequirements : branch->levels) {
+            auto matrixKernelLevel = levelRequirements.level;
 
-        if (matrixKernelLevel == Level::UNSPECIFIED) {
-            if (error) {
-                *error = "Seen unspecified source matrix level; this should not happen.";
+            // Check matrix kernel level
+
+            // Use legacy behavior when kernel FCM version is not specified. Blindly add all of
+            // them here. The correct one (with smallest matrixKernelLevel) will be picked later.
+            if (kernelLevel == Level::UNSPECIFIED) {
+                kernelsForLevel.push_back(&levelRequirements);
+                continue;
             }
-            return {};
-        }
 
-        if (matrixKernelLevel < kernelLevel) {
-            continue;
-        }
+            if (matrixKernelLevel == Level::UNSPECIFIED) {
+                if (error) {
+                    *error = "Seen unspecified source matrix level; this should not happen.";
+                }
+                return {};
+            }
+
+            if (matrixKernelLevel < kernelLevel) {
+                continue;
+            }
 
-        // matrix level >= kernel level
+            // matrix level >= kernel level
 
-        // for kernel level >= S, do not allow matrix level > kernel level; i.e. only check
-        // matching KMI.
-        if (kernelLevel >= Level::S && matrixKernelLevel > kernelLevel) {
-            continue;
-        }
+            // for kernel level >= S, do not allow matrix level > kernel level; i.e. only check
+            // matching KMI.
+            if (kernelLevel >= Level::S && matrixKernelLevel > kernelLevel) {
+                continue;
+            }
 
-        kernelsForLevel[matrixKernelLevel].push_back(&matrixKernel);
+            kernelsForLevel.push_back(&levelRequirements);
+        }
     }
 
     if (kernelsForLevel.empty()) {
@@ -122,7 +132,7 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
                << " at kernel FCM version "
                << (kernelLevel == Level::UNSPECIFIED ? "unspecified" : to_string(kernelLevel))
                << ". The following kernel requirements are checked:";
-            for (const MatrixKernel& matrixKernel : kernels) {
+            for (const MatrixKernel& matrixKernel : index.kernels()) {
                 ss << "\n  Minimum LTS: " << matrixKernel.minLts()
                    << ", kernel FCM version: " << matrixKernel.getSourceMatrixLevel()
                    << (matrixKernel.conditions().empty() ? "" : ", with conditionals");
@@ -132,6 +142,9 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
         return {};
     }
 
+    // Each config of the branch is looked up and parsed at most once, for all levels.
+    details::KernelConfigValues configValues(*branch, mConfigs);
+
     // At this point, kernelsForLevel contains kernel requirements for each level.
     // For example, if the running kernel version is 4.14.y then kernelsForLevel contains
     // 4.14-p, 4.14-q, 4.14-r.
@@ -147,7 +160,7 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
     // state kernel FCM version explicitly in the device manifest. The value is automatically
     // inserted for devices with target FCM version >= 5 when manifest is built with assemble_vintf.
     if (kernelLevel == Level::UNSPECIFIED) {
-        auto [matrixKernelLevel, matrixKernels] = *kernelsForLevel.begin();
+        auto [matrixKernelLevel, matrixKernels] = *kernelsForLevel.front();
 
         // Do not allow *-r and above kernels.
         if (matrixKernelLevel != Level::UNSPECIFIED && matrixKernelLevel >= Level::R) {
@@ -163,7 +176,8 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
             return {};
         }
 
-        auto matchedMatrixKernels = getMatchedKernelVersionAndConfigs(matrixKernels, error);
+        auto matchedMatrixKernels =
+            getMatchedKernelVersionAndConfigs(matrixKernels, &configValues, error);
         if (matchedMatrixKernels.empty()) {
             return {};
         }
@@ -175,7 +189,7 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
     // For kernel FCM version >= S, only matching KMI is accepted. e.g. kernel FCM version 6 (S)
     // matches 4.19-stable, 5.10-android12, 5.4-android12, not x.y-android13.
     // Note we already filtered |kernels| based on kernel version.
-    auto [firstMatrixKernelLevel, firstMatrixKernels] = *kernelsForLevel.begin();
+    Level firstMatrixKernelLevel = kernelsForLevel.front()->level;
     if (firstMatrixKernelLevel == Level::UNSPECIFIED || firstMatrixKernelLevel > kernelLevel) {
         if (error) {
             *error = "Kernel FCM Version is " + to_string(kernelLevel) + " and kernel version is " +
@@ -185,13 +199,14 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
         }
         return {};
     }
-    for (auto [matrixKernelLevel, matrixKernels] : kernelsForLevel) {
+    for (const LevelRequirements* levelRequirements : kernelsForLevel) {
+        const auto& [matrixKernelLevel, matrixKernels] = *levelRequirements;
         if (matrixKernelLevel == Level::UNSPECIFIED || matrixKernelLevel < kernelLevel) {
             continue;
         }
         std::string errorForLevel;
         auto matchedMatrixKernels =
-            getMatchedKernelVersionAndConfigs(matrixKernels, &errorForLevel);
+            getMatchedKernelVersionAndConfigs(matrixKernels, &configValues, &errorForLevel);
         if (matchedMatrixKernels.empty()) {
             if (error) {
                 *error += "For kernel requirements at matrix level " +
@@ -210,19 +225,24 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelRequirements(
 }
 
 std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelVersionAndConfigs(
-    const std::vector<const MatrixKernel*>& kernels, std::string* error) const {
+    const std::vector<details::KernelRequirement>& kernels,
+    details::KernelConfigValues* configValues, std::string* error) const {
     std::vector<const MatrixKernel*> result;
     bool foundMatchedKernelVersion = false;
-    for (const MatrixKernel* matrixKernel : kernels) {
+    for (const auto& [matrixKernel, conditions, configs] : kernels) {
         if (!matchKernelVersion(matrixKernel->minLts())) {
             continue;
         }
         foundMatchedKernelVersion = true;
         // ignore this fragment if not all conditions are met.
-        if (!matchKernelConfigs(matrixKernel->conditions(), nullptr)) {
+        if (details::findKernelConfigMismatch(conditions, configValues) != conditions.size()) {
             continue;
         }
-        if (!matchKernelConfigs(matrixKernel->configs(), error)) {
+        if (details::findKernelConfigMismatch(configs, configValues) != configs.size()) {
+            // Describe all mismatches only now that the check has failed.
+            if (error != nullptr) {
+                matchKernelConfigs(matrixKernel->configs(), error);
+            }
             return {};
         }
         result.push_back(matrixKernel);
@@ -232,7 +252,8 @@ std::vector<const MatrixKernel*> KernelInfo::getMatchedKernelVersionAndConfigs(
             std::stringstream ss;
             ss << "Framework is incompatible with kernel version " << version()
                << ", compatible kernel versions are:";
-            for (const MatrixKernel* matrixKernel : kernels) {
+            for (const auto& requirement : kernels) {
+                const MatrixKernel* matrixKernel = requirement.kernel;
                 ss << "\n  Minimum LTS: " << matrixKernel->minLts()
                    << ", kernel FCM version: " << matrixKernel->getSourceMatrixLevel()
                    << (matrixKernel->conditions().empty() ? "" : ", with conditionals");
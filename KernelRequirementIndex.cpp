@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "KernelRequirementIndex.h"
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include <vintf/CompatibilityMatrix.h>
+#include <vintf/parse_string.h>
+
+namespace android::vintf::details {
+
+namespace {
+
+using KeyHandles = std::unordered_map<std::string_view, uint32_t>;
+
+void compile(const std::vector<KernelConfig>& configs, KeyHandles* handles,
+             KernelRequirementIndex::Branch* branch, CompiledKernelConfigs* out) {
+    for (const auto& [key, value] : configs) {
+        auto [it, inserted] = handles->emplace(key, branch->keys.size());
+        if (inserted) {
+            branch->keys.push_back(&key);
+            branch->keyTypes.push_back(0);
+        }
+        out->add(it->second, value);
+        branch->keyTypes[it->second] |= 1 << static_cast<size_t>(out->types.back());
+    }
+}
+
+bool hasType(uint8_t types, KernelConfigType type) {
+    return types & (1 << static_cast<size_t>(type));
+}
+
+// Like KernelConfigTypedValue::matchValue, where string values are quoted.
+bool matchString(const std::string& raw, const std::string& required) {
+    return raw.size() == required.size() + 2 && raw.front() == '"' && raw.back() == '"' &&
+           raw.compare(1, required.size(), required) == 0;
+}
+
+}  // namespace
+
+void CompiledKernelConfigs::add(uint32_t key, const KernelConfigTypedValue& value) {
+    keys.push_back(key);
+    types.push_back(value.mType);
+    values.push_back(0);
+    upperBounds.push_back(0);
+    strings.push_back(nullptr);
+    allowMissing.push_back(value == KernelConfigTypedValue::gMissingConfig);
+    switch (value.mType) {
+        case KernelConfigType::STRING:
+            strings.back() = &value.mStringValue;
+            break;
+        case KernelConfigType::INTEGER:
+            values.back() = static_cast<uint64_t>(value.mIntegerValue);
+            break;
+        case KernelConfigType::RANGE:
+            values.back() = value.mRangeValue.first;
+            upperBounds.back() = value.mRangeValue.second;
+            break;
+        case KernelConfigType::TRISTATE:
+            values.back() = static_cast<uint64_t>(value.mTristateValue);
+            break;
+    }
+}
+
+KernelRequirementIndex::KernelRequirementIndex(const std::vector<MatrixKernel>& kernels,
+                                               std::optional<Version> onlyBranch)
+    : mKernels(&kernels) {
+    std::map<Version, KeyHandles> handles;
+    for (const MatrixKernel& kernel : kernels) {
+        Version xy = kernel.minLts().dropMinor();
+        if (onlyBranch.has_value() && xy != *onlyBranch) {
+            continue;
+        }
+        Branch& branch = mBranches[xy];
+        auto& branchHandles = handles[xy];
+
+        Level level = kernel.getSourceMatrixLevel();
+        auto it = std::lower_bound(
+            branch.levels.begin(), branch.levels.end(), level,
+            [](const LevelRequirements& e, Level l) { return e.level < l; });
+        if (it == branch.levels.end() || it->level != level) {
+            it = branch.levels.insert(it, LevelRequirements{level, {}});
+        }
+
+        KernelRequirement& requirement = it->requirements.emplace_back();
+        requirement.kernel = &kernel;
+        compile(kernel.conditions(), &branchHandles, &branch, &requirement.conditions);
+        compile(kernel.configs(), &branchHandles, &branch, &requirement.configs);
+    }
+}
+
+const KernelRequirementIndex::Branch* KernelRequirementIndex::find(
+    const KernelVersion& version) const {
+    auto it = mBranches.find(version.dropMinor());
+    return it == mBranches.end() ? nullptr : &it->second;
+}
+
+KernelConfigValues::KernelConfigValues(const KernelRequirementIndex::Branch& branch,
+                                       const std::map<std::string, std::string>& configs)
+    : mBranch(branch), mConfigs(configs), mValues(branch.keys.size()) {}
+
+const TypedKernelConfigValue& KernelConfigValues::get(uint32_t handle) {
+    TypedKernelConfigValue& value = mValues[handle];
+    if (value.resolved) {
+        return value;
+    }
+    value.resolved = true;
+    auto it = mConfigs.find(*mBranch.keys[handle]);
+    if (it == mConfigs.end()) {
+        return value;
+    }
+    value.raw = &it->second;
+    uint8_t types = mBranch.keyTypes[handle];
+    if (hasType(types, KernelConfigType::INTEGER)) {
+        value.isInteger = parseKernelConfigInt(it->second, &value.integerValue);
+    }
+    if (hasType(types, KernelConfigType::RANGE)) {
+        value.isRange = parseRange(it->second, &value.rangeValue);
+    }
+    if (hasType(types, KernelConfigType::TRISTATE)) {
+        value.isTristate = parse(it->second, &value.tristateValue);
+    }
+    return value;
+}
+
+size_t findKernelConfigMismatch(const CompiledKernelConfigs& configs, KernelConfigValues* values) {
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const TypedKernelConfigValue& value = values->get(configs.keys[i]);
+        bool match;
+        if (value.raw == nullptr) {
+            match = configs.allowMissing[i];
+        } else {
+            switch (configs.types[i]) {
+                case KernelConfigType::STRING:
+                    match = matchString(*value.raw, *configs.strings[i]);
+                    break;
+                case KernelConfigType::INTEGER:
+                    match = value.isInteger &&
+                            static_cast<uint64_t>(value.integerValue) == configs.values[i];
+                    break;
+                case KernelConfigType::RANGE:
+                    match = value.isRange && value.rangeValue.first == configs.values[i] &&
+                            value.rangeValue.second == configs.upperBounds[i];
+                    break;
+                case KernelConfigType::TRISTATE:
+                    match = value.isTristate &&
+                            static_cast<uint64_t>(value.tristateValue) == configs.values[i];
+                    break;
+            }
+        }
+        if (!match) return i;
+    }
+    return configs.size();
+}
+
+KernelRequirementIndexCache::KernelRequirementIndexCache() = default;
+
+KernelRequirementIndexCache::~KernelRequirementIndexCache() = default;
+
+KernelRequirementIndexCache::KernelRequirementIndexCache(const KernelRequirementIndexCache&) {}
+
+KernelRequirementIndexCache& KernelRequirementIndexCache::operator=(
+    const KernelRequirementIndexCache&) {
+    reset();
+    return *this;
+}
+
+const KernelRequirementIndex& KernelRequirementIndexCache::get(
+    const std::vector<MatrixKernel>& kernels) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mIndex == nullptr) {
+        mIndex = std::make_unique<KernelRequirementIndex>(kernels);
+    }
+    return *mIndex;
+}
+
+void KernelRequirementIndexCache::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mIndex.reset();
+}
+
+}  // namespace android::vintf::details
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vintf/KernelConfigType.h>
+#include <vintf/KernelConfigTypedValue.h>
+#include <vintf/Level.h>
+#include <vintf/MatrixKernel.h>
+#include <vintf/Version.h>
+
+namespace android::vintf::details {
+
+// Kernel config requirements (<config>s of a <kernel> or of its <conditions>), compiled into
+// parallel arrays so that they can be checked without parsing or allocating.
+struct CompiledKernelConfigs {
+    // Handle of the key of each requirement in its KernelRequirementIndex::Branch.
+    std::vector<uint32_t> keys;
+    std::vector<KernelConfigType> types;
+    // The required integer (as unsigned bits), tristate or lower bound of the range.
+    std::vector<uint64_t> values;
+    // The required upper bound of the range.
+    std::vector<uint64_t> upperBounds;
+    // The required string, unquoted, or nullptr for other types.
+    std::vector<const std::string*> strings;
+    // Whether a missing config meets the requirement, i.e. it is <value type="tristate">n.
+    std::vector<bool> allowMissing;
+
+    void add(uint32_t key, const KernelConfigTypedValue& value);
+    size_t size() const { return keys.size(); }
+};
+
+// The value of a kernel config referred to by a KernelRequirementIndex::Branch, parsed once
+// into each form that requirements of the branch compare it with.
+struct TypedKernelConfigValue {
+    bool resolved = false;
+    // nullptr if the config is missing.
+    const std::string* raw = nullptr;
+    bool isInteger = false;
+    bool isRange = false;
+    bool isTristate = false;
+    KernelConfigIntValue integerValue = 0;
+    KernelConfigRangeValue rangeValue;
+    Tristate tristateValue = Tristate::NO;
+};
+
+// A <kernel> in a KernelRequirementIndex.
+struct KernelRequirement {
+    const MatrixKernel* kernel;
+    CompiledKernelConfigs conditions;
+    CompiledKernelConfigs configs;
+};
+
+// The <kernel> requirements of a framework compatibility matrix, grouped the way
+// KernelInfo::getMatchedKernelRequirements looks them up: by x.y of the kernel version, then
+// by source matrix level. Config keys are replaced by handles, so each key is looked up and
+// parsed once per check, no matter how many <kernel>s use it.
+//
+// The index points into the kernels it is built from, which must not change while it is in
+// use.
+class KernelRequirementIndex {
+   public:
+    // If |onlyBranch| is set, only <kernel>s with that x.y are indexed.
+    explicit KernelRequirementIndex(const std::vector<MatrixKernel>& kernels,
+                                    std::optional<Version> onlyBranch = std::nullopt);
+
+    // <kernel>s with the same x.y and source matrix level, in the order of the matrix.
+    struct LevelRequirements {
+        Level level;
+        std::vector<KernelRequirement> requirements;
+    };
+
+    // <kernel>s with the same x.y.
+    struct Branch {
+        // Sorted by level. Level::UNSPECIFIED, if present, is last.
+        std::vector<LevelRequirements> levels;
+        // Config keys of the <kernel>s in this branch, indexed by handle.
+        std::vector<const std::string*> keys;
+        // For each key, the bits (1 << KernelConfigType) of the types it is compared as.
+        std::vector<uint8_t> keyTypes;
+    };
+
+    // Return nullptr if there are no <kernel>s for x.y of |version|.
+    const Branch* find(const KernelVersion& version) const;
+
+    // All kernels the index is built from, in the order of the matrix.
+    const std::vector<MatrixKernel>& kernels() const { return *mKernels; }
+
+   private:
+    const std::vector<MatrixKernel>* mKernels;
+    std::map<Version, Branch> mBranches;
+};
+
+// The configs of a kernel that a KernelRequirementIndex::Branch refers to, each looked up and
+// parsed on first use.
+class KernelConfigValues {
+   public:
+    KernelConfigValues(const KernelRequirementIndex::Branch& branch,
+                       const std::map<std::string, std::string>& configs);
+
+    const TypedKernelConfigValue& get(uint32_t handle);
+
+   private:
+    const KernelRequirementIndex::Branch& mBranch;
+    const std::map<std::string, std::string>& mConfigs;
+    std::vector<TypedKernelConfigValue> mValues;
+};
+
+// Return the index of the first requirement in |configs| that |values| do not meet, or
+// configs.size() if all of them are met. |values| must be of the branch that |configs|
+// belong to.
+size_t findKernelConfigMismatch(const CompiledKernelConfigs& configs, KernelConfigValues* values);
+
+}  // namespace android::vintf::details
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "KernelRequirementTable.h"
+
+#include <string.h>
+
+#include <set>
+
+#include "parse_string.h"
+#include "utils.h"
+
+namespace android::vintf::details {
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'I', 'N', 'T', 'F', 'K', 'R', 'T'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr uint32_t kFormatVersion = 1;
+
+// The table is a Header, followed by kernelCount KernelRecords, configCount ConfigRecords
+// (the conditions, then the configs, of each kernel in order) and stringsSize bytes of
+// strings. All records are copied in and out with memcpy, so the table needs no alignment.
+struct Header {
+    char magic[8];
+    uint32_t byteOrderMark;
+    uint32_t formatVersion;
+    uint32_t kernelCount;
+    uint32_t configCount;
+    uint32_t stringsSize;
+    uint32_t reserved;
+    uint64_t xmlHash;
+};
+
+struct KernelRecord {
+    uint64_t version;
+    uint64_t majorRev;
+    uint64_t minorRev;
+    uint64_t sourceMatrixLevel;
+    uint32_t conditionCount;
+    uint32_t configCount;
+};
+
+struct ConfigRecord {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint32_t type;
+    uint32_t reserved;
+    // STRING: offset and length of the string. INTEGER: the integer as unsigned bits in
+    // value0. RANGE: the bounds. TRISTATE: the tristate in value0.
+    uint64_t value0;
+    uint64_t value1;
+};
+
+static_assert(sizeof(Header) == 40);
+static_assert(sizeof(KernelRecord) == 40);
+static_assert(sizeof(ConfigRecord) == 32);
+
+template <typename T>
+void append(const T& record, std::string* out) {
+    out->append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
+bool readHeader(std::string_view table, Header* header) {
+    if (table.size() < sizeof(Header)) return false;
+    memcpy(header, table.data(), sizeof(Header));
+    return memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+           header->byteOrderMark == kByteOrderMark && header->formatVersion == kFormatVersion;
+}
+
+}  // namespace
+
+class KernelRequirementTable::Writer {
+   public:
+    explicit Writer(SerializeFlags::Type flags) : mFlags(flags) {}
+
+    void add(const MatrixKernel& kernel) {
+        KernelVersion minLts = kernel.mMinLts;
+        if (!mFlags.isKernelMinorRevisionEnabled()) {
+            minLts.minorRev = 0u;
+        }
+        size_t configCount = mFlags.isKernelConfigsEnabled() ? kernel.mConfigs.size() : 0;
+        append(KernelRecord{minLts.version, minLts.majorRev, minLts.minorRev,
+                            static_cast<uint64_t>(kernel.getSourceMatrixLevel()),
+                            static_cast<uint32_t>(kernel.mConditions.size()),
+                            static_cast<uint32_t>(configCount)},
+               &mKernels);
+        ++mKernelCount;
+        for (const auto& config : kernel.mConditions) {
+            add(config);
+        }
+        for (size_t i = 0; i < configCount; ++i) {
+            add(kernel.mConfigs[i]);
+        }
+    }
+
+    std::string finish(std::string_view xml) {
+        Header header{};
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.byteOrderMark = kByteOrderMark;
+        header.formatVersion = kFormatVersion;
+        header.kernelCount = mKernelCount;
+        header.configCount = mConfigCount;
+        header.stringsSize = static_cast<uint32_t>(mStrings.size());
+        header.xmlHash = fnv1a(xml);
+
+        std::string table;
+        table.reserve(sizeof(header) + mKernels.size() + mConfigs.size() + mStrings.size());
+        append(header, &table);
+        table += mKernels;
+        table += mConfigs;
+        table += mStrings;
+        return table;
+    }
+
+   private:
+    void add(const KernelConfig& config) {
+        const KernelConfigTypedValue& value = config.second;
+        ConfigRecord record{};
+        record.keyOffset = addString(config.first);
+        record.keyLength = static_cast<uint32_t>(config.first.size());
+        record.type = static_cast<uint32_t>(value.mType);
+        switch (value.mType) {
+            case KernelConfigType::STRING:
+                record.value0 = addString(value.mStringValue);
+                record.value1 = value.mStringValue.size();
+                break;
+            case KernelConfigType::INTEGER:
+                record.value0 = static_cast<uint64_t>(value.mIntegerValue);
+                break;
+            case KernelConfigType::RANGE:
+                record.value0 = value.mRangeValue.first;
+                record.value1 = value.mRangeValue.second;
+                break;
+            case KernelConfigType::TRISTATE:
+                record.value0 = static_cast<uint64_t>(value.mTristateValue);
+                break;
+        }
+        append(record, &mConfigs);
+        ++mConfigCount;
+    }
+
+    uint32_t addString(const std::string& s) {
+        uint32_t offset = static_cast<uint32_t>(mStrings.size());
+        mStrings += s;
+        return offset;
+    }
+
+    SerializeFlags::Type mFlags;
+    uint32_t mKernelCount = 0;
+    uint32_t mConfigCount = 0;
+    std::string mKernels;
+    std::string mConfigs;
+    std::string mStrings;
+};
+
+class KernelRequirementTable::Reader {
+   public:
+    bool read(std::string_view table, std::vector<MatrixKernel>* out, std::string* error) {
+        Header header;
+        if (!readHeader(table, &header)) {
+            *error = "Not a kernel requirement table of format version " +
+                     std::to_string(kFormatVersion);
+            return false;
+        }
+        uint64_t expectedSize = sizeof(Header) +
+                                uint64_t{header.kernelCount} * sizeof(KernelRecord) +
+                                uint64_t{header.configCount} * sizeof(ConfigRecord) +
+                                header.stringsSize;
+        if (table.size() != expectedSize) {
+            *error = "Kernel requirement table has size " + std::to_string(table.size()) +
+                     ", expected " + std::to_string(expectedSize);
+            return false;
+        }
+        const char* kernelRecords = table.data() + sizeof(Header);
+        mConfigRecords = kernelRecords + size_t{header.kernelCount} * sizeof(KernelRecord);
+        mConfigCount = header.configCount;
+        mStrings = table.substr(table.size() - header.stringsSize);
+        mNextConfig = 0;
+        mError = error;
+
+        std::vector<MatrixKernel> kernels(header.kernelCount);
+        for (size_t i = 0; i < kernels.size(); ++i) {
+            KernelRecord record;
+            memcpy(&record, kernelRecords + i * sizeof(KernelRecord), sizeof(record));
+            MatrixKernel& kernel = kernels[i];
+            kernel.mMinLts = KernelVersion(record.version, record.majorRev, record.minorRev);
+            Level level = static_cast<Level>(record.sourceMatrixLevel);
+            if (!IsValid(level)) {
+                *error = "Kernel requirement table has an unknown level " +
+                         std::to_string(record.sourceMatrixLevel);
+                return false;
+            }
+            kernel.setSourceMatrixLevel(level);
+            if (!readConfigs(record.conditionCount, &kernel.mConditions) ||
+                !readConfigs(record.configCount, &kernel.mConfigs)) {
+                return false;
+            }
+        }
+        if (mNextConfig != mConfigCount) {
+            *error = "Kernel requirement table has unused configs";
+            return false;
+        }
+        if (!checkKernelConditions(kernels, error)) {
+            return false;
+        }
+        *out = std::move(kernels);
+        return true;
+    }
+
+   private:
+    bool readConfigs(uint32_t count, std::vector<KernelConfig>* configs) {
+        if (count > mConfigCount - mNextConfig) {
+            *mError = "Kernel requirement table has too few configs";
+            return false;
+        }
+        configs->reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            ConfigRecord record;
+            memcpy(&record, mConfigRecords + (mNextConfig++) * sizeof(ConfigRecord),
+                   sizeof(record));
+            std::string_view key;
+            if (!readString(record.keyOffset, record.keyLength, &key)) {
+                return false;
+            }
+            switch (static_cast<KernelConfigType>(record.type)) {
+                case KernelConfigType::STRING: {
+                    std::string_view value;
+                    if (!readString(record.value0, record.value1, &value)) {
+                        return false;
+                    }
+                    configs->emplace_back(std::string(key),
+                                          KernelConfigTypedValue(std::string(value)));
+                } break;
+                case KernelConfigType::INTEGER: {
+                    configs->emplace_back(
+                        std::string(key),
+                        KernelConfigTypedValue(static_cast<KernelConfigIntValue>(record.value0)));
+                } break;
+                case KernelConfigType::RANGE: {
+                    configs->emplace_back(std::string(key),
+                                          KernelConfigTypedValue(KernelConfigRangeValue(
+                                              record.value0, record.value1)));
+                } break;
+                case KernelConfigType::TRISTATE: {
+                    if (record.value0 > static_cast<uint64_t>(Tristate::MODULE)) {
+                        *mError = "Kernel requirement table has an invalid tristate for " +
+                                  std::string(key);
+                        return false;
+                    }
+                    configs->emplace_back(
+                        std::string(key),
+                        KernelConfigTypedValue(static_cast<Tristate>(record.value0)));
+                } break;
+                default: {
+                    *mError = "Kernel requirement table has an invalid type for " +
+                              std::string(key);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool readString(uint64_t offset, uint64_t length, std::string_view* out) {
+        if (offset > mStrings.size() || length > mStrings.size() - offset) {
+            *mError = "Kernel requirement table has a string out of bounds";
+            return false;
+        }
+        *out = mStrings.substr(offset, length);
+        return true;
+    }
+
+    const char* mConfigRecords = nullptr;
+    uint32_t mConfigCount = 0;
+    uint32_t mNextConfig = 0;
+    std::string_view mStrings;
+    std::string* mError = nullptr;
+};
+
+std::string KernelRequirementTable::write(const std::vector<MatrixKernel>& kernels,
+                                          SerializeFlags::Type flags, std::string_view xml) {
+    Writer writer(flags);
+    if (flags.isKernelEnabled()) {
+        for (const auto& kernel : kernels) {
+            writer.add(kernel);
+        }
+    }
+    return writer.finish(xml);
+}
+
+bool KernelRequirementTable::matches(std::string_view table, std::string_view xml) {
+    Header header;
+    return readHeader(table, &header) && header.xmlHash == fnv1a(xml);
+}
+
+bool KernelRequirementTable::read(std::string_view table, std::vector<MatrixKernel>* kernels,
+                                  std::string* error) {
+    std::string errorBuffer;
+    return Reader{}.read(table, kernels, error != nullptr ? error : &errorBuffer);
+}
+
+bool checkKernelConditions(const std::vector<MatrixKernel>& kernels, std::string* error) {
+    std::set<Version> seenKernelVersions;
+    for (const auto& kernel : kernels) {
+        Version minLts(kernel.minLts().version, kernel.minLts().majorRev);
+        if (seenKernelVersions.find(minLts) != seenKernelVersions.end()) {
+            continue;
+        }
+        if (!kernel.conditions().empty()) {
+            *error = "First <kernel> for version " + to_string(minLts) +
+                     " must have empty <conditions> for backwards compatibility.";
+            return false;
+        }
+        seenKernelVersions.insert(minLts);
+    }
+    return true;
+}
+
+}  // namespace android::vintf::details
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vintf/MatrixKernel.h>
+#include <vintf/SerializeFlags.h>
+
+namespace android::vintf::details {
+
+// Suffix of the file that holds the kernel requirement table of a framework compatibility
+// matrix, e.g. compatibility_matrix.5.xml.kernels next to compatibility_matrix.5.xml.
+constexpr std::string_view kKernelRequirementTableSuffix = ".kernels";
+
+// The <kernel> requirements of a framework compatibility matrix as a binary table, written by
+// assemble_vintf --kernel-table when it writes the matrix. Loading the table instead of the
+// <kernel> elements of the matrix avoids parsing the configs and their values from XML.
+//
+// A table records a hash of the matrix file it was written for, so a table that is out of
+// date with its matrix is not used. Tables are in host byte order, like the rest of the
+// build output they are installed with.
+class KernelRequirementTable {
+   public:
+    // Serialize |kernels| as they appear in |xml|, which is toXml(matrix, flags).
+    static std::string write(const std::vector<MatrixKernel>& kernels,
+                             SerializeFlags::Type flags, std::string_view xml);
+
+    // Whether |table| is a table written for |xml|.
+    static bool matches(std::string_view table, std::string_view xml);
+
+    // Replace |kernels| with the content of |table|. On error, |kernels| is unchanged.
+    static bool read(std::string_view table, std::vector<MatrixKernel>* kernels,
+                     std::string* error);
+
+   private:
+    class Writer;
+    class Reader;
+};
+
+// The first <kernel> of each kernel version must not have <conditions>.
+bool checkKernelConditions(const std::vector<MatrixKernel>& kernels, std::string* error);
+
+}  // namespace android::vintf::details
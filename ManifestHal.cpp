@@ -26,6 +26,17 @@
 namespace android {
 namespace vintf {
 
+// The assignments keep the allocator of mManifestInstances, so the instances are copied or moved
+// into |alloc|.
+ManifestHal::ManifestHal(const ManifestHal& other, const allocator_type& alloc)
+    : ManifestHal(alloc) {
+    *this = other;
+}
+
+ManifestHal::ManifestHal(ManifestHal&& other, const allocator_type& alloc) : ManifestHal(alloc) {
+    *this = std::move(other);
+}
+
 bool ManifestHal::isValid(std::string* error) const {
     if (error) {
         error->clear();
@@ -106,10 +117,12 @@ bool ManifestHal::isDisabledHal() const {
 
 void ManifestHal::appendAllVersions(std::set<Version>* ret) const {
     ret->insert(versions.begin(), versions.end());
-    forEachInstance([&](const auto& e) {
-        ret->insert(e.version());
-        return true;
-    });
+    // forEachInstance() pairs each AIDL instance with each of |versions|, which are already
+    // inserted, so only the versions of other instances need to be added.
+    if (format == HalFormat::AIDL) return;
+    for (const auto& manifestInstance : mManifestInstances) {
+        ret->insert(manifestInstance.version());
+    }
 }
 
 bool ManifestHal::verifyInstance(const FqInstance& fqInstance, std::string* error) const {
@@ -70,7 +70,7 @@ Version ManifestInstance::version() const {
     return mFqInstance.getVersion();
 }
 
-std::string ManifestInstance::interface() const {
+const std::string& ManifestInstance::interface() const {
     return mFqInstance.getInterface();
 }
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vintf/ManifestInstanceIndex.h>
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+#include "constants-private.h"
+
+namespace android {
+namespace vintf {
+
+namespace {
+
+auto sortKey(const ManifestInstance& e) {
+    return std::make_tuple(e.format(), std::string_view(e.package()),
+                           std::string_view(e.interface()), std::string_view(e.instance()),
+                           e.version());
+}
+
+}  // namespace
+
+size_t ManifestInstanceIndex::KeyHash::operator()(const Key& key) const {
+    std::hash<std::string_view> hash;
+    size_t ret = static_cast<size_t>(key.format);
+    for (std::string_view s : {key.package, key.interface, key.instance}) {
+        ret = ret * 31 + hash(s);
+    }
+    return ret;
+}
+
+ManifestInstanceIndex::ManifestInstanceIndex(std::shared_ptr<const HalManifest> deviceManifest,
+                                             std::shared_ptr<const HalManifest> frameworkManifest)
+    : mDeviceManifest(std::move(deviceManifest)),
+      mFrameworkManifest(std::move(frameworkManifest)) {
+    for (const auto* manifest : {mDeviceManifest.get(), mFrameworkManifest.get()}) {
+        if (manifest == nullptr) continue;
+        manifest->forEachInstance([this](const ManifestInstance& manifestInstance) {
+            mInstances.push_back(manifestInstance);
+            return true;
+        });
+    }
+    std::sort(mInstances.begin(), mInstances.end(),
+              [](const auto& a, const auto& b) { return sortKey(a) < sortKey(b); });
+
+    // mInstances does not change from here on, so the keys can point into it.
+    mInterfaces.reserve(mInstances.size());
+    mPoints.reserve(mInstances.size());
+    for (size_t i = 0; i < mInstances.size(); ++i) {
+        const ManifestInstance& e = mInstances[i];
+        Key key{e.format(), e.package(), e.interface(), e.instance()};
+        // Instances with the same key are adjacent, so only the end of the slice of an existing
+        // key needs to be extended.
+        mPoints.try_emplace(key, Slice{i, i}).first->second.end = i + 1;
+        key.instance = {};
+        mInterfaces.try_emplace(key, Slice{i, i}).first->second.end = i + 1;
+    }
+}
+
+ManifestInstanceIndex::Range ManifestInstanceIndex::getRange(
+    const std::unordered_map<Key, Slice, KeyHash>& map, const Key& key) const {
+    auto it = map.find(key);
+    if (it == map.end()) return {};
+    return {mInstances.data() + it->second.begin, mInstances.data() + it->second.end};
+}
+
+ManifestInstanceIndex::Range ManifestInstanceIndex::getInstances(
+    HalFormat format, std::string_view package, std::string_view interface) const {
+    return getRange(mInterfaces, {format, package, interface, {}});
+}
+
+ManifestInstanceIndex::Range ManifestInstanceIndex::getInstances(
+    HalFormat format, std::string_view package, std::string_view interface,
+    std::string_view instance) const {
+    return getRange(mPoints, {format, package, interface, instance});
+}
+
+const ManifestInstance* ManifestInstanceIndex::getAidlInstance(std::string_view package,
+                                                               std::string_view interface,
+                                                               std::string_view instance) const {
+    Range range = getInstances(HalFormat::AIDL, package, interface, instance);
+    return range.empty() ? nullptr : range.end() - 1;
+}
+
+bool ManifestInstanceIndex::hasInstance(HalFormat format, std::string_view package,
+                                        const Version& version, std::string_view interface,
+                                        std::string_view instance) const {
+    for (const ManifestInstance& e : getInstances(format, package, interface, instance)) {
+        if (e.version().minorAtLeast(version)) return true;
+    }
+    return false;
+}
+
+bool ManifestInstanceIndex::hasHidlInstance(std::string_view package, const Version& version,
+                                            std::string_view interface,
+                                            std::string_view instance) const {
+    return hasInstance(HalFormat::HIDL, package, version, interface, instance);
+}
+
+bool ManifestInstanceIndex::hasAidlInstance(std::string_view package, size_t version,
+                                            std::string_view interface,
+                                            std::string_view instance) const {
+    return hasInstance(HalFormat::AIDL, package, {details::kFakeAidlMajorVersion, version},
+                       interface, instance);
+}
+
+}  // namespace vintf
+}  // namespace android
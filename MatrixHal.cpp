@@ -19,6 +19,7 @@
 #include <algorithm>
 
 #include "MapValueIterator.h"
+#include "ProvidedInstances.h"
 #include "constants-private.h"
 #include "utils.h"
 
@@ -27,6 +28,26 @@ namespace vintf {
 
 using details::convertLegacyInstanceIntoFqInstance;
 
+MatrixHal::MatrixHal(HalFormat format, std::string name, std::vector<VersionRange> versionRanges,
+                     bool optional, bool updatableViaApex,
+                     std::pmr::map<std::string, HalInterface> interfaces)
+    : format(format),
+      name(std::move(name)),
+      versionRanges(std::move(versionRanges)),
+      optional(optional),
+      updatableViaApex(updatableViaApex),
+      interfaces(std::move(interfaces)) {}
+
+// The assignments keep the allocator of interfaces, so the interfaces are copied or moved into
+// |alloc|.
+MatrixHal::MatrixHal(const MatrixHal& other, const allocator_type& alloc) : MatrixHal(alloc) {
+    *this = other;
+}
+
+MatrixHal::MatrixHal(MatrixHal&& other, const allocator_type& alloc) : MatrixHal(alloc) {
+    *this = std::move(other);
+}
+
 bool MatrixHal::isValid(std::string* error) const {
     bool success = true;
 
@@ -118,7 +139,7 @@ bool MatrixHal::forEachInstance(
     return true;
 }
 
-bool MatrixHal::isCompatible(const std::set<FqInstance>& providedInstances,
+bool MatrixHal::isCompatible(const details::ProvidedInstances& providedInstances,
                              const std::set<Version>& providedVersions) const {
     // <version>'s are related by OR.
     return std::any_of(versionRanges.begin(), versionRanges.end(), [&](const VersionRange& vr) {
@@ -126,7 +147,8 @@ bool MatrixHal::isCompatible(const std::set<FqInstance>& providedInstances,
     });
 }
 
-bool MatrixHal::isCompatible(const VersionRange& vr, const std::set<FqInstance>& providedInstances,
+bool MatrixHal::isCompatible(const VersionRange& vr,
+                             const details::ProvidedInstances& providedInstances,
                              const std::set<Version>& providedVersions) const {
     bool hasAnyInstance = false;
     bool versionUnsatisfied = false;
@@ -135,11 +157,7 @@ bool MatrixHal::isCompatible(const VersionRange& vr, const std::set<FqInstance>&
     forEachInstance(vr, [&](const MatrixInstance& matrixInstance) {
         hasAnyInstance = true;
 
-        versionUnsatisfied |=
-            !std::any_of(providedInstances.begin(), providedInstances.end(),
-                         [&](const FqInstance& providedInstance) {
-                             return matrixInstance.isSatisfiedBy(providedInstance);
-                         });
+        versionUnsatisfied |= !providedInstances.satisfies(matrixInstance);
 
         return !versionUnsatisfied;  // if any interface/instance is unsatisfied, break
     });
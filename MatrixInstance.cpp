@@ -58,7 +58,7 @@ const VersionRange& MatrixInstance::versionRange() const {
     return mRange;
 }
 
-std::string MatrixInstance::interface() const {
+const std::string& MatrixInstance::interface() const {
     return mFqInstance.getInterface();
 }
 
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PackedManifestInstances.h"
+
+#include <tuple>
+
+#include <android-base/logging.h>
+
+#include "constants-private.h"
+
+namespace android::vintf::details {
+
+static_assert(sizeof(PackedManifestInstance) == 32);
+static_assert(gHalFormatStrings.size() <= 4, "HalFormat does not fit in PackedManifestInstance");
+static_assert(gTransportStrings.size() <= 4, "Transport does not fit in PackedManifestInstance");
+static_assert(gArchStrings.size() <= 4, "Arch does not fit in PackedManifestInstance");
+
+// Bytes allocated on the heap by |s|, or 0 if it uses the small string optimization.
+static size_t heapUsage(const std::string& s) {
+    const char* begin = reinterpret_cast<const char*>(&s);
+    bool isInline = s.data() >= begin && s.data() < begin + sizeof(s);
+    return isInline ? 0 : s.capacity() + 1;
+}
+
+static size_t heapUsage(const std::optional<std::string>& s) {
+    return s.has_value() ? heapUsage(*s) : 0;
+}
+
+StringPool::Id StringPool::intern(std::string_view s) {
+    auto it = mIds.find(s);
+    if (it != mIds.end()) {
+        return it->second;
+    }
+    CHECK(mStrings.size() < kNone);
+    Id id = mStrings.size();
+    const std::string& stored = mStrings.emplace_back(s);
+    mIds.emplace(stored, id);
+    return id;
+}
+
+const std::string& StringPool::get(Id id) const {
+    return mStrings.at(id);
+}
+
+size_t StringPool::memoryUsage() const {
+    size_t usage = sizeof(*this);
+    for (const auto& s : mStrings) {
+        usage += sizeof(s) + heapUsage(s);
+    }
+    // Buckets, and one node with a next pointer per entry.
+    usage += mIds.bucket_count() * sizeof(void*);
+    usage += mIds.size() * (sizeof(void*) + sizeof(decltype(mIds)::value_type));
+    return usage;
+}
+
+static std::optional<std::string> getOptional(const StringPool& strings, StringPool::Id id) {
+    if (id == StringPool::kNone) return std::nullopt;
+    return strings.get(id);
+}
+
+// The major version of AIDL HALs is stored as UINT16_MAX, so it is not available to others.
+static std::optional<uint32_t> packVersion(const Version& version) {
+    uint32_t major;
+    if (version.majorVer == kFakeAidlMajorVersion) {
+        major = UINT16_MAX;
+    } else if (version.majorVer < UINT16_MAX) {
+        major = version.majorVer;
+    } else {
+        return std::nullopt;
+    }
+    if (version.minorVer > UINT16_MAX) {
+        return std::nullopt;
+    }
+    return major << 16 | version.minorVer;
+}
+
+static Version unpackVersion(uint32_t packed) {
+    size_t major = packed >> 16;
+    return Version(major == UINT16_MAX ? kFakeAidlMajorVersion : major, packed & UINT16_MAX);
+}
+
+std::optional<size_t> PackedManifestInstances::add(const ManifestInstance& manifestInstance) {
+    Version version = manifestInstance.version();
+    std::optional<uint32_t> packedVersion = packVersion(version);
+    if (!packedVersion.has_value()) {
+        return std::nullopt;
+    }
+    // Only the interface of the FQName is stored, so check that nothing else is lost.
+    auto fqInstance = FqInstance::from(manifestInstance.package(), version.majorVer,
+                                       version.minorVer, manifestInstance.interface(),
+                                       manifestInstance.instance());
+    if (!fqInstance.has_value() || *fqInstance != manifestInstance.getFqInstance()) {
+        return std::nullopt;
+    }
+
+    auto intern = [this](const std::optional<std::string>& s) {
+        return s.has_value() ? mStrings.intern(*s) : StringPool::kNone;
+    };
+    PackedManifestInstance packed{
+        .package = mStrings.intern(manifestInstance.package()),
+        .interface = mStrings.intern(manifestInstance.interface()),
+        .instance = mStrings.intern(manifestInstance.instance()),
+        .accessor = intern(manifestInstance.accessor()),
+        .updatableViaApex = intern(manifestInstance.updatableViaApex()),
+        .version = *packedVersion,
+        .inetAddress = PackedManifestInstance::kNoInetAddress,
+        .format = static_cast<uint8_t>(manifestInstance.format()),
+        .transport = static_cast<uint8_t>(manifestInstance.transport()),
+        .arch = static_cast<uint8_t>(manifestInstance.arch()),
+        .updatableViaSystem = manifestInstance.updatableViaSystem(),
+    };
+    if (manifestInstance.ip().has_value() || manifestInstance.port().has_value()) {
+        packed.inetAddress = mInetAddresses.size();
+        mInetAddresses.emplace_back(manifestInstance.ip(), manifestInstance.port());
+    }
+    mInstances.push_back(packed);
+    return mInstances.size() - 1;
+}
+
+ManifestInstance PackedManifestInstances::get(size_t index) const {
+    const PackedManifestInstance& packed = mInstances.at(index);
+    Version version = unpackVersion(packed.version);
+    FqInstance fqInstance;
+    CHECK(fqInstance.setTo(mStrings.get(packed.package), version.majorVer, version.minorVer,
+                           mStrings.get(packed.interface), mStrings.get(packed.instance)));
+    TransportArch transportArch(static_cast<Transport>(packed.transport),
+                                static_cast<Arch>(packed.arch));
+    if (packed.inetAddress != PackedManifestInstance::kNoInetAddress) {
+        std::tie(transportArch.ip, transportArch.port) = mInetAddresses.at(packed.inetAddress);
+    }
+    return ManifestInstance(std::move(fqInstance), std::move(transportArch),
+                            static_cast<HalFormat>(packed.format),
+                            getOptional(mStrings, packed.updatableViaApex),
+                            getOptional(mStrings, packed.accessor), packed.updatableViaSystem);
+}
+
+size_t PackedManifestInstances::memoryUsage() const {
+    size_t usage = sizeof(*this) - sizeof(mStrings) + mStrings.memoryUsage();
+    usage += mInstances.capacity() * sizeof(PackedManifestInstance);
+    usage += mInetAddresses.capacity() * sizeof(decltype(mInetAddresses)::value_type);
+    for (const auto& [ip, port] : mInetAddresses) {
+        usage += heapUsage(ip);
+    }
+    return usage;
+}
+
+size_t unpackedMemoryUsage(const std::vector<ManifestInstance>& manifestInstances) {
+    // Color and parent, left and right pointers of each std::set node.
+    constexpr size_t kSetNodeOverhead = 4 * sizeof(void*);
+    size_t usage = 0;
+    for (const ManifestInstance& manifestInstance : manifestInstances) {
+        usage += kSetNodeOverhead + sizeof(ManifestInstance);
+        usage += heapUsage(manifestInstance.package());
+        usage += heapUsage(manifestInstance.interface());
+        usage += heapUsage(manifestInstance.instance());
+        usage += heapUsage(manifestInstance.accessor());
+        usage += heapUsage(manifestInstance.updatableViaApex());
+        usage += heapUsage(manifestInstance.ip());
+    }
+    return usage;
+}
+
+}  // namespace android::vintf::details
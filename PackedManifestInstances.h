@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vintf/ManifestInstance.h>
+
+namespace android::vintf::details {
+
+// Stores each distinct string once and refers to it by a 32-bit id.
+class StringPool {
+   public:
+    using Id = uint32_t;
+    static constexpr Id kNone = UINT32_MAX;
+
+    Id intern(std::string_view s);
+    const std::string& get(Id id) const;
+    size_t size() const { return mStrings.size(); }
+
+    // Approximate number of bytes used by the pool, including heap allocations.
+    size_t memoryUsage() const;
+
+   private:
+    // A deque so that the keys of mIds stay valid.
+    std::deque<std::string> mStrings;
+    std::unordered_map<std::string_view, Id> mIds;
+};
+
+// A ManifestInstance in 32 bytes. Strings are ids into the StringPool of the table that
+// holds the instance.
+struct PackedManifestInstance {
+    StringPool::Id package;
+    StringPool::Id interface;
+    StringPool::Id instance;
+    // StringPool::kNone if not set.
+    StringPool::Id accessor;
+    StringPool::Id updatableViaApex;
+    // Major version in the high 16 bits, minor version in the low 16 bits. The major
+    // version of AIDL HALs is UINT16_MAX.
+    uint32_t version;
+    // Index of the IP address and port in the table, or kNoInetAddress.
+    uint32_t inetAddress;
+    uint8_t format : 2;
+    uint8_t transport : 2;
+    uint8_t arch : 2;
+    bool updatableViaSystem : 1;
+
+    static constexpr uint32_t kNoInetAddress = UINT32_MAX;
+};
+
+// An append-only table of ManifestInstances in the PackedManifestInstance layout. Strings
+// that are shared between instances, like package and instance names, are stored once.
+class PackedManifestInstances {
+   public:
+    // Return the index of the added instance, or nullopt if it cannot be packed (e.g. its
+    // version does not fit in 16 bits).
+    std::optional<size_t> add(const ManifestInstance& manifestInstance);
+
+    size_t size() const { return mInstances.size(); }
+    const PackedManifestInstance& at(size_t index) const { return mInstances.at(index); }
+    const StringPool& strings() const { return mStrings; }
+
+    // Unpack the instance at |index|. The result compares equal to the added instance.
+    ManifestInstance get(size_t index) const;
+
+    // Approximate number of bytes used by the table, including heap allocations.
+    size_t memoryUsage() const;
+
+   private:
+    StringPool mStrings;
+    std::vector<PackedManifestInstance> mInstances;
+    std::vector<std::pair<std::optional<std::string>, std::optional<uint64_t>>> mInetAddresses;
+};
+
+// Approximate number of bytes used by |manifestInstances| as a std::set, which is how
+// ManifestHal stores them, including heap allocations.
+size_t unpackedMemoryUsage(const std::vector<ManifestInstance>& manifestInstances);
+
+}  // namespace android::vintf::details
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProvidedInstances.h"
+
+#include <algorithm>
+
+namespace android::vintf::details {
+
+size_t ProvidedInstances::GroupKeyHash::operator()(const GroupKey& key) const {
+    std::hash<std::string_view> hash;
+    return (hash(key.package) * 31 + key.majorVer) * 31 + hash(key.interface);
+}
+
+void ProvidedInstances::add(const ManifestHal& hal) {
+    // Same instances as ManifestHal::forEachInstance, without copying each AIDL instance for
+    // each <version>.
+    for (const ManifestInstance& manifestInstance : hal.mManifestInstances) {
+        if (hal.format == HalFormat::AIDL) {
+            for (const Version& version : hal.versions) {
+                add(manifestInstance.getFqInstance(), version);
+            }
+        } else {
+            add(manifestInstance.getFqInstance(), manifestInstance.version());
+        }
+    }
+}
+
+void ProvidedInstances::add(const FqInstance& instance, const Version& version) {
+    Group& group = mGroups[{instance.getPackage(), version.majorVer, instance.getInterface()}];
+    const std::string& name = instance.getInstance();
+    auto [it, inserted] = group.emplace(name, Provided{&name, version.minorVer});
+    if (!inserted) {
+        it->second.minorVer = std::max(it->second.minorVer, version.minorVer);
+    }
+}
+
+const Regex* ProvidedInstances::getRegex(const std::string& pattern) const {
+    auto it = mRegexes.find(pattern);
+    if (it == mRegexes.end()) {
+        auto regex = std::make_unique<Regex>();
+        if (!regex->compile(pattern)) {
+            regex = nullptr;
+        }
+        it = mRegexes.emplace(pattern, std::move(regex)).first;
+    }
+    return it->second.get();
+}
+
+bool ProvidedInstances::satisfies(const MatrixInstance& matrixInstance) const {
+    const VersionRange& range = matrixInstance.versionRange();
+    auto groupIt =
+        mGroups.find({matrixInstance.package(), range.majorVer, matrixInstance.interface()});
+    if (groupIt == mGroups.end()) {
+        return false;
+    }
+    const Group& group = groupIt->second;
+
+    // VersionRange::supportedBy only requires the provided minor version to be at least
+    // minMinor, so the highest provided minor version of each instance is sufficient.
+    if (!matrixInstance.isRegex()) {
+        auto it = group.find(matrixInstance.exactInstance());
+        return it != group.end() && it->second.minorVer >= range.minMinor;
+    }
+
+    const Regex* regex = getRegex(matrixInstance.regexPattern());
+    if (regex == nullptr) {
+        return false;
+    }
+    return std::any_of(group.begin(), group.end(), [&](const auto& entry) {
+        return entry.second.minorVer >= range.minMinor && regex->matches(*entry.second.instance);
+    });
+}
+
+}  // namespace android::vintf::details
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <vintf/FqInstance.h>
+#include <vintf/ManifestHal.h>
+#include <vintf/MatrixInstance.h>
+#include <vintf/Regex.h>
+#include <vintf/Version.h>
+
+namespace android::vintf::details {
+
+// Instances provided by a manifest, indexed for matching against the instances that a
+// compatibility matrix requires.
+//
+// Instances are grouped by package, major version and interface. Exact requirements are
+// looked up by instance name. Regex requirements only scan instances of their group, and
+// each pattern is compiled at most once per ProvidedInstances object. Keys are views into the
+// added HALs, so that indexing and matching do not allocate strings.
+class ProvidedInstances {
+   public:
+    ProvidedInstances() = default;
+    ProvidedInstances(const ProvidedInstances&) = delete;
+    ProvidedInstances& operator=(const ProvidedInstances&) = delete;
+
+    // Add the instances provided by |hal|, which must outlive this object.
+    void add(const ManifestHal& hal);
+
+    // Whether matrixInstance.isSatisfiedBy(i) for any provided instance i.
+    bool satisfies(const MatrixInstance& matrixInstance) const;
+
+   private:
+    struct GroupKey {
+        std::string_view package;
+        size_t majorVer;
+        std::string_view interface;
+
+        bool operator==(const GroupKey& other) const {
+            return package == other.package && majorVer == other.majorVer &&
+                   interface == other.interface;
+        }
+    };
+    struct GroupKeyHash {
+        size_t operator()(const GroupKey& key) const;
+    };
+    struct Provided {
+        // The instance name, which Regex::matches needs as a std::string.
+        const std::string* instance;
+        // The highest minor version the instance is provided at.
+        size_t minorVer;
+    };
+    // Keyed by instance name.
+    using Group = std::unordered_map<std::string_view, Provided>;
+
+    // Add |instance| at |version| instead of its own version.
+    void add(const FqInstance& instance, const Version& version);
+    // Return the compiled |pattern|, or nullptr if it is not a valid regex.
+    const Regex* getRegex(const std::string& pattern) const;
+
+    std::unordered_map<GroupKey, Group, GroupKeyHash> mGroups;
+    mutable std::map<std::string, std::unique_ptr<Regex>> mRegexes;
+};
+
+}  // namespace android::vintf::details
@@ -100,7 +100,7 @@ bool RuntimeInfo::checkCompatibility(const CompatibilityMatrix& mat, std::string
 
     if (flags.isKernelEnabled()) {
         if (!isMainlineKernel() &&
-            mKernel.getMatchedKernelRequirements(mat.framework.mKernels, kernelLevel(), error)
+            mKernel.getMatchedKernelRequirements(mat.kernelRequirementIndex(), kernelLevel(), error)
                 .empty()) {
             return false;
         }
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vintf/Tracer.h>
+
+namespace android {
+namespace vintf {
+namespace details {
+
+bool TracerNoOp::isEnabled() const {
+    return false;
+}
+
+void TracerNoOp::beginSpan(const char*) {}
+
+void TracerNoOp::endSpan(const char*, const Attributes&) {}
+
+ScopedSpan::ScopedSpan(Tracer* tracer, const char* name)
+    : mTracer(tracer != nullptr && tracer->isEnabled() ? tracer : nullptr), mName(name) {
+    if (mTracer != nullptr) mTracer->beginSpan(mName);
+}
+
+ScopedSpan::~ScopedSpan() {
+    if (mTracer != nullptr) mTracer->endSpan(mName, mAttributes);
+}
+
+void ScopedSpan::addAttribute(const char* key, std::string value) {
+    if (mTracer != nullptr) mAttributes.emplace_back(key, std::move(value));
+}
+
+void ScopedSpan::addAttribute(const char* key, size_t value) {
+    if (mTracer != nullptr) mAttributes.emplace_back(key, std::to_string(value));
+}
+
+}  // namespace details
+}  // namespace vintf
+}  // namespace android
@@ -0,0 +1,803 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <vintf/VintfDiff.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string_view>
+#include <tuple>
+
+#include <android-base/strings.h>
+
+#include <vintf/CompatibilityMatrix.h>
+#include <vintf/HalManifest.h>
+#include <vintf/parse_string.h>
+
+namespace android {
+namespace vintf {
+
+namespace {
+
+// Sections in the order they are reported.
+enum class Section : size_t {
+    ATTRIBUTE,
+    HAL,
+    INSTANCE,
+    SEPOLICY,
+    AVB,
+    KERNEL,
+    KERNEL_CONFIG,
+    VENDOR_NDK,
+    SYSTEM_SDK,
+    XMLFILE,
+};
+constexpr const char* kSectionNames[] = {"attribute",     "hal",        "instance",   "sepolicy",
+                                         "avb",           "kernel",     "kernel-config",
+                                         "vendor-ndk",    "system-sdk", "xmlfile"};
+
+// Differences by section. Within a section, they are added in key order.
+class Differences {
+   public:
+    void add(Section section, DiffEntry::Type type, std::string key, std::string oldValue,
+             std::string newValue) {
+        size_t index = static_cast<size_t>(section);
+        mSections[index].push_back({type, kSectionNames[index], std::move(key),
+                                    std::move(oldValue), std::move(newValue)});
+    }
+
+    std::vector<DiffEntry> release() {
+        std::vector<DiffEntry> ret;
+        for (auto& entries : mSections) {
+            ret.insert(ret.end(), std::make_move_iterator(entries.begin()),
+                       std::make_move_iterator(entries.end()));
+        }
+        return ret;
+    }
+
+   private:
+    std::array<std::vector<DiffEntry>, std::size(kSectionNames)> mSections;
+};
+
+// Appends "name=value" pairs and flags to a summary of an element.
+class Summary {
+   public:
+    template <typename T>
+    Summary& add(const char* name, const T& value) {
+        separate() << name << "=" << value;
+        return *this;
+    }
+    Summary& addFlag(const char* name, bool set) {
+        if (set) separate() << name;
+        return *this;
+    }
+    template <typename T>
+    Summary& addIfSet(const char* name, const std::optional<T>& value) {
+        if (value.has_value()) add(name, *value);
+        return *this;
+    }
+    std::string str() const { return mStream.str(); }
+
+   private:
+    std::ostream& separate() {
+        if (mStream.tellp() > 0) mStream << " ";
+        return mStream;
+    }
+    std::ostringstream mStream;
+};
+
+std::string versionString(HalFormat format, const Version& version) {
+    return format == HalFormat::AIDL ? aidlVersionToString(version) : to_string(version);
+}
+
+std::string versionRangeString(HalFormat format, const VersionRange& range) {
+    return format == HalFormat::AIDL ? aidlVersionRangeToString(range) : to_string(range);
+}
+
+// Key of an instance. It includes the major version for HIDL, because different major
+// versions of a HIDL interface are different interfaces.
+std::string instanceKey(HalFormat format, const std::string& package, const Version& version,
+                        const std::string& interface, const std::string& instance) {
+    std::ostringstream os;
+    os << format << " ";
+    switch (format) {
+        case HalFormat::HIDL:
+            os << package << "@" << version.majorVer << "::" << interface << "/" << instance;
+            break;
+        case HalFormat::AIDL:
+            os << toAidlFqnameString(package, interface, instance);
+            break;
+        case HalFormat::NATIVE:
+            os << package;
+            if (!interface.empty()) os << "::" << interface;
+            os << "/" << instance;
+            break;
+    }
+    return os.str();
+}
+
+// The part of the version of an instance that is in its key.
+size_t keyMajorVersion(HalFormat format, size_t majorVer) {
+    return format == HalFormat::HIDL ? majorVer : 0;
+}
+
+template <typename T>
+std::string toString(const T& value) {
+    return to_string(value);
+}
+
+std::optional<Level> specifiedLevel(Level level) {
+    if (level == Level::UNSPECIFIED) return std::nullopt;
+    return level;
+}
+
+// Sort |elements| by |less|. They are usually in that order already, which is checked in
+// linear time.
+template <typename T, typename Less>
+void sortIfNeeded(std::vector<T>* elements, Less less) {
+    if (!std::is_sorted(elements->begin(), elements->end(), less)) {
+        std::sort(elements->begin(), elements->end(), less);
+    }
+}
+
+// Whether each element of [begin1, end1) is |same| as an element of [begin2, end2) and vice
+// versa. The ranges hold the elements with one key, so they are short.
+template <typename It, typename Same>
+bool sameElements(It begin1, It end1, It begin2, It end2, Same same) {
+    auto contains = [&](It begin, It end, const auto& element) {
+        return std::any_of(begin, end, [&](const auto& other) { return same(element, other); });
+    };
+    return std::all_of(begin1, end1, [&](const auto& e) { return contains(begin2, end2, e); }) &&
+           std::all_of(begin2, end2, [&](const auto& e) { return contains(begin1, end1, e); });
+}
+
+// Values of the elements with one key in [begin, end), as they are reported.
+template <typename It, typename Value>
+std::string joinValues(It begin, It end, Value value) {
+    std::set<std::string> values;
+    for (It it = begin; it != end; ++it) values.insert(value(*it));
+    return android::base::Join(values, "; ");
+}
+
+// Walk |olds| and |news|, which are both sorted by |less|, in parallel, and report each key
+// that only one side has, or whose elements are not |same| on both sides. |key| and |value|
+// format an element; they are only called for elements that are reported.
+template <typename Container, typename Less, typename Same, typename Key, typename Value>
+void diffSorted(Section section, const Container& olds, const Container& news, Less less,
+                Same same, Key key, Value value, Differences* out) {
+    // End of the elements with the same key as |begin|.
+    auto keyEnd = [&](auto begin, const Container& container) {
+        auto end = begin;
+        while (end != container.end() && !less(*begin, *end)) ++end;
+        return end;
+    };
+    auto oldIt = olds.begin();
+    auto newIt = news.begin();
+    while (oldIt != olds.end() || newIt != news.end()) {
+        if (newIt == news.end() || (oldIt != olds.end() && less(*oldIt, *newIt))) {
+            auto oldEnd = keyEnd(oldIt, olds);
+            out->add(section, DiffEntry::Type::REMOVED, key(*oldIt),
+                     joinValues(oldIt, oldEnd, value), "");
+            oldIt = oldEnd;
+        } else if (oldIt == olds.end() || less(*newIt, *oldIt)) {
+            auto newEnd = keyEnd(newIt, news);
+            out->add(section, DiffEntry::Type::ADDED, key(*newIt), "",
+                     joinValues(newIt, newEnd, value));
+            newIt = newEnd;
+        } else {
+            auto oldEnd = keyEnd(oldIt, olds);
+            auto newEnd = keyEnd(newIt, news);
+            if (!sameElements(oldIt, oldEnd, newIt, newEnd, same)) {
+                out->add(section, DiffEntry::Type::CHANGED, key(*oldIt),
+                         joinValues(oldIt, oldEnd, value), joinValues(newIt, newEnd, value));
+            }
+            oldIt = oldEnd;
+            newIt = newEnd;
+        }
+    }
+}
+
+// Report the element |key|, whose value is |oldValue| / |newValue|, or nullopt if the element
+// is missing on that side.
+template <typename T, typename Format>
+void diffValue(Section section, const char* key, const std::optional<T>& oldValue,
+               const std::optional<T>& newValue, Format format, Differences* out) {
+    if (!oldValue.has_value() && !newValue.has_value()) return;
+    if (!oldValue.has_value()) {
+        out->add(section, DiffEntry::Type::ADDED, key, "", format(*newValue));
+    } else if (!newValue.has_value()) {
+        out->add(section, DiffEntry::Type::REMOVED, key, format(*oldValue), "");
+    } else if (!(*oldValue == *newValue)) {
+        out->add(section, DiffEntry::Type::CHANGED, key, format(*oldValue), format(*newValue));
+    }
+}
+
+// Call |f| once for each name of a HAL in |oldHals| or |newHals|, which are sorted by name,
+// after setting |oldGroup| and |newGroup| to the HALs with that name.
+template <typename Hals, typename Hal, typename F>
+void forEachHalName(const Hals& oldHals, const Hals& newHals, std::vector<const Hal*>* oldGroup,
+                    std::vector<const Hal*>* newGroup, F f) {
+    auto oldIt = oldHals.begin();
+    auto newIt = newHals.begin();
+    while (oldIt != oldHals.end() || newIt != newHals.end()) {
+        bool oldFirst = newIt == newHals.end() ||
+                        (oldIt != oldHals.end() && oldIt->getName() < newIt->getName());
+        const std::string& name = oldFirst ? oldIt->getName() : newIt->getName();
+        oldGroup->clear();
+        newGroup->clear();
+        for (; oldIt != oldHals.end() && oldIt->getName() == name; ++oldIt) {
+            oldGroup->push_back(&*oldIt);
+        }
+        for (; newIt != newHals.end() && newIt->getName() == name; ++newIt) {
+            newGroup->push_back(&*newIt);
+        }
+        f();
+    }
+}
+
+// HALs with the same name are keyed by format.
+template <typename Hal>
+bool lessFormat(const Hal* a, const Hal* b) {
+    return a->format < b->format;
+}
+
+template <typename Hal>
+std::string halKey(const Hal* hal) {
+    return to_string(hal->format) + " " + hal->name;
+}
+
+// An instance of a ManifestHal. AIDL instances are provided at each <version> of their HAL.
+struct ManifestInstanceRef {
+    const ManifestInstance* instance;
+    Version version;
+};
+
+bool lessInstance(const ManifestInstanceRef& a, const ManifestInstanceRef& b) {
+    auto key = [](const ManifestInstanceRef& ref) {
+        const ManifestInstance& e = *ref.instance;
+        return std::make_tuple(e.format(), keyMajorVersion(e.format(), ref.version.majorVer),
+                               std::string_view(e.package()), std::string_view(e.interface()),
+                               std::string_view(e.instance()));
+    };
+    return key(a) < key(b);
+}
+
+bool sameInstance(const ManifestInstanceRef& a, const ManifestInstanceRef& b) {
+    const ManifestInstance& x = *a.instance;
+    const ManifestInstance& y = *b.instance;
+    return a.version == b.version && x.transport() == y.transport() && x.arch() == y.arch() &&
+           x.ip() == y.ip() && x.port() == y.port() && x.accessor() == y.accessor() &&
+           x.updatableViaApex() == y.updatableViaApex() &&
+           x.updatableViaSystem() == y.updatableViaSystem();
+}
+
+std::string instanceKey(const ManifestInstanceRef& ref) {
+    const ManifestInstance& e = *ref.instance;
+    return instanceKey(e.format(), e.package(), ref.version, e.interface(), e.instance());
+}
+
+std::string instanceValue(const ManifestInstanceRef& ref) {
+    const ManifestInstance& e = *ref.instance;
+    Summary summary;
+    summary.add("version", versionString(e.format(), ref.version));
+    if (e.transport() != Transport::EMPTY) summary.add("transport", e.transport());
+    if (e.arch() != Arch::ARCH_EMPTY) summary.add("arch", e.arch());
+    summary.addIfSet("ip", e.ip())
+        .addIfSet("port", e.port())
+        .addIfSet("accessor", e.accessor())
+        .addIfSet("updatable-via-apex", e.updatableViaApex())
+        .addFlag("updatable-via-system", e.updatableViaSystem());
+    return summary.str();
+}
+
+// An instance or regex-instance of a MatrixHal at one of its version ranges.
+struct MatrixInstanceRef {
+    const MatrixHal* hal;
+    const VersionRange* range;
+    const std::string* interface;
+    const std::string* instance;
+    bool isRegex;
+};
+
+bool lessInstance(const MatrixInstanceRef& a, const MatrixInstanceRef& b) {
+    auto key = [](const MatrixInstanceRef& ref) {
+        HalFormat format = ref.hal->format;
+        return std::make_tuple(format, keyMajorVersion(format, ref.range->majorVer),
+                               std::string_view(*ref.interface), ref.isRegex,
+                               std::string_view(*ref.instance));
+    };
+    return key(a) < key(b);
+}
+
+bool sameInstance(const MatrixInstanceRef& a, const MatrixInstanceRef& b) {
+    return *a.range == *b.range && a.hal->optional == b.hal->optional;
+}
+
+std::string instanceKey(const MatrixInstanceRef& ref) {
+    return instanceKey(ref.hal->format, ref.hal->name, ref.range->minVer(), *ref.interface,
+                       ref.isRegex ? "regex:" + *ref.instance : *ref.instance);
+}
+
+std::string instanceValue(const MatrixInstanceRef& ref) {
+    return Summary()
+        .add("version", versionRangeString(ref.hal->format, *ref.range))
+        .addFlag("optional", ref.hal->optional)
+        .str();
+}
+
+bool lessVendorNdk(const VendorNdk* a, const VendorNdk* b) {
+    return a->version() < b->version();
+}
+
+void diffVendorNdks(const std::vector<const VendorNdk*>& olds,
+                    const std::vector<const VendorNdk*>& news, Differences* out) {
+    diffSorted(
+        Section::VENDOR_NDK, olds, news, lessVendorNdk,
+        [](const VendorNdk* a, const VendorNdk* b) { return a->libraries() == b->libraries(); },
+        [](const VendorNdk* vendorNdk) { return vendorNdk->version(); },
+        [](const VendorNdk* vendorNdk) {
+            return android::base::Join(vendorNdk->libraries(), ",");
+        },
+        out);
+}
+
+void diffSystemSdks(const SystemSdk* oldSdk, const SystemSdk* newSdk, Differences* out) {
+    static const std::set<std::string> kNoVersions;
+    diffSorted(
+        Section::SYSTEM_SDK, oldSdk ? oldSdk->versions() : kNoVersions,
+        newSdk ? newSdk->versions() : kNoVersions, std::less<std::string>(),
+        std::equal_to<std::string>(), [](const std::string& version) { return version; },
+        [](const std::string&) { return std::string(); }, out);
+}
+
+// The <xmlfile>s of |schema|, sorted by |less|.
+template <typename XmlFileType, typename Schema, typename Less>
+std::vector<const XmlFileType*> sortedXmlFiles(const Schema& schema, Less less) {
+    std::vector<const XmlFileType*> ret;
+    for (const XmlFileType& xmlFile : schema.getXmlFiles()) ret.push_back(&xmlFile);
+    sortIfNeeded(&ret, less);
+    return ret;
+}
+
+template <typename XmlFileType>
+std::string xmlFileValue(const XmlFileType* xmlFile, Summary&& summary) {
+    if (!xmlFile->overriddenPath().empty()) summary.add("path", xmlFile->overriddenPath());
+    return summary.str();
+}
+
+}  // namespace
+
+namespace details {
+
+// Walks two HalManifests or two CompatibilityMatrices in parallel.
+class VintfDiffer {
+   public:
+    static std::vector<DiffEntry> diff(const HalManifest& oldManifest,
+                                       const HalManifest& newManifest);
+    static std::vector<DiffEntry> diff(const CompatibilityMatrix& oldMatrix,
+                                       const CompatibilityMatrix& newMatrix);
+
+   private:
+    // Diff the <hal>s of |oldSchema| and |newSchema|, and their instances.
+    template <typename Hal, typename InstanceRef, typename Schema>
+    static void diffHals(const Schema& oldSchema, const Schema& newSchema, Differences* out);
+    // Set |out| to the instances of |hals|, sorted by key.
+    static void getInstances(const std::vector<const ManifestHal*>& hals,
+                             std::vector<ManifestInstanceRef>* out);
+    static void getInstances(const std::vector<const MatrixHal*>& hals,
+                             std::vector<MatrixInstanceRef>* out);
+
+    static void diffKernel(const HalManifest& oldManifest, const HalManifest& newManifest,
+                           Differences* out);
+    static void diffKernels(const CompatibilityMatrix& oldMatrix,
+                            const CompatibilityMatrix& newMatrix, Differences* out);
+    static bool lessKernel(const MatrixKernel& a, const MatrixKernel& b);
+    static std::string kernelKey(const MatrixKernel& kernel);
+
+    // All versions of |hal|, sorted.
+    static std::vector<Version> allVersions(const ManifestHal* hal);
+    static bool sameHal(const ManifestHal* a, const ManifestHal* b);
+    static std::string halValue(const ManifestHal* hal);
+    static bool sameHal(const MatrixHal* a, const MatrixHal* b);
+    static std::string halValue(const MatrixHal* hal);
+};
+
+std::vector<Version> VintfDiffer::allVersions(const ManifestHal* hal) {
+    std::set<Version> versions;
+    hal->appendAllVersions(&versions);
+    return std::vector<Version>(versions.begin(), versions.end());
+}
+
+bool VintfDiffer::sameHal(const ManifestHal* a, const ManifestHal* b) {
+    return a->isOverride() == b->isOverride() && a->getMaxLevel() == b->getMaxLevel() &&
+           a->getMinLevel() == b->getMinLevel() && allVersions(a) == allVersions(b);
+}
+
+std::string VintfDiffer::halValue(const ManifestHal* hal) {
+    std::vector<std::string> versionStrings;
+    for (const Version& version : allVersions(hal)) {
+        versionStrings.push_back(versionString(hal->format, version));
+    }
+    Summary summary;
+    summary.add("versions", android::base::Join(versionStrings, ","))
+        .addFlag("override", hal->isOverride());
+    if (hal->getMaxLevel() != Level::UNSPECIFIED) summary.add("max-level", hal->getMaxLevel());
+    if (hal->getMinLevel() != Level::UNSPECIFIED) summary.add("min-level", hal->getMinLevel());
+    return summary.str();
+}
+
+bool VintfDiffer::sameHal(const MatrixHal* a, const MatrixHal* b) {
+    return a->versionRanges == b->versionRanges && a->optional == b->optional &&
+           a->updatableViaApex == b->updatableViaApex;
+}
+
+std::string VintfDiffer::halValue(const MatrixHal* hal) {
+    std::vector<std::string> versionStrings;
+    for (const VersionRange& range : hal->versionRanges) {
+        versionStrings.push_back(versionRangeString(hal->format, range));
+    }
+    return Summary()
+        .add("versions", android::base::Join(versionStrings, ","))
+        .addFlag("optional", hal->optional)
+        .addFlag("updatable-via-apex", hal->updatableViaApex)
+        .str();
+}
+
+
+template <typename Hal, typename InstanceRef, typename Schema>
+void VintfDiffer::diffHals(const Schema& oldSchema, const Schema& newSchema, Differences* out) {
+    // Reused for each HAL name.
+    std::vector<const Hal*> oldHals;
+    std::vector<const Hal*> newHals;
+    std::vector<InstanceRef> oldInstances;
+    std::vector<InstanceRef> newInstances;
+    forEachHalName(oldSchema.getHals(), newSchema.getHals(), &oldHals, &newHals, [&] {
+        sortIfNeeded(&oldHals, lessFormat<Hal>);
+        sortIfNeeded(&newHals, lessFormat<Hal>);
+        diffSorted(
+            Section::HAL, oldHals, newHals, lessFormat<Hal>,
+            [](const Hal* a, const Hal* b) { return sameHal(a, b); }, halKey<Hal>,
+            [](const Hal* hal) { return halValue(hal); }, out);
+
+        getInstances(oldHals, &oldInstances);
+        getInstances(newHals, &newInstances);
+        diffSorted(
+            Section::INSTANCE, oldInstances, newInstances,
+            [](const InstanceRef& a, const InstanceRef& b) { return lessInstance(a, b); },
+            [](const InstanceRef& a, const InstanceRef& b) { return sameInstance(a, b); },
+            [](const InstanceRef& ref) { return instanceKey(ref); },
+            [](const InstanceRef& ref) { return instanceValue(ref); }, out);
+    });
+}
+
+void VintfDiffer::getInstances(const std::vector<const ManifestHal*>& hals,
+                               std::vector<ManifestInstanceRef>* out) {
+    out->clear();
+    for (const ManifestHal* hal : hals) {
+        // Same instances as ManifestHal::forEachInstance, without copying each AIDL instance
+        // for each <version>.
+        for (const ManifestInstance& instance : hal->mManifestInstances) {
+            if (hal->format == HalFormat::AIDL) {
+                for (const Version& version : hal->versions) out->push_back({&instance, version});
+            } else {
+                out->push_back({&instance, instance.version()});
+            }
+        }
+    }
+    sortIfNeeded(out, [](const auto& a, const auto& b) { return lessInstance(a, b); });
+}
+
+void VintfDiffer::getInstances(const std::vector<const MatrixHal*>& hals,
+                               std::vector<MatrixInstanceRef>* out) {
+    out->clear();
+    for (const MatrixHal* hal : hals) {
+        for (const VersionRange& range : hal->versionRanges) {
+            for (const HalInterface& interface : iterateValues(hal->interfaces)) {
+                interface.forEachInstance(
+                    [&](const std::string& name, const std::string& instance, bool isRegex) {
+                        out->push_back({hal, &range, &name, &instance, isRegex});
+                        return true;
+                    });
+            }
+        }
+    }
+    sortIfNeeded(out, [](const auto& a, const auto& b) { return lessInstance(a, b); });
+}
+
+void VintfDiffer::diffKernel(const HalManifest& oldManifest, const HalManifest& newManifest,
+                             Differences* out) {
+    static const std::map<std::string, std::string> kNoConfigs;
+    auto getKernel = [](const HalManifest& manifest) -> const KernelInfo* {
+        if (manifest.type() != SchemaType::DEVICE || !manifest.device.mKernel.has_value()) {
+            return nullptr;
+        }
+        return &*manifest.device.mKernel;
+    };
+    auto getLevel = [](const KernelInfo* kernel) -> std::optional<Level> {
+        if (kernel == nullptr) return std::nullopt;
+        return specifiedLevel(kernel->level());
+    };
+    auto getVersion = [](const KernelInfo* kernel) -> std::optional<KernelVersion> {
+        if (kernel == nullptr) return std::nullopt;
+        return kernel->version();
+    };
+    const KernelInfo* oldKernel = getKernel(oldManifest);
+    const KernelInfo* newKernel = getKernel(newManifest);
+    diffValue(Section::KERNEL, "target-level", getLevel(oldKernel), getLevel(newKernel),
+              toString<Level>, out);
+    diffValue(Section::KERNEL, "version", getVersion(oldKernel), getVersion(newKernel),
+              toString<KernelVersion>, out);
+
+    using Config = std::pair<const std::string, std::string>;
+    diffSorted(
+        Section::KERNEL_CONFIG, oldKernel ? oldKernel->configs() : kNoConfigs,
+        newKernel ? newKernel->configs() : kNoConfigs,
+        [](const Config& a, const Config& b) { return a.first < b.first; },
+        [](const Config& a, const Config& b) { return a.second == b.second; },
+        [](const Config& config) { return config.first; },
+        [](const Config& config) { return config.second; }, out);
+}
+
+bool VintfDiffer::lessKernel(const MatrixKernel& a, const MatrixKernel& b) {
+    if (a.minLts() < b.minLts()) return true;
+    if (b.minLts() < a.minLts()) return false;
+    // Kernels with the same version from matrices of different levels are different
+    // requirements.
+    if (a.getSourceMatrixLevel() != b.getSourceMatrixLevel()) {
+        return a.getSourceMatrixLevel() < b.getSourceMatrixLevel();
+    }
+    // Conditions are ordered by name and then by value. Values are only formatted to order
+    // conditions with the same name and different values.
+    return std::lexicographical_compare(
+        a.conditions().begin(), a.conditions().end(), b.conditions().begin(),
+        b.conditions().end(), [](const KernelConfig& x, const KernelConfig& y) {
+            if (x.first != y.first) return x.first < y.first;
+            return !(x.second == y.second) && to_string(x.second) < to_string(y.second);
+        });
+}
+
+std::string VintfDiffer::kernelKey(const MatrixKernel& kernel) {
+    std::string key = to_string(kernel.minLts());
+    if (kernel.getSourceMatrixLevel() != Level::UNSPECIFIED) {
+        key += " level=" + to_string(kernel.getSourceMatrixLevel());
+    }
+    std::vector<std::string> conditions;
+    for (const auto& [name, value] : kernel.conditions()) {
+        conditions.push_back(name + "=" + to_string(value));
+    }
+    if (!conditions.empty()) key += " if " + android::base::Join(conditions, ",");
+    return key;
+}
+
+void VintfDiffer::diffKernels(const CompatibilityMatrix& oldMatrix,
+                              const CompatibilityMatrix& newMatrix, Differences* out) {
+    struct ConfigRef {
+        const MatrixKernel* kernel;
+        const KernelConfig* config;
+    };
+    auto lessKernelPointer = [](const MatrixKernel* a, const MatrixKernel* b) {
+        return lessKernel(*a, *b);
+    };
+    auto lessConfig = [](const ConfigRef& a, const ConfigRef& b) {
+        if (lessKernel(*a.kernel, *b.kernel)) return true;
+        if (lessKernel(*b.kernel, *a.kernel)) return false;
+        return a.config->first < b.config->first;
+    };
+    auto getKernels = [&](const CompatibilityMatrix& matrix) {
+        std::vector<const MatrixKernel*> ret;
+        if (matrix.type() != SchemaType::FRAMEWORK) return ret;
+        for (const MatrixKernel& kernel : matrix.framework.mKernels) ret.push_back(&kernel);
+        sortIfNeeded(&ret, lessKernelPointer);
+        return ret;
+    };
+    auto getConfigs = [&](const std::vector<const MatrixKernel*>& kernels) {
+        std::vector<ConfigRef> ret;
+        for (const MatrixKernel* kernel : kernels) {
+            for (const KernelConfig& config : kernel->configs()) ret.push_back({kernel, &config});
+        }
+        sortIfNeeded(&ret, lessConfig);
+        return ret;
+    };
+
+    std::vector<const MatrixKernel*> oldKernels = getKernels(oldMatrix);
+    std::vector<const MatrixKernel*> newKernels = getKernels(newMatrix);
+    diffSorted(
+        Section::KERNEL, oldKernels, newKernels, lessKernelPointer,
+        [](const MatrixKernel*, const MatrixKernel*) { return true; },
+        [](const MatrixKernel* kernel) { return kernelKey(*kernel); },
+        [](const MatrixKernel*) { return std::string(); }, out);
+    diffSorted(
+        Section::KERNEL_CONFIG, getConfigs(oldKernels), getConfigs(newKernels), lessConfig,
+        [](const ConfigRef& a, const ConfigRef& b) {
+            return a.config->second == b.config->second;
+        },
+        [](const ConfigRef& ref) { return kernelKey(*ref.kernel) + " " + ref.config->first; },
+        [](const ConfigRef& ref) { return to_string(ref.config->second); }, out);
+}
+
+std::vector<DiffEntry> VintfDiffer::diff(const HalManifest& oldManifest,
+                                         const HalManifest& newManifest) {
+    Differences out;
+    diffValue(Section::ATTRIBUTE, "level", specifiedLevel(oldManifest.level()),
+              specifiedLevel(newManifest.level()), toString<Level>, &out);
+    diffValue(Section::ATTRIBUTE, "type", std::make_optional(oldManifest.type()),
+              std::make_optional(newManifest.type()), toString<SchemaType>, &out);
+
+    diffHals<ManifestHal, ManifestInstanceRef>(oldManifest, newManifest, &out);
+
+    auto isDevice = [](const HalManifest& manifest) {
+        return manifest.type() == SchemaType::DEVICE;
+    };
+    auto getSepolicyVersion = [&](const HalManifest& manifest) -> std::optional<SepolicyVersion> {
+        if (!isDevice(manifest)) return std::nullopt;
+        return manifest.device.mSepolicyVersion;
+    };
+    diffValue(Section::SEPOLICY, "version", getSepolicyVersion(oldManifest),
+              getSepolicyVersion(newManifest), toString<SepolicyVersion>, &out);
+    diffKernel(oldManifest, newManifest, &out);
+
+    auto getVendorNdks = [&](const HalManifest& manifest) {
+        std::vector<const VendorNdk*> ret;
+        if (isDevice(manifest)) return ret;
+        for (const VendorNdk& vendorNdk : manifest.framework.mVendorNdks) {
+            ret.push_back(&vendorNdk);
+        }
+        sortIfNeeded(&ret, lessVendorNdk);
+        return ret;
+    };
+    diffVendorNdks(getVendorNdks(oldManifest), getVendorNdks(newManifest), &out);
+    diffSystemSdks(isDevice(oldManifest) ? nullptr : &oldManifest.framework.mSystemSdk,
+                   isDevice(newManifest) ? nullptr : &newManifest.framework.mSystemSdk, &out);
+
+    auto lessXmlFile = [](const ManifestXmlFile* a, const ManifestXmlFile* b) {
+        return std::tie(a->name(), a->version()) < std::tie(b->name(), b->version());
+    };
+    diffSorted(
+        Section::XMLFILE, sortedXmlFiles<ManifestXmlFile>(oldManifest, lessXmlFile),
+        sortedXmlFiles<ManifestXmlFile>(newManifest, lessXmlFile), lessXmlFile,
+        [](const ManifestXmlFile* a, const ManifestXmlFile* b) {
+            return a->overriddenPath() == b->overriddenPath();
+        },
+        [](const ManifestXmlFile* xmlFile) {
+            return xmlFile->name() + "@" + to_string(xmlFile->version());
+        },
+        [](const ManifestXmlFile* xmlFile) { return xmlFileValue(xmlFile, Summary()); }, &out);
+    return out.release();
+}
+
+std::vector<DiffEntry> VintfDiffer::diff(const CompatibilityMatrix& oldMatrix,
+                                         const CompatibilityMatrix& newMatrix) {
+    Differences out;
+    diffValue(Section::ATTRIBUTE, "level", specifiedLevel(oldMatrix.level()),
+              specifiedLevel(newMatrix.level()), toString<Level>, &out);
+    diffValue(Section::ATTRIBUTE, "type", std::make_optional(oldMatrix.type()),
+              std::make_optional(newMatrix.type()), toString<SchemaType>, &out);
+
+    diffHals<MatrixHal, MatrixInstanceRef>(oldMatrix, newMatrix, &out);
+
+    auto isFramework = [](const CompatibilityMatrix& matrix) {
+        return matrix.type() == SchemaType::FRAMEWORK;
+    };
+    auto getKernelSepolicyVersion = [&](const CompatibilityMatrix& matrix) {
+        if (!isFramework(matrix)) return std::optional<size_t>();
+        return std::make_optional(matrix.framework.mSepolicy.kernelSepolicyVersion());
+    };
+    diffValue(Section::SEPOLICY, "kernel-sepolicy-version", getKernelSepolicyVersion(oldMatrix),
+              getKernelSepolicyVersion(newMatrix),
+              [](size_t version) { return std::to_string(version); }, &out);
+    // All <sepolicy-version>s have the same key, so they are compared as a set.
+    auto getSepolicyVersions = [&](const CompatibilityMatrix& matrix) {
+        std::vector<const SepolicyVersionRange*> ret;
+        if (!isFramework(matrix)) return ret;
+        for (const auto& range : matrix.framework.mSepolicy.sepolicyVersions()) {
+            ret.push_back(&range);
+        }
+        return ret;
+    };
+    diffSorted(
+        Section::SEPOLICY, getSepolicyVersions(oldMatrix), getSepolicyVersions(newMatrix),
+        [](const SepolicyVersionRange*, const SepolicyVersionRange*) { return false; },
+        [](const SepolicyVersionRange* a, const SepolicyVersionRange* b) { return *a == *b; },
+        [](const SepolicyVersionRange*) { return std::string("sepolicy-version"); },
+        [](const SepolicyVersionRange* range) { return to_string(*range); }, &out);
+
+    auto getAvbMetaVersion = [&](const CompatibilityMatrix& matrix) -> std::optional<Version> {
+        if (!isFramework(matrix)) return std::nullopt;
+        return matrix.framework.mAvbMetaVersion;
+    };
+    diffValue(Section::AVB, "vbmeta-version", getAvbMetaVersion(oldMatrix),
+              getAvbMetaVersion(newMatrix), toString<Version>, &out);
+    diffKernels(oldMatrix, newMatrix, &out);
+
+    auto getVendorNdks = [&](const CompatibilityMatrix& matrix) {
+        std::vector<const VendorNdk*> ret;
+        if (!isFramework(matrix) && !matrix.device.mVendorNdk.version().empty()) {
+            ret.push_back(&matrix.device.mVendorNdk);
+        }
+        return ret;
+    };
+    diffVendorNdks(getVendorNdks(oldMatrix), getVendorNdks(newMatrix), &out);
+    diffSystemSdks(isFramework(oldMatrix) ? nullptr : &oldMatrix.device.mSystemSdk,
+                   isFramework(newMatrix) ? nullptr : &newMatrix.device.mSystemSdk, &out);
+
+    auto lessXmlFile = [](const MatrixXmlFile* a, const MatrixXmlFile* b) {
+        auto key = [](const MatrixXmlFile* xmlFile) {
+            const VersionRange& range = xmlFile->versionRange();
+            return std::make_tuple(std::string_view(xmlFile->name()), range.majorVer,
+                                   range.minMinor, range.maxMinor);
+        };
+        return key(a) < key(b);
+    };
+    diffSorted(
+        Section::XMLFILE, sortedXmlFiles<MatrixXmlFile>(oldMatrix, lessXmlFile),
+        sortedXmlFiles<MatrixXmlFile>(newMatrix, lessXmlFile), lessXmlFile,
+        [](const MatrixXmlFile* a, const MatrixXmlFile* b) {
+            return a->format() == b->format() && a->optional() == b->optional() &&
+                   a->overriddenPath() == b->overriddenPath();
+        },
+        [](const MatrixXmlFile* xmlFile) {
+            return xmlFile->name() + "@" + to_string(xmlFile->versionRange());
+        },
+        [](const MatrixXmlFile* xmlFile) {
+            Summary summary;
+            summary.add("format", xmlFile->format()).addFlag("optional", xmlFile->optional());
+            return xmlFileValue(xmlFile, std::move(summary));
+        },
+        &out);
+    return out.release();
+}
+
+}  // namespace details
+
+bool DiffEntry::operator==(const DiffEntry& other) const {
+    return type == other.type && section == other.section && key == other.key &&
+           oldValue == other.oldValue && newValue == other.newValue;
+}
+
+std::vector<DiffEntry> diff(const HalManifest& oldManifest, const HalManifest& newManifest) {
+    return details::VintfDiffer::diff(oldManifest, newManifest);
+}
+
+std::vector<DiffEntry> diff(const CompatibilityMatrix& oldMatrix,
+                            const CompatibilityMatrix& newMatrix) {
+    return details::VintfDiffer::diff(oldMatrix, newMatrix);
+}
+
+std::ostream& operator<<(std::ostream& os, const DiffEntry& entry) {
+    switch (entry.type) {
+        case DiffEntry::Type::ADDED:
+            os << "+ " << entry.section << " " << entry.key;
+            if (!entry.newValue.empty()) os << ": " << entry.newValue;
+            return os;
+        case DiffEntry::Type::REMOVED:
+            os << "- " << entry.section << " " << entry.key;
+            if (!entry.oldValue.empty()) os << ": " << entry.oldValue;
+            return os;
+        case DiffEntry::Type::CHANGED:
+            return os << "~ " << entry.section << " " << entry.key << ": " << entry.oldValue
+                      << " -> " << entry.newValue;
+    }
+}
+
+}  // namespace vintf
+}  // namespace android
@@ -20,7 +20,9 @@
 #include <algorithm>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <set>
 #include <vector>
 
 #include <aidl/metadata.h>
@@ -32,11 +34,13 @@
 
 #include "Apex.h"
 #include "CompatibilityMatrix.h"
+#include "KernelRequirementTable.h"
 #include "VintfObjectUtils.h"
 #include "constants-private.h"
 #include "include/vintf/FqInstance.h"
 #include "parse_string.h"
 #include "parse_xml.h"
+#include "parse_xml_internal.h"
 #include "utils.h"
 
 using std::placeholders::_1;
@@ -105,24 +109,29 @@ static bool isAllowedToUseLibvintf() {
            allowedBinaries.end();
 }
 
-std::shared_ptr<VintfObject> VintfObject::GetInstance() {
-    static details::LockedSharedPtr<VintfObject> sInstance{};
-    std::unique_lock<std::mutex> lock(sInstance.mutex);
-    if (sInstance.object == nullptr) {
+// The global instance, created on first use. Function-local statics are initialized exactly
+// once, and later calls only check the initialization guard with an atomic load, so reading
+// the instance does not lock. Static variants of member functions use the reference directly
+// instead of copying the shared_ptr, which would contend on its reference count.
+static const std::shared_ptr<VintfObject>& sharedInstance() {
+    static const std::shared_ptr<VintfObject> sInstance = [] {
         if (!isAllowedToUseLibvintf()) {
             LOG(ERROR) << "libvintf-usage-violation: Executable "
                        << android::base::GetExecutablePath()
                        << " should not use libvintf. It should query VINTF "
                        << "metadata via servicemanager";
         }
+        return std::shared_ptr<VintfObject>(VintfObject::Builder().build().release());
+    }();
+    return sInstance;
+}
 
-        sInstance.object = std::shared_ptr<VintfObject>(VintfObject::Builder().build().release());
-    }
-    return sInstance.object;
+std::shared_ptr<VintfObject> VintfObject::GetInstance() {
+    return sharedInstance();
 }
 
 std::shared_ptr<const HalManifest> VintfObject::GetDeviceHalManifest() {
-    return GetInstance()->getDeviceHalManifest();
+    return sharedInstance()->getDeviceHalManifest();
 }
 
 std::shared_ptr<const HalManifest> VintfObject::getDeviceHalManifest() {
@@ -133,7 +142,7 @@ std::shared_ptr<const HalManifest> VintfObject::getDeviceHalManifest() {
 }
 
 std::shared_ptr<const HalManifest> VintfObject::GetFrameworkHalManifest() {
-    return GetInstance()->getFrameworkHalManifest();
+    return sharedInstance()->getFrameworkHalManifest();
 }
 
 std::shared_ptr<const HalManifest> VintfObject::getFrameworkHalManifest() {
@@ -143,8 +152,35 @@ std::shared_ptr<const HalManifest> VintfObject::getFrameworkHalManifest() {
                apex::GetModifiedTime(getFileSystem().get(), getPropertyFetcher().get()));
 }
 
+std::shared_ptr<const ManifestInstanceIndex> VintfObject::GetManifestInstanceIndex() {
+    return sharedInstance()->getManifestInstanceIndex();
+}
+
+std::shared_ptr<const ManifestInstanceIndex> VintfObject::getManifestInstanceIndex() {
+    // Reload the manifests if necessary before any locks.
+    (void)getDeviceHalManifest();
+    (void)getFrameworkHalManifest();
+
+    std::unique_lock<std::mutex> lock(mManifestInstanceIndex.mutex);
+    // Another thread may have reloaded a manifest since the calls above, so index the manifests
+    // that are cached now. Otherwise, an index of older manifests could replace a newer one.
+    auto deviceManifest = GetCached(&mDeviceManifest);
+    auto frameworkManifest = GetCached(&mFrameworkManifest);
+    if (deviceManifest == nullptr && frameworkManifest == nullptr) return nullptr;
+
+    // The index holds the manifests it is built from, so a reloaded manifest never has the
+    // address of the one that is indexed.
+    const auto& index = mManifestInstanceIndex.object;
+    if (index == nullptr || index->deviceManifest() != deviceManifest ||
+        index->frameworkManifest() != frameworkManifest) {
+        mManifestInstanceIndex.object = std::make_shared<ManifestInstanceIndex>(
+            std::move(deviceManifest), std::move(frameworkManifest));
+    }
+    return mManifestInstanceIndex.object;
+}
+
 std::shared_ptr<const CompatibilityMatrix> VintfObject::GetDeviceCompatibilityMatrix() {
-    return GetInstance()->getDeviceCompatibilityMatrix();
+    return sharedInstance()->getDeviceCompatibilityMatrix();
 }
 
 std::shared_ptr<const CompatibilityMatrix> VintfObject::getDeviceCompatibilityMatrix() {
@@ -152,7 +188,7 @@ std::shared_ptr<const CompatibilityMatrix> VintfObject::getDeviceCompatibilityMa
 }
 
 std::shared_ptr<const CompatibilityMatrix> VintfObject::GetFrameworkCompatibilityMatrix() {
-    return GetInstance()->getFrameworkCompatibilityMatrix();
+    return sharedInstance()->getFrameworkCompatibilityMatrix();
 }
 
 std::shared_ptr<const CompatibilityMatrix> VintfObject::getFrameworkCompatibilityMatrix() {
@@ -175,13 +211,40 @@ std::shared_ptr<const CompatibilityMatrix> VintfObject::getFrameworkCompatibilit
     }
 
     return Get(__func__, &mFrameworkMatrix,
-               std::bind(&CompatibilityMatrix::fetchAllInformation, _1, getFileSystem().get(),
-                         kSystemLegacyMatrix, _2));
+               std::bind(&details::fetchAllInformation<CompatibilityMatrix>, getFileSystem().get(),
+                         kSystemLegacyMatrix, _1, _2, getTracer().get()));
 }
 
 status_t VintfObject::getCombinedFrameworkMatrix(
     const std::shared_ptr<const HalManifest>& deviceManifest, Level kernelLevel,
     CompatibilityMatrix* out, std::string* error) {
+    details::ScopedSpan frameworkMatrixSpan(getTracer().get(),
+                                            "VintfObject::getCombinedFrameworkMatrix");
+    if (deviceManifest != nullptr && deviceManifest->level() != Level::UNSPECIFIED) {
+        // Combine fragments as they are read, so that fragments that do not contribute to the
+        // combined matrix are dropped right away.
+        CompatibilityMatrix::Combiner combiner(deviceManifest->level(), kernelLevel);
+        size_t fragmentCount = 0;
+        status_t status = forEachFrameworkMatrixLevel(
+            [&](CompatibilityMatrix&& fragment, std::string* fragmentError) {
+                ++fragmentCount;
+                return combiner.add(std::move(fragment), fragmentError);
+            },
+            error);
+        if (status != OK) {
+            return status;
+        }
+        details::ScopedSpan span(getTracer().get(), "CompatibilityMatrix::combine");
+        if (span.isEnabled()) span.addAttribute("fragments", fragmentCount);
+        auto combined = combiner.combine(error);
+        if (combined == nullptr) {
+            return BAD_VALUE;
+        }
+        *out = std::move(*combined);
+        return OK;
+    }
+
+    // The device level is inferred from the fragments, so they are all read before combining.
     std::vector<CompatibilityMatrix> matrixFragments;
     auto matrixFragmentsStatus = getAllFrameworkMatrixLevels(&matrixFragments, error);
     if (matrixFragmentsStatus != OK) {
@@ -194,20 +257,13 @@ status_t VintfObject::getCombinedFrameworkMatrix(
         return NAME_NOT_FOUND;
     }
 
+    // Cannot infer FCM version. Combine all matrices by assuming
+    // Shipping FCM Version == min(all supported FCM Versions in the framework)
     Level deviceLevel = Level::UNSPECIFIED;
-
-    if (deviceManifest != nullptr) {
-        deviceLevel = deviceManifest->level();
-    }
-
-    if (deviceLevel == Level::UNSPECIFIED) {
-        // Cannot infer FCM version. Combine all matrices by assuming
-        // Shipping FCM Version == min(all supported FCM Versions in the framework)
-        for (auto&& fragment : matrixFragments) {
-            Level fragmentLevel = fragment.level();
-            if (fragmentLevel != Level::UNSPECIFIED && deviceLevel > fragmentLevel) {
-                deviceLevel = fragmentLevel;
-            }
+    for (auto&& fragment : matrixFragments) {
+        Level fragmentLevel = fragment.level();
+        if (fragmentLevel != Level::UNSPECIFIED && deviceLevel > fragmentLevel) {
+            deviceLevel = fragmentLevel;
         }
     }
 
@@ -221,6 +277,8 @@ status_t VintfObject::getCombinedFrameworkMatrix(
         return NAME_NOT_FOUND;
     }
 
+    details::ScopedSpan span(getTracer().get(), "CompatibilityMatrix::combine");
+    if (span.isEnabled()) span.addAttribute("fragments", matrixFragments.size());
     auto combined = CompatibilityMatrix::combine(deviceLevel, kernelLevel, &matrixFragments, error);
     if (combined == nullptr) {
         return BAD_VALUE;
@@ -234,7 +292,8 @@ status_t VintfObject::getCombinedFrameworkMatrix(
 status_t VintfObject::addDirectoryManifests(const std::string& directory, HalManifest* manifest,
                                             bool forceSchemaType, std::string* error) {
     std::vector<std::string> fileNames;
-    status_t err = getFileSystem()->listFiles(directory, &fileNames, error);
+    status_t err = details::tracedListFiles(getTracer().get(), getFileSystem().get(), directory,
+                                            &fileNames, error);
     // if the directory isn't there, that's okay
     if (err == NAME_NOT_FOUND) {
         if (error) {
@@ -244,10 +303,13 @@ status_t VintfObject::addDirectoryManifests(const std::string& directory, HalMan
     }
     if (err != OK) return err;
 
+    // The fragments are dropped once addAll() has moved their HALs into |manifest|, so they are
+    // allocated from an arena that is freed at once.
+    std::pmr::monotonic_buffer_resource arena;
     for (const std::string& file : fileNames) {
         // Only adds HALs because all other things are added by libvintf
         // itself for now.
-        HalManifest fragmentManifest;
+        HalManifest fragmentManifest(&arena);
         err = fetchOneHalManifest(directory + file, &fragmentManifest, error);
         if (err != OK) return err;
 
@@ -255,6 +317,8 @@ status_t VintfObject::addDirectoryManifests(const std::string& directory, HalMan
             fragmentManifest.setType(manifest->type());
         }
 
+        details::ScopedSpan span(getTracer().get(), "HalManifest::addAll");
+        if (span.isEnabled()) span.addAttribute("path", directory + file);
         if (!manifest->addAll(&fragmentManifest, error)) {
             if (error) {
                 error->insert(0, "Cannot add manifest fragment " + directory + file + ": ");
@@ -300,6 +364,7 @@ status_t VintfObject::fetchDeviceHalManifestApex(HalManifest* out, std::string*
 // A + B means unioning <hal> tags from A and B. If B declares an override, then this takes priority
 // over A.
 status_t VintfObject::fetchDeviceHalManifest(HalManifest* out, std::string* error) {
+    details::ScopedSpan span(getTracer().get(), "VintfObject::fetchDeviceHalManifest");
     HalManifest vendorManifest;
     status_t vendorStatus = fetchVendorHalManifest(&vendorManifest, error);
     if (vendorStatus != OK && vendorStatus != NAME_NOT_FOUND) {
@@ -328,6 +393,8 @@ status_t VintfObject::fetchDeviceHalManifest(HalManifest* out, std::string* erro
 
     if (vendorStatus == OK) {
         if (odmStatus == OK) {
+            details::ScopedSpan addAllSpan(getTracer().get(), "HalManifest::addAll");
+            if (addAllSpan.isEnabled()) addAllSpan.addAttribute("path", odmManifest.fileName());
             if (!out->addAll(&odmManifest, error)) {
                 if (error) {
                     error->insert(0, "Cannot add ODM manifest :");
@@ -347,7 +414,8 @@ status_t VintfObject::fetchDeviceHalManifest(HalManifest* out, std::string* erro
     }
 
     // Use legacy /vendor/manifest.xml
-    return out->fetchAllInformation(getFileSystem().get(), kVendorLegacyManifest, error);
+    return details::fetchAllInformation(getFileSystem().get(), kVendorLegacyManifest, out, error,
+                                        getTracer().get());
 }
 
 // Priority:
@@ -428,8 +496,9 @@ status_t VintfObject::fetchOdmHalManifest(HalManifest* out, std::string* error)
 // Returns NAME_NOT_FOUND if file is missing.
 status_t VintfObject::fetchOneHalManifest(const std::string& path, HalManifest* out,
                                           std::string* error) {
-    HalManifest ret;
-    status_t status = ret.fetchAllInformation(getFileSystem().get(), path, error);
+    HalManifest ret(out->memoryResource());
+    status_t status =
+        details::fetchAllInformation(getFileSystem().get(), path, &ret, error, getTracer().get());
     if (status == OK) {
         *out = std::move(ret);
     }
@@ -437,12 +506,15 @@ status_t VintfObject::fetchOneHalManifest(const std::string& path, HalManifest*
 }
 
 status_t VintfObject::fetchDeviceMatrix(CompatibilityMatrix* out, std::string* error) {
+    details::ScopedSpan span(getTracer().get(), "VintfObject::fetchDeviceMatrix");
     CompatibilityMatrix etcMatrix;
-    if (etcMatrix.fetchAllInformation(getFileSystem().get(), kVendorMatrix, error) == OK) {
+    if (details::fetchAllInformation(getFileSystem().get(), kVendorMatrix, &etcMatrix, error,
+                                     getTracer().get()) == OK) {
         *out = std::move(etcMatrix);
         return OK;
     }
-    return out->fetchAllInformation(getFileSystem().get(), kVendorLegacyMatrix, error);
+    return details::fetchAllInformation(getFileSystem().get(), kVendorLegacyMatrix, out, error,
+                                        getTracer().get());
 }
 
 // Priority:
@@ -471,6 +543,8 @@ status_t VintfObject::fetchUnfilteredFrameworkHalManifest(HalManifest* out, std:
                 return status;
             }
             if (status == OK) {
+                details::ScopedSpan span(getTracer().get(), "HalManifest::addAll");
+                if (span.isEnabled()) span.addAttribute("path", manifestPath);
                 if (!out->addAll(&halManifest, error)) {
                     if (error) {
                         error->insert(0, "Cannot add "s + manifestPath + ":");
@@ -492,10 +566,12 @@ status_t VintfObject::fetchUnfilteredFrameworkHalManifest(HalManifest* out, std:
                      << (error ? *error : strerror(-systemEtcStatus));
     }
 
-    return out->fetchAllInformation(getFileSystem().get(), kSystemLegacyManifest, error);
+    return details::fetchAllInformation(getFileSystem().get(), kSystemLegacyManifest, out, error,
+                                        getTracer().get());
 }
 
 status_t VintfObject::fetchFrameworkHalManifest(HalManifest* out, std::string* error) {
+    details::ScopedSpan span(getTracer().get(), "VintfObject::fetchFrameworkHalManifest");
     status_t status = fetchUnfilteredFrameworkHalManifest(out, error);
     if (status != OK) {
         return status;
@@ -565,12 +641,50 @@ static void appendLine(std::string* error, const std::string& message) {
 }
 
 status_t VintfObject::getOneMatrix(const std::string& path, CompatibilityMatrix* out,
-                                   std::string* error) {
+                                   std::string* error, const std::string& kernelTablePath) {
     std::string content;
-    status_t status = getFileSystem()->fetch(path, &content, error);
+    status_t status =
+        details::tracedFetch(getTracer().get(), getFileSystem().get(), path, &content, error);
     if (status != OK) {
         return status;
     }
+    if (!kernelTablePath.empty()) {
+        std::string table;
+        std::string tableError;
+        status = details::tracedFetch(getTracer().get(), getFileSystem().get(), kernelTablePath,
+                                      &table, &tableError);
+        if (status == OK && !details::KernelRequirementTable::matches(table, content)) {
+            tableError = "out of date with " + path;
+            status = BAD_VALUE;
+        }
+        if (status == OK) {
+            details::ScopedSpan span(getTracer().get(), "fromXml");
+            if (span.isEnabled()) {
+                span.addAttribute("path", path);
+                span.addAttribute("bytes", content.size());
+            }
+            CompatibilityMatrix matrix;
+            if (fromXmlWithoutKernels(&matrix, content, &tableError)) {
+                // Only framework compatibility matrices have kernel requirements.
+                if (matrix.type() != SchemaType::FRAMEWORK) {
+                    tableError = path + " is not a framework compatibility matrix";
+                } else if (details::KernelRequirementTable::read(
+                               table, &matrix.framework.mKernels, &tableError)) {
+                    *out = std::move(matrix);
+                    out->setFileName(path);
+                    return OK;
+                }
+            }
+        }
+        // Fall back to the <kernel>s in the matrix.
+        LOG(WARNING) << "Ignore kernel requirement table " << kernelTablePath << ": "
+                     << tableError;
+    }
+    details::ScopedSpan span(getTracer().get(), "fromXml");
+    if (span.isEnabled()) {
+        span.addAttribute("path", path);
+        span.addAttribute("bytes", content.size());
+    }
     if (!fromXml(out, content, error)) {
         if (error) {
             error->insert(0, "Cannot parse " + path + ": ");
@@ -583,6 +697,18 @@ status_t VintfObject::getOneMatrix(const std::string& path, CompatibilityMatrix*
 
 status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatrix>* results,
                                                   std::string* error) {
+    return forEachFrameworkMatrixLevel(
+        [results](CompatibilityMatrix&& matrix, std::string*) {
+            results->emplace_back(std::move(matrix));
+            return true;
+        },
+        error);
+}
+
+status_t VintfObject::forEachFrameworkMatrixLevel(
+    const std::function<bool(CompatibilityMatrix&&, std::string*)>& onMatrix,
+    std::string* error) {
+    size_t matrixCount = 0;
     std::vector<std::string> dirs = {
         kSystemVintfDir,
         kSystemExtVintfDir,
@@ -590,7 +716,8 @@ status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatri
     };
     for (const auto& dir : dirs) {
         std::vector<std::string> fileNames;
-        status_t listStatus = getFileSystem()->listFiles(dir, &fileNames, error);
+        status_t listStatus = details::tracedListFiles(getTracer().get(), getFileSystem().get(),
+                                                       dir, &fileNames, error);
         if (listStatus == NAME_NOT_FOUND) {
             if (error) {
                 error->clear();
@@ -600,11 +727,25 @@ status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatri
         if (listStatus != OK) {
             return listStatus;
         }
+        std::set<std::string> kernelTables;
         for (const std::string& fileName : fileNames) {
+            if (base::EndsWith(fileName, details::kKernelRequirementTableSuffix)) {
+                kernelTables.insert(fileName);
+            }
+        }
+        for (const std::string& fileName : fileNames) {
+            if (kernelTables.count(fileName) > 0) {
+                continue;
+            }
             std::string path = dir + fileName;
+            std::string kernelTableName =
+                fileName + std::string(details::kKernelRequirementTableSuffix);
+            std::string kernelTablePath =
+                kernelTables.count(kernelTableName) > 0 ? dir + kernelTableName : "";
             CompatibilityMatrix namedMatrix;
             std::string matrixError;
-            status_t matrixStatus = getOneMatrix(path, &namedMatrix, &matrixError);
+            status_t matrixStatus =
+                getOneMatrix(path, &namedMatrix, &matrixError, kernelTablePath);
             if (matrixStatus != OK) {
                 // Manifests and matrices share the same dir. Client may not have enough
                 // permissions to read system manifests, or may not be able to parse it.
@@ -612,10 +753,13 @@ status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatri
                 LOG(logLevel) << "Framework Matrix: Ignore file " << path << ": " << matrixError;
                 continue;
             }
-            results->emplace_back(std::move(namedMatrix));
+            ++matrixCount;
+            if (!onMatrix(std::move(namedMatrix), error)) {
+                return BAD_VALUE;
+            }
         }
 
-        if (dir == kSystemVintfDir && results->empty()) {
+        if (dir == kSystemVintfDir && matrixCount == 0) {
             if (error) {
                 *error = "No framework matrices under " + dir + " can be fetched or parsed.\n";
             }
@@ -623,7 +767,7 @@ status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatri
         }
     }
 
-    if (results->empty()) {
+    if (matrixCount == 0) {
         if (error) {
             *error =
                 "No framework matrices can be fetched or parsed. "
@@ -636,7 +780,7 @@ status_t VintfObject::getAllFrameworkMatrixLevels(std::vector<CompatibilityMatri
 }
 
 std::shared_ptr<const RuntimeInfo> VintfObject::GetRuntimeInfo(RuntimeInfo::FetchFlags flags) {
-    return GetInstance()->getRuntimeInfo(flags);
+    return sharedInstance()->getRuntimeInfo(flags);
 }
 std::shared_ptr<const RuntimeInfo> VintfObject::getRuntimeInfo(RuntimeInfo::FetchFlags flags) {
     std::unique_lock<std::mutex> _lock(mDeviceRuntimeInfo.mutex);
@@ -688,6 +832,25 @@ std::shared_ptr<const RuntimeInfo> VintfObject::getRuntimeInfo(RuntimeInfo::Fetc
 }
 
 int32_t VintfObject::checkCompatibility(std::string* error, CheckFlags::Type flags) {
+    return checkCompatibility(CompatibilityCheckResults{}, error, flags);
+}
+
+// Return |result| of a check if it has one, and set |error| accordingly. Otherwise, run the
+// check.
+template <typename F>
+static bool checkOrReuse(const std::optional<VintfObject::CompatibilityCheckResult>& result,
+                         std::string* error, const F& check) {
+    if (!result.has_value()) {
+        return check();
+    }
+    if (!result->compatible && error) {
+        *error = result->error;
+    }
+    return result->compatible;
+}
+
+int32_t VintfObject::checkCompatibility(const CompatibilityCheckResults& results,
+                                        std::string* error, CheckFlags::Type flags) {
     status_t status = OK;
     // null checks for files and runtime info
     if (getFrameworkHalManifest() == nullptr) {
@@ -716,14 +879,21 @@ int32_t VintfObject::checkCompatibility(std::string* error, CheckFlags::Type fla
     if (status != OK) return status;
 
     // compatiblity check.
-    if (!getDeviceHalManifest()->checkCompatibility(*getFrameworkCompatibilityMatrix(), error)) {
+    details::ScopedSpan span(getTracer().get(), "VintfObject::checkCompatibility");
+    if (!checkOrReuse(results.deviceManifest, error, [&] {
+            return getDeviceHalManifest()->checkCompatibility(*getFrameworkCompatibilityMatrix(),
+                                                              error);
+        })) {
         if (error) {
             error->insert(0,
                           "Device manifest and framework compatibility matrix are incompatible: ");
         }
         return INCOMPATIBLE;
     }
-    if (!getFrameworkHalManifest()->checkCompatibility(*getDeviceCompatibilityMatrix(), error)) {
+    if (!checkOrReuse(results.frameworkManifest, error, [&] {
+            return getFrameworkHalManifest()->checkCompatibility(*getDeviceCompatibilityMatrix(),
+                                                                 error);
+        })) {
         if (error) {
             error->insert(0,
                           "Framework manifest and device compatibility matrix are incompatible: ");
@@ -732,8 +902,10 @@ int32_t VintfObject::checkCompatibility(std::string* error, CheckFlags::Type fla
     }
 
     if (flags.isRuntimeInfoEnabled()) {
-        if (!getRuntimeInfo()->checkCompatibility(*getFrameworkCompatibilityMatrix(), error,
-                                                  flags)) {
+        if (!checkOrReuse(results.runtimeInfo, error, [&] {
+                return getRuntimeInfo()->checkCompatibility(*getFrameworkCompatibilityMatrix(),
+                                                            error, flags);
+            })) {
             if (error) {
                 error->insert(0,
                               "Runtime info and framework compatibility matrix are incompatible: ");
@@ -1007,8 +1179,13 @@ int32_t VintfObject::checkDeprecation(const std::vector<HidlInterfaceMetadata>&
         return NAME_NOT_FOUND;
     }
     // so that they can be combined into one matrix for deprecation checking.
-    auto targetMatrix =
-        CompatibilityMatrix::combine(deviceLevel, kernelLevel, &targetMatrices, error);
+    std::unique_ptr<CompatibilityMatrix> targetMatrix;
+    {
+        details::ScopedSpan span(getTracer().get(), "CompatibilityMatrix::combine");
+        if (span.isEnabled()) span.addAttribute("fragments", targetMatrices.size());
+        targetMatrix =
+            CompatibilityMatrix::combine(deviceLevel, kernelLevel, &targetMatrices, error);
+    }
     if (targetMatrix == nullptr) {
         return BAD_VALUE;
     }
@@ -1066,6 +1243,10 @@ const std::unique_ptr<ObjectFactory<RuntimeInfo>>& VintfObject::getRuntimeInfoFa
     return mRuntimeInfoFactory;
 }
 
+const std::unique_ptr<Tracer>& VintfObject::getTracer() {
+    return mTracer;
+}
+
 android::base::Result<bool> VintfObject::hasFrameworkCompatibilityMatrixExtensions() {
     std::vector<CompatibilityMatrix> matrixFragments;
     std::string error;
@@ -1433,11 +1614,17 @@ VintfObjectBuilder& VintfObjectBuilder::setPropertyFetcher(std::unique_ptr<Prope
     return *this;
 }
 
+VintfObjectBuilder& VintfObjectBuilder::setTracer(std::unique_ptr<Tracer>&& e) {
+    mObject->mTracer = std::move(e);
+    return *this;
+}
+
 std::unique_ptr<VintfObject> VintfObjectBuilder::buildInternal() {
     if (!mObject->mFileSystem) mObject->mFileSystem = createDefaultFileSystem();
     if (!mObject->mRuntimeInfoFactory)
         mObject->mRuntimeInfoFactory = std::make_unique<ObjectFactory<RuntimeInfo>>();
     if (!mObject->mPropertyFetcher) mObject->mPropertyFetcher = createDefaultPropertyFetcher();
+    if (!mObject->mTracer) mObject->mTracer = std::make_unique<details::TracerNoOp>();
     return std::move(mObject);
 }
 
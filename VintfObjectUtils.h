@@ -59,6 +59,13 @@ std::shared_ptr<const T> Get(const char* id, LockedSharedPtr<T>* ptr, const F& f
     return ptr->object;
 }
 
+// Return the data cached in LockedSharedPtr by the last Get(), without fetching it.
+template <typename T>
+std::shared_ptr<const T> GetCached(LockedSharedPtr<T>* ptr) {
+    std::unique_lock<std::mutex> lock(ptr->mutex);
+    return ptr->object;
+}
+
 }  // namespace details
 }  // namespace vintf
 }  // namespace android
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "XmlPullParser.h"
+
+#include <ctype.h>
+#include <stdint.h>
+
+namespace android::vintf::details {
+
+namespace {
+
+constexpr std::string_view kBom = "\xEF\xBB\xBF";
+
+// Same character classes as tinyxml2::XMLUtil.
+inline bool isWhiteSpace(char c) {
+    auto ch = static_cast<unsigned char>(c);
+    return ch < 128 && isspace(ch);
+}
+
+inline bool isNameStartChar(char c) {
+    auto ch = static_cast<unsigned char>(c);
+    return ch >= 128 || isalpha(ch) || ch == ':' || ch == '_';
+}
+
+inline bool isNameChar(char c) {
+    return isNameStartChar(c) || isdigit(static_cast<unsigned char>(c)) || c == '.' || c == '-';
+}
+
+inline bool startsWith(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+void appendUtf8(uint32_t ucs, std::string* out) {
+    if (ucs < 0x80) {
+        out->push_back(static_cast<char>(ucs));
+    } else if (ucs < 0x800) {
+        out->push_back(static_cast<char>(0xC0 | (ucs >> 6)));
+        out->push_back(static_cast<char>(0x80 | (ucs & 0x3F)));
+    } else if (ucs < 0x10000) {
+        out->push_back(static_cast<char>(0xE0 | (ucs >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((ucs >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (ucs & 0x3F)));
+    } else if (ucs < 0x200000) {
+        out->push_back(static_cast<char>(0xF0 | (ucs >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((ucs >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((ucs >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (ucs & 0x3F)));
+    }
+    // Like tinyxml2, code points that do not fit in 4 bytes are dropped.
+}
+
+// Parse a character reference ("&#123;" or "&#x7B;") at the beginning of |s|.
+// On success, return the number of characters consumed. Return 0 if |s| does not start with
+// a valid character reference.
+size_t parseCharacterRef(std::string_view s, std::string* out) {
+    bool hex = startsWith(s, "&#x");
+    size_t begin = hex ? 3 : 2;
+    size_t end = s.find(';', begin);
+    if (end == std::string_view::npos || end == begin) {
+        return 0;
+    }
+    uint32_t ucs = 0;
+    for (size_t i = begin; i < end; ++i) {
+        char c = s[i];
+        uint32_t digit;
+        if (isdigit(static_cast<unsigned char>(c))) {
+            digit = c - '0';
+        } else if (hex && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (hex && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return 0;
+        }
+        uint32_t base = hex ? 16 : 10;
+        if (ucs > (UINT32_MAX - digit) / base) {
+            return 0;
+        }
+        ucs = ucs * base + digit;
+    }
+    appendUtf8(ucs, out);
+    return end + 1;
+}
+
+struct Entity {
+    std::string_view pattern;
+    char value;
+};
+
+constexpr Entity kEntities[] = {
+    {"quot;", '"'}, {"amp;", '&'}, {"apos;", '\''}, {"lt;", '<'}, {"gt;", '>'},
+};
+
+}  // namespace
+
+void unescapeXml(std::string_view raw, bool processEntities, std::string* out) {
+    out->clear();
+    out->reserve(raw.size());
+    size_t i = 0;
+    while (i < raw.size()) {
+        char c = raw[i];
+        if (c == '\r' || c == '\n') {
+            // CR-LF, LF-CR, lone CR and lone LF all become LF.
+            char pair = c == '\r' ? '\n' : '\r';
+            i += (i + 1 < raw.size() && raw[i + 1] == pair) ? 2 : 1;
+            out->push_back('\n');
+            continue;
+        }
+        if (processEntities && c == '&') {
+            std::string_view rest = raw.substr(i);
+            if (startsWith(rest, "&#")) {
+                size_t consumed = parseCharacterRef(rest, out);
+                if (consumed > 0) {
+                    i += consumed;
+                    continue;
+                }
+            } else {
+                bool found = false;
+                for (const auto& entity : kEntities) {
+                    if (startsWith(rest.substr(1), entity.pattern)) {
+                        out->push_back(entity.value);
+                        i += entity.pattern.size() + 1;
+                        found = true;
+                        break;
+                    }
+                }
+                if (found) continue;
+            }
+            // Unknown references are kept verbatim.
+        }
+        out->push_back(c);
+        ++i;
+    }
+}
+
+// --------------- XmlPullParser
+
+XmlPullParser::XmlPullParser(std::string_view xml) : mXml(xml.substr(0, xml.find('\0'))) {
+    skipWhiteSpace();
+    if (startsWith(mXml.substr(mPos), kBom)) {
+        mPos += kBom.size();
+    }
+    if (mPos >= mXml.size()) {
+        // An empty document is an error.
+        mLastEvent = Event::ERROR;
+    }
+}
+
+XmlPullParser::Event XmlPullParser::fail() {
+    mAttributes.clear();
+    return mLastEvent = Event::ERROR;
+}
+
+void XmlPullParser::skipWhiteSpace() {
+    while (mPos < mXml.size() && isWhiteSpace(mXml[mPos])) ++mPos;
+}
+
+bool XmlPullParser::skipPast(std::string_view terminator) {
+    size_t end = mXml.find(terminator, mPos);
+    if (end == std::string_view::npos) {
+        return false;
+    }
+    mText = mXml.substr(mPos, end - mPos);
+    mPos = end + terminator.size();
+    return true;
+}
+
+bool XmlPullParser::parseName(std::string_view* name) {
+    size_t begin = mPos;
+    if (mPos >= mXml.size() || !isNameStartChar(mXml[mPos])) {
+        return false;
+    }
+    ++mPos;
+    while (mPos < mXml.size() && isNameChar(mXml[mPos])) ++mPos;
+    *name = mXml.substr(begin, mPos - begin);
+    return true;
+}
+
+XmlPullParser::Event XmlPullParser::next() {
+    if (mLastEvent == Event::END_DOCUMENT || mLastEvent == Event::ERROR) {
+        return mLastEvent;
+    }
+    mAttributes.clear();
+    mIsCData = false;
+
+    if (mPendingEnd) {
+        mPendingEnd = false;
+        mName = mOpenElements.back();
+        mOpenElements.pop_back();
+        return mLastEvent = Event::END_ELEMENT;
+    }
+
+    size_t textBegin = mPos;
+    skipWhiteSpace();
+    if (mPos >= mXml.size()) {
+        if (!mOpenElements.empty()) {
+            return fail();  // unclosed element
+        }
+        return mLastEvent = Event::END_DOCUMENT;
+    }
+
+    std::string_view rest = mXml.substr(mPos);
+    if (rest[0] != '<') {
+        // All the text counts, including leading whitespace.
+        mPos = textBegin;
+        if (!skipPast("<")) {
+            return fail();
+        }
+        --mPos;  // leave '<' for the next token
+        mSeenNode = true;
+        return mLastEvent = Event::TEXT;
+    }
+    if (startsWith(rest, "<?")) {
+        // Declarations must come before anything else in the document.
+        if (mSeenNode || !mOpenElements.empty()) {
+            return fail();
+        }
+        mPos += 2;
+        if (!skipPast("?>")) return fail();
+        return mLastEvent = Event::OTHER;
+    }
+    mSeenNode = true;
+    if (startsWith(rest, "<!--")) {
+        mPos += 4;
+        if (!skipPast("-->")) return fail();
+        return mLastEvent = Event::OTHER;
+    }
+    if (startsWith(rest, "<![CDATA[")) {
+        mPos += 9;
+        if (!skipPast("]]>")) return fail();
+        mIsCData = true;
+        return mLastEvent = Event::TEXT;
+    }
+    if (startsWith(rest, "<!")) {
+        mPos += 2;
+        if (!skipPast(">")) return fail();
+        return mLastEvent = Event::OTHER;
+    }
+    ++mPos;
+    return mLastEvent = parseElement();
+}
+
+XmlPullParser::Event XmlPullParser::parseElement() {
+    skipWhiteSpace();
+    bool closing = mPos < mXml.size() && mXml[mPos] == '/';
+    if (closing) ++mPos;
+    if (!parseName(&mName)) {
+        return fail();
+    }
+
+    if (closing) {
+        skipWhiteSpace();
+        if (mPos >= mXml.size() || mXml[mPos] != '>') {
+            return fail();
+        }
+        ++mPos;
+        if (mOpenElements.empty() || mOpenElements.back() != mName) {
+            return fail();  // mismatched element
+        }
+        mOpenElements.pop_back();
+        return Event::END_ELEMENT;
+    }
+
+    while (true) {
+        skipWhiteSpace();
+        if (mPos >= mXml.size()) {
+            return fail();
+        }
+        char c = mXml[mPos];
+        if (c == '>') {
+            ++mPos;
+            break;
+        }
+        if (c == '/' && mPos + 1 < mXml.size() && mXml[mPos + 1] == '>') {
+            mPos += 2;
+            mPendingEnd = true;
+            break;
+        }
+        std::string_view attrName;
+        if (!parseName(&attrName)) {
+            return fail();
+        }
+        skipWhiteSpace();
+        if (mPos >= mXml.size() || mXml[mPos] != '=') {
+            return fail();
+        }
+        ++mPos;
+        skipWhiteSpace();
+        if (mPos >= mXml.size() || (mXml[mPos] != '"' && mXml[mPos] != '\'')) {
+            return fail();
+        }
+        char quote[] = {mXml[mPos], '\0'};
+        ++mPos;
+        if (!skipPast(quote)) {
+            return fail();
+        }
+        for (const auto& [name, value] : mAttributes) {
+            if (name == attrName) return fail();  // duplicated attribute
+        }
+        mAttributes.emplace_back(attrName, mText);
+    }
+    mOpenElements.push_back(mName);
+    return Event::START_ELEMENT;
+}
+
+// --------------- XmlPullElement
+
+const std::string_view* XmlPullElement::attribute(std::string_view name) const {
+    for (const XmlPullAttribute* a = mFirstAttribute; a != nullptr; a = a->mNext) {
+        if (a->mName == name) return &a->mValue;
+    }
+    return nullptr;
+}
+
+const XmlPullElement* XmlPullElement::firstChildElement(std::string_view name) const {
+    for (const XmlPullElement* e = mFirstChild; e != nullptr; e = e->mNextSibling) {
+        if (name.empty() || e->mName == name) return e;
+    }
+    return nullptr;
+}
+
+const XmlPullElement* XmlPullElement::nextSiblingElement(std::string_view name) const {
+    for (const XmlPullElement* e = mNextSibling; e != nullptr; e = e->mNextSibling) {
+        if (name.empty() || e->mName == name) return e;
+    }
+    return nullptr;
+}
+
+// --------------- XmlPullDocument
+
+XmlPullDocument::XmlPullDocument()
+    : mElements(&mArena), mAttributes(&mArena), mUnescaped(&mArena) {}
+
+void XmlPullDocument::clear() {
+    mRoot = nullptr;
+    // Memory of a previous parse stays in the arena until the document is destroyed.
+    mElements.clear();
+    mAttributes.clear();
+    mUnescaped.clear();
+}
+
+std::string_view XmlPullDocument::unescape(std::string_view raw, bool processEntities) {
+    if (raw.find_first_of(processEntities ? "&\r" : "\r") == std::string_view::npos) {
+        return raw;
+    }
+    std::string& out = mUnescaped.emplace_back();
+    unescapeXml(raw, processEntities, &out);
+    return out;
+}
+
+bool XmlPullDocument::parse(std::string_view xml) {
+    clear();
+    XmlPullParser parser(xml);
+    std::vector<XmlPullElement*> openElements;
+    while (true) {
+        XmlPullElement* parent = openElements.empty() ? nullptr : openElements.back();
+        bool isFirstChildNode = parent != nullptr && !parent->mHasChildNode;
+        if (parent != nullptr) parent->mHasChildNode = true;
+
+        switch (parser.next()) {
+            case XmlPullParser::Event::START_ELEMENT: {
+                XmlPullElement* element = &mElements.emplace_back();
+                element->mName = parser.name();
+                for (const auto& [name, value] : parser.attributes()) {
+                    XmlPullAttribute* attr = &mAttributes.emplace_back();
+                    attr->mName = name;
+                    attr->mValue = unescape(value, true /* processEntities */);
+                    if (element->mLastAttribute == nullptr) {
+                        element->mFirstAttribute = attr;
+                    } else {
+                        element->mLastAttribute->mNext = attr;
+                    }
+                    element->mLastAttribute = attr;
+                }
+                if (parent == nullptr) {
+                    if (mRoot == nullptr) mRoot = element;
+                } else {
+                    if (parent->mLastChild == nullptr) {
+                        parent->mFirstChild = element;
+                    } else {
+                        parent->mLastChild->mNextSibling = element;
+                    }
+                    parent->mLastChild = element;
+                }
+                openElements.push_back(element);
+            } break;
+            case XmlPullParser::Event::END_ELEMENT: {
+                openElements.pop_back();
+            } break;
+            case XmlPullParser::Event::TEXT: {
+                if (isFirstChildNode) {
+                    parent->mText = unescape(parser.text(), !parser.isCData());
+                    parent->mHasText = true;
+                }
+            } break;
+            case XmlPullParser::Event::OTHER:
+                break;
+            case XmlPullParser::Event::END_DOCUMENT:
+                return true;
+            case XmlPullParser::Event::ERROR:
+                clear();
+                return false;
+        }
+    }
+}
+
+}  // namespace android::vintf::details
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace android::vintf::details {
+
+// A minimal, non-validating pull parser for the subset of XML that libvintf reads.
+//
+// The parser does not allocate any node objects; it hands out views into the input
+// buffer, one token at a time. Well-formedness rules, whitespace handling and entity
+// decoding follow tinyxml2 (with PRESERVE_WHITESPACE) so that the two backends of
+// parse_xml.cpp accept and reject the same documents:
+// - Whitespace-only text between tags is dropped; other text is kept verbatim.
+// - <?...?> is only allowed before any other node of the document.
+// - Comments, <!DOCTYPE ...> and other <!...> nodes are reported as OTHER.
+// - CDATA sections are reported as TEXT with isCData() == true.
+class XmlPullParser {
+   public:
+    enum class Event {
+        START_ELEMENT,
+        END_ELEMENT,
+        TEXT,
+        OTHER,
+        END_DOCUMENT,
+        ERROR,
+    };
+
+    using Attribute = std::pair<std::string_view, std::string_view>;
+
+    // |xml| must outlive this object. Parsing stops at the first NUL character.
+    explicit XmlPullParser(std::string_view xml);
+
+    // Advance to the next token. Once END_DOCUMENT or ERROR is returned, all
+    // subsequent calls return the same value.
+    Event next();
+
+    // Name of the element. Valid after START_ELEMENT and END_ELEMENT.
+    std::string_view name() const { return mName; }
+
+    // Raw (escaped) attributes in document order. Valid after START_ELEMENT.
+    const std::vector<Attribute>& attributes() const { return mAttributes; }
+
+    // Raw (escaped) text. Valid after TEXT.
+    std::string_view text() const { return mText; }
+
+    // Whether the last TEXT token is a CDATA section, in which case entities
+    // must not be decoded.
+    bool isCData() const { return mIsCData; }
+
+    // Nesting depth of the current element; 0 at document level.
+    size_t depth() const { return mOpenElements.size(); }
+
+   private:
+    Event fail();
+    Event parseElement();
+    bool parseName(std::string_view* name);
+    bool skipPast(std::string_view terminator);
+    void skipWhiteSpace();
+
+    std::string_view mXml;
+    size_t mPos = 0;
+    Event mLastEvent = Event::OTHER;
+    bool mPendingEnd = false;
+    bool mSeenNode = false;
+    bool mIsCData = false;
+    std::string_view mName;
+    std::string_view mText;
+    std::vector<Attribute> mAttributes;
+    std::vector<std::string_view> mOpenElements;
+};
+
+// Decode entity and character references and normalize line endings of |raw| into |out|
+// the same way tinyxml2 does. If |processEntities| is false, only line endings are
+// normalized (e.g. for CDATA sections).
+void unescapeXml(std::string_view raw, bool processEntities, std::string* out);
+
+class XmlPullAttribute {
+   public:
+    std::string_view name() const { return mName; }
+    std::string_view value() const { return mValue; }
+    const XmlPullAttribute* next() const { return mNext; }
+
+   private:
+    friend class XmlPullDocument;
+    friend class XmlPullElement;
+    std::string_view mName;
+    std::string_view mValue;
+    XmlPullAttribute* mNext = nullptr;
+};
+
+// An element read by XmlPullDocument. Only the information that the XmlNodeConverter
+// hierarchy queries is kept: name, attributes, leading text and child elements.
+class XmlPullElement {
+   public:
+    std::string_view name() const { return mName; }
+
+    // Text of the first child node if it is a text node (like tinyxml2's GetText()),
+    // otherwise nullptr.
+    const std::string_view* text() const { return mHasText ? &mText : nullptr; }
+
+    // Return nullptr if the attribute does not exist.
+    const std::string_view* attribute(std::string_view name) const;
+    const XmlPullAttribute* firstAttribute() const { return mFirstAttribute; }
+
+    // If |name| is empty, any element matches.
+    const XmlPullElement* firstChildElement(std::string_view name = {}) const;
+    const XmlPullElement* nextSiblingElement(std::string_view name = {}) const;
+
+   private:
+    friend class XmlPullDocument;
+    std::string_view mName;
+    std::string_view mText;
+    bool mHasText = false;
+    bool mHasChildNode = false;
+    XmlPullAttribute* mFirstAttribute = nullptr;
+    XmlPullAttribute* mLastAttribute = nullptr;
+    XmlPullElement* mFirstChild = nullptr;
+    XmlPullElement* mLastChild = nullptr;
+    XmlPullElement* mNextSibling = nullptr;
+};
+
+// Flat, append-only storage of the elements of an XML document, filled in a single
+// pass over XmlPullParser tokens. Names and values are views into the input buffer;
+// only values that contain entity references or carriage returns are copied.
+// Elements and attributes are allocated from an arena owned by the document, so a
+// document costs a few large allocations and is freed at once.
+class XmlPullDocument {
+   public:
+    XmlPullDocument();
+    XmlPullDocument(const XmlPullDocument&) = delete;
+    XmlPullDocument& operator=(const XmlPullDocument&) = delete;
+
+    // |xml| must outlive this object. Return false if |xml| is not well-formed.
+    __attribute__((warn_unused_result)) bool parse(std::string_view xml);
+
+    // The first top-level element, or nullptr if there is none.
+    const XmlPullElement* rootElement() const { return mRoot; }
+
+   private:
+    std::string_view unescape(std::string_view raw, bool processEntities);
+    void clear();
+
+    XmlPullElement* mRoot = nullptr;
+    // Declared before the containers that allocate from it.
+    std::pmr::monotonic_buffer_resource mArena;
+    std::pmr::deque<XmlPullElement> mElements;
+    std::pmr::deque<XmlPullAttribute> mAttributes;
+    std::pmr::deque<std::string> mUnescaped;
+};
+
+}  // namespace android::vintf::details
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "XmlWriter.h"
+
+#include <android-base/logging.h>
+
+namespace android::vintf::details {
+
+namespace {
+
+// Most documents written by libvintf are a few kilobytes; start with a buffer that fits
+// them so that the output is rarely reallocated.
+constexpr size_t kInitialCapacity = 4096;
+
+constexpr std::string_view kIndent = "    ";
+
+// tinyxml2 takes C strings, so anything after a NUL character is not written.
+std::string_view truncateAtNul(std::string_view s) {
+    return s.substr(0, s.find('\0'));
+}
+
+}  // namespace
+
+void appendEscapedXml(std::string_view s, bool isAttribute, std::string* out) {
+    size_t begin = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        std::string_view entity;
+        switch (s[i]) {
+            case '&':
+                entity = "&amp;";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '"':
+                if (isAttribute) entity = "&quot;";
+                break;
+            case '\'':
+                if (isAttribute) entity = "&apos;";
+                break;
+            default:
+                break;
+        }
+        if (entity.empty()) continue;
+        out->append(s.substr(begin, i - begin));
+        out->append(entity);
+        begin = i + 1;
+    }
+    out->append(s.substr(begin));
+}
+
+XmlWriter::XmlWriter() {
+    mOut.reserve(kInitialCapacity);
+}
+
+void XmlWriter::sealElementIfJustOpened() {
+    if (mElementJustOpened) {
+        mElementJustOpened = false;
+        mOut.push_back('>');
+    }
+}
+
+XmlWriterElement* XmlWriter::openElement(std::string_view name) {
+    sealElementIfJustOpened();
+    if (mTextDepth < 0 && !mFirstElement) {
+        mOut.push_back('\n');
+        for (size_t i = 0; i < mOpenElements.size(); ++i) mOut.append(kIndent);
+    }
+    mOut.push_back('<');
+    mOut.append(name);
+
+    XmlWriterElement& element = mOpenElements.emplace_back();
+    element.mWriter = this;
+    element.mName = name;
+    element.mAttributesEnd = mOut.size();
+    mElementJustOpened = true;
+    mFirstElement = false;
+    return &element;
+}
+
+void XmlWriter::addAttribute(XmlWriterElement* element, std::string_view name,
+                             std::string_view value) {
+    CHECK(!mOpenElements.empty() && element == &mOpenElements.back())
+            << "Attributes can only be added to the innermost open element";
+    // Usually the start tag is still open and the attribute goes to the end of the output.
+    // Attributes added after text or children are inserted into the start tag.
+    std::string inserted;
+    std::string* out = element->mAttributesEnd == mOut.size() ? &mOut : &inserted;
+    out->push_back(' ');
+    out->append(name);
+    out->append("=\"");
+    appendEscapedXml(truncateAtNul(value), true /* isAttribute */, out);
+    out->push_back('"');
+    if (out == &mOut) {
+        element->mAttributesEnd = mOut.size();
+    } else {
+        mOut.insert(element->mAttributesEnd, inserted);
+        element->mAttributesEnd += inserted.size();
+    }
+}
+
+void XmlWriter::addText(XmlWriterElement* element, std::string_view text) {
+    CHECK(!mOpenElements.empty() && element == &mOpenElements.back())
+            << "Text can only be added to the innermost open element";
+    mTextDepth = static_cast<int>(mOpenElements.size()) - 1;
+    sealElementIfJustOpened();
+    appendEscapedXml(truncateAtNul(text), false /* isAttribute */, &mOut);
+}
+
+void XmlWriter::closeElement(XmlWriterElement* element) {
+    CHECK(!mOpenElements.empty() && element == &mOpenElements.back())
+            << "Only the innermost open element can be closed";
+    int depth = static_cast<int>(mOpenElements.size()) - 1;
+    if (mElementJustOpened) {
+        mOut.append("/>");
+    } else {
+        if (mTextDepth < 0) {
+            mOut.push_back('\n');
+            for (int i = 0; i < depth; ++i) mOut.append(kIndent);
+        }
+        mOut.append("</");
+        mOut.append(element->mName);
+        mOut.push_back('>');
+    }
+    if (mTextDepth == depth) {
+        mTextDepth = -1;
+    }
+    if (depth == 0) {
+        mOut.push_back('\n');
+    }
+    mElementJustOpened = false;
+    mOpenElements.pop_back();
+}
+
+std::string XmlWriter::release() {
+    CHECK(mOpenElements.empty()) << "Not all elements are closed";
+    std::string out = std::move(mOut);
+    mOut.clear();
+    mTextDepth = -1;
+    mElementJustOpened = false;
+    mFirstElement = true;
+    return out;
+}
+
+}  // namespace android::vintf::details
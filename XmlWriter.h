@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+namespace android::vintf::details {
+
+class XmlWriter;
+
+// An element that is still being written by an XmlWriter.
+class XmlWriterElement {
+   public:
+    XmlWriter* writer() const { return mWriter; }
+
+   private:
+    friend class XmlWriter;
+    XmlWriter* mWriter = nullptr;
+    std::string mName;
+    // Offset in the output where the next attribute of this element goes.
+    size_t mAttributesEnd = 0;
+};
+
+// Serializes elements directly into a string, without building a document first.
+//
+// The output is byte-identical to printing the equivalent tinyxml2 document with
+// tinyxml2::XMLPrinter: four-space indentation, elements with text printed on a single line,
+// empty elements printed as <name/>, and the same escaping of text and attribute values.
+//
+// Elements are written in the order they are opened. An element is finished when it is
+// closed, which must happen before another element is opened under its parent. Attributes
+// may be added to the innermost open element at any time, even after its children;
+// attributes appear in the order they are added. Each attribute name may be added at most
+// once per element.
+class XmlWriter {
+   public:
+    XmlWriter();
+    XmlWriter(const XmlWriter&) = delete;
+    XmlWriter& operator=(const XmlWriter&) = delete;
+
+    // Start a child element of the innermost open element, or a top-level element.
+    // The returned pointer is valid until the element is closed.
+    XmlWriterElement* openElement(std::string_view name);
+
+    // |element| must be the innermost open element.
+    void addAttribute(XmlWriterElement* element, std::string_view name, std::string_view value);
+    void addText(XmlWriterElement* element, std::string_view text);
+    void closeElement(XmlWriterElement* element);
+
+    // Return the output and reset the writer. All elements must be closed.
+    std::string release();
+
+   private:
+    void sealElementIfJustOpened();
+
+    std::string mOut;
+    std::deque<XmlWriterElement> mOpenElements;
+    // Depth of the innermost element that contains text, or -1 if there is none.
+    int mTextDepth = -1;
+    bool mElementJustOpened = false;
+    bool mFirstElement = true;
+};
+
+// Append |s| to |out|, escaping characters like tinyxml2::XMLPrinter. If |isAttribute|,
+// quotes are escaped as well.
+void appendEscapedXml(std::string_view s, bool isAttribute, std::string* out);
+
+}  // namespace android::vintf::details
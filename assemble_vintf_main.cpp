@@ -15,9 +15,16 @@
  */
 
 #include <getopt.h>
+#include <unistd.h>
 
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <vintf/AssembleVintf.h>
 #include "utils.h"
@@ -27,6 +34,16 @@ void help() {
                  "    fill in build-time flags into the given file.\n"
                  "assemble_vintf -h\n"
                  "               Display this help text.\n"
+                 "assemble_vintf --batch <job file>\n"
+                 "               Run many jobs in one process. Each line of <job file> is one\n"
+                 "               job: zero or more environment variables as NAME=VALUE,\n"
+                 "               followed by the arguments of an assemble_vintf command line.\n"
+                 "               Words are separated by whitespace; quote parts that contain\n"
+                 "               whitespace with '' or \"\".\n"
+                 "               Empty lines and lines starting with # are ignored. Jobs run\n"
+                 "               in order, so a job may read the output of an earlier job.\n"
+                 "               Input files used by several jobs are parsed only once.\n"
+                 "               Stops at the first job that fails and returns 1.\n"
                  "assemble_vintf -i <input file>[:<input file>[...]] [-o <output file>] [-m]\n"
                  "               [-c [<check file>]]\n"
                  "               Fill in build-time flags into the given file.\n"
@@ -68,19 +85,101 @@ void help() {
                  "               Cannot be used with -l.\n"
                  "    --no-kernel-requirements\n"
                  "               Output has no <config> entries in <kernel>, and kernel minor\n"
-                 "               version is set to zero. (For example, 3.18.0).\n";
+                 "               version is set to zero. (For example, 3.18.0).\n"
+                 "    --kernel-table=<kernel table file>\n"
+                 "               Also write the <kernel> requirements of the output framework\n"
+                 "               compatibility matrix as a binary table, which libvintf loads\n"
+                 "               instead of the <kernel> entries of the matrix. Install it next\n"
+                 "               to the matrix as <matrix file name>.kernels.\n"
+                 "    --fingerprint=<fingerprint file>\n"
+                 "               Incremental mode; requires -o. Hashes of all inputs, including\n"
+                 "               --kernel config files and environment variables that are\n"
+                 "               read, and of the outputs, including the --kernel-table file, are\n"
+                 "               written to <fingerprint file>. If <fingerprint file> is up to\n"
+                 "               date with the inputs and the output files, nothing is done.\n";
 }
 
-int main(int argc, char** argv) {
-    using namespace ::android::vintf;
+using ::android::vintf::AssembleVintf;
+using ::android::vintf::AssembleVintfCache;
+
+// Run |assembleVintf| unless |fingerprintPath| shows that |outFilePath| is up to date. If
+// nothing needs to be done, no file is touched.
+static int assembleIncrementally(AssembleVintf* assembleVintf, const std::string& outFilePath,
+                                 const std::string& kernelTablePath,
+                                 const std::string& fingerprintPath) {
+    using ::android::base::ReadFileToString;
+    using ::android::base::WriteStringToFile;
+    if (outFilePath.empty()) {
+        std::cerr << "--fingerprint requires -o." << std::endl;
+        return 1;
+    }
+
+    std::string previousFingerprint;
+    std::string previousOutput;
+    std::string previousKernelTable;
+    if (ReadFileToString(fingerprintPath, &previousFingerprint) &&
+        ReadFileToString(outFilePath, &previousOutput) &&
+        (kernelTablePath.empty() || ReadFileToString(kernelTablePath, &previousKernelTable))) {
+        assembleVintf->setPreviousFingerprint(previousFingerprint, previousOutput,
+                                              previousKernelTable);
+    }
+
+    auto out = std::make_unique<std::ostringstream>();
+    auto& outRef = *out;
+    assembleVintf->setOutputStream(std::move(out));
+    std::ostringstream* kernelTable = nullptr;
+    if (!kernelTablePath.empty()) {
+        auto kernelTableOut = std::make_unique<std::ostringstream>();
+        kernelTable = kernelTableOut.get();
+        assembleVintf->setKernelTableOutputStream(std::move(kernelTableOut));
+    }
+    bool success = assembleVintf->assemble();
+    if (assembleVintf->skipped()) {
+        return 0;
+    }
+    if (!WriteStringToFile(outRef.str(), outFilePath)) {
+        std::cerr << "Failed to write " << outFilePath << std::endl;
+        success = false;
+    }
+    if (kernelTable != nullptr && !WriteStringToFile(kernelTable->str(), kernelTablePath)) {
+        std::cerr << "Failed to write " << kernelTablePath << std::endl;
+        success = false;
+    }
+    if (!success) {
+        unlink(fingerprintPath.c_str());
+        return 1;
+    }
+    if (!WriteStringToFile(assembleVintf->fingerprint(), fingerprintPath)) {
+        std::cerr << "Failed to write " << fingerprintPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Run one assemble_vintf command line. |envs| override environment variables, and |cache|,
+// if not null, is shared with other jobs. Return the exit code.
+static int run(int argc, char** argv, const std::map<std::string, std::string>& envs,
+               const std::shared_ptr<AssembleVintfCache>& cache) {
     const struct option longopts[] = {{"kernel", required_argument, NULL, 'k'},
                                       {"hals-only", no_argument, NULL, 'l'},
                                       {"no-hals", no_argument, NULL, 'n'},
                                       {"no-kernel-requirements", no_argument, NULL, 'K'},
+                                      {"fingerprint", required_argument, NULL, 'F'},
+                                      {"kernel-table", required_argument, NULL, 'T'},
                                       {0, 0, 0, 0}};
 
     std::string outFilePath;
+    std::string fingerprintPath;
+    std::string kernelTablePath;
     auto assembleVintf = AssembleVintf::newInstance();
+    for (const auto& [key, value] : envs) {
+        assembleVintf->setFakeEnv(key, value);
+    }
+    if (cache != nullptr) {
+        assembleVintf->setCache(cache);
+    }
+    // Rescan from the first argument; getopt keeps its state between command lines.
+    optind = 0;
     int res;
     while ((res = getopt_long(argc, argv, "hi:o:mc:nl", longopts, nullptr)) >= 0) {
         switch (res) {
@@ -94,11 +193,16 @@ int main(int argc, char** argv) {
             } break;
 
             case 'o': {
+                // Opened after all options are known; see below.
                 outFilePath = optarg;
-                if (!assembleVintf->openOutFile(optarg)) {
-                    std::cerr << "Failed to open " << optarg << std::endl;
-                    return 1;
-                }
+            } break;
+
+            case 'F': {
+                fingerprintPath = optarg;
+            } break;
+
+            case 'T': {
+                kernelTablePath = optarg;
             } break;
 
             case 'm': {
@@ -145,7 +249,94 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (!fingerprintPath.empty()) {
+        return assembleIncrementally(assembleVintf.get(), outFilePath, kernelTablePath,
+                                     fingerprintPath);
+    }
+
+    if (!outFilePath.empty() && !assembleVintf->openOutFile(outFilePath)) {
+        std::cerr << "Failed to open " << outFilePath << std::endl;
+        return 1;
+    }
+    if (!kernelTablePath.empty() && !assembleVintf->openKernelTableFile(kernelTablePath)) {
+        std::cerr << "Failed to open " << kernelTablePath << std::endl;
+        return 1;
+    }
+
     bool success = assembleVintf->assemble();
 
     return success ? 0 : 1;
 }
+
+// Split |line| into words like a shell without escapes or expansions. Return false if a quote
+// is not closed.
+static bool splitJobLine(const std::string& line, std::vector<std::string>* words) {
+    words->clear();
+    bool inWord = false;
+    char quote = '\0';
+    for (char c : line) {
+        if (quote != '\0') {
+            if (c == quote) {
+                quote = '\0';
+            } else {
+                words->back().push_back(c);
+            }
+        } else if (c == ' ' || c == '\t') {
+            inWord = false;
+        } else {
+            if (!inWord) {
+                words->emplace_back();
+                inWord = true;
+            }
+            if (c == '\'' || c == '"') {
+                quote = c;
+            } else {
+                words->back().push_back(c);
+            }
+        }
+    }
+    return quote == '\0';
+}
+
+static int runBatch(const std::string& jobFilePath) {
+    std::ifstream jobFile(jobFilePath);
+    if (!jobFile.is_open()) {
+        std::cerr << "Failed to open " << jobFilePath << std::endl;
+        return 1;
+    }
+    auto cache = AssembleVintfCache::newInstance();
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(jobFile, line); ++lineNumber) {
+        std::vector<std::string> tokens;
+        if (!splitJobLine(line, &tokens)) {
+            std::cerr << jobFilePath << ":" << lineNumber << ": unterminated quote." << std::endl;
+            return 1;
+        }
+        if (tokens.empty() || tokens.front()[0] == '#') {
+            continue;
+        }
+        std::map<std::string, std::string> envs;
+        std::vector<char*> args{const_cast<char*>("assemble_vintf")};
+        for (auto& token : tokens) {
+            size_t pos = token.find('=');
+            if (args.size() == 1 && token[0] != '-' && pos != std::string::npos) {
+                envs[token.substr(0, pos)] = token.substr(pos + 1);
+            } else {
+                args.push_back(token.data());
+            }
+        }
+        args.push_back(nullptr);
+        if (run(args.size() - 1, args.data(), envs, cache) != 0) {
+            std::cerr << "Job at " << jobFilePath << ":" << lineNumber << " failed." << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && argv[1] == std::string("--batch")) {
+        return runBatch(argv[2]);
+    }
+    return run(argc, argv, {} /* envs */, nullptr /* cache */);
+}
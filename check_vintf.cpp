@@ -23,6 +23,7 @@
 #include <iostream>
 #include <map>
 #include <optional>
+#include <string_view>
 
 #include <aidl/metadata.h>
 #include <android-base/file.h>
@@ -36,6 +37,7 @@
 #include <vintf/Dirmap.h>
 #include <vintf/HostFileSystem.h>
 #include <vintf/KernelConfigParser.h>
+#include <vintf/VintfDiff.h>
 #include <vintf/VintfObject.h>
 #include <vintf/fcm_exclude.h>
 #include <vintf/parse_string.h>
@@ -190,6 +192,47 @@ int checkCompatibilityForFiles(const std::string& manifestPath, const std::strin
     return 0;
 }
 
+// Print the differences between two HAL manifests or two compatibility matrices.
+// Like diff(1), return 0 if they are the same and 1 if they differ.
+int diffFiles(const std::string& oldPath, const std::string& newPath) {
+    std::string oldXml;
+    std::string newXml;
+    if (!android::base::ReadFileToString(oldPath, &oldXml)) {
+        PLOG(ERROR) << "ERROR: Cannot read " << oldPath;
+        return EX_NOINPUT;
+    }
+    if (!android::base::ReadFileToString(newPath, &newXml)) {
+        PLOG(ERROR) << "ERROR: Cannot read " << newPath;
+        return EX_NOINPUT;
+    }
+
+    std::vector<DiffEntry> entries;
+    HalManifest oldManifest;
+    HalManifest newManifest;
+    CompatibilityMatrix oldMatrix;
+    CompatibilityMatrix newMatrix;
+    std::string manifestError;
+    std::string matrixError;
+    if (fromXml(&oldManifest, oldXml, &manifestError) &&
+        fromXml(&newManifest, newXml, &manifestError)) {
+        entries = diff(oldManifest, newManifest);
+    } else if (fromXml(&oldMatrix, oldXml, &matrixError) &&
+               fromXml(&newMatrix, newXml, &matrixError)) {
+        entries = diff(oldMatrix, newMatrix);
+    } else {
+        LOG(ERROR) << "ERROR: " << oldPath << " and " << newPath
+                   << " are not two HAL manifests or two compatibility matrices."
+                   << "\n    As HAL manifests: " << manifestError
+                   << "\n    As compatibility matrices: " << matrixError;
+        return EX_DATAERR;
+    }
+
+    for (const DiffEntry& entry : entries) {
+        std::cout << entry << std::endl;
+    }
+    return entries.empty() ? 0 : 1;
+}
+
 Args parseArgs(int argc, char** argv) {
     int longOptFlag;
     int optionIndex;
@@ -326,6 +369,9 @@ int usage(const char* me) {
         << "                directory specified by --root-dir." << std::endl
         << "        --check-one: check consistency of VINTF metadata for a single partition."
         << std::endl
+        << "        --diff <old.xml> <new.xml>: print the differences between two" << std::endl
+        << "                HAL manifests or two compatibility matrices. Exit status" << std::endl
+        << "                is 0 if they are the same and 1 if they differ." << std::endl
         << std::endl
         << "    Options:" << std::endl
         << "        --rootdir=<dir>: specify root directory for all metadata. Same as " << std::endl
@@ -594,6 +640,10 @@ int main(int argc, char** argv) {
         if (ret >= 0) return ret;
     }
 
+    if (argc == 4 && argv[1] == std::string_view("--diff")) {
+        return diffFiles(argv[2], argv[3]);
+    }
+
     Args args = parseArgs(argc, argv);
 
     if (!iterateValues(args, HELP).empty()) {
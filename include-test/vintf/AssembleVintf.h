@@ -30,6 +30,18 @@
 namespace android {
 namespace vintf {
 
+// Inputs parsed by AssembleVintf. Instances that share a cache parse each distinct input
+// file only once, e.g. the jobs of assemble_vintf --batch. Thread-safe.
+class AssembleVintfCache {
+   public:
+    static std::shared_ptr<AssembleVintfCache> newInstance();
+
+    virtual ~AssembleVintfCache() = default;
+
+    // Number of inputs that were reused instead of parsed.
+    virtual size_t hits() const = 0;
+};
+
 class AssembleVintf {
    public:
     using Ostream = std::unique_ptr<std::ostream>;
@@ -44,13 +56,28 @@ class AssembleVintf {
     virtual void setOutputMatrix() = 0;
     virtual bool assemble() = 0;
 
+    // Incremental builds. |fingerprint| is the fingerprint() of an earlier successful run, and
+    // |output| and |kernelTable| are the current content of the output and the kernel table of
+    // that run. |kernelTable| is ignored if no kernel table is written. If the inputs, the
+    // environment variables read by that run, |output| and |kernelTable| are all unchanged,
+    // assemble() returns true without writing any output, and skipped() returns true.
+    virtual void setPreviousFingerprint(const std::string& fingerprint, const std::string& output,
+                                        const std::string& kernelTable) = 0;
+    // Hashes of the inputs and output of the last assemble(), to be saved for
+    // setPreviousFingerprint().
+    virtual std::string fingerprint() const = 0;
+    virtual bool skipped() const = 0;
+
     bool openOutFile(const std::string& path);
+    bool openKernelTableFile(const std::string& path);
     bool openInFile(const std::string& path);
     bool openCheckFile(const std::string& path);
     bool addKernel(const std::string& kernelArg);
 
     virtual std::ostream& setOutputStream(Ostream&&) = 0;
     virtual std::ostream& setErrorStream(Ostream&&) = 0;
+    // Also write the kernel requirement table of the output framework compatibility matrix.
+    virtual std::ostream& setKernelTableOutputStream(Ostream&&) = 0;
     virtual std::istream& addInputStream(const std::string& name, Istream&&) = 0;
     virtual std::istream& setCheckInputStream(const std::string& name, Istream&&) = 0;
     virtual std::istream& addKernelConfigInputStream(const KernelVersion& kernelVer,
@@ -58,6 +85,7 @@ class AssembleVintf {
     virtual void setFakeAidlMetadata(const std::vector<AidlInterfaceMetadata>& metadata) = 0;
     virtual void setFakeAidlUseUnfrozen(const std::optional<bool>& use) = 0;
     virtual void setFakeEnv(const std::string& key, const std::string& value) = 0;
+    virtual void setCache(std::shared_ptr<AssembleVintfCache> cache) = 0;
 
    protected:
     virtual bool hasKernelVersion(const KernelVersion&) const = 0;
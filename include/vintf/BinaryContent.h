@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_VINTF_BINARY_CONTENT_H
+#define ANDROID_VINTF_BINARY_CONTENT_H
+
+#include <stdint.h>
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include <vintf/ContentVisitor.h>
+
+namespace android {
+namespace vintf {
+
+// A compact binary encoding of the content visited by a ContentVisitor, so that it can be read
+// without an XML or JSON parser. The data starts with kBinaryContentMagic and a format version
+// byte (kBinaryContentVersion), followed by records of the form
+//     tag (1 byte) | name | payload
+// Strings, including names, are a length followed by the bytes of the string, and lengths and
+// unsigned integers are in unsigned LEB128. Tags are:
+//     'o' / 'a': begin an object / array. No payload.
+//     'O' / 'A': end the innermost object / array. No name and no payload.
+//     's': a string. 'u': an unsigned integer. 'b': a bool, as one byte that is 0 or 1.
+// New tags are only added together with a new format version.
+constexpr std::string_view kBinaryContentMagic = "VINTFBIN";
+constexpr uint8_t kBinaryContentVersion = 1;
+
+// Writes the visited content to |out| in the format above. The header is written on
+// construction.
+class BinaryContentWriter : public ContentVisitor {
+   public:
+    explicit BinaryContentWriter(std::ostream& out);
+
+    void beginObject(std::string_view name) override;
+    void endObject() override;
+    void beginArray(std::string_view name) override;
+    void endArray() override;
+    void visitString(std::string_view name, std::string_view value) override;
+    void visitUint(std::string_view name, uint64_t value) override;
+    void visitBool(std::string_view name, bool value) override;
+
+   private:
+    void writeTag(char tag, std::string_view name);
+    void writeString(std::string_view s);
+    void writeUint(uint64_t value);
+
+    std::ostream& mOut;
+};
+
+// Reads |data| in the format above and replays its content into |visitor|. Returns false and
+// sets |error| if the header is wrong, a record is truncated or malformed, or objects and
+// arrays are not balanced. |visitor| may have received part of the content when this fails.
+bool readBinaryContent(std::string_view data, ContentVisitor* visitor,
+                       std::string* error = nullptr);
+
+}  // namespace vintf
+}  // namespace android
+
+#endif  // ANDROID_VINTF_BINARY_CONTENT_H
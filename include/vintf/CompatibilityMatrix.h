@@ -17,9 +17,12 @@
 #ifndef ANDROID_VINTF_COMPATIBILITY_MATRIX_H
 #define ANDROID_VINTF_COMPATIBILITY_MATRIX_H
 
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <utils/Errors.h>
 
@@ -43,6 +46,27 @@ namespace vintf {
 
 namespace details {
 class CheckVintfUtils;
+class ContentWalker;
+class KernelRequirementIndex;
+class VintfDiffer;
+
+// Index of the <kernel> requirements of a compatibility matrix, built on first use. The
+// index points into the kernels of the matrix it is built for, so it is not copied or moved
+// with the matrix, and it must be reset whenever the kernels change.
+class KernelRequirementIndexCache {
+   public:
+    KernelRequirementIndexCache();
+    ~KernelRequirementIndexCache();
+    KernelRequirementIndexCache(const KernelRequirementIndexCache&);
+    KernelRequirementIndexCache& operator=(const KernelRequirementIndexCache&);
+
+    const KernelRequirementIndex& get(const std::vector<MatrixKernel>& kernels) const;
+    void reset();
+
+   private:
+    mutable std::mutex mMutex;
+    mutable std::unique_ptr<KernelRequirementIndex> mIndex;
+};
 }  // namespace details
 
 // Compatibility matrix defines what hardware does the framework requires.
@@ -51,6 +75,9 @@ struct CompatibilityMatrix : public HalGroup<MatrixHal>,
                              public WithFileName {
     // Create a framework compatibility matrix.
     CompatibilityMatrix() : mType(SchemaType::FRAMEWORK) {}
+    // Create a framework compatibility matrix whose HALs are allocated from |resource|.
+    explicit CompatibilityMatrix(std::pmr::memory_resource* resource)
+        : HalGroup<MatrixHal>(resource), mType(SchemaType::FRAMEWORK) {}
 
     SchemaType type() const;
     Level level() const;
@@ -89,6 +116,10 @@ struct CompatibilityMatrix : public HalGroup<MatrixHal>,
     // Add a <kernel> tag to "this". Error if there is a conflict.
     bool addKernel(MatrixKernel&& kernel, std::string* error);
 
+    // Index of framework.mKernels, built on the first call and reused until the kernels
+    // change.
+    const details::KernelRequirementIndex& kernelRequirementIndex() const;
+
     // Merge <sepolicy> with other's <sepolicy>. Error if there is a conflict.
     bool addSepolicy(CompatibilityMatrix* other, std::string* error);
 
@@ -129,10 +160,39 @@ struct CompatibilityMatrix : public HalGroup<MatrixHal>,
     //     with lower level()
     //   - <sepolicy>, <avb><vbmeta-version> is ignored
     // Return the combined matrix, nullptr if any error (e.g. conflict of information).
+    // Upon return, matrices are sorted by level(), and their contents may have been moved
+    // into the combined matrix.
     static std::unique_ptr<CompatibilityMatrix> combine(Level deviceLevel, Level kernelLevel,
                                                         std::vector<CompatibilityMatrix>* matrices,
                                                         std::string* error);
 
+    // Combines framework compatibility matrices one at a time, e.g. while they are parsed,
+    // so that fragments that do not contribute to the result are never kept around.
+    // The combined matrix is the same as combine() on all fragments that were added.
+    class Combiner {
+       public:
+        Combiner(Level deviceLevel, Level kernelLevel);
+
+        // Take |fragment|. Return false if it is not a framework compatibility matrix.
+        bool add(CompatibilityMatrix&& fragment, std::string* error = nullptr);
+
+        // Return the combined matrix, nullptr if any error (e.g. conflict of information).
+        // The Combiner must not be used afterwards.
+        std::unique_ptr<CompatibilityMatrix> combine(std::string* error = nullptr);
+
+       private:
+        friend struct CompatibilityMatrix;
+
+        // Like add(), but |fragment| is owned by the caller.
+        bool addUnowned(CompatibilityMatrix* fragment, std::string* error);
+        bool checkType(const CompatibilityMatrix& fragment, std::string* error) const;
+
+        Level mDeviceLevel;
+        Level mKernelLevel;
+        std::list<CompatibilityMatrix> mOwned;
+        std::vector<CompatibilityMatrix*> mFragments;
+    };
+
     // Combine a set of device compatibility matrices.
     static std::unique_ptr<CompatibilityMatrix> combineDeviceMatrices(
         std::vector<CompatibilityMatrix>* matrices, std::string* error);
@@ -156,12 +216,15 @@ struct CompatibilityMatrix : public HalGroup<MatrixHal>,
     friend struct RuntimeInfo;
     friend struct CompatibilityMatrixConverter;
     friend struct LibVintfTest;
+    friend struct LibVintfBenchmark;
     friend struct FrameworkCompatibilityMatrixCombineTest;
     friend struct DeviceCompatibilityMatrixCombineTest;
     friend class VintfObject;
     friend class AssembleVintfImpl;
     friend class KernelInfo;
     friend class details::CheckVintfUtils;
+    friend class details::ContentWalker;
+    friend class details::VintfDiffer;
     friend bool operator==(const CompatibilityMatrix &, const CompatibilityMatrix &);
 
     SchemaType mType;
@@ -172,6 +235,7 @@ struct CompatibilityMatrix : public HalGroup<MatrixHal>,
         std::vector<MatrixKernel> mKernels;
         Sepolicy mSepolicy;
         Version mAvbMetaVersion;
+        details::KernelRequirementIndexCache mKernelIndex;
     } framework;
 
     // entries only for device compatibility matrix.
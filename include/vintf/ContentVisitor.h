@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_VINTF_CONTENT_VISITOR_H
+#define ANDROID_VINTF_CONTENT_VISITOR_H
+
+#include <stdint.h>
+
+#include <string_view>
+
+namespace android {
+namespace vintf {
+
+struct CompatibilityMatrix;
+struct HalManifest;
+
+// Receives the content of a HalManifest or a CompatibilityMatrix as a tree of objects, arrays
+// and values, in the order of the corresponding XML elements. This allows other formats to be
+// produced directly from the in-memory objects instead of from toXml().
+//
+// Every value has a name, except values directly inside an array, whose name is empty.
+class ContentVisitor {
+   public:
+    virtual ~ContentVisitor() = default;
+
+    virtual void beginObject(std::string_view name) = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray(std::string_view name) = 0;
+    virtual void endArray() = 0;
+    virtual void visitString(std::string_view name, std::string_view value) = 0;
+    virtual void visitUint(std::string_view name, uint64_t value) = 0;
+    virtual void visitBool(std::string_view name, bool value) = 0;
+};
+
+// The content is a single object named "manifest" or "compatibility-matrix". Optional
+// attributes and elements that are not set are omitted. Versions are formatted as they are in
+// the XML, e.g. "1.0" for HIDL and "1" for AIDL.
+void visitContent(const HalManifest& manifest, ContentVisitor* visitor);
+void visitContent(const CompatibilityMatrix& matrix, ContentVisitor* visitor);
+
+}  // namespace vintf
+}  // namespace android
+
+#endif  // ANDROID_VINTF_CONTENT_VISITOR_H
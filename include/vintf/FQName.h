@@ -16,20 +16,22 @@
 
 #pragma once
 
+#include <initializer_list>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace android::vintf::details {
 
 struct FQName {
-    __attribute__((warn_unused_result)) static bool parse(const std::string& s, FQName* into);
+    __attribute__((warn_unused_result)) static bool parse(std::string_view s, FQName* into);
 
     explicit FQName();
 
     FQName(const std::string& package, const std::string& version, const std::string& name = "");
 
     // Returns false if string isn't a valid FQName object.
-    __attribute__((warn_unused_result)) bool setTo(const std::string& s);
+    __attribute__((warn_unused_result)) bool setTo(std::string_view s);
     __attribute__((warn_unused_result)) bool setTo(const std::string& package, size_t majorVer,
                                                    size_t minorVer, const std::string& name = "");
 
@@ -70,6 +72,12 @@ struct FQName {
 
     std::string string() const;
 
+    // Compare string() followed by |suffix| to other.string() followed by |otherSuffix|, like
+    // std::string::compare, but without building the strings. Each suffix has at most two
+    // pieces.
+    int compare(const FQName& other, std::initializer_list<std::string_view> suffix = {},
+                std::initializer_list<std::string_view> otherSuffix = {}) const;
+
     bool operator<(const FQName& other) const;
     bool operator==(const FQName& other) const;
     bool operator!=(const FQName& other) const;
@@ -95,6 +103,17 @@ struct FQName {
     size_t getPackageMinorVersion() const;
 
    private:
+    // Parts of a parsed FQName. Views point into the parsed string.
+    struct Components {
+        std::string_view package;
+        size_t major = 0;
+        size_t minor = 0;
+        std::string_view name;
+        bool isIdentifier = false;
+    };
+    // Parse |s| without copying any part of it.
+    __attribute__((warn_unused_result)) static bool parse(std::string_view s, Components* out);
+
     bool mIsIdentifier;
     std::string mPackage;
     // mMajor == 0 means empty.
@@ -119,10 +138,6 @@ struct FQName {
     void clearVersion();
 
     bool isIdentifier() const;
-    // Return version in the form "@1.0" if it is present, otherwise empty string.
-    std::string atVersion() const;
-
-    std::vector<std::string> getPackageComponents() const;
 };
 
 }  // namespace android::vintf::details
@@ -18,6 +18,7 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include <vintf/FQName.h>
@@ -38,7 +39,8 @@ class FqInstance {
     size_t getMajorVersion() const;
     size_t getMinorVersion() const;
     std::pair<size_t, size_t> getVersion() const;
-    std::string getInterface() const;
+    // Empty if there is no interface.
+    const std::string& getInterface() const;
     const std::string& getInstance() const;
     std::string getFqNameString() const;
 
@@ -59,7 +61,7 @@ class FqInstance {
     // @1.0::IFoo/instance
     // @1.0/instance
     // IFoo/instance
-    __attribute__((warn_unused_result)) bool setTo(const std::string& s);
+    __attribute__((warn_unused_result)) bool setTo(std::string_view s);
 
     // Convenience method for the following formats:
     // android.hardware.foo@1.0::IFoo/default
@@ -18,6 +18,7 @@
 #define ANDROID_VINTF_HAL_GROUP_H
 
 #include <map>
+#include <memory_resource>
 #include <set>
 
 #include "HalFormat.h"
@@ -29,13 +30,28 @@ namespace vintf {
 
 // A HalGroup is a wrapped multimap from name to Hal.
 // Hal.getName() must return a string indicating the name.
+// Hal must be allocator-aware (see ManifestHal) so that a Hal added to the group allocates
+// from the memory resource of the group.
 template <typename Hal>
 struct HalGroup {
     using InstanceType = typename Hal::InstanceType;
+    using HalMap = std::pmr::multimap<std::string, Hal>;
+    using HalIterable = typename MapIterTypes<HalMap>::ValueIterable;
+    using ConstHalIterable = typename MapIterTypes<HalMap>::ConstValueIterable;
 
    public:
     virtual ~HalGroup() {}
 
+    // Declared explicitly because the virtual destructor suppresses the implicit moves.
+    HalGroup() = default;
+    // Allocate the HALs from |resource|, which must outlive this object. Copies use the
+    // default resource; HALs moved into another HalGroup are moved into its resource.
+    explicit HalGroup(std::pmr::memory_resource* resource) : mHals(resource) {}
+    HalGroup(const HalGroup&) = default;
+    HalGroup(HalGroup&&) = default;
+    HalGroup& operator=(const HalGroup&) = default;
+    HalGroup& operator=(HalGroup&&) = default;
+
    protected:
     // Get all hals with the given name (e.g "android.hardware.camera").
     // There could be multiple hals that matches the same given name.
@@ -168,15 +184,18 @@ struct HalGroup {
    protected:
     // sorted map from component name to the component.
     // The component name looks like: android.hardware.foo
-    std::multimap<std::string, Hal> mHals;
+    HalMap mHals;
+
+    // The memory resource that the HALs are allocated from.
+    std::pmr::memory_resource* memoryResource() const { return mHals.get_allocator().resource(); }
 
     // Return an iterable to all Hal objects. Call it as follows:
     // for (const auto& e : vm.getHals()) { }
-    ConstMultiMapValueIterable<std::string, Hal> getHals() const { return iterateValues(mHals); }
+    ConstHalIterable getHals() const { return iterateValues(mHals); }
 
     // Return an iterable to all Hal objects. Call it as follows:
     // for (const auto& e : vm.getHals()) { }
-    MultiMapValueIterable<std::string, Hal> getHals() { return iterateValues(mHals); }
+    HalIterable getHals() { return iterateValues(mHals); }
 
     // Get any HAL component based on the component name. Return any one
     // if multiple. Return nullptr if the component does not exist. This is only
@@ -38,6 +38,7 @@ struct HalInterface {
         const std::function<bool(const std::string& interface, const std::string& instance,
                                  bool isRegex)>& func) const;
     bool hasAnyInstance() const;
+    bool hasInstance(const std::string& instanceOrPattern, bool isRegex) const;
 
     // Return true if inserted, false otherwise.
     bool insertInstance(const std::string& instanceOrPattern, bool isRegex);
@@ -45,6 +46,11 @@ struct HalInterface {
     // Return true if removed, false otherwise.
     bool removeInstance(const std::string& instanceOrPattern, bool isRegex);
 
+    // Remove all instances and patterns for which |predicate| returns true. Return the number
+    // of removed entries.
+    size_t removeInstancesIf(
+        const std::function<bool(const std::string& instanceOrPattern, bool isRegex)>& predicate);
+
     const std::string& name() const { return mName; }
 
    private:
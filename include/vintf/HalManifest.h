@@ -21,6 +21,7 @@
 #include <utils/Errors.h>
 #include <map>
 #include <optional>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -56,6 +57,8 @@ using Instances = std::map<Version, InstancesOfVersion>;
 
 class CheckVintfUtils;
 class FmOnlyVintfObject;
+class ContentWalker;
+class VintfDiffer;
 
 }  // namespace details
 
@@ -68,6 +71,10 @@ struct HalManifest : public HalGroup<ManifestHal>,
 
     // Construct a device HAL manifest.
     HalManifest() : mType(SchemaType::DEVICE) {}
+    // Construct a device HAL manifest whose HALs are allocated from |resource|, e.g. an arena
+    // for a fragment that is parsed, merged with addAll() and dropped.
+    explicit HalManifest(std::pmr::memory_resource* resource)
+        : HalGroup<ManifestHal>(resource), mType(SchemaType::DEVICE) {}
 
     bool add(ManifestHal&& hal, std::string* error = nullptr);
     // Move all hals from another HalManifest to this.
@@ -159,7 +166,7 @@ struct HalManifest : public HalGroup<ManifestHal>,
 
    protected:
     // Check before add()
-    bool shouldAdd(const ManifestHal& toAdd, std::string* error) const;
+    bool shouldAdd(const ManifestHal& toAdd, std::string* error);
     bool shouldAddXmlFile(const ManifestXmlFile& toAdd) const override;
 
     bool forEachInstanceOfVersion(
@@ -169,6 +176,19 @@ struct HalManifest : public HalGroup<ManifestHal>,
     bool forEachNativeInstance(const std::string& package,
                                const std::function<bool(const ManifestInstance&)>& func) const;
 
+    // The non-const accessors below hide those of HalGroup so that mConflictIndex is
+    // updated when HALs are modified or removed.
+    using HalGroup<ManifestHal>::getHals;
+    // The caller may modify the returned HALs, so their entry in mConflictIndex is rebuilt
+    // when it is next used.
+    std::vector<ManifestHal*> getHals(const std::string& name);
+    ManifestHal* getAnyHal(const std::string& name);
+    // The caller may modify any HAL, so mConflictIndex is rebuilt when it is next used.
+    HalIterable getHals();
+    // Remove if shouldRemove(hal), then rebuild the entries in mConflictIndex for the names of
+    // removed HALs.
+    void removeHalsIf(const std::function<bool(const ManifestHal&)>& shouldRemove);
+
    private:
     friend struct HalManifestConverter;
     friend class VintfObject;
@@ -176,6 +196,8 @@ struct HalManifest : public HalGroup<ManifestHal>,
     friend class details::CheckVintfUtils;
     friend struct LibVintfTest;
     friend class details::FmOnlyVintfObject;
+    friend class details::ContentWalker;
+    friend class details::VintfDiffer;
     friend std::string dump(const HalManifest &vm);
     friend bool operator==(const HalManifest &lft, const HalManifest &rgt);
 
@@ -191,8 +213,17 @@ struct HalManifest : public HalGroup<ManifestHal>,
     // That is, return empty list iff
     // (instance in matrix) => (instance in manifest).
     std::vector<std::string> checkIncompatibleHals(const CompatibilityMatrix& mat) const;
+    // Same as !checkIncompatibleHals(mat).empty(), but stops at the first incompatible HAL
+    // and does not render any error messages.
+    bool hasIncompatibleHals(const CompatibilityMatrix& mat) const;
+    // Whether this manifest supports all instances in matrixHal, ignoring matrixHal.optional.
+    bool isHalCompatible(const MatrixHal& matrixHal) const;
+    // Error message of checkIncompatibleHals for a matrixHal that is not compatible.
+    std::string describeIncompatibleHal(const MatrixHal& matrixHal) const;
 
     void removeHals(const std::string& name, size_t majorVer);
+    // Remove all major versions in |majorVers| from HALs named |name|.
+    void removeHals(const std::string& name, const std::set<size_t>& majorVers);
 
     // Returns a list of instance names that are in this manifest but
     // are not specified in the given matrix, whether the HAL is specified as an optional or
@@ -230,12 +261,59 @@ struct HalManifest : public HalGroup<ManifestHal>,
 
     // Helper for shouldAdd(). Check if |hal| has a conflicting major version with this. Return
     // false if hal should not be added, and set |error| accordingly. Return true if check passes.
-    bool addingConflictingMajorVersion(const ManifestHal& hal, std::string* error) const;
+    bool addingConflictingMajorVersion(const ManifestHal& hal, std::string* error);
 
     // Helper for shouldAdd(). Check if |hal| has a conflicting major version in <fqname> with this.
     // Return false if hal should not be added, and set |error| accordingly. Return true if check
     // passes.
-    bool addingConflictingFqInstance(const ManifestHal& hal, std::string* error) const;
+    bool addingConflictingFqInstance(const ManifestHal& hal, std::string* error);
+
+    // Index of the HALs in mHals that shouldAdd() checks for conflicts, so that adding a HAL
+    // does not need to look at every instance of existing HALs with the same name.
+    // It points into mHals, so it is not copied or moved; the destination rebuilds it when it is
+    // first used, and the source of a move drops it because its pointers now refer to nodes
+    // owned by the destination.
+    struct ConflictIndex {
+        // Indexed HALs with the same name.
+        struct Entry {
+            // Key: major version of a <version> tag
+            std::map<size_t, std::pair<const ManifestHal*, Version>> majorVersions;
+            // Key: FqInstance with minor version 0
+            std::map<FqInstance, const ManifestHal*> fqInstances;
+            std::map<std::string, const ManifestHal*> accessors;
+        };
+
+        ConflictIndex() = default;
+        ConflictIndex(const ConflictIndex&) {}
+        ConflictIndex& operator=(const ConflictIndex&) {
+            clear();
+            return *this;
+        }
+        ConflictIndex(ConflictIndex&& other) { other.clear(); }
+        ConflictIndex& operator=(ConflictIndex&& other) {
+            clear();
+            other.clear();
+            return *this;
+        }
+        void clear() {
+            valid = false;
+            entries.clear();
+            stale.clear();
+        }
+
+        bool valid = false;
+        std::map<std::string, Entry> entries;
+        // Names of HALs that may have been modified since their entry was built.
+        std::set<std::string> stale;
+    };
+
+    // Return the entry in mConflictIndex for HALs named |name|. Builds mConflictIndex if
+    // necessary.
+    const ConflictIndex::Entry& getConflictIndexEntry(const std::string& name);
+    // Add |hal|, which must be in mHals, to mConflictIndex. Existing entries take precedence.
+    void indexHal(const ManifestHal& hal);
+    // Rebuild the entry in mConflictIndex for HALs named |name| if mConflictIndex is built.
+    void reindexHals(const std::string& name);
 
     // Inferred kernel level.
     Level inferredKernelLevel() const;
@@ -247,6 +325,8 @@ struct HalManifest : public HalGroup<ManifestHal>,
     // Otherwise, the object is created programmatically, so default to libvintf meta version.
     Version mSourceMetaVersion = kMetaVersion;
 
+    ConflictIndex mConflictIndex;
+
     // entries for device hal manifest only
     struct {
         SepolicyVersion mSepolicyVersion;
@@ -28,6 +28,12 @@ namespace vintf {
 using KernelConfigIntValue = int64_t;
 using KernelConfigRangeValue = std::pair<uint64_t, uint64_t>;
 
+namespace details {
+class ContentWalker;
+struct CompiledKernelConfigs;
+class KernelRequirementTable;
+}  // namespace details
+
 // compatibility-matrix.kernel.config.value item.
 struct KernelConfigTypedValue {
 
@@ -47,6 +53,9 @@ struct KernelConfigTypedValue {
 
 private:
     friend struct KernelConfigTypedValueConverter;
+    friend class details::ContentWalker;
+    friend struct details::CompiledKernelConfigs;
+    friend class details::KernelRequirementTable;
     friend std::ostream &operator<<(std::ostream &os, const KernelConfigTypedValue &kctv);
     friend bool parseKernelConfigValue(const std::string &s, KernelConfigTypedValue *kctv);
     friend bool parseKernelConfigTypedValue(const std::string& s, KernelConfigTypedValue* kctv);
@@ -27,8 +27,13 @@ namespace android {
 namespace vintf {
 
 namespace details {
+class ContentWalker;
+class KernelRequirementIndex;
+class KernelConfigValues;
+struct KernelRequirement;
 class MockRuntimeInfo;
 struct StaticRuntimeInfo;
+class VintfDiffer;
 }  // namespace details
 
 // KernelInfo includes kernel-specific information on a device.
@@ -57,16 +62,27 @@ class KernelInfo {
 
    private:
     friend class AssembleVintfImpl;
+    friend class details::ContentWalker;
     friend class details::MockRuntimeInfo;
     friend struct details::StaticRuntimeInfo;
+    friend class details::VintfDiffer;
     friend struct HalManifest;
     friend struct KernelInfoConverter;
+    friend struct LibVintfBenchmark;
     friend struct LibVintfTest;
     friend struct RuntimeInfoFetcher;
     friend struct RuntimeInfo;
 
+    // Same as above, but looks up an index of the kernel requirements, which can be reused
+    // across checks. See CompatibilityMatrix::kernelRequirementIndex.
+    std::vector<const MatrixKernel*> getMatchedKernelRequirements(
+        const details::KernelRequirementIndex& index, Level kernelLevel,
+        std::string* error = nullptr) const;
+
+    // |configValues| are the configs of this kernel for the branch that |kernels| belong to.
     std::vector<const MatrixKernel*> getMatchedKernelVersionAndConfigs(
-        const std::vector<const MatrixKernel*>& kernels, std::string* error) const;
+        const std::vector<details::KernelRequirement>& kernels,
+        details::KernelConfigValues* configValues, std::string* error) const;
 
     // The kernel FCM version.
     // This API is for internal use only, depending on the parent object that contains this
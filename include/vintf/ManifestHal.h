@@ -19,6 +19,7 @@
 #define ANDROID_VINTF_MANIFEST_HAL_H
 
 #include <map>
+#include <memory_resource>
 #include <optional>
 #include <set>
 #include <string>
@@ -36,11 +37,22 @@
 namespace android {
 namespace vintf {
 
+namespace details {
+class ProvidedInstances;
+class VintfDiffer;
+}  // namespace details
+
 // A component of HalManifest.
 struct ManifestHal : public WithFileName {
     using InstanceType = ManifestInstance;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
 
     ManifestHal() = default;
+    // Allocator-extended constructors, used by HalGroup so that the instances of a ManifestHal
+    // are allocated from the memory resource of the HalManifest that holds it.
+    explicit ManifestHal(const allocator_type& alloc) : mManifestInstances(alloc) {}
+    ManifestHal(const ManifestHal& other, const allocator_type& alloc);
+    ManifestHal(ManifestHal&& other, const allocator_type& alloc);
 
     bool operator==(const ManifestHal &other) const;
 
@@ -82,6 +94,8 @@ struct ManifestHal : public WithFileName {
     friend struct LibVintfTest;
     friend struct ManifestHalConverter;
     friend struct HalManifest;
+    friend class details::ProvidedInstances;
+    friend class details::VintfDiffer;
     friend bool parse(const std::string &s, ManifestHal *hal);
 
     // Whether this hal is a valid one. Note that an empty ManifestHal
@@ -108,7 +122,7 @@ struct ManifestHal : public WithFileName {
     std::optional<std::string> mUpdatableViaApex;
     bool mUpdatableViaSystem = false;
     // All instances specified with <fqname> and <version> x <interface> x <instance>
-    std::set<ManifestInstance> mManifestInstances;
+    std::pmr::set<ManifestInstance> mManifestInstances;
 
     // Max level of this HAL (inclusive). Only valid for framework manifest HALs.
     // If set, HALs with max-level < target FCM version in device manifest is
@@ -45,7 +45,7 @@ class ManifestInstance {
                      const std::optional<std::string>& accessor, bool updatableViaSystem);
     const std::string& package() const;
     Version version() const;
-    std::string interface() const;
+    const std::string& interface() const;
     const std::string& instance() const;
     Transport transport() const;
     Arch arch() const;
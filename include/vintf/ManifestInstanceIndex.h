@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_VINTF_MANIFEST_INSTANCE_INDEX_H
+#define ANDROID_VINTF_MANIFEST_INSTANCE_INDEX_H
+
+#include <stddef.h>
+
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vintf/HalFormat.h>
+#include <vintf/HalManifest.h>
+#include <vintf/ManifestInstance.h>
+#include <vintf/Version.h>
+
+namespace android {
+namespace vintf {
+
+// A read-only hash index over the instances of the device and framework HAL manifests, for
+// clients like servicemanager that repeatedly look up single instances. Lookups take
+// std::string_views, run in constant time and do not allocate; the results point into the
+// index.
+//
+// The index holds the manifests it is built from. Use VintfObject::getManifestInstanceIndex()
+// to get an index that is rebuilt when the cached manifests are reloaded.
+class ManifestInstanceIndex {
+   public:
+    // A contiguous range of instances in the index.
+    class Range {
+       public:
+        Range() = default;
+        Range(const ManifestInstance* begin, const ManifestInstance* end)
+            : mBegin(begin), mEnd(end) {}
+        const ManifestInstance* begin() const { return mBegin; }
+        const ManifestInstance* end() const { return mEnd; }
+        bool empty() const { return mBegin == mEnd; }
+        size_t size() const { return mEnd - mBegin; }
+
+       private:
+        const ManifestInstance* mBegin = nullptr;
+        const ManifestInstance* mEnd = nullptr;
+    };
+
+    // Either manifest may be nullptr.
+    ManifestInstanceIndex(std::shared_ptr<const HalManifest> deviceManifest,
+                          std::shared_ptr<const HalManifest> frameworkManifest);
+
+    ManifestInstanceIndex(const ManifestInstanceIndex&) = delete;
+    ManifestInstanceIndex& operator=(const ManifestInstanceIndex&) = delete;
+
+    const std::shared_ptr<const HalManifest>& deviceManifest() const { return mDeviceManifest; }
+    const std::shared_ptr<const HalManifest>& frameworkManifest() const {
+        return mFrameworkManifest;
+    }
+
+    // Instances of package.interface of |format| in either manifest, of any version, ordered
+    // by instance name, then by version.
+    Range getInstances(HalFormat format, std::string_view package,
+                       std::string_view interface) const;
+
+    // All instances of package.interface/instance of |format| in either manifest, in
+    // ascending version order.
+    Range getInstances(HalFormat format, std::string_view package, std::string_view interface,
+                       std::string_view instance) const;
+
+    // AIDL instances of package.interface, e.g. to list declared instances without building a
+    // std::set like HalManifest::getAidlInstances.
+    Range getAidlInstances(std::string_view package, std::string_view interface) const {
+        return getInstances(HalFormat::AIDL, package, interface);
+    }
+
+    // Return the AIDL instance package.interface/instance with the highest version, or nullptr
+    // if it is not declared. Use it to read e.g. its accessor() or updatableViaApex().
+    const ManifestInstance* getAidlInstance(std::string_view package, std::string_view interface,
+                                            std::string_view instance) const;
+
+    // Equivalent to HalManifest::hasHidlInstance on both manifests.
+    bool hasHidlInstance(std::string_view package, const Version& version,
+                         std::string_view interface, std::string_view instance) const;
+
+    // Equivalent to HalManifest::hasAidlInstance on both manifests.
+    bool hasAidlInstance(std::string_view package, size_t version, std::string_view interface,
+                         std::string_view instance) const;
+    bool hasAidlInstance(std::string_view package, std::string_view interface,
+                         std::string_view instance) const {
+        return getAidlInstance(package, interface, instance) != nullptr;
+    }
+
+    // Number of indexed instances.
+    size_t size() const { return mInstances.size(); }
+
+   private:
+    struct Key {
+        HalFormat format;
+        std::string_view package;
+        std::string_view interface;
+        // Empty for keys of mInterfaces.
+        std::string_view instance;
+
+        bool operator==(const Key& other) const {
+            return format == other.format && package == other.package &&
+                   interface == other.interface && instance == other.instance;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    // Indices into mInstances.
+    struct Slice {
+        size_t begin;
+        size_t end;
+    };
+
+    Range getRange(const std::unordered_map<Key, Slice, KeyHash>& map, const Key& key) const;
+    bool hasInstance(HalFormat format, std::string_view package, const Version& version,
+                     std::string_view interface, std::string_view instance) const;
+
+    std::shared_ptr<const HalManifest> mDeviceManifest;
+    std::shared_ptr<const HalManifest> mFrameworkManifest;
+    // Copies of the instances of both manifests, ordered by format, package, interface,
+    // instance and version. Keys of the maps below point into these.
+    std::vector<ManifestInstance> mInstances;
+    // Instances of format, package and interface.
+    std::unordered_map<Key, Slice, KeyHash> mInterfaces;
+    // Instances of format, package, interface and instance.
+    std::unordered_map<Key, Slice, KeyHash> mPoints;
+};
+
+}  // namespace vintf
+}  // namespace android
+
+#endif  // ANDROID_VINTF_MANIFEST_INSTANCE_INDEX_H
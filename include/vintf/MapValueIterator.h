@@ -120,26 +120,30 @@ using MapValueIterable = typename MapIterTypes<std::map<K, V>>::ValueIterable;
 template <typename K, typename V>
 using MultiMapValueIterable = typename MapIterTypes<std::multimap<K, V>>::ValueIterable;
 
-template<typename K, typename V>
-ConstMapValueIterable<K, V> iterateValues(const std::map<K, V> &map) {
+template <typename K, typename V, typename C, typename A>
+typename MapIterTypes<std::map<K, V, C, A>>::ConstValueIterable iterateValues(
+    const std::map<K, V, C, A>& map) {
     return map;
 }
-template<typename K, typename V>
-ConstMultiMapValueIterable<K, V> iterateValues(const std::multimap<K, V> &map) {
+template <typename K, typename V, typename C, typename A>
+typename MapIterTypes<std::multimap<K, V, C, A>>::ConstValueIterable iterateValues(
+    const std::multimap<K, V, C, A>& map) {
     return map;
 }
-template <typename K, typename V>
-MapValueIterable<K, V> iterateValues(std::map<K, V>& map) {
+template <typename K, typename V, typename C, typename A>
+typename MapIterTypes<std::map<K, V, C, A>>::ValueIterable iterateValues(
+    std::map<K, V, C, A>& map) {
     return map;
 }
-template <typename K, typename V>
-MultiMapValueIterable<K, V> iterateValues(std::multimap<K, V>& map) {
+template <typename K, typename V, typename C, typename A>
+typename MapIterTypes<std::multimap<K, V, C, A>>::ValueIterable iterateValues(
+    std::multimap<K, V, C, A>& map) {
     return map;
 }
 
-template <typename K, typename V>
-typename MapIterTypes<std::multimap<K, V>>::template RangeImpl<true> iterateValues(
-    const std::multimap<K, V>& map, const K& key) {
+template <typename K, typename V, typename C, typename A>
+typename MapIterTypes<std::multimap<K, V, C, A>>::template RangeImpl<true> iterateValues(
+    const std::multimap<K, V, C, A>& map, const K& key) {
     return map.equal_range(key);
 }
 
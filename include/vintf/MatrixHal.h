@@ -18,6 +18,7 @@
 #define ANDROID_VINTF_MATRIX_HAL_H
 
 #include <map>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <vector>
@@ -30,9 +31,24 @@
 namespace android {
 namespace vintf {
 
+namespace details {
+class ProvidedInstances;
+}  // namespace details
+
 // A HAL entry to a compatibility matrix
 struct MatrixHal {
     using InstanceType = MatrixInstance;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    MatrixHal() = default;
+    MatrixHal(HalFormat format, std::string name, std::vector<VersionRange> versionRanges,
+              bool optional, bool updatableViaApex,
+              std::pmr::map<std::string, HalInterface> interfaces = {});
+    // Allocator-extended constructors, used by HalGroup so that the interfaces of a MatrixHal
+    // are allocated from the memory resource of the CompatibilityMatrix that holds it.
+    explicit MatrixHal(const allocator_type& alloc) : interfaces(alloc) {}
+    MatrixHal(const MatrixHal& other, const allocator_type& alloc);
+    MatrixHal(MatrixHal&& other, const allocator_type& alloc);
 
     bool operator==(const MatrixHal &other) const;
     // Check whether the MatrixHal contains the given version.
@@ -43,7 +59,7 @@ struct MatrixHal {
     std::vector<VersionRange> versionRanges;
     bool optional = false;
     bool updatableViaApex = false;
-    std::map<std::string, HalInterface> interfaces;
+    std::pmr::map<std::string, HalInterface> interfaces;
 
     inline const std::string& getName() const { return name; }
 
@@ -72,9 +88,9 @@ struct MatrixHal {
         const std::function<bool(const std::vector<VersionRange>&, const std::string&,
                                  const std::string& instanceOrPattern, bool isRegex)>& func) const;
 
-    bool isCompatible(const std::set<FqInstance>& providedInstances,
+    bool isCompatible(const details::ProvidedInstances& providedInstances,
                       const std::set<Version>& providedVersions) const;
-    bool isCompatible(const VersionRange& vr, const std::set<FqInstance>& providedInstances,
+    bool isCompatible(const VersionRange& vr, const details::ProvidedInstances& providedInstances,
                       const std::set<Version>& providedVersions) const;
 
     void setOptional(bool o);
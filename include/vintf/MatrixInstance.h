@@ -42,7 +42,7 @@ class MatrixInstance {
                    bool optional, bool isRegex);
     const std::string& package() const;
     const VersionRange& versionRange() const;
-    std::string interface() const;
+    const std::string& interface() const;
     bool optional() const;
     HalFormat format() const;
 
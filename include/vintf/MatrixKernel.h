@@ -36,6 +36,13 @@ struct KernelConfigKey : public std::string {
 
 using KernelConfig = std::pair<KernelConfigKey, KernelConfigTypedValue>;
 
+namespace details {
+class ContentWalker;
+class KernelRequirementIndex;
+class KernelRequirementTable;
+class VintfDiffer;
+}  // namespace details
+
 // A <kernel> entry to a compatibility matrix represents a fragment of kernel
 // config requirements.
 struct MatrixKernel {
@@ -62,6 +69,10 @@ struct MatrixKernel {
     friend struct CompatibilityMatrix;
     friend class AssembleVintfImpl;
     friend class KernelInfo;
+    friend class details::ContentWalker;
+    friend class details::KernelRequirementIndex;
+    friend class details::KernelRequirementTable;
+    friend class details::VintfDiffer;
 
     void setSourceMatrixLevel(Level level);
     Level getSourceMatrixLevel() const;
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VINTF_TRACER_H
+#define ANDROID_VINTF_TRACER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace vintf {
+
+// Receives named spans that cover the phases of loading and checking VINTF metadata,
+// e.g. FileSystem::fetch, fromXml, HalManifest::addAll and CompatibilityMatrix::combine.
+// Spans started on the same thread are strictly nested. A Tracer may receive spans from
+// multiple threads at the same time.
+//
+// This class can be used to forward spans to a tracing system or to record them in tests.
+class Tracer {
+   public:
+    using Attributes = std::vector<std::pair<std::string, std::string>>;
+
+    virtual ~Tracer() {}
+    // If false, spans are not reported and their attributes are not computed.
+    virtual bool isEnabled() const { return true; }
+    virtual void beginSpan(const char* name) = 0;
+    // |attributes| describe the work done in the span, e.g. the path and size of a file.
+    virtual void endSpan(const char* name, const Attributes& attributes) = 0;
+};
+
+namespace details {
+
+// Class that does nothing.
+class TracerNoOp : public Tracer {
+   public:
+    bool isEnabled() const override;
+    void beginSpan(const char*) override;
+    void endSpan(const char*, const Attributes&) override;
+};
+
+// Begins a span on construction and ends it on destruction. |tracer| may be null.
+class ScopedSpan {
+   public:
+    ScopedSpan(Tracer* tracer, const char* name);
+    ~ScopedSpan();
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    // Attributes are only reported if this is true. Check it before computing attributes, so
+    // that no strings are built when tracing is off.
+    bool isEnabled() const { return mTracer != nullptr; }
+    // Ignored if !isEnabled().
+    void addAttribute(const char* key, std::string value);
+    void addAttribute(const char* key, size_t value);
+
+   private:
+    Tracer* mTracer;
+    const char* mName;
+    Tracer::Attributes mAttributes;
+};
+
+}  // namespace details
+}  // namespace vintf
+}  // namespace android
+
+#endif  // ANDROID_VINTF_TRACER_H
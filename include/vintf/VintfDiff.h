@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef ANDROID_VINTF_VINTF_DIFF_H
+#define ANDROID_VINTF_VINTF_DIFF_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace vintf {
+
+struct CompatibilityMatrix;
+struct HalManifest;
+
+// A difference between two HAL manifests or two compatibility matrices.
+struct DiffEntry {
+    enum class Type {
+        ADDED,
+        REMOVED,
+        CHANGED,
+    };
+
+    Type type;
+    // The kind of element, e.g. "hal", "instance", "kernel-config", "sepolicy", "xmlfile".
+    std::string section;
+    // Identifies the element within its section, e.g. "aidl android.hardware.foo.IFoo/default".
+    std::string key;
+    // Summary of the element in the old / new object. Empty if the element is ADDED / REMOVED.
+    std::string oldValue;
+    std::string newValue;
+
+    bool operator==(const DiffEntry& other) const;
+};
+
+// Return the differences between |oldManifest| and |newManifest|, ordered by section and
+// then by key. <hal>s are reported by name and format, and each of their instances is
+// reported by its interface and instance name (and the major version for HIDL), so that a
+// version bump is reported as a changed instance instead of a removed and an added one.
+// The <hal>s of both manifests are walked in parallel in name order, and the elements within
+// each name, which are normally already in key order, are compared field by field. Strings
+// are only formatted for the differences that are returned.
+std::vector<DiffEntry> diff(const HalManifest& oldManifest, const HalManifest& newManifest);
+
+// Same as above for compatibility matrices.
+std::vector<DiffEntry> diff(const CompatibilityMatrix& oldMatrix,
+                            const CompatibilityMatrix& newMatrix);
+
+// "+ section key: newValue", "- section key: oldValue" or
+// "~ section key: oldValue -> newValue".
+std::ostream& operator<<(std::ostream& os, const DiffEntry& entry);
+
+}  // namespace vintf
+}  // namespace android
+
+#endif  // ANDROID_VINTF_VINTF_DIFF_H
@@ -17,6 +17,7 @@
 #ifndef ANDROID_VINTF_VINTF_OBJECT_H_
 #define ANDROID_VINTF_VINTF_OBJECT_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -34,9 +35,11 @@
 #include <vintf/FileSystem.h>
 #include <vintf/HalManifest.h>
 #include <vintf/Level.h>
+#include <vintf/ManifestInstanceIndex.h>
 #include <vintf/ObjectFactory.h>
 #include <vintf/PropertyFetcher.h>
 #include <vintf/RuntimeInfo.h>
+#include <vintf/Tracer.h>
 
 namespace android {
 namespace vintf {
@@ -55,6 +58,11 @@ struct LockedSharedPtr {
     std::optional<timespec> lastModified;
 };
 
+struct LockedManifestInstanceIndex {
+    std::shared_ptr<const ManifestInstanceIndex> object;
+    std::mutex mutex;
+};
+
 struct LockedRuntimeInfoCache {
     std::shared_ptr<RuntimeInfo> object;
     std::mutex mutex;
@@ -121,6 +129,17 @@ class VintfObject {
      */
     virtual std::shared_ptr<const CompatibilityMatrix> getFrameworkCompatibilityMatrix();
 
+    /*
+     * Return an index over the instances of getDeviceHalManifest() and
+     * getFrameworkHalManifest() for repeated lookups. The index is rebuilt when either
+     * manifest is reloaded. Return nullptr if neither manifest can be read.
+     *
+     * Each call costs as much as calling both getters: it locks the cached manifests and
+     * checks the modification time of APEX data. Keep the returned index for a batch of
+     * lookups instead of calling this for each one.
+     */
+    std::shared_ptr<const ManifestInstanceIndex> getManifestInstanceIndex();
+
     /*
      * Return the API that access device runtime info.
      *
@@ -150,6 +169,32 @@ class VintfObject {
     int32_t checkCompatibility(std::string* error = nullptr,
                                CheckFlags::Type flags = CheckFlags::DEFAULT);
 
+    // Result of one of the checks that checkCompatibility() runs.
+    struct CompatibilityCheckResult {
+        bool compatible = false;
+        // Set if not compatible.
+        std::string error;
+    };
+
+    // Results of the checks that checkCompatibility() runs, for callers that already ran
+    // some of them on the objects returned by this VintfObject.
+    struct CompatibilityCheckResults {
+        // Device manifest against framework compatibility matrix.
+        std::optional<CompatibilityCheckResult> deviceManifest;
+        // Framework manifest against device compatibility matrix.
+        std::optional<CompatibilityCheckResult> frameworkManifest;
+        // Runtime info against framework compatibility matrix.
+        std::optional<CompatibilityCheckResult> runtimeInfo;
+    };
+
+    /**
+     * Same as checkCompatibility(error, flags), but use |results| instead of running the
+     * checks that already have a result.
+     */
+    int32_t checkCompatibility(const CompatibilityCheckResults& results,
+                               std::string* error = nullptr,
+                               CheckFlags::Type flags = CheckFlags::DEFAULT);
+
     /**
      * Check deprecation on existing VINTF metadata. Use Device Manifest as the
      * predicate to check if a HAL is in use.
@@ -221,6 +266,7 @@ class VintfObject {
     std::unique_ptr<FileSystem> mFileSystem;
     std::unique_ptr<ObjectFactory<RuntimeInfo>> mRuntimeInfoFactory;
     std::unique_ptr<PropertyFetcher> mPropertyFetcher;
+    std::unique_ptr<Tracer> mTracer;
     details::LockedSharedPtr<HalManifest> mDeviceManifest;
     details::LockedSharedPtr<HalManifest> mFrameworkManifest;
     details::LockedSharedPtr<CompatibilityMatrix> mDeviceMatrix;
@@ -232,6 +278,7 @@ class VintfObject {
     // End of mFrameworkCompatibilityMatrixMutex
 
     details::LockedRuntimeInfoCache mDeviceRuntimeInfo;
+    details::LockedManifestInstanceIndex mManifestInstanceIndex;
 
     bool getCheckAidlCompatMatrix();
     std::optional<bool> mFakeCheckAidlCompatibilityMatrix;
@@ -252,10 +299,11 @@ class VintfObject {
     virtual const std::unique_ptr<FileSystem>& getFileSystem();
     virtual const std::unique_ptr<PropertyFetcher>& getPropertyFetcher();
     virtual const std::unique_ptr<ObjectFactory<RuntimeInfo>>& getRuntimeInfoFactory();
+    virtual const std::unique_ptr<Tracer>& getTracer();
 
    public:
     /*
-     * Get global instance. Results are cached.
+     * Get global instance. Results are cached. After the first call, this does not lock.
      */
     static std::shared_ptr<VintfObject> GetInstance();
 
@@ -285,6 +333,12 @@ class VintfObject {
      */
     static std::shared_ptr<const CompatibilityMatrix> GetFrameworkCompatibilityMatrix();
 
+    /*
+     * Return an index over the instances of the device and framework HAL manifests for
+     * repeated lookups.
+     */
+    static std::shared_ptr<const ManifestInstanceIndex> GetManifestInstanceIndex();
+
     /*
      * Return the API that access device runtime info.
      *
@@ -301,8 +355,15 @@ class VintfObject {
                                         std::string* error = nullptr);
     status_t getAllFrameworkMatrixLevels(std::vector<CompatibilityMatrix>* out,
                                          std::string* error = nullptr);
+    // Call |onMatrix| on each matrix that getAllFrameworkMatrixLevels() would return, as soon
+    // as it is read. Return BAD_VALUE if |onMatrix| returns false.
+    status_t forEachFrameworkMatrixLevel(
+        const std::function<bool(CompatibilityMatrix&&, std::string*)>& onMatrix,
+        std::string* error = nullptr);
+    // If |kernelTablePath| is not empty, <kernel>s are loaded from the kernel requirement table
+    // at that path if it is up to date with the matrix at |path|.
     status_t getOneMatrix(const std::string& path, CompatibilityMatrix* out,
-                          std::string* error = nullptr);
+                          std::string* error = nullptr, const std::string& kernelTablePath = {});
     status_t addDirectoryManifests(const std::string& directory, HalManifest* manifests,
                                    bool ignoreSchemaType, std::string* error);
     status_t addDirectoriesManifests(const std::vector<std::string>& directories,
@@ -382,6 +443,7 @@ class VintfObjectBuilder {
     VintfObjectBuilder& setFileSystem(std::unique_ptr<FileSystem>&&);
     VintfObjectBuilder& setRuntimeInfoFactory(std::unique_ptr<ObjectFactory<RuntimeInfo>>&&);
     VintfObjectBuilder& setPropertyFetcher(std::unique_ptr<PropertyFetcher>&&);
+    VintfObjectBuilder& setTracer(std::unique_ptr<Tracer>&&);
     template <typename VintfObjectType = VintfObject>
     std::unique_ptr<VintfObjectType> build() {
         return std::unique_ptr<VintfObjectType>(
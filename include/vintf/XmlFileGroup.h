@@ -39,6 +39,13 @@ struct XmlFileGroup {
    public:
     virtual ~XmlFileGroup() {}
 
+    // Declared explicitly because the virtual destructor suppresses the implicit moves.
+    XmlFileGroup() = default;
+    XmlFileGroup(const XmlFileGroup&) = default;
+    XmlFileGroup(XmlFileGroup&&) = default;
+    XmlFileGroup& operator=(const XmlFileGroup&) = default;
+    XmlFileGroup& operator=(XmlFileGroup&&) = default;
+
     bool addXmlFile(T&& t) {
         if (!shouldAddXmlFile(t)) {
             return false;
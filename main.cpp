@@ -17,16 +17,23 @@
 #include <getopt.h>
 
 #include <android-base/strings.h>
-#include <json/json.h>
+#include <vintf/BinaryContent.h>
+#include <vintf/ContentVisitor.h>
 #include <vintf/VintfObject.h>
 #include <vintf/parse_string.h>
 #include <vintf/parse_xml.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <optional>
+#include <string_view>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "JsonContentVisitor.h"
+
 using namespace ::android::vintf;
 
 static const std::string kColumnSeperator = "   ";
@@ -90,8 +97,16 @@ std::vector<DumpTargetOption> gTargetOptions = {
     {"ri", &dumpRi, "Print Runtime Information."},
 };
 
+enum class OutputFormat {
+    // XML for manifests and matrices, JSON for ri, text for legacy.
+    DEFAULT,
+    JSON,
+    BINARY,
+};
+
 struct ParsedOptions {
     bool verbose = false;
+    OutputFormat format = OutputFormat::DEFAULT;
     std::function<void(const ParsedOptions&)> fn = &dumpLegacy;
 };
 
@@ -99,13 +114,19 @@ struct Option {
     char shortOption = '\0';
     std::string longOption;
     std::string help;
-    std::function<Status(ParsedOptions*)> op;
+    // The argument is nullptr unless the option has an argument.
+    std::function<Status(ParsedOptions*, const char* argument)> op;
+    // If not empty, the option has an argument, described by this in the help message.
+    std::string argument;
 };
 
 std::string getShortOptions(const std::vector<Option>& options) {
     std::stringstream ret;
-    for (const auto& e : options)
-        if (e.shortOption != '\0') ret << e.shortOption;
+    for (const auto& e : options) {
+        if (e.shortOption == '\0') continue;
+        ret << e.shortOption;
+        if (!e.argument.empty()) ret << ':';
+    }
     return ret.str();
 }
 
@@ -115,7 +136,7 @@ std::unique_ptr<struct option[]> getLongOptions(const std::vector<Option>& optio
     int i = 0;
     for (const auto& e : options) {
         ret[i].name = e.longOption.c_str();
-        ret[i].has_arg = no_argument;
+        ret[i].has_arg = e.argument.empty() ? no_argument : required_argument;
         ret[i].flag = longOptFlag;
         ret[i].val = i;
 
@@ -153,7 +174,7 @@ Status parseOptions(int argc, char** argv, const std::vector<Option>& options, P
             return USAGE;
         }
 
-        Status status = found->op(out);
+        Status status = found->op(out, optarg);
         if (status != OK) return status;
     }
     // optional/positional/enum
@@ -182,6 +203,7 @@ void usage(char* me, const std::vector<Option>& options) {
         if (e.shortOption != '\0') std::cerr << "-" << e.shortOption;
         if (e.shortOption != '\0' && !e.longOption.empty()) std::cerr << ", ";
         if (!e.longOption.empty()) std::cerr << "--" << e.longOption;
+        if (!e.argument.empty()) std::cerr << "=<" << e.argument << ">";
         std::cerr << ": "
                   << android::base::Join(android::base::Split(e.help, "\n"), "\n            ")
                   << std::endl;
@@ -198,6 +220,42 @@ void usage(char* me, const std::vector<Option>& options) {
     }
 }
 
+// Print the content visited by |visit| in |format|, which must be JSON or BINARY.
+void dumpContent(OutputFormat format, const std::function<void(ContentVisitor*)>& visit) {
+    if (format == OutputFormat::BINARY) {
+        BinaryContentWriter visitor(std::cout);
+        visit(&visitor);
+        std::cout.flush();
+        return;
+    }
+    details::JsonContentVisitor visitor;
+    visit(&visitor);
+    std::cout << visitor.root() << '\n';
+}
+
+// Print a manifest or a matrix as XML, or in options.format.
+template <typename T>
+void dumpObject(const ParsedOptions& options, const T& object) {
+    if (options.format == OutputFormat::DEFAULT) {
+        std::cout << toXml(object);
+        return;
+    }
+    dumpContent(options.format, [&](ContentVisitor* visitor) { visitContent(object, visitor); });
+}
+
+// Keep field names in sync with VintfDeviceInfo's usage
+void visitRuntimeInfo(const RuntimeInfo& ri, ContentVisitor* visitor) {
+    visitor->beginObject("runtime-info");
+    visitor->visitString("cpu_info", ri.cpuInfo());
+    visitor->visitString("os_name", ri.osName());
+    visitor->visitString("node_name", ri.nodeName());
+    visitor->visitString("os_release", ri.osRelease());
+    visitor->visitString("os_version", ri.osVersion());
+    visitor->visitString("hardware_id", ri.hardwareId());
+    visitor->visitString("kernel_version", to_string(ri.kernelVersion()));
+    visitor->endObject();
+}
+
 struct TableRow {
     // Whether the HAL version is in device manifest, framework manifest, device compatibility
     // matrix, framework compatibility matrix, respectively.
@@ -228,60 +286,160 @@ std::ostream& operator<<(std::ostream& out, const TableRow& row) {
                << kColumnSeperator << (row.dcm ? "DCM" : "   ");
 }
 
-using RowMutator = std::function<void(TableRow*)>;
-using Table = std::map<std::string, TableRow>;
+// A row of the HAL summary from one source, keyed by the description of a HAL instance.
+struct SourceRow {
+    std::string key;
+    // For compatibility matrices, whether the row is for the first version of a version range,
+    // and whether the instance is required.
+    bool firstVersion = false;
+    bool required = false;
+};
+
+// The rows from one of the four sources of the HAL summary, sorted by key.
+struct SummarySource {
+    // The indicator that the source sets in a TableRow.
+    bool TableRow::*column;
+    std::vector<SourceRow> rows;
+    // The first row that is not merged yet.
+    size_t next = 0;
+};
+
+// Descriptions of a MatrixInstance for each version in its version range, built from a
+// single call to MatrixInstance::description() by replacing the version in it.
+class MatrixInstanceDescriptions {
+   public:
+    explicit MatrixInstanceDescriptions(const MatrixInstance& matrixInstance)
+        : mMatrixInstance(matrixInstance) {
+        Version minVersion = matrixInstance.versionRange().minVer();
+        std::string description = matrixInstance.description(minVersion);
+        std::string version = versionString(minVersion);
+        // HIDL and native: package@version::IFoo/instance
+        // AIDL: package.IFoo/instance (@version)
+        size_t pos = matrixInstance.format() == HalFormat::AIDL
+                         ? description.rfind(version)
+                         : matrixInstance.package().size() + 1;
+        if (pos == std::string::npos || description.compare(pos, version.size(), version) != 0) {
+            return;
+        }
+        mPrefix = description.substr(0, pos);
+        mSuffix = description.substr(pos + version.size());
+        mValid = true;
+    }
+
+    std::string get(const Version& version) const {
+        if (!mValid) return mMatrixInstance.description(version);
+        return mPrefix + versionString(version) + mSuffix;
+    }
+
+   private:
+    std::string versionString(const Version& version) const {
+        return mMatrixInstance.format() == HalFormat::AIDL ? aidlVersionToString(version)
+                                                            : to_string(version);
+    }
 
-// Insert each fqInstanceName foo@x.y::IFoo/instance to the table by inserting the key
-// if it does not exist and setting the corresponding indicator (as specified by "mutate").
-void insert(const HalManifest* manifest, Table* table, const RowMutator& mutate) {
-    if (manifest == nullptr) return;
+    const MatrixInstance& mMatrixInstance;
+    bool mValid = false;
+    std::string mPrefix;
+    std::string mSuffix;
+};
+
+void sortRows(SummarySource* source) {
+    std::stable_sort(source->rows.begin(), source->rows.end(),
+                     [](const auto& a, const auto& b) { return a.key < b.key; });
+}
+
+// Collect each fqInstanceName foo@x.y::IFoo/instance in the manifest.
+SummarySource collect(const HalManifest* manifest, bool TableRow::*column) {
+    SummarySource source{column, {}};
+    if (manifest == nullptr) return source;
     manifest->forEachInstance([&](const auto& manifestInstance) {
-        std::string key = manifestInstance.description();
-        mutate(&(*table)[key]);
+        source.rows.push_back({manifestInstance.description()});
         return true;
     });
+    sortRows(&source);
+    return source;
 }
 
-void insert(const CompatibilityMatrix* matrix, Table* table, const RowMutator& mutate) {
-    if (matrix == nullptr) return;
+// Collect each fqInstanceName foo@x.y::IFoo/instance for every version in the version ranges
+// of the matrix.
+SummarySource collect(const CompatibilityMatrix* matrix, bool TableRow::*column) {
+    SummarySource source{column, {}};
+    if (matrix == nullptr) return source;
     matrix->forEachInstance([&](const auto& matrixInstance) {
-        for (auto minorVer = matrixInstance.versionRange().minMinor;
-             minorVer >= matrixInstance.versionRange().minMinor &&
-             minorVer <= matrixInstance.versionRange().maxMinor;
-             ++minorVer) {
-            Version version{matrixInstance.versionRange().majorVer, minorVer};
-            std::string key = matrixInstance.description(version);
-            auto it = table->find(key);
-            if (it == table->end()) {
-                mutate(&(*table)[key]);
-            } else {
-                mutate(&it->second);
-                if (minorVer == matrixInstance.versionRange().minMinor) {
-                    it->second.required = !matrixInstance.optional();
-                }
-            }
+        const VersionRange& range = matrixInstance.versionRange();
+        MatrixInstanceDescriptions descriptions(matrixInstance);
+        for (auto minorVer = range.minMinor;
+             minorVer >= range.minMinor && minorVer <= range.maxMinor; ++minorVer) {
+            source.rows.push_back({descriptions.get(Version{range.majorVer, minorVer}),
+                                   minorVer == range.minMinor, !matrixInstance.optional()});
         }
         return true;
     });
+    sortRows(&source);
+    return source;
 }
 
-Table generateHalSummary(const HalManifest* vm, const HalManifest* fm,
-                         const CompatibilityMatrix* vcm, const CompatibilityMatrix* fcm) {
-    Table table;
-    insert(vm, &table, [](auto* row) { row->dm = true; });
-    insert(fm, &table, [](auto* row) { row->fm = true; });
-    insert(vcm, &table, [](auto* row) { row->dcm = true; });
-    insert(fcm, &table, [](auto* row) { row->fcm = true; });
-
-    return table;
+// Merge the sorted sources in one pass, and call |emit| for each row of the summary in the
+// order of its key. A row that is in several sources is built by applying the sources in the
+// given order: the indicator of each source is set, and a matrix sets whether the row is
+// required at the first version of a range if an earlier source already has the row.
+void generateHalSummary(const HalManifest* vm, const HalManifest* fm,
+                        const CompatibilityMatrix* vcm, const CompatibilityMatrix* fcm,
+                        const std::function<void(const std::string&, const TableRow&)>& emit) {
+    SummarySource sources[] = {
+        collect(vm, &TableRow::dm),
+        collect(fm, &TableRow::fm),
+        collect(vcm, &TableRow::dcm),
+        collect(fcm, &TableRow::fcm),
+    };
+    for (;;) {
+        const std::string* key = nullptr;
+        for (const auto& source : sources) {
+            if (source.next < source.rows.size() &&
+                (key == nullptr || source.rows[source.next].key < *key)) {
+                key = &source.rows[source.next].key;
+            }
+        }
+        if (key == nullptr) break;
+
+        TableRow row;
+        bool exists = false;
+        for (auto& source : sources) {
+            for (; source.next < source.rows.size() && source.rows[source.next].key == *key;
+                 ++source.next) {
+                const SourceRow& sourceRow = source.rows[source.next];
+                row.*source.column = true;
+                if (exists && sourceRow.firstVersion) row.required = sourceRow.required;
+                exists = true;
+            }
+        }
+        emit(*key, row);
+    }
 }
 
 static const std::vector<Option> gAvailableOptions{
-    {'h', "help", "Print help message.", [](auto) { return USAGE; }},
-    {'v', "verbose", "Dump detailed and raw content, including kernel configurations", [](auto o) {
+    {'h', "help", "Print help message.", [](auto, auto) { return USAGE; }},
+    {'v', "verbose", "Dump detailed and raw content, including kernel configurations",
+     [](auto o, auto) {
          o->verbose = true;
          return OK;
-     }}};
+     }},
+    {'\0', "format",
+     "Print the dump target as JSON or in a compact binary format.\n"
+     "By default, manifests and matrices are printed as XML, ri as JSON,\n"
+     "and legacy as text.",
+     [](auto o, const char* argument) {
+         if (argument == std::string_view("json")) {
+             o->format = OutputFormat::JSON;
+         } else if (argument == std::string_view("binary")) {
+             o->format = OutputFormat::BINARY;
+         } else {
+             std::cerr << "unrecognized format `" << argument << "'" << std::endl;
+             return USAGE;
+         }
+         return OK;
+     },
+     "json|binary"}};
 // A convenience binary to dump information available through libvintf.
 int main(int argc, char** argv) {
     ParsedOptions options;
@@ -299,6 +457,26 @@ void dumpLegacy(const ParsedOptions& options) {
     auto fcm = VintfObject::GetFrameworkCompatibilityMatrix();
     auto ki = VintfObject::GetRuntimeInfo();
 
+    if (options.format != OutputFormat::DEFAULT) {
+        // All objects that exist, e.g. {"device-manifest": {"manifest": {...}}, ...}
+        dumpContent(options.format, [&](ContentVisitor* visitor) {
+            auto visitObject = [visitor](std::string_view name, const auto& object) {
+                if (object == nullptr) return;
+                visitor->beginObject(name);
+                visitContent(*object, visitor);
+                visitor->endObject();
+            };
+            visitor->beginObject("vintf");
+            visitObject("device-manifest", vm);
+            visitObject("framework-manifest", fm);
+            visitObject("device-compatibility-matrix", vcm);
+            visitObject("framework-compatibility-matrix", fcm);
+            if (ki != nullptr) visitRuntimeInfo(*ki, visitor);
+            visitor->endObject();
+        });
+        return;
+    }
+
     if (!options.verbose) {
         std::cout << "======== HALs =========" << std::endl
                   << "R: required. (empty): optional or missing from matrices. "
@@ -307,10 +485,10 @@ void dumpLegacy(const ParsedOptions& options) {
                   << "FCM: framework compatibility matrix. DCM: device compatibility matrix."
                   << std::endl
                   << std::endl;
-        auto table = generateHalSummary(vm.get(), fm.get(), vcm.get(), fcm.get());
-
-        for (const auto& pair : table)
-            std::cout << pair.second << kColumnSeperator << pair.first << std::endl;
+        generateHalSummary(vm.get(), fm.get(), vcm.get(), fcm.get(),
+                           [](const std::string& key, const TableRow& row) {
+                               std::cout << row << kColumnSeperator << key << "\n";
+                           });
 
         std::cout << std::endl;
     }
@@ -338,33 +516,37 @@ void dumpLegacy(const ParsedOptions& options) {
               << "Device Matrix?      " << existString(vcm != nullptr) << std::endl
               << "Framework Manifest? " << existString(fm != nullptr) << std::endl
               << "Framework Matrix?   " << existString(fcm != nullptr) << std::endl;
-    std::string error;
+    // The verdict of VintfObject::checkCompatibility() below reuses these results instead of
+    // running the same checks again.
+    VintfObject::CompatibilityCheckResults checks;
     if (vm && fcm) {
-        bool compatible = vm->checkCompatibility(*fcm, &error);
+        auto& result = checks.deviceManifest.emplace();
+        result.compatible = vm->checkCompatibility(*fcm, &result.error);
         std::cout << "Device HAL Manifest <==> Framework Compatibility Matrix? "
-                  << boolCompatString(compatible);
-        if (!compatible)
-            std::cout << ", " << error;
+                  << boolCompatString(result.compatible);
+        if (!result.compatible) std::cout << ", " << result.error;
         std::cout << std::endl;
     }
     if (fm && vcm) {
-        bool compatible = fm->checkCompatibility(*vcm, &error);
+        auto& result = checks.frameworkManifest.emplace();
+        result.compatible = fm->checkCompatibility(*vcm, &result.error);
         std::cout << "Framework HAL Manifest <==> Device Compatibility Matrix? "
-                  << boolCompatString(compatible);
-        if (!compatible)
-            std::cout << ", " << error;
+                  << boolCompatString(result.compatible);
+        if (!result.compatible) std::cout << ", " << result.error;
         std::cout << std::endl;
     }
     if (ki && fcm) {
-        bool compatible = ki->checkCompatibility(*fcm, &error);
+        auto& result = checks.runtimeInfo.emplace();
+        result.compatible = ki->checkCompatibility(*fcm, &result.error);
         std::cout << "Runtime info <==> Framework Compatibility Matrix?        "
-                  << boolCompatString(compatible);
-        if (!compatible) std::cout << ", " << error;
+                  << boolCompatString(result.compatible);
+        if (!result.compatible) std::cout << ", " << result.error;
         std::cout << std::endl;
     }
 
+    std::string error;
     {
-        auto compatible = VintfObject::GetInstance()->checkCompatibility(&error);
+        auto compatible = VintfObject::GetInstance()->checkCompatibility(checks, &error);
         std::cout << "VintfObject::checkCompatibility?                         "
                   << compatibleString(compatible);
         if (compatible != COMPATIBLE) std::cout << ", " << error;
@@ -381,42 +563,35 @@ void dumpLegacy(const ParsedOptions& options) {
     }
 }
 
-void dumpDm(const ParsedOptions&) {
+void dumpDm(const ParsedOptions& options) {
     auto dm = VintfObject::GetDeviceHalManifest();
-    if (dm != nullptr) std::cout << toXml(*dm);
+    if (dm != nullptr) dumpObject(options, *dm);
 }
 
-void dumpFm(const ParsedOptions&) {
+void dumpFm(const ParsedOptions& options) {
     auto fm = VintfObject::GetFrameworkHalManifest();
-    if (fm != nullptr) std::cout << toXml(*fm);
+    if (fm != nullptr) dumpObject(options, *fm);
 }
 
-void dumpDcm(const ParsedOptions&) {
+void dumpDcm(const ParsedOptions& options) {
     auto dcm = VintfObject::GetDeviceCompatibilityMatrix();
-    if (dcm != nullptr) std::cout << toXml(*dcm);
+    if (dcm != nullptr) dumpObject(options, *dcm);
 }
 
-void dumpFcm(const ParsedOptions&) {
+void dumpFcm(const ParsedOptions& options) {
     auto fcm = VintfObject::GetFrameworkCompatibilityMatrix();
-    if (fcm != nullptr) std::cout << toXml(*fcm);
+    if (fcm != nullptr) dumpObject(options, *fcm);
 }
 
-// Keep field names in sync with VintfDeviceInfo's usage
-void dumpRi(const ParsedOptions&) {
+void dumpRi(const ParsedOptions& options) {
     const RuntimeInfo::FetchFlags flags = RuntimeInfo::FetchFlag::CPU_INFO |
                                           RuntimeInfo::FetchFlag::CPU_VERSION |
                                           RuntimeInfo::FetchFlag::POLICYVERS;
 
     auto ri = VintfObject::GetRuntimeInfo(flags);
     if (ri != nullptr) {
-        Json::Value root;
-        root["cpu_info"] = ri->cpuInfo();
-        root["os_name"] = ri->osName();
-        root["node_name"] = ri->nodeName();
-        root["os_release"] = ri->osRelease();
-        root["os_version"] = ri->osVersion();
-        root["hardware_id"] = ri->hardwareId();
-        root["kernel_version"] = to_string(ri->kernelVersion());
-        std::cout << root << '\n';
+        OutputFormat format =
+            options.format == OutputFormat::DEFAULT ? OutputFormat::JSON : options.format;
+        dumpContent(format, [&](ContentVisitor* visitor) { visitRuntimeInfo(*ri, visitor); });
     }
 }
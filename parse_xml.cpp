@@ -21,17 +21,24 @@
 
 #include "parse_xml.h"
 
+#include <algorithm>
+#include <optional>
+#include <string_view>
 #include <type_traits>
 
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <tinyxml2.h>
 
+#include "KernelRequirementTable.h"
 #include "Regex.h"
+#include "XmlPullParser.h"
+#include "XmlWriter.h"
 #include "constants-private.h"
 #include "constants.h"
 #include "parse_string.h"
 #include "parse_xml_for_test.h"
+#include "parse_xml_internal.h"
 #include "utils.h"
 
 using namespace std::string_literals;
@@ -45,84 +52,92 @@ static constexpr bool kDevice = false;
 namespace android {
 namespace vintf {
 
-// --------------- tinyxml2 details
-
-using NodeType = tinyxml2::XMLElement;
-using DocType = tinyxml2::XMLDocument;
+// --------------- XmlWriter details
+// XML is written directly into a string by details::XmlWriter. Nodes are closed when they
+// are appended to their parent, so a node must be appended before the next sibling is
+// created.
 
-// caller is responsible for deleteDocument() call
-inline DocType *createDocument() {
-    return new tinyxml2::XMLDocument();
-}
+using NodeType = details::XmlWriterElement;
+using DocType = details::XmlWriter;
 
 // caller is responsible for deleteDocument() call
-inline DocType *createDocument(const std::string &xml) {
-    DocType *doc = new tinyxml2::XMLDocument();
-    if (doc->Parse(xml.c_str()) == tinyxml2::XML_SUCCESS) {
-        return doc;
-    }
-    delete doc;
-    return nullptr;
+inline DocType* createDocument() {
+    return new details::XmlWriter();
 }
 
-inline void deleteDocument(DocType *d) {
+inline void deleteDocument(DocType* d) {
     delete d;
 }
 
-inline std::string printDocument(DocType *d) {
-    tinyxml2::XMLPrinter p;
-    d->Print(&p);
-    return std::string{p.CStr()};
+inline std::string printDocument(DocType* d) {
+    return d->release();
 }
 
-inline NodeType *createNode(const std::string &name, DocType *d) {
-    return d->NewElement(name.c_str());
+inline NodeType* createNode(const std::string& name, DocType* d) {
+    return d->openElement(name);
 }
 
-inline void appendChild(NodeType *parent, NodeType *child) {
-    parent->InsertEndChild(child);
+inline void appendChild(NodeType* /* parent */, NodeType* child) {
+    child->writer()->closeElement(child);
 }
 
-inline void appendChild(DocType *parent, NodeType *child) {
-    parent->InsertEndChild(child);
+inline void appendChild(DocType* parent, NodeType* child) {
+    parent->closeElement(child);
 }
 
-inline void appendStrAttr(NodeType *e, const std::string &attrName, const std::string &attr) {
-    e->SetAttribute(attrName.c_str(), attr.c_str());
+inline void appendStrAttr(NodeType* e, const std::string& attrName, const std::string& attr) {
+    e->writer()->addAttribute(e, attrName, attr);
 }
 
 // text -> text
-inline void appendText(NodeType *parent, const std::string &text, DocType *d) {
-    parent->InsertEndChild(d->NewText(text.c_str()));
+inline void appendText(NodeType* parent, const std::string& text, DocType* d) {
+    d->addText(parent, text);
 }
 
-inline std::string nameOf(NodeType *root) {
-    return root->Name() == NULL ? "" : root->Name();
+// --------------- XmlWriter details end.
+
+#ifndef LIBVINTF_XML_PULL_PARSER
+
+// --------------- tinyxml2 details
+
+using ParsedNodeType = tinyxml2::XMLElement;
+using ParsedDocType = tinyxml2::XMLDocument;
+
+// caller is responsible for deleteDocument() call
+inline ParsedDocType* createDocument(const std::string& xml) {
+    ParsedDocType* doc = new tinyxml2::XMLDocument();
+    if (doc->Parse(xml.c_str()) == tinyxml2::XML_SUCCESS) {
+        return doc;
+    }
+    delete doc;
+    return nullptr;
+}
+
+inline void deleteDocument(ParsedDocType* d) {
+    delete d;
 }
 
-inline std::string getText(NodeType *root) {
+inline std::string getText(ParsedNodeType* root) {
     return root->GetText() == NULL ? "" : root->GetText();
 }
 
-inline NodeType *getChild(NodeType *parent, const std::string &name) {
-    return parent->FirstChildElement(name.c_str());
+inline std::string_view nameViewOf(ParsedNodeType* root) {
+    return root->Name() == NULL ? "" : root->Name();
 }
 
-inline NodeType *getRootChild(DocType *parent) {
+inline ParsedNodeType* getRootChild(ParsedDocType* parent) {
     return parent->FirstChildElement();
 }
 
-inline std::vector<NodeType *> getChildren(NodeType *parent, const std::string &name) {
-    std::vector<NodeType *> v;
-    for (NodeType *child = parent->FirstChildElement(name.c_str());
-         child != nullptr;
-         child = child->NextSiblingElement(name.c_str())) {
-        v.push_back(child);
-    }
-    return v;
+inline ParsedNodeType* getFirstChild(ParsedNodeType* parent) {
+    return parent->FirstChildElement();
 }
 
-inline bool getAttr(NodeType *root, const std::string &attrName, std::string *s) {
+inline ParsedNodeType* getNextSibling(ParsedNodeType* node) {
+    return node->NextSiblingElement();
+}
+
+inline bool getAttr(ParsedNodeType* root, const std::string& attrName, std::string* s) {
     const char *c = root->Attribute(attrName.c_str());
     if (c == NULL)
         return false;
@@ -132,6 +147,62 @@ inline bool getAttr(NodeType *root, const std::string &attrName, std::string *s)
 
 // --------------- tinyxml2 details end.
 
+#endif  // LIBVINTF_XML_PULL_PARSER
+
+#ifdef LIBVINTF_XML_PULL_PARSER
+
+// --------------- XmlPullParser details
+// Reading XML goes through details::XmlPullDocument instead of a tinyxml2 DOM.
+
+using ParsedNodeType = const details::XmlPullElement;
+using ParsedDocType = details::XmlPullDocument;
+
+// caller is responsible for deleteDocument() call. |xml| must outlive the returned document.
+inline ParsedDocType* createDocument(const std::string& xml) {
+    ParsedDocType* doc = new details::XmlPullDocument();
+    if (doc->parse(xml)) {
+        return doc;
+    }
+    delete doc;
+    return nullptr;
+}
+
+inline void deleteDocument(ParsedDocType* d) {
+    delete d;
+}
+
+inline std::string getText(ParsedNodeType* root) {
+    const std::string_view* text = root->text();
+    return text == nullptr ? "" : std::string(*text);
+}
+
+inline std::string_view nameViewOf(ParsedNodeType* root) {
+    return root->name();
+}
+
+inline ParsedNodeType* getRootChild(ParsedDocType* parent) {
+    return parent->rootElement();
+}
+
+inline ParsedNodeType* getFirstChild(ParsedNodeType* parent) {
+    return parent->firstChildElement();
+}
+
+inline ParsedNodeType* getNextSibling(ParsedNodeType* node) {
+    return node->nextSiblingElement();
+}
+
+inline bool getAttr(ParsedNodeType* root, const std::string& attrName, std::string* s) {
+    const std::string_view* value = root->attribute(attrName);
+    if (value == nullptr) return false;
+    *s = *value;
+    return true;
+}
+
+// --------------- XmlPullParser details end.
+
+#endif  // LIBVINTF_XML_PULL_PARSER
+
 // Helper functions for XmlConverter
 static bool parse(const std::string &attrText, bool *attr) {
     if (attrText == "true" || attrText == "1") {
@@ -161,6 +232,42 @@ static bool parse(const std::string& s, std::optional<uint64_t>* out) {
 
 // ---------------------- XmlNodeConverter definitions
 
+// Child elements of an XML element, grouped by element name in document order. The
+// children are walked once when the index is built, so looking up each kind of child
+// element of a node is proportional to the number of distinct names, not the number of
+// children.
+class ChildIndex {
+   public:
+    explicit ChildIndex(ParsedNodeType* parent) : mParent(parent) {
+        for (ParsedNodeType* child = getFirstChild(parent); child != nullptr;
+             child = getNextSibling(child)) {
+            std::string_view name = nameViewOf(child);
+            auto it = std::find_if(mGroups.begin(), mGroups.end(),
+                                   [name](const auto& group) { return group.first == name; });
+            if (it == mGroups.end()) {
+                mGroups.emplace_back(name, std::vector<ParsedNodeType*>{child});
+            } else {
+                it->second.push_back(child);
+            }
+        }
+    }
+
+    ParsedNodeType* parent() const { return mParent; }
+
+    // All children with the given name.
+    const std::vector<ParsedNodeType*>& get(std::string_view name) const {
+        static const std::vector<ParsedNodeType*> kEmpty;
+        for (const auto& [groupName, children] : mGroups) {
+            if (groupName == name) return children;
+        }
+        return kEmpty;
+    }
+
+   private:
+    ParsedNodeType* mParent;
+    std::vector<std::pair<std::string_view, std::vector<ParsedNodeType*>>> mGroups;
+};
+
 // When serializing an object to an XML document, these parameters don't change until
 // the object is fully serialized.
 // These parameters are also passed to converters of child nodes so they see the same
@@ -181,6 +288,8 @@ struct BuildObjectParam {
     std::string* error;
     Version metaVersion;
     std::string fileName;
+    // Leave out the <kernel>s of a <compatibility-matrix>.
+    bool skipKernels = false;
 };
 
 template <typename Object>
@@ -190,7 +299,8 @@ struct XmlNodeConverter {
 
    protected:
     virtual void mutateNode(const Object& object, NodeType* root, const MutateNodeParam&) const = 0;
-    virtual bool buildObject(Object* object, NodeType* root, const BuildObjectParam&) const = 0;
+    virtual bool buildObject(Object* object, ParsedNodeType* root,
+                             const BuildObjectParam&) const = 0;
 
    public:
     // Methods for other (usually parent) converters
@@ -203,11 +313,14 @@ struct XmlNodeConverter {
         return root;
     }
     // Deserialize XML element |root| into |object|.
-    inline bool operator()(Object* object, NodeType* root, const BuildObjectParam& param) const {
-        if (nameOf(root) != this->elementName()) {
+    inline bool operator()(Object* object, ParsedNodeType* root,
+                           const BuildObjectParam& param) const {
+        if (nameViewOf(root) != this->elementName()) {
             return false;
         }
-        return this->buildObject(object, root, param);
+        bool ret = this->buildObject(object, root, param);
+        mChildren.reset();
+        return ret;
     }
 
     // Public methods for android::vintf::fromXml / android::vintf::toXml.
@@ -220,7 +333,8 @@ struct XmlNodeConverter {
         return s;
     }
     // Deserialize XML string |xml| into |o|.
-    inline bool fromXml(Object* o, const std::string& xml, std::string* error) const {
+    inline bool fromXml(Object* o, const std::string& xml, std::string* error,
+                        bool skipKernels = false) const {
         std::string errorBuffer;
         if (error == nullptr) error = &errorBuffer;
 
@@ -233,7 +347,7 @@ struct XmlNodeConverter {
         // CompatibilityMatrixConverter fills in metaversion and pass down to children.
         // For other nodes, we don't know metaversion of the original XML, so just leave empty
         // for maximum backwards compatibility.
-        BuildObjectParam buildObjectParam{error, {}, {}};
+        BuildObjectParam buildObjectParam{error, {}, {}, skipKernels};
         // Pass down filename for the current XML document.
         if constexpr (std::is_base_of_v<WithFileName, Object>) {
             // Get the last filename in case `o` keeps the list of filenames
@@ -287,12 +401,28 @@ struct XmlNodeConverter {
         }
     }
 
+    // Children of |root| named |name|, in document order. The children of |root| are
+    // indexed on first use, so buildObject() may look up any number of child element names
+    // without rescanning the children of |root|.
+    inline const std::vector<ParsedNodeType*>& getChildren(ParsedNodeType* root,
+                                                           std::string_view name) const {
+        if (!mChildren.has_value() || mChildren->parent() != root) {
+            mChildren.emplace(root);
+        }
+        return mChildren->get(name);
+    }
+
+    inline ParsedNodeType* getChild(ParsedNodeType* root, std::string_view name) const {
+        const auto& children = getChildren(root, name);
+        return children.empty() ? nullptr : children.front();
+    }
+
     // All parse* functions helps buildObject() to deserialize XML to the object. Returns
     // true if deserialization is successful, false if any error, and "error" will be
     // set to error message.
     template <typename T>
-    inline bool parseOptionalAttr(NodeType* root, const std::string& attrName, T&& defaultValue,
-                                  T* attr, std::string* /* error */) const {
+    inline bool parseOptionalAttr(ParsedNodeType* root, const std::string& attrName,
+                                  T&& defaultValue, T* attr, std::string* /* error */) const {
         std::string attrText;
         bool success = getAttr(root, attrName, &attrText) &&
                        ::android::vintf::parse(attrText, attr);
@@ -303,7 +433,7 @@ struct XmlNodeConverter {
     }
 
     template <typename T>
-    inline bool parseAttr(NodeType* root, const std::string& attrName, T* attr,
+    inline bool parseAttr(ParsedNodeType* root, const std::string& attrName, T* attr,
                           std::string* error) const {
         std::string attrText;
         bool ret = getAttr(root, attrName, &attrText) && ::android::vintf::parse(attrText, attr);
@@ -314,7 +444,7 @@ struct XmlNodeConverter {
         return ret;
     }
 
-    inline bool parseAttr(NodeType* root, const std::string& attrName, std::string* attr,
+    inline bool parseAttr(ParsedNodeType* root, const std::string& attrName, std::string* attr,
                           std::string* error) const {
         bool ret = getAttr(root, attrName, attr);
         if (!ret) {
@@ -324,9 +454,9 @@ struct XmlNodeConverter {
         return ret;
     }
 
-    inline bool parseTextElement(NodeType* root, const std::string& elementName, std::string* s,
-                                 std::string* error) const {
-        NodeType *child = getChild(root, elementName);
+    inline bool parseTextElement(ParsedNodeType* root, const std::string& elementName,
+                                 std::string* s, std::string* error) const {
+        ParsedNodeType* child = getChild(root, elementName);
         if (child == nullptr) {
             *error = "Could not find element with name <" + elementName + "> in element <" +
                      this->elementName() + ">";
@@ -337,16 +467,16 @@ struct XmlNodeConverter {
     }
 
     template <typename T>
-    inline bool parseOptionalTextElement(NodeType* root, const std::string& elementName,
+    inline bool parseOptionalTextElement(ParsedNodeType* root, const std::string& elementName,
                                          T&& defaultValue, T* s, std::string* /* error */) const {
-        NodeType* child = getChild(root, elementName);
+        ParsedNodeType* child = getChild(root, elementName);
         *s = child == nullptr ? std::move(defaultValue) : getText(child);
         return true;
     }
 
-    inline bool parseTextElements(NodeType* root, const std::string& elementName,
+    inline bool parseTextElements(ParsedNodeType* root, const std::string& elementName,
                                   std::vector<std::string>* v, std::string* /* error */) const {
-        auto nodes = getChildren(root, elementName);
+        const auto& nodes = getChildren(root, elementName);
         v->resize(nodes.size());
         for (size_t i = 0; i < nodes.size(); ++i) {
             v->at(i) = getText(nodes[i]);
@@ -355,9 +485,9 @@ struct XmlNodeConverter {
     }
 
     template <typename T>
-    inline bool parseChild(NodeType* root, const XmlNodeConverter<T>& conv, T* t,
+    inline bool parseChild(ParsedNodeType* root, const XmlNodeConverter<T>& conv, T* t,
                            const BuildObjectParam& param) const {
-        NodeType *child = getChild(root, conv.elementName());
+        ParsedNodeType* child = getChild(root, conv.elementName());
         if (child == nullptr) {
             *param.error = "Could not find element with name <" + conv.elementName() +
                            "> in element <" + this->elementName() + ">";
@@ -367,9 +497,9 @@ struct XmlNodeConverter {
     }
 
     template <typename T>
-    inline bool parseOptionalChild(NodeType* root, const XmlNodeConverter<T>& conv,
+    inline bool parseOptionalChild(ParsedNodeType* root, const XmlNodeConverter<T>& conv,
                                    T&& defaultValue, T* t, const BuildObjectParam& param) const {
-        NodeType *child = getChild(root, conv.elementName());
+        ParsedNodeType* child = getChild(root, conv.elementName());
         if (child == nullptr) {
             *t = std::move(defaultValue);
             return true;
@@ -378,9 +508,9 @@ struct XmlNodeConverter {
     }
 
     template <typename T>
-    inline bool parseOptionalChild(NodeType* root, const XmlNodeConverter<T>& conv,
+    inline bool parseOptionalChild(ParsedNodeType* root, const XmlNodeConverter<T>& conv,
                                    std::optional<T>* t, const BuildObjectParam& param) const {
-        NodeType* child = getChild(root, conv.elementName());
+        ParsedNodeType* child = getChild(root, conv.elementName());
         if (child == nullptr) {
             *t = std::nullopt;
             return true;
@@ -389,10 +519,10 @@ struct XmlNodeConverter {
         return conv(&**t, child, param);
     }
 
-    template <typename T>
-    inline bool parseChildren(NodeType* root, const XmlNodeConverter<T>& conv, std::vector<T>* v,
-                              const BuildObjectParam& param) const {
-        auto nodes = getChildren(root, conv.elementName());
+    template <typename T, typename Allocator>
+    inline bool parseChildren(ParsedNodeType* root, const XmlNodeConverter<T>& conv,
+                              std::vector<T, Allocator>* v, const BuildObjectParam& param) const {
+        const auto& nodes = getChildren(root, conv.elementName());
         v->resize(nodes.size());
         for (size_t i = 0; i < nodes.size(); ++i) {
             if (!conv(&v->at(i), nodes[i], param)) {
@@ -406,14 +536,14 @@ struct XmlNodeConverter {
 
     template <typename Container, typename T = typename Container::value_type,
               typename = typename Container::key_compare>
-    inline bool parseChildren(NodeType* root, const XmlNodeConverter<T>& conv, Container* s,
+    inline bool parseChildren(ParsedNodeType* root, const XmlNodeConverter<T>& conv, Container* s,
                               const BuildObjectParam& param) const {
         std::vector<T> vec;
         if (!parseChildren(root, conv, &vec, param)) {
             return false;
         }
         s->clear();
-        s->insert(vec.begin(), vec.end());
+        s->insert(std::make_move_iterator(vec.begin()), std::make_move_iterator(vec.end()));
         if (s->size() != vec.size()) {
             *param.error = "Duplicated elements <" + conv.elementName() + "> in element <" +
                            this->elementName() + ">";
@@ -424,24 +554,24 @@ struct XmlNodeConverter {
     }
 
     template <typename K, typename V>
-    inline bool parseChildren(NodeType* root, const XmlNodeConverter<std::pair<K, V>>& conv,
+    inline bool parseChildren(ParsedNodeType* root, const XmlNodeConverter<std::pair<K, V>>& conv,
                               std::map<K, V>* s, const BuildObjectParam& param) const {
         return parseChildren<std::map<K, V>, std::pair<K, V>>(root, conv, s, param);
     }
 
-    inline bool parseText(NodeType* node, std::string* s, std::string* /* error */) const {
+    inline bool parseText(ParsedNodeType* node, std::string* s, std::string* /* error */) const {
         *s = getText(node);
         return true;
     }
 
     template <typename T>
-    inline bool parseText(NodeType* node, T* s, std::string* error) const {
+    inline bool parseText(ParsedNodeType* node, T* s, std::string* error) const {
         bool (*parser)(const std::string&, T*) = ::android::vintf::parse;
         return parseText(node, s, {parser}, error);
     }
 
     template <typename T>
-    inline bool parseText(NodeType* node, T* s,
+    inline bool parseText(ParsedNodeType* node, T* s,
                           const std::function<bool(const std::string&, T*)>& parse,
                           std::string* error) const {
         std::string text = getText(node);
@@ -451,6 +581,11 @@ struct XmlNodeConverter {
         }
         return ret;
     }
+
+   private:
+    // Index of the children of the element being deserialized. Converters are created
+    // per use, so this is never shared between threads.
+    mutable std::optional<ChildIndex> mChildren;
 };
 
 template<typename Object>
@@ -459,7 +594,8 @@ struct XmlTextConverter : public XmlNodeConverter<Object> {
                     const MutateNodeParam& param) const override {
         appendText(root, ::android::vintf::to_string(object), param.d);
     }
-    bool buildObject(Object* object, NodeType* root, const BuildObjectParam& param) const override {
+    bool buildObject(Object* object, ParsedNodeType* root,
+                     const BuildObjectParam& param) const override {
         return this->parseText(root, object, param.error);
     }
 };
@@ -471,7 +607,8 @@ struct XmlPairConverter : public XmlNodeConverter<Pair> {
         appendChild(root, FirstConverter{}(object.first, param));
         appendChild(root, SecondConverter{}(object.second, param));
     }
-    bool buildObject(Pair* object, NodeType* root, const BuildObjectParam& param) const override {
+    bool buildObject(Pair* object, ParsedNodeType* root,
+                     const BuildObjectParam& param) const override {
         return this->parseChild(root, FirstConverter{}, &object->first, param) &&
                this->parseChild(root, SecondConverter{}, &object->second, param);
     }
@@ -502,7 +639,7 @@ struct AidlVersionConverter : public XmlNodeConverter<Version> {
                     const MutateNodeParam& param) const override {
         appendText(root, aidlVersionToString(object), param.d);
     }
-    bool buildObject(Version* object, NodeType* root,
+    bool buildObject(Version* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseText(root, object, {parseAidlVersion}, param.error);
     }
@@ -516,7 +653,7 @@ struct AidlVersionRangeConverter : public XmlNodeConverter<VersionRange> {
                     const MutateNodeParam& param) const override {
         appendText(root, aidlVersionRangeToString(object), param.d);
     }
-    bool buildObject(VersionRange* object, NodeType* root,
+    bool buildObject(VersionRange* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseText(root, object, {parseAidlVersionRange}, param.error);
     }
@@ -537,7 +674,7 @@ struct TransportArchConverter : public XmlNodeConverter<TransportArch> {
         }
         appendText(root, ::android::vintf::to_string(object.transport), param.d);
     }
-    bool buildObject(TransportArch* object, NodeType* root,
+    bool buildObject(TransportArch* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         if (!parseOptionalAttr(root, "arch", Arch::ARCH_EMPTY, &object->arch, param.error) ||
             !parseOptionalAttr(root, "ip", {}, &object->ip, param.error) ||
@@ -559,7 +696,7 @@ struct KernelConfigTypedValueConverter : public XmlNodeConverter<KernelConfigTyp
         appendAttr(root, "type", object.mType);
         appendText(root, ::android::vintf::to_string(object), param.d);
     }
-    bool buildObject(KernelConfigTypedValue* object, NodeType* root,
+    bool buildObject(KernelConfigTypedValue* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         std::string stringValue;
         if (!parseAttr(root, "type", &object->mType, param.error) ||
@@ -593,7 +730,7 @@ struct HalInterfaceConverter : public XmlNodeConverter<HalInterface> {
         appendTextElements(root, "instance", object.mInstances, param.d);
         appendTextElements(root, "regex-instance", object.mRegexes, param.d);
     }
-    bool buildObject(HalInterface* object, NodeType* root,
+    bool buildObject(HalInterface* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         std::vector<std::string> instances;
         std::vector<std::string> regexes;
@@ -651,7 +788,7 @@ struct MatrixHalConverter : public XmlNodeConverter<MatrixHal> {
         }
         appendChildren(root, HalInterfaceConverter{}, iterateValues(object.interfaces), param);
     }
-    bool buildObject(MatrixHal* object, NodeType* root,
+    bool buildObject(MatrixHal* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         std::vector<HalInterface> interfaces;
         if (!parseOptionalAttr(root, "format", HalFormat::HIDL, &object->format, param.error) ||
@@ -738,7 +875,7 @@ struct MatrixKernelConditionsConverter : public XmlNodeConverter<std::vector<Ker
                     const MutateNodeParam& param) const override {
         appendChildren(root, MatrixKernelConfigConverter{}, object, param);
     }
-    bool buildObject(std::vector<KernelConfig>* object, NodeType* root,
+    bool buildObject(std::vector<KernelConfig>* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseChildren(root, MatrixKernelConfigConverter{}, object, param);
     }
@@ -765,7 +902,7 @@ struct MatrixKernelConverter : public XmlNodeConverter<MatrixKernel> {
             appendChildren(root, MatrixKernelConfigConverter{}, object.mConfigs, param);
         }
     }
-    bool buildObject(MatrixKernel* object, NodeType* root,
+    bool buildObject(MatrixKernel* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         Level sourceMatrixLevel = Level::UNSPECIFIED;
         if (!parseAttr(root, "version", &object->mMinLts, param.error) ||
@@ -835,7 +972,7 @@ struct ManifestHalConverter : public XmlNodeConverter<ManifestHal> {
             appendAttr(root, "min-level", object.getMinLevel());
         }
     }
-    bool buildObject(ManifestHal* object, NodeType* root,
+    bool buildObject(ManifestHal* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         std::vector<HalInterface> interfaces;
         if (!parseOptionalAttr(root, "format", HalFormat::HIDL, &object->format, param.error) ||
@@ -1106,7 +1243,7 @@ struct SepolicyConverter : public XmlNodeConverter<Sepolicy> {
         appendChild(root, KernelSepolicyVersionConverter{}(object.kernelSepolicyVersion(), param));
         appendChildren(root, SepolicyVersionRangeConverter{}, object.sepolicyVersions(), param);
     }
-    bool buildObject(Sepolicy* object, NodeType* root,
+    bool buildObject(Sepolicy* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         if (!parseChild(root, KernelSepolicyVersionConverter{}, &object->mKernelSepolicyVersion,
                         param) ||
@@ -1137,7 +1274,8 @@ struct [[deprecated]] VndkConverter : public XmlNodeConverter<Vndk> {
         appendChild(root, VndkVersionRangeConverter{}(object.mVersionRange, param));
         appendChildren(root, VndkLibraryConverter{}, object.mLibraries, param);
     }
-    bool buildObject(Vndk* object, NodeType* root, const BuildObjectParam& param) const override {
+    bool buildObject(Vndk* object, ParsedNodeType* root,
+                     const BuildObjectParam& param) const override {
         if (!parseChild(root, VndkVersionRangeConverter{}, &object->mVersionRange, param) ||
             !parseChildren(root, VndkLibraryConverter{}, &object->mLibraries, param)) {
             return false;
@@ -1153,7 +1291,7 @@ struct VendorNdkConverter : public XmlNodeConverter<VendorNdk> {
         appendChild(root, VndkVersionConverter{}(object.mVersion, param));
         appendChildren(root, VndkLibraryConverter{}, object.mLibraries, param);
     }
-    bool buildObject(VendorNdk* object, NodeType* root,
+    bool buildObject(VendorNdk* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         if (!parseChild(root, VndkVersionConverter{}, &object->mVersion, param) ||
             !parseChildren(root, VndkLibraryConverter{}, &object->mLibraries, param)) {
@@ -1173,7 +1311,7 @@ struct SystemSdkConverter : public XmlNodeConverter<SystemSdk> {
                     const MutateNodeParam& param) const override {
         appendChildren(root, SystemSdkVersionConverter{}, object.versions(), param);
     }
-    bool buildObject(SystemSdk* object, NodeType* root,
+    bool buildObject(SystemSdk* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseChildren(root, SystemSdkVersionConverter{}, &object->mVersions, param);
     }
@@ -1185,7 +1323,7 @@ struct HalManifestSepolicyConverter : public XmlNodeConverter<SepolicyVersion> {
                     const MutateNodeParam& param) const override {
         appendChild(root, SepolicyVersionConverter{}(object, param));
     }
-    bool buildObject(SepolicyVersion* object, NodeType* root,
+    bool buildObject(SepolicyVersion* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseChild(root, SepolicyVersionConverter{}, object, param);
     }
@@ -1201,7 +1339,7 @@ struct ManifestXmlFileConverter : public XmlNodeConverter<ManifestXmlFile> {
             appendTextElement(root, "path", object.overriddenPath(), param.d);
         }
     }
-    bool buildObject(ManifestXmlFile* object, NodeType* root,
+    bool buildObject(ManifestXmlFile* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         if (!parseTextElement(root, "name", &object->mName, param.error) ||
             !parseChild(root, VersionConverter{}, &object->mVersion, param) ||
@@ -1240,7 +1378,7 @@ struct KernelInfoConverter : public XmlNodeConverter<KernelInfo> {
             appendChildren(root, StringKernelConfigConverter{}, object.configs(), param);
         }
     }
-    bool buildObject(KernelInfo* object, NodeType* root,
+    bool buildObject(KernelInfo* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseOptionalAttr(root, "version", {}, &object->mVersion, param.error) &&
                parseOptionalAttr(root, "target-level", Level::UNSPECIFIED, &object->mLevel,
@@ -1301,7 +1439,7 @@ struct HalManifestConverter : public XmlNodeConverter<HalManifest> {
             appendChildren(root, ManifestXmlFileConverter{}, object.getXmlFiles(), param);
         }
     }
-    bool buildObject(HalManifest* object, NodeType* root,
+    bool buildObject(HalManifest* object, ParsedNodeType* root,
                      const BuildObjectParam& constParam) const override {
         BuildObjectParam param = constParam;
         if (!parseAttr(root, "version", &param.metaVersion, param.error)) return false;
@@ -1316,7 +1454,8 @@ struct HalManifestConverter : public XmlNodeConverter<HalManifest> {
             return false;
         }
 
-        std::vector<ManifestHal> hals;
+        // Build the HALs in the memory resource of |object| so that add() moves them in.
+        std::pmr::vector<ManifestHal> hals(object->memoryResource());
         if (!parseChildren(root, ManifestHalConverter{}, &hals, param)) {
             return false;
         }
@@ -1409,7 +1548,7 @@ struct AvbConverter : public XmlNodeConverter<Version> {
                     const MutateNodeParam& param) const override {
         appendChild(root, AvbVersionConverter{}(object, param));
     }
-    bool buildObject(Version* object, NodeType* root,
+    bool buildObject(Version* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         return parseChild(root, AvbVersionConverter{}, object, param);
     }
@@ -1427,7 +1566,7 @@ struct MatrixXmlFileConverter : public XmlNodeConverter<MatrixXmlFile> {
             appendTextElement(root, "path", object.overriddenPath(), param.d);
         }
     }
-    bool buildObject(MatrixXmlFile* object, NodeType* root,
+    bool buildObject(MatrixXmlFile* object, ParsedNodeType* root,
                      const BuildObjectParam& param) const override {
         if (!parseTextElement(root, "name", &object->mName, param.error) ||
             !parseAttr(root, "format", &object->mFormat, param.error) ||
@@ -1496,7 +1635,7 @@ struct CompatibilityMatrixConverter : public XmlNodeConverter<CompatibilityMatri
             appendChildren(root, MatrixXmlFileConverter{}, object.getXmlFiles(), param);
         }
     }
-    bool buildObject(CompatibilityMatrix* object, NodeType* root,
+    bool buildObject(CompatibilityMatrix* object, ParsedNodeType* root,
                      const BuildObjectParam& constParam) const override {
         BuildObjectParam param = constParam;
         if (!parseAttr(root, "version", &param.metaVersion, param.error)) return false;
@@ -1507,7 +1646,7 @@ struct CompatibilityMatrixConverter : public XmlNodeConverter<CompatibilityMatri
             return false;
         }
 
-        std::vector<MatrixHal> hals;
+        std::pmr::vector<MatrixHal> hals(object->memoryResource());
         if (!parseAttr(root, "type", &object->mType, param.error) ||
             !parseChildren(root, MatrixHalConverter{}, &hals, param)) {
             return false;
@@ -1516,28 +1655,20 @@ struct CompatibilityMatrixConverter : public XmlNodeConverter<CompatibilityMatri
         if (object->mType == SchemaType::FRAMEWORK) {
             // <avb> and <sepolicy> can be missing because it can be determined at build time, not
             // hard-coded in the XML file.
-            if (!parseChildren(root, MatrixKernelConverter{}, &object->framework.mKernels, param) ||
-                !parseOptionalChild(root, SepolicyConverter{}, {}, &object->framework.mSepolicy,
+            object->framework.mKernelIndex.reset();
+            if (!param.skipKernels &&
+                (!parseChildren(root, MatrixKernelConverter{}, &object->framework.mKernels,
+                                param) ||
+                 !details::checkKernelConditions(object->framework.mKernels, param.error))) {
+                return false;
+            }
+            if (!parseOptionalChild(root, SepolicyConverter{}, {}, &object->framework.mSepolicy,
                                     param) ||
                 !parseOptionalChild(root, AvbConverter{}, {}, &object->framework.mAvbMetaVersion,
                                     param)) {
                 return false;
             }
 
-            std::set<Version> seenKernelVersions;
-            for (const auto& kernel : object->framework.mKernels) {
-                Version minLts(kernel.minLts().version, kernel.minLts().majorRev);
-                if (seenKernelVersions.find(minLts) != seenKernelVersions.end()) {
-                    continue;
-                }
-                if (!kernel.conditions().empty()) {
-                    *param.error = "First <kernel> for version " + to_string(minLts) +
-                                   " must have empty <conditions> for backwards compatibility.";
-                    return false;
-                }
-                seenKernelVersions.insert(minLts);
-            }
-
             if (!parseOptionalAttr(root, "level", Level::UNSPECIFIED, &object->mLevel,
                                    param.error)) {
                 return false;
@@ -1616,5 +1747,9 @@ CREATE_CONVERT_FN(ManifestHal)
 
 #undef CREATE_CONVERT_FN
 
+bool fromXmlWithoutKernels(CompatibilityMatrix* o, const std::string& xml, std::string* error) {
+    return CompatibilityMatrixConverter{}.fromXml(o, xml, error, true /* skipKernels */);
+}
+
 } // namespace vintf
 } // namespace android
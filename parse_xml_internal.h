@@ -20,4 +20,8 @@
 namespace android::vintf {
 std::string toXml(const KernelInfo& o, SerializeFlags::Type flags = SerializeFlags::EVERYTHING);
 [[nodiscard]] bool fromXml(KernelInfo* o, const std::string& xml, std::string* error = nullptr);
+// Like fromXml, but <kernel>s of a framework compatibility matrix are left out, to be loaded
+// from its KernelRequirementTable instead.
+[[nodiscard]] bool fromXmlWithoutKernels(CompatibilityMatrix* o, const std::string& xml,
+                                         std::string* error = nullptr);
 }  // namespace android::vintf
@@ -23,6 +23,7 @@
 #include <aidl/metadata.h>
 #include <vintf/AssembleVintf.h>
 #include <vintf/parse_string.h>
+#include "KernelRequirementTable.h"
 #include "constants-private.h"
 #include "test_constants.h"
 
@@ -711,6 +712,187 @@ TEST_F(AssembleVintfTest, ManifestLevelConflictCorrectLocation) {
     EXPECT_IN("File 'manifest_2.xml' has level 2", getError());
 }
 
+TEST_F(AssembleVintfTest, FirstInvalidFileIsReported) {
+    for (size_t i = 0; i < 16; ++i) {
+        std::string name = "manifest_" + std::to_string(i) + ".xml";
+        if (i == 5 || i == 9) {
+            addInput(name, "<manifest " + kMetaVersionStr + R"( type="device">)");
+        } else if (i == 12) {
+            addInput(name, "<manifest " + kMetaVersionStr + R"( type="framework" />)");
+        } else {
+            addInput(name, "<manifest " + kMetaVersionStr + R"( type="device" />)");
+        }
+    }
+    EXPECT_FALSE(getInstance()->assemble());
+    EXPECT_IN("File \"manifest_5.xml\" is not a valid device manifest", getError());
+    EXPECT_FALSE(In("manifest_9.xml", getError())) << getError();
+    EXPECT_FALSE(In("manifest_12.xml", getError())) << getError();
+}
+
+TEST_F(AssembleVintfTest, SharedCache) {
+    auto cache = AssembleVintfCache::newInstance();
+    auto assembleWithCache = [&](const std::string& manifest) {
+        auto instance = AssembleVintf::newInstance();
+        auto out = makeStream("");
+        auto& outRef = *out;
+        instance->setOutputStream(std::move(out));
+        instance->setErrorStream(makeStream(""));
+        instance->setFakeEnv("PRODUCT_ENFORCE_VINTF_MANIFEST", "true");
+        instance->setCache(cache);
+        instance->addInputStream("manifest.xml", makeStream(manifest));
+        EXPECT_TRUE(instance->assemble());
+        return outRef.str();
+    };
+    std::string manifest1 = "<manifest " + kMetaVersionStr + R"( type="device" />)";
+    std::string manifest2 =
+        "<manifest " + kMetaVersionStr + R"( type="device" target-level="1" />)";
+
+    addInput("manifest.xml", manifest1);
+    EXPECT_TRUE(getInstance()->assemble());
+    EXPECT_EQ(getOutput(), assembleWithCache(manifest1));
+    EXPECT_EQ(0u, cache->hits());
+    EXPECT_EQ(getOutput(), assembleWithCache(manifest1));
+    EXPECT_EQ(1u, cache->hits());
+
+    // Same file name, new content.
+    EXPECT_IN(R"(target-level="1")", assembleWithCache(manifest2));
+    EXPECT_EQ(1u, cache->hits());
+}
+
+TEST_F(AssembleVintfTest, Fingerprint) {
+    std::string manifest = "<manifest " + kMetaVersionStr + R"( type="device" />)";
+    std::string kernelConfig = "CONFIG_FOO=y\n";
+    setFakeEnvs({{"BOARD_SEPOLICY_VERS", "202404"}, {"IGNORE_TARGET_FCM_VERSION", "true"}});
+    addInput("manifest.xml", manifest);
+    getInstance()->addKernelConfigInputStream({3, 18, 10}, "android-base.config",
+                                              makeStream(kernelConfig));
+    ASSERT_TRUE(getInstance()->assemble());
+    EXPECT_FALSE(getInstance()->skipped());
+    std::string output = getOutput();
+    std::string fingerprint = getInstance()->fingerprint();
+    EXPECT_IN("env:BOARD_SEPOLICY_VERS", fingerprint);
+
+    // Run again with the given changes. Return whether assemble() was skipped.
+    auto rerun = [&](const std::map<std::string, std::string>& envs,
+                     const std::string& newKernelConfig, const std::string& previousOutput) {
+        auto instance = AssembleVintf::newInstance();
+        auto out = makeStream("");
+        auto& outRef = *out;
+        instance->setOutputStream(std::move(out));
+        instance->setErrorStream(makeStream(""));
+        instance->setFakeEnv("PRODUCT_ENFORCE_VINTF_MANIFEST", "true");
+        instance->setFakeEnv("IGNORE_TARGET_FCM_VERSION", "true");
+        for (const auto& [key, value] : envs) {
+            instance->setFakeEnv(key, value);
+        }
+        instance->addInputStream("manifest.xml", makeStream(manifest));
+        instance->addKernelConfigInputStream({3, 18, 10}, "android-base.config",
+                                             makeStream(newKernelConfig));
+        instance->setPreviousFingerprint(fingerprint, previousOutput, "" /* kernelTable */);
+        EXPECT_TRUE(instance->assemble());
+        if (instance->skipped()) {
+            EXPECT_EQ("", outRef.str());
+            EXPECT_EQ(fingerprint, instance->fingerprint());
+        } else {
+            EXPECT_NE("", outRef.str());
+        }
+        return instance->skipped();
+    };
+
+    EXPECT_TRUE(rerun({{"BOARD_SEPOLICY_VERS", "202404"}}, kernelConfig, output));
+    // An environment variable that is not read does not matter.
+    EXPECT_TRUE(rerun({{"BOARD_SEPOLICY_VERS", "202404"}, {"UNUSED", "1"}}, kernelConfig, output));
+    EXPECT_FALSE(rerun({{"BOARD_SEPOLICY_VERS", "202504"}}, kernelConfig, output));
+    EXPECT_FALSE(rerun({{"BOARD_SEPOLICY_VERS", "202404"}}, "CONFIG_FOO=n\n", output));
+    EXPECT_FALSE(rerun({{"BOARD_SEPOLICY_VERS", "202404"}}, kernelConfig, output + " "));
+}
+
+TEST_F(AssembleVintfTest, KernelTable) {
+    addInput("compatibility_matrix.empty.xml",
+             "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\" />");
+    setFakeEnvs({
+        {"POLICYVERS", "30"},
+        {"PLATFORM_SEPOLICY_VERSION", "202404"},
+        {"FRAMEWORK_VBMETA_VERSION", "1.0"},
+    });
+    getInstance()->addKernelConfigInputStream({3, 18, 0}, "android-base.config",
+                                              makeStream("CONFIG_FOO=y\n"));
+    getInstance()->addKernelConfigInputStream({3, 18, 0}, "android-base-arm64.config",
+                                              makeStream("CONFIG_BAR=y\n"));
+    getInstance()->addKernelConfigInputStream({4, 4, 0}, "android-base.config",
+                                              makeStream("# CONFIG_FOO is not set\n"));
+    auto s = makeStream("");
+    auto* table = s.get();
+    getInstance()->setKernelTableOutputStream(std::move(s));
+    ASSERT_TRUE(getInstance()->assemble()) << getError();
+
+    ASSERT_TRUE(details::KernelRequirementTable::matches(table->str(), getOutput()));
+    std::vector<MatrixKernel> kernels;
+    std::string error;
+    ASSERT_TRUE(details::KernelRequirementTable::read(table->str(), &kernels, &error)) << error;
+    ASSERT_EQ(3u, kernels.size());
+    EXPECT_EQ(KernelVersion(3, 18, 0), kernels[0].minLts());
+    EXPECT_TRUE(kernels[0].conditions().empty());
+    EXPECT_EQ(KernelVersion(3, 18, 0), kernels[1].minLts());
+    ASSERT_EQ(1u, kernels[1].conditions().size());
+    EXPECT_EQ("CONFIG_ARM64", kernels[1].conditions()[0].first);
+    ASSERT_EQ(1u, kernels[1].configs().size());
+    EXPECT_EQ("CONFIG_BAR", kernels[1].configs()[0].first);
+    EXPECT_EQ(KernelVersion(4, 4, 0), kernels[2].minLts());
+}
+
+// The fingerprint covers the kernel table, so a modified table is written again.
+TEST_F(AssembleVintfTest, FingerprintKernelTable) {
+    std::string matrix = "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\" />";
+    // Assemble the matrix with a kernel table. Return whether assemble() was skipped.
+    auto run = [&](const std::optional<std::pair<std::string, std::string>>& previousRun,
+                   std::string* fingerprint, std::string* output, std::string* table) {
+        auto instance = AssembleVintf::newInstance();
+        auto out = makeStream("");
+        auto& outRef = *out;
+        auto tableOut = makeStream("");
+        auto& tableRef = *tableOut;
+        instance->setOutputStream(std::move(out));
+        instance->setErrorStream(makeStream(""));
+        instance->setKernelTableOutputStream(std::move(tableOut));
+        instance->setFakeEnv("POLICYVERS", "30");
+        instance->setFakeEnv("PLATFORM_SEPOLICY_VERSION", "202404");
+        instance->setFakeEnv("FRAMEWORK_VBMETA_VERSION", "1.0");
+        instance->addInputStream("compatibility_matrix.empty.xml", makeStream(matrix));
+        instance->addKernelConfigInputStream({4, 4, 0}, "android-base.config",
+                                             makeStream("CONFIG_FOO=y\n"));
+        if (previousRun.has_value()) {
+            instance->setPreviousFingerprint(*fingerprint, previousRun->first,
+                                             previousRun->second);
+        }
+        EXPECT_TRUE(instance->assemble());
+        *fingerprint = instance->fingerprint();
+        *output = outRef.str();
+        *table = tableRef.str();
+        return instance->skipped();
+    };
+
+    std::string fingerprint, output, table;
+    ASSERT_FALSE(run(std::nullopt, &fingerprint, &output, &table));
+    EXPECT_IN("output-kernel-table ", fingerprint);
+    std::string previousFingerprint = fingerprint;
+    std::string unused;
+
+    EXPECT_TRUE(run(std::make_pair(output, table), &fingerprint, &unused, &unused));
+    EXPECT_EQ(previousFingerprint, fingerprint);
+    EXPECT_FALSE(run(std::make_pair(output, table + " "), &fingerprint, &unused, &unused));
+    fingerprint = previousFingerprint;
+    EXPECT_FALSE(run(std::make_pair(output, ""), &fingerprint, &unused, &table));
+    EXPECT_NE("", table);
+}
+
+TEST_F(AssembleVintfTest, KernelTableRequiresFrameworkMatrix) {
+    setFakeEnvs({{"BOARD_SEPOLICY_VERS", "202404"}, {"IGNORE_TARGET_FCM_VERSION", "true"}});
+    addInput("manifest.xml", "<manifest " + kMetaVersionStr + R"( type="device" />)");
+    getInstance()->setKernelTableOutputStream(makeStream(""));
+    EXPECT_FALSE(getInstance()->assemble());
+}
+
 TEST_F(AssembleVintfTest, PassMultipleManifestEntrySameModule) {
     setFakeEnvs({{"VINTF_IGNORE_TARGET_FCM_VERSION", "true"}});
     std::vector<AidlInterfaceMetadata> aidl{
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/strings.h>
+#include <vintf/FileSystem.h>
+
+namespace android {
+namespace vintf {
+
+// A FileSystem backed by a map from paths to file content, for tests and benchmarks that use
+// VintfObject from many threads. Each call can be delayed to simulate slow storage, and the
+// modified time of files can advance with wall time to make VintfObject reload the objects
+// that depend on it, like HAL manifests with APEX data.
+//
+// Add files before the file system is in use. The other functions are thread-safe.
+class FakeFileSystem : public FileSystem {
+   public:
+    void add(const std::string& path, std::string content) { mFiles[path] = std::move(content); }
+
+    // Delay each call by |latency|.
+    void setLatency(std::chrono::microseconds latency) { mLatency = latency; }
+
+    // If not zero, the modified time of all files changes every |interval|.
+    void setModifiedTimeInterval(std::chrono::microseconds interval) {
+        mModifiedTimeInterval = interval;
+    }
+
+    // Number of files fetched so far.
+    size_t fetchCount() const { return mFetchCount; }
+
+    status_t fetch(const std::string& path, std::string* fetched,
+                   std::string* /* error */) const override {
+        delay();
+        auto it = mFiles.find(path);
+        if (it == mFiles.end()) return NAME_NOT_FOUND;
+        ++mFetchCount;
+        *fetched = it->second;
+        return OK;
+    }
+
+    status_t listFiles(const std::string& path, std::vector<std::string>* out,
+                       std::string* /* error */) const override {
+        delay();
+        bool found = false;
+        for (auto it = mFiles.lower_bound(path); it != mFiles.end(); ++it) {
+            if (!android::base::StartsWith(it->first, path)) break;
+            std::string name = it->first.substr(path.size());
+            if (name.find('/') != std::string::npos) continue;
+            out->push_back(std::move(name));
+            found = true;
+        }
+        return found ? OK : NAME_NOT_FOUND;
+    }
+
+    status_t modifiedTime(const std::string& path, timespec* mtime,
+                          std::string* /* error */) const override {
+        delay();
+        if (mFiles.find(path) == mFiles.end()) return NAME_NOT_FOUND;
+        *mtime = {};
+        std::chrono::microseconds interval = mModifiedTimeInterval;
+        if (interval.count() != 0) {
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            mtime->tv_sec = now / interval;
+        }
+        return OK;
+    }
+
+   private:
+    void delay() const {
+        std::chrono::microseconds latency = mLatency;
+        if (latency.count() != 0) std::this_thread::sleep_for(latency);
+    }
+
+    std::map<std::string, std::string> mFiles;
+    std::atomic<std::chrono::microseconds> mLatency{};
+    std::atomic<std::chrono::microseconds> mModifiedTimeInterval{};
+    mutable std::atomic<size_t> mFetchCount{0};
+};
+
+}  // namespace vintf
+}  // namespace android
@@ -0,0 +1,892 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <hidl/metadata.h>
+#include <vintf/CompatibilityMatrix.h>
+#include <vintf/FQName.h>
+#include <vintf/HalManifest.h>
+#include <vintf/KernelConfigParser.h>
+#include <vintf/ManifestInstanceIndex.h>
+#include <vintf/MatrixInstance.h>
+#include <vintf/ObjectFactory.h>
+#include <vintf/RuntimeInfo.h>
+#include <vintf/VintfObject.h>
+#include <vintf/parse_xml.h>
+
+#include "FakeFileSystem.h"
+#include "PackedManifestInstances.h"
+#include "constants-private.h"
+#include "test_constants.h"
+
+using namespace std::string_literals;
+
+// Benchmarks for libvintf hot paths over synthetic, deterministic inputs. The inputs are
+// scaled by the number of HALs (N), instances per HAL (M), matrix fragments (K) and the
+// fraction of HALs that use regex-instance, so that regressions show up as changes in the
+// growth rate as well as in absolute time.
+
+namespace android::vintf {
+
+// Access to private members of libvintf classes.
+struct LibVintfBenchmark {
+    static std::unique_ptr<CompatibilityMatrix> combine(Level deviceLevel,
+                                                        std::vector<CompatibilityMatrix>* matrices,
+                                                        std::string* error) {
+        return CompatibilityMatrix::combine(deviceLevel, Level::UNSPECIFIED, matrices, error);
+    }
+    static std::vector<const MatrixKernel*> matchKernel(const KernelInfo& kernel,
+                                                        const CompatibilityMatrix& matrix) {
+        return kernel.getMatchedKernelRequirements(matrix.kernelRequirementIndex(),
+                                                   kernel.level());
+    }
+    static const std::vector<MatrixKernel>& kernels(const CompatibilityMatrix& matrix) {
+        return matrix.framework.mKernels;
+    }
+    static KernelInfo makeKernelInfo(const KernelVersion& version, Level level,
+                                     std::map<std::string, std::string> configs) {
+        KernelInfo kernel;
+        kernel.mVersion = version;
+        kernel.mLevel = level;
+        kernel.mConfigs = std::move(configs);
+        return kernel;
+    }
+};
+
+namespace {
+
+using details::FQName;
+using details::kApexInfoFile;
+using details::kBootstrapApexInfoFile;
+using details::kSystemManifest;
+using details::kSystemVintfDir;
+using details::kVendorManifest;
+using details::kVendorMatrix;
+
+constexpr size_t kNumInstances = 4;
+
+// Every |kRegexInterval|-th HAL in a matrix also lists a regex-instance.
+constexpr size_t kRegexInterval = 2;
+
+// A device manifest with |numHals| AIDL HALs and |numHals| HIDL HALs, each with
+// |numInstances| instances.
+std::string makeManifestXml(size_t numHals, size_t numInstances) {
+    std::string xml = "<manifest " + kMetaVersionStr + " type=\"device\" target-level=\"5\">\n";
+    for (size_t i = 0; i < numHals; ++i) {
+        std::string index = std::to_string(i);
+        xml += "    <hal format=\"aidl\">\n"
+               "        <name>android.hardware.aidl" + index + "</name>\n"
+               "        <version>2</version>\n";
+        for (size_t j = 0; j < numInstances; ++j) {
+            xml += "        <fqname>IFoo/instance" + std::to_string(j) + "</fqname>\n";
+        }
+        xml += "    </hal>\n"
+               "    <hal format=\"hidl\">\n"
+               "        <name>android.hardware.hidl" + index + "</name>\n"
+               "        <transport>hwbinder</transport>\n";
+        for (size_t j = 0; j < numInstances; ++j) {
+            xml += "        <fqname>@1.0::IBar/instance" + std::to_string(j) + "</fqname>\n";
+        }
+        xml += "    </hal>\n";
+    }
+    xml += "    <sepolicy>\n"
+           "        <version>30.0</version>\n"
+           "    </sepolicy>\n"
+           "</manifest>\n";
+    return xml;
+}
+
+// A framework compatibility matrix at |level| that requires the HALs of makeManifestXml().
+// If |regexInterval| is not 0, every |regexInterval|-th HAL also lists a regex-instance.
+std::string makeMatrixXml(size_t numHals, size_t numInstances,
+                          size_t regexInterval = kRegexInterval, Level level = Level::R) {
+    std::string xml = "<compatibility-matrix " + kMetaVersionStr +
+                      " type=\"framework\" level=\"" + to_string(level) + "\">\n";
+    for (size_t i = 0; i < numHals; ++i) {
+        std::string index = std::to_string(i);
+        std::string regex = regexInterval != 0 && i % regexInterval == 0
+                                ? "            <regex-instance>instance[0-9]+</regex-instance>\n"
+                                : "";
+        xml += "    <hal format=\"aidl\" optional=\"false\">\n"
+               "        <name>android.hardware.aidl" + index + "</name>\n"
+               "        <version>1-2</version>\n"
+               "        <interface>\n"
+               "            <name>IFoo</name>\n";
+        for (size_t j = 0; j < numInstances; ++j) {
+            xml += "            <instance>instance" + std::to_string(j) + "</instance>\n";
+        }
+        xml += regex +
+               "        </interface>\n"
+               "    </hal>\n"
+               "    <hal format=\"hidl\" optional=\"false\">\n"
+               "        <name>android.hardware.hidl" + index + "</name>\n"
+               "        <version>1.0</version>\n"
+               "        <interface>\n"
+               "            <name>IBar</name>\n";
+        for (size_t j = 0; j < numInstances; ++j) {
+            xml += "            <instance>instance" + std::to_string(j) + "</instance>\n";
+        }
+        xml += regex +
+               "        </interface>\n"
+               "    </hal>\n";
+    }
+    xml += "    <sepolicy>\n"
+           "        <kernel-sepolicy-version>30</kernel-sepolicy-version>\n"
+           "        <sepolicy-version>30.0</sepolicy-version>\n"
+           "    </sepolicy>\n"
+           "</compatibility-matrix>\n";
+    return xml;
+}
+
+// A device compatibility matrix that requires the framework HALs of makeFrameworkManifestXml().
+std::string makeDeviceMatrixXml() {
+    return "<compatibility-matrix " + kMetaVersionStr + " type=\"device\">\n"
+           "    <hal format=\"aidl\" optional=\"true\">\n"
+           "        <name>android.frameworks.aidl0</name>\n"
+           "        <interface>\n"
+           "            <name>IFramework</name>\n"
+           "            <instance>default</instance>\n"
+           "        </interface>\n"
+           "    </hal>\n"
+           "</compatibility-matrix>\n";
+}
+
+std::string makeFrameworkManifestXml() {
+    return "<manifest " + kMetaVersionStr + " type=\"framework\">\n"
+           "    <hal format=\"aidl\">\n"
+           "        <name>android.frameworks.aidl0</name>\n"
+           "        <fqname>IFramework/default</fqname>\n"
+           "    </hal>\n"
+           "</manifest>\n";
+}
+
+// A kernel config in the format of /proc/config.gz with |numConfigs| entries, mixing the
+// value types found in a real defconfig.
+std::string makeKernelConfig(size_t numConfigs) {
+    std::string config = "#\n# Automatically generated file; DO NOT EDIT.\n#\n";
+    for (size_t i = 0; i < numConfigs; ++i) {
+        std::string key = "CONFIG_SYNTHETIC_OPTION_" + std::to_string(i);
+        switch (i % 5) {
+            case 0:
+                config += "# " + key + " is not set\n";
+                break;
+            case 1:
+                config += key + "=m\n";
+                break;
+            case 2:
+                config += key + "=0x" + std::to_string(i) + "\n";
+                break;
+            case 3:
+                config += key + "=\"/path/to/" + std::to_string(i) + "\"\n";
+                break;
+            default:
+                config += key + "=y\n";
+                break;
+        }
+        if (i % 50 == 0) config += "\n#\n# Section " + std::to_string(i) + "\n#\n";
+    }
+    return config;
+}
+
+template <typename Object>
+Object parse(const std::string& xml) {
+    Object object;
+    std::string error;
+    CHECK(fromXml(&object, xml, &error)) << error;
+    return object;
+}
+
+// VintfObject takes ownership of its FileSystem, so give each instance a view of the
+// shared files.
+class SharedFileSystem : public FileSystem {
+   public:
+    explicit SharedFileSystem(std::shared_ptr<const FileSystem> impl) : mImpl(std::move(impl)) {}
+    status_t fetch(const std::string& path, std::string* fetched,
+                   std::string* error) const override {
+        return mImpl->fetch(path, fetched, error);
+    }
+    status_t listFiles(const std::string& path, std::vector<std::string>* out,
+                       std::string* error) const override {
+        return mImpl->listFiles(path, out, error);
+    }
+    status_t modifiedTime(const std::string& path, timespec* mtime,
+                          std::string* error) const override {
+        return mImpl->modifiedTime(path, mtime, error);
+    }
+
+   private:
+    std::shared_ptr<const FileSystem> mImpl;
+};
+
+// Runtime information is not read from the file system; report an empty kernel.
+class EmptyRuntimeInfo : public RuntimeInfo {
+   public:
+    status_t fetchAllInformation(FetchFlags) override { return OK; }
+};
+class EmptyRuntimeInfoFactory : public ObjectFactory<RuntimeInfo> {
+   public:
+    std::shared_ptr<RuntimeInfo> make_shared() const override {
+        return std::make_shared<EmptyRuntimeInfo>();
+    }
+};
+
+std::unique_ptr<VintfObject> makeVintfObject(std::shared_ptr<const FileSystem> files) {
+    return VintfObject::Builder()
+        .setFileSystem(std::make_unique<SharedFileSystem>(std::move(files)))
+        .setRuntimeInfoFactory(std::make_unique<EmptyRuntimeInfoFactory>())
+        .build();
+}
+
+// ---------------------- fromXml / toXml
+
+void BM_HalManifestFromXml(benchmark::State& state) {
+    std::string xml = makeManifestXml(state.range(0), kNumInstances);
+    for (auto _ : state) {
+        HalManifest manifest;
+        CHECK(fromXml(&manifest, xml));
+        benchmark::DoNotOptimize(manifest);
+    }
+    state.SetBytesProcessed(state.iterations() * xml.size());
+}
+BENCHMARK(BM_HalManifestFromXml)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_CompatibilityMatrixFromXml(benchmark::State& state) {
+    std::string xml = makeMatrixXml(state.range(0), kNumInstances);
+    for (auto _ : state) {
+        CompatibilityMatrix matrix;
+        CHECK(fromXml(&matrix, xml));
+        benchmark::DoNotOptimize(matrix);
+    }
+    state.SetBytesProcessed(state.iterations() * xml.size());
+}
+BENCHMARK(BM_CompatibilityMatrixFromXml)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_HalManifestToXml(benchmark::State& state) {
+    auto manifest = parse<HalManifest>(makeManifestXml(state.range(0), kNumInstances));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(toXml(manifest, SerializeFlags::EVERYTHING));
+    }
+}
+BENCHMARK(BM_HalManifestToXml)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_CompatibilityMatrixToXml(benchmark::State& state) {
+    auto matrix = parse<CompatibilityMatrix>(makeMatrixXml(state.range(0), kNumInstances));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(toXml(matrix, SerializeFlags::EVERYTHING));
+    }
+}
+BENCHMARK(BM_CompatibilityMatrixToXml)->RangeMultiplier(4)->Range(4, 256);
+
+// ---------------------- Compatibility checks
+
+// Levels of the <kernel> requirements of makeKernelMatrixXml().
+constexpr Level kKernelLevels[] = {Level::R, Level::S, Level::T, Level::U};
+
+// Config key of the |k|-th requirement of the |c|-th conditional <kernel>.
+std::string kernelRequirementKey(size_t c, size_t k) {
+    return "CONFIG_REQUIREMENT_" + std::to_string(c) + "_" + std::to_string(k);
+}
+
+// A framework compatibility matrix with <kernel> requirements for kernel branches 5.0 to
+// 5.|numBranches - 1| at each of kKernelLevels. For each branch and level there is a base
+// <kernel> and |numConditional| <kernel>s, each conditional on one of four architectures.
+std::string makeKernelMatrixXml(size_t numBranches, size_t numConditional) {
+    std::string xml = "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\">\n";
+    auto configXml = [](const std::string& key) {
+        return "            <config>\n"
+               "                <key>" + key + "</key>\n"
+               "                <value type=\"tristate\">y</value>\n"
+               "            </config>\n";
+    };
+    for (size_t b = 0; b < numBranches; ++b) {
+        for (Level level : kKernelLevels) {
+            std::string kernelTag = "    <kernel version=\"5." + std::to_string(b) +
+                                    ".0\" level=\"" + to_string(level) + "\">\n";
+            xml += kernelTag + configXml("CONFIG_BASE") + "    </kernel>\n";
+            for (size_t c = 0; c < numConditional; ++c) {
+                xml += kernelTag + "        <conditions>\n" +
+                       configXml("CONFIG_ARCH_" + std::to_string(c % 4)) +
+                       "        </conditions>\n";
+                for (size_t k = 0; k < 4; ++k) xml += configXml(kernelRequirementKey(c, k));
+                xml += "    </kernel>\n";
+            }
+        }
+    }
+    xml += "    <sepolicy>\n"
+           "        <kernel-sepolicy-version>30</kernel-sepolicy-version>\n"
+           "        <sepolicy-version>30.0</sepolicy-version>\n"
+           "    </sepolicy>\n"
+           "</compatibility-matrix>\n";
+    return xml;
+}
+
+// A 5.|branch| kernel at level S that satisfies makeKernelMatrixXml() on architecture 0.
+KernelInfo makeKernelInfo(size_t branch, size_t numConditional) {
+    std::map<std::string, std::string> configs{{"CONFIG_BASE", "y"}, {"CONFIG_ARCH_0", "y"}};
+    for (size_t c = 0; c < numConditional; ++c) {
+        for (size_t k = 0; k < 4; ++k) configs.emplace(kernelRequirementKey(c, k), "y");
+    }
+    return LibVintfBenchmark::makeKernelInfo({5, branch, 100}, Level::S, std::move(configs));
+}
+
+// Arguments: number of conditional <kernel>s per branch and level, whether the index of the
+// matrix is reused across checks.
+void BM_KernelMatchRequirements(benchmark::State& state) {
+    constexpr size_t kNumBranches = 8;
+    size_t numConditional = state.range(0);
+    auto matrix = parse<CompatibilityMatrix>(makeKernelMatrixXml(kNumBranches, numConditional));
+    KernelInfo kernel = makeKernelInfo(kNumBranches / 2, numConditional);
+    CHECK_EQ(numConditional / 4 + 1, LibVintfBenchmark::matchKernel(kernel, matrix).size());
+    for (auto _ : state) {
+        if (state.range(1)) {
+            benchmark::DoNotOptimize(LibVintfBenchmark::matchKernel(kernel, matrix));
+        } else {
+            benchmark::DoNotOptimize(kernel.getMatchedKernelRequirements(
+                LibVintfBenchmark::kernels(matrix), Level::S));
+        }
+    }
+}
+BENCHMARK(BM_KernelMatchRequirements)->ArgsProduct({{4, 16, 64}, {0, 1}});
+
+// Arguments: number of HALs, regex interval.
+void BM_HalManifestCheckCompatibility(benchmark::State& state) {
+    auto manifest = parse<HalManifest>(makeManifestXml(state.range(0), kNumInstances));
+    auto matrix = parse<CompatibilityMatrix>(
+        makeMatrixXml(state.range(0), kNumInstances, state.range(1)));
+    std::string error;
+    CHECK(manifest.checkCompatibility(matrix, &error)) << error;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manifest.checkCompatibility(matrix, &error));
+    }
+}
+BENCHMARK(BM_HalManifestCheckCompatibility)
+    ->ArgsProduct({benchmark::CreateRange(4, 256, 4), {0, kRegexInterval, 1}});
+
+// Arguments: number of fragments, number of HALs per fragment.
+void BM_CompatibilityMatrixCombine(benchmark::State& state) {
+    std::vector<CompatibilityMatrix> fragments;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        Level level = static_cast<Level>(static_cast<size_t>(Level::R) + i);
+        auto& fragment = fragments.emplace_back(parse<CompatibilityMatrix>(
+            makeMatrixXml(state.range(1), kNumInstances, kRegexInterval, level)));
+        fragment.setFileName("compatibility_matrix." + to_string(level) + ".xml");
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::vector<CompatibilityMatrix> copy = fragments;
+        std::string error;
+        state.ResumeTiming();
+        auto combined = LibVintfBenchmark::combine(Level::R, &copy, &error);
+        CHECK(combined != nullptr) << error;
+        benchmark::DoNotOptimize(combined);
+    }
+}
+BENCHMARK(BM_CompatibilityMatrixCombine)->ArgsProduct({{1, 2, 4}, {16, 64, 256}});
+
+// ---------------------- Manifest fragments
+
+// A manifest fragment with HIDL HAL |halIndex| of makeManifestXml(), at minor version 1.
+std::string makeManifestFragmentXml(size_t halIndex, size_t numInstances, bool override) {
+    std::string xml = "<manifest " + kMetaVersionStr + " type=\"device\">\n"s +
+                      "    <hal format=\"hidl\"" + (override ? " override=\"true\"" : "") + ">\n" +
+                      "        <name>android.hardware.hidl" + std::to_string(halIndex) + "</name>\n"
+                      "        <transport>hwbinder</transport>\n";
+    for (size_t j = 0; j < numInstances; ++j) {
+        xml += "        <fqname>@1.1::IBar/instance" + std::to_string(j) + "</fqname>\n";
+    }
+    xml += "    </hal>\n"
+           "</manifest>\n";
+    return xml;
+}
+
+// Arguments: number of HALs in the manifest, number of override fragments.
+// Fragments are added with addAll() in the order that VintfObject adds them.
+void BM_HalManifestAddAllOverride(benchmark::State& state) {
+    size_t numHals = state.range(0);
+    auto manifest = parse<HalManifest>(makeManifestXml(numHals, kNumInstances));
+    std::vector<HalManifest> fragments;
+    for (int64_t i = 0; i < state.range(1); ++i) {
+        fragments.emplace_back(parse<HalManifest>(
+            makeManifestFragmentXml(i % numHals, kNumInstances, true /* override */)));
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        HalManifest copy = manifest;
+        std::vector<HalManifest> fragmentsCopy = fragments;
+        std::string error;
+        state.ResumeTiming();
+        for (auto& fragment : fragmentsCopy) {
+            CHECK(copy.addAll(&fragment, &error)) << error;
+        }
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_HalManifestAddAllOverride)->ArgsProduct({{64, 256}, {100, 400}});
+
+// ---------------------- Kernel configs
+
+void BM_KernelConfigParser(benchmark::State& state) {
+    std::string config = makeKernelConfig(state.range(0));
+    for (auto _ : state) {
+        KernelConfigParser parser;
+        CHECK_EQ(OK, parser.processAndFinish(config));
+        benchmark::DoNotOptimize(parser.configs());
+    }
+    state.SetBytesProcessed(state.iterations() * config.size());
+}
+// A full arm64 GKI defconfig expands to about 6000 entries.
+BENCHMARK(BM_KernelConfigParser)->RangeMultiplier(4)->Range(256, 8192);
+
+// ---------------------- Instance lookups
+
+void BM_MatrixInstanceMatchInstance(benchmark::State& state) {
+    bool isRegex = state.range(0) != 0;
+    FqInstance fqInstance;
+    CHECK(fqInstance.setTo("android.hardware.foo", 1, 0, "IFoo",
+                           isRegex ? "instance[0-9]+" : "instance7"));
+    MatrixInstance instance(HalFormat::HIDL, std::move(fqInstance), VersionRange(1, 0),
+                            true /* optional */, isRegex);
+    CHECK(instance.matchInstance("instance7"));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(instance.matchInstance("instance7"));
+        benchmark::DoNotOptimize(instance.matchInstance("other"));
+    }
+}
+BENCHMARK(BM_MatrixInstanceMatchInstance)->Arg(0)->Arg(1);
+
+void BM_HalManifestGetHidlTransport(benchmark::State& state) {
+    auto manifest = parse<HalManifest>(makeManifestXml(state.range(0), kNumInstances));
+    std::string last = "android.hardware.hidl" + std::to_string(state.range(0) - 1);
+    CHECK_EQ(Transport::HWBINDER,
+             manifest.getHidlTransport(last, {1, 0}, "IBar", "instance0"));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manifest.getHidlTransport(last, {1, 0}, "IBar", "instance0"));
+        benchmark::DoNotOptimize(
+            manifest.getHidlTransport("android.hardware.missing", {1, 0}, "IBar", "instance0"));
+    }
+}
+BENCHMARK(BM_HalManifestGetHidlTransport)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_FQNameSetTo(benchmark::State& state) {
+    const std::vector<std::string> names = {
+        "android.hardware.foo@1.0",
+        "android.hardware.foo@1.0::IFoo",
+        "android.hardware.camera.provider@2.4::ICameraProvider.Callback",
+        "@1.0::IFoo",
+        "IFoo",
+    };
+    for (auto _ : state) {
+        for (const auto& name : names) {
+            FQName fqName;
+            benchmark::DoNotOptimize(fqName.setTo(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_FQNameSetTo);
+
+// Parses the names of all known HIDL interfaces and the names they inherit from, like
+// HalManifest::checkUnusedHals and VintfObject::GetListedInstanceInheritance do.
+void BM_FQNameParseHidlMetadata(benchmark::State& state) {
+    std::vector<std::string> names;
+    for (const auto& metadata : HidlInterfaceMetadata::all()) {
+        names.push_back(metadata.name);
+        names.insert(names.end(), metadata.inherited.begin(), metadata.inherited.end());
+    }
+    if (names.empty()) {
+        // No metadata in this build; fall back to synthetic names of the same shape.
+        for (size_t i = 0; i < 256; ++i) {
+            names.push_back("android.hardware.hidl" + std::to_string(i) + "@1.0::IFoo");
+            names.push_back("android.hidl.base@1.0::IBase");
+        }
+    }
+    for (auto _ : state) {
+        for (const auto& name : names) {
+            FQName fqName;
+            benchmark::DoNotOptimize(fqName.setTo(name));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_FQNameParseHidlMetadata);
+
+// Arguments: whether to compare equal instances.
+void BM_FqInstanceSetToAndCompare(benchmark::State& state) {
+    std::string otherInstance = state.range(0) != 0 ? "default" : "other";
+    for (auto _ : state) {
+        FqInstance fqInstance;
+        CHECK(fqInstance.setTo("android.hardware.camera.provider", 2, 4, "ICameraProvider",
+                               "default"));
+        FqInstance other;
+        CHECK(other.setTo("android.hardware.camera.provider", 2, 4, "ICameraProvider",
+                          otherInstance));
+        benchmark::DoNotOptimize(fqInstance < other);
+        benchmark::DoNotOptimize(fqInstance == other);
+    }
+}
+BENCHMARK(BM_FqInstanceSetToAndCompare)->Arg(0)->Arg(1);
+
+// ---------------------- Memory layout
+
+// Memory report for the instances of the device manifest, in the layout of ManifestHal and in
+// the PackedManifestInstances layout. Uses the manifest of the device if there is one, and a
+// synthetic manifest otherwise. The time is the time to pack all instances.
+void BM_PackedManifestInstances(benchmark::State& state) {
+    std::shared_ptr<const HalManifest> manifest = VintfObject::GetDeviceHalManifest();
+    if (manifest == nullptr) {
+        manifest = std::make_shared<HalManifest>(
+            parse<HalManifest>(makeManifestXml(64, kNumInstances)));
+    }
+    std::vector<ManifestInstance> instances;
+    manifest->forEachInstance([&](const ManifestInstance& manifestInstance) {
+        instances.push_back(manifestInstance);
+        return true;
+    });
+
+    size_t packedBytes = 0;
+    for (auto _ : state) {
+        details::PackedManifestInstances packed;
+        for (const ManifestInstance& manifestInstance : instances) {
+            benchmark::DoNotOptimize(packed.add(manifestInstance));
+        }
+        packedBytes = packed.memoryUsage();
+    }
+    state.counters["instances"] = instances.size();
+    state.counters["unpacked_bytes"] = details::unpackedMemoryUsage(instances);
+    state.counters["packed_bytes"] = packedBytes;
+}
+BENCHMARK(BM_PackedManifestInstances)->Unit(benchmark::kMicrosecond);
+
+// ---------------------- Instance queries
+
+// Lookups of servicemanager against the AIDL HALs of makeManifestXml(): every declared
+// instance, and one undeclared instance per HAL.
+struct AidlQuery {
+    std::string package;
+    std::string interface;
+    std::string instance;
+};
+
+std::vector<AidlQuery> makeAidlQueries(size_t numHals) {
+    std::vector<AidlQuery> queries;
+    for (size_t i = 0; i < numHals; ++i) {
+        std::string package = "android.hardware.aidl" + std::to_string(i);
+        for (size_t j = 0; j <= kNumInstances; ++j) {
+            queries.push_back({package, "IFoo", "instance" + std::to_string(j)});
+        }
+    }
+    return queries;
+}
+
+// The device manifest of makeManifestXml() with |numHals| HALs and the framework manifest of
+// makeFrameworkManifestXml(), parsed once and shared by all threads of a benchmark.
+std::shared_ptr<const ManifestInstanceIndex> getSharedIndex(size_t numHals) {
+    static std::mutex mutex;
+    static std::map<size_t, std::shared_ptr<const ManifestInstanceIndex>> indices;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& index = indices[numHals];
+    if (index == nullptr) {
+        index = std::make_shared<ManifestInstanceIndex>(
+            std::make_shared<HalManifest>(
+                parse<HalManifest>(makeManifestXml(numHals, kNumInstances))),
+            std::make_shared<HalManifest>(parse<HalManifest>(makeFrameworkManifestXml())));
+    }
+    return index;
+}
+
+// Point lookups with HalManifest::hasAidlInstance, which scans the instances of the package.
+// Argument: number of HALs. Each thread is a concurrent reader of the same manifest.
+void BM_HalManifestHasAidlInstance(benchmark::State& state) {
+    auto manifest = getSharedIndex(state.range(0))->deviceManifest();
+    auto queries = makeAidlQueries(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        const AidlQuery& query = queries[i++ % queries.size()];
+        benchmark::DoNotOptimize(
+            manifest->hasAidlInstance(query.package, query.interface, query.instance));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HalManifestHasAidlInstance)
+    ->RangeMultiplier(4)
+    ->Range(4, 256)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// The same lookups with ManifestInstanceIndex.
+void BM_ManifestInstanceIndexHasAidlInstance(benchmark::State& state) {
+    auto index = getSharedIndex(state.range(0));
+    auto queries = makeAidlQueries(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        const AidlQuery& query = queries[i++ % queries.size()];
+        benchmark::DoNotOptimize(
+            index->hasAidlInstance(query.package, query.interface, query.instance));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ManifestInstanceIndexHasAidlInstance)
+    ->RangeMultiplier(4)
+    ->Range(4, 256)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// Listing the instances of an interface, with HalManifest::getAidlInstances (Arg 0) and by
+// iterating ManifestInstanceIndex::getAidlInstances (Arg 1). 64 HALs.
+void BM_ListAidlInstances(benchmark::State& state) {
+    constexpr size_t kNumHals = 64;
+    auto index = getSharedIndex(kNumHals);
+    auto queries = makeAidlQueries(kNumHals);
+    bool useIndex = state.range(0) != 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        const AidlQuery& query = queries[i++ % queries.size()];
+        if (useIndex) {
+            for (const ManifestInstance& e : index->getAidlInstances(query.package,
+                                                                     query.interface)) {
+                benchmark::DoNotOptimize(e.instance().data());
+            }
+        } else {
+            benchmark::DoNotOptimize(
+                index->deviceManifest()->getAidlInstances(query.package, query.interface));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ListAidlInstances)->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+// ---------------------- VintfObject
+
+// VINTF files of a device with |numHals| HALs in the device manifest and |numFragments|
+// framework matrix fragments.
+std::shared_ptr<FakeFileSystem> makeVintfFiles(size_t numHals, size_t numFragments) {
+    auto files = std::make_shared<FakeFileSystem>();
+    files->add(kVendorManifest, makeManifestXml(numHals, kNumInstances));
+    files->add(kVendorMatrix, makeDeviceMatrixXml());
+    files->add(kSystemManifest, makeFrameworkManifestXml());
+    for (size_t i = 0; i < numFragments; ++i) {
+        Level level = static_cast<Level>(static_cast<size_t>(Level::R) + i);
+        files->add(kSystemVintfDir + "compatibility_matrix."s + to_string(level) + ".xml",
+                   makeMatrixXml(numHals, kNumInstances, kRegexInterval, level));
+    }
+    return files;
+}
+
+// Cold load of all four VINTF objects from an in-memory file system. Arguments: number of
+// HALs in the device manifest, number of framework matrix fragments.
+void BM_VintfObjectLoad(benchmark::State& state) {
+    auto files = makeVintfFiles(state.range(0), state.range(1));
+    for (auto _ : state) {
+        auto vintfObject = makeVintfObject(files);
+        CHECK(vintfObject->getDeviceHalManifest() != nullptr);
+        CHECK(vintfObject->getFrameworkHalManifest() != nullptr);
+        CHECK(vintfObject->getDeviceCompatibilityMatrix() != nullptr);
+        CHECK(vintfObject->getFrameworkCompatibilityMatrix() != nullptr);
+    }
+}
+BENCHMARK(BM_VintfObjectLoad)
+    ->ArgsProduct({benchmark::CreateRange(4, 256, 4), {1, 4}})
+    ->Unit(benchmark::kMicrosecond);
+
+// VintfObject::getManifestInstanceIndex() followed by a lookup, as a servicemanager client
+// that does not hold on to the index would do it. The manifests are cached, so this measures
+// the freshness checks of the cache under concurrent readers. Argument: number of HALs.
+void BM_VintfObjectManifestInstanceIndex(benchmark::State& state) {
+    static std::mutex mutex;
+    static std::map<int64_t, std::shared_ptr<VintfObject>> vintfObjects;
+    std::shared_ptr<VintfObject> vintfObject;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& shared = vintfObjects[state.range(0)];
+        if (shared == nullptr) {
+            auto files = std::make_shared<FakeFileSystem>();
+            files->add(kVendorManifest, makeManifestXml(state.range(0), kNumInstances));
+            files->add(kSystemManifest, makeFrameworkManifestXml());
+            shared = makeVintfObject(files);
+            CHECK(shared->getManifestInstanceIndex() != nullptr);
+        }
+        vintfObject = shared;
+    }
+    auto queries = makeAidlQueries(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        const AidlQuery& query = queries[i++ % queries.size()];
+        benchmark::DoNotOptimize(vintfObject->getManifestInstanceIndex()->hasAidlInstance(
+            query.package, query.interface, query.instance));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VintfObjectManifestInstanceIndex)
+    ->Arg(4)
+    ->Arg(256)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// ---------------------- VintfObject concurrency
+
+// Getters of VintfObject that the binder threads of a process call concurrently.
+enum class Getter : int64_t {
+    DEVICE_MANIFEST,
+    FRAMEWORK_MANIFEST,
+    DEVICE_MATRIX,
+    FRAMEWORK_MATRIX,
+    RUNTIME_INFO,
+    // The static VintfObject::GetInstance(). Reading the function-local static does not lock;
+    // what remains is the atomic reference count of the returned shared_ptr copy.
+    GET_INSTANCE,
+};
+
+bool callGetter(VintfObject* vintfObject, Getter getter) {
+    switch (getter) {
+        case Getter::DEVICE_MANIFEST:
+            return vintfObject->getDeviceHalManifest() != nullptr;
+        case Getter::FRAMEWORK_MANIFEST:
+            return vintfObject->getFrameworkHalManifest() != nullptr;
+        case Getter::DEVICE_MATRIX:
+            return vintfObject->getDeviceCompatibilityMatrix() != nullptr;
+        case Getter::FRAMEWORK_MATRIX:
+            return vintfObject->getFrameworkCompatibilityMatrix() != nullptr;
+        case Getter::RUNTIME_INFO:
+            return vintfObject->getRuntimeInfo() != nullptr;
+        case Getter::GET_INSTANCE:
+            return VintfObject::GetInstance() != nullptr;
+    }
+    return false;
+}
+
+// The VintfObject and files that all threads of the running benchmark share. Set up by thread
+// 0 before the benchmark loop, which the other threads wait for.
+std::shared_ptr<FakeFileSystem> gSharedFiles;
+std::shared_ptr<VintfObject> gSharedVintfObject;
+
+void setUpSharedVintfObject(std::chrono::microseconds latency,
+                            std::chrono::microseconds modifiedTimeInterval) {
+    gSharedFiles = makeVintfFiles(64, 2);
+    // There are no APEXes, but the modified time of the list of APEXes decides when HAL
+    // manifests are reloaded.
+    gSharedFiles->add(kApexInfoFile, "<apex-info-list></apex-info-list>");
+    gSharedFiles->add(kBootstrapApexInfoFile, "<apex-info-list></apex-info-list>");
+    gSharedVintfObject = makeVintfObject(gSharedFiles);
+    // Load everything before the latency applies.
+    for (int64_t i = 0; i <= static_cast<int64_t>(Getter::RUNTIME_INFO); ++i) {
+        CHECK(callGetter(gSharedVintfObject.get(), static_cast<Getter>(i)));
+    }
+    gSharedFiles->setLatency(latency);
+    gSharedFiles->setModifiedTimeInterval(modifiedTimeInterval);
+}
+
+void tearDownSharedVintfObject() {
+    gSharedVintfObject = nullptr;
+    gSharedFiles = nullptr;
+}
+
+// Call |getter| on the shared VintfObject in the benchmark loop, and report the latency of
+// the calls of each thread as percentiles, averaged over threads.
+void runGetter(benchmark::State& state, Getter getter) {
+    std::vector<int64_t> latencies;
+    latencies.reserve(1 << 16);
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        bool found = callGetter(gSharedVintfObject.get(), getter);
+        auto end = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(found);
+        latencies.push_back(std::chrono::nanoseconds(end - start).count());
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (latencies.empty()) return;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](size_t p) {
+        return static_cast<double>(latencies[(latencies.size() - 1) * p / 100]);
+    };
+    state.counters["p50_ns"] = benchmark::Counter(percentile(50), benchmark::Counter::kAvgThreads);
+    state.counters["p99_ns"] = benchmark::Counter(percentile(99), benchmark::Counter::kAvgThreads);
+    state.counters["max_ns"] = benchmark::Counter(percentile(100), benchmark::Counter::kAvgThreads);
+}
+
+// Throughput and latency of a cached getter with 1 to 32 threads calling it. Nothing is
+// reloaded, so this measures the locks of the caches. Argument: Getter.
+void BM_VintfObjectGetterContention(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        setUpSharedVintfObject(std::chrono::microseconds(0), std::chrono::microseconds(0));
+    }
+    runGetter(state, static_cast<Getter>(state.range(0)));
+    if (state.thread_index() == 0) tearDownSharedVintfObject();
+}
+BENCHMARK(BM_VintfObjectGetterContention)
+    ->DenseRange(0, static_cast<int64_t>(Getter::GET_INSTANCE))
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+
+// VintfObject::GetInstance() as it was implemented before it was initialized once: lock a
+// mutex on every call, then copy the shared_ptr.
+std::shared_ptr<VintfObject> getInstanceLocked() {
+    static details::LockedSharedPtr<VintfObject> sInstance{};
+    std::unique_lock<std::mutex> lock(sInstance.mutex);
+    if (sInstance.object == nullptr) sInstance.object = VintfObject::GetInstance();
+    return sInstance.object;
+}
+
+// The global instance with getInstanceLocked() (Arg 0) and VintfObject::GetInstance()
+// (Arg 1), from 1 to 32 threads.
+void BM_VintfObjectGetInstance(benchmark::State& state) {
+    CHECK(getInstanceLocked() != nullptr);
+    bool locked = state.range(0) == 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(locked ? getInstanceLocked() : VintfObject::GetInstance());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VintfObjectGetInstance)->Arg(0)->Arg(1)->ThreadRange(1, 32)->UseRealTime();
+
+// Throughput and latency of a getter while the HAL manifests are reloaded every |interval|
+// microseconds from storage with a latency of |latency| microseconds per file operation.
+// Readers that find a stale manifest wait for the reload under the lock of the cache.
+// Arguments: Getter, interval, latency.
+void BM_VintfObjectGetterDuringReload(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        setUpSharedVintfObject(std::chrono::microseconds(state.range(2)),
+                               std::chrono::microseconds(state.range(1)));
+    }
+    size_t fetchCount = 0;
+    if (state.thread_index() == 0) fetchCount = gSharedFiles->fetchCount();
+    runGetter(state, static_cast<Getter>(state.range(0)));
+    if (state.thread_index() == 0) {
+        state.counters["fetches"] = gSharedFiles->fetchCount() - fetchCount;
+        tearDownSharedVintfObject();
+    }
+}
+BENCHMARK(BM_VintfObjectGetterDuringReload)
+    ->ArgsProduct({{static_cast<int64_t>(Getter::DEVICE_MANIFEST),
+                    static_cast<int64_t>(Getter::FRAMEWORK_MATRIX)},
+                   {1000, 10000},
+                   {0, 20}})
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace android::vintf
+
+BENCHMARK_MAIN();
@@ -18,6 +18,8 @@
 
 #include <algorithm>
 #include <functional>
+#include <memory_resource>
+#include <sstream>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -26,12 +28,23 @@
 #include <android-base/strings.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <tinyxml2.h>
 
+#include <vintf/BinaryContent.h>
 #include <vintf/CompatibilityMatrix.h>
+#include <vintf/ContentVisitor.h>
 #include <vintf/KernelConfigParser.h>
+#include <vintf/ManifestInstanceIndex.h>
+#include <vintf/VintfDiff.h>
 #include <vintf/VintfObject.h>
 #include <vintf/parse_string.h>
 #include <vintf/parse_xml.h>
+#include "JsonContentVisitor.h"
+#include "KernelRequirementIndex.h"
+#include "KernelRequirementTable.h"
+#include "PackedManifestInstances.h"
+#include "XmlPullParser.h"
+#include "XmlWriter.h"
 #include "constants-private.h"
 #include "parse_xml_for_test.h"
 #include "parse_xml_internal.h"
@@ -44,6 +57,7 @@ using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::IsEmpty;
+using ::testing::IsSupersetOf;
 using ::testing::Optional;
 using ::testing::Property;
 using ::testing::Range;
@@ -107,7 +121,7 @@ public:
     MatrixHal *getAnyHal(CompatibilityMatrix &cm, const std::string &name) {
         return cm.getAnyHal(name);
     }
-    ConstMultiMapValueIterable<std::string, ManifestHal> getHals(const HalManifest& vm) {
+    HalManifest::ConstHalIterable getHals(const HalManifest& vm) {
         return vm.getHals();
     }
     std::vector<const ManifestHal*> getHals(const HalManifest& vm, const std::string& name) {
@@ -120,9 +134,15 @@ public:
         return mh.isValid();
     }
     std::vector<MatrixKernel>& getKernels(CompatibilityMatrix& cm) { return cm.framework.mKernels; }
+    const details::KernelRequirementIndex& kernelRequirementIndex(const CompatibilityMatrix& cm) {
+        return cm.kernelRequirementIndex();
+    }
     bool addAllHalsAsOptional(CompatibilityMatrix* cm1, CompatibilityMatrix* cm2, std::string* e) {
         return cm1->addAllHalsAsOptional(cm2, e);
     }
+    bool addAll(CompatibilityMatrix* cm1, CompatibilityMatrix* cm2, std::string* e) {
+        return cm1->addAll(cm2, e);
+    }
     bool addAllXmlFilesAsOptional(CompatibilityMatrix* cm1, CompatibilityMatrix* cm2,
                                   std::string* e) {
         return cm1->addAllXmlFilesAsOptional(cm2, e);
@@ -130,16 +150,26 @@ public:
     std::set<std::string> checkUnusedHals(const HalManifest& m, const CompatibilityMatrix& cm) {
         return m.checkUnusedHals(cm, {});
     }
+    std::vector<std::string> checkIncompatibleHals(const HalManifest& m,
+                                                   const CompatibilityMatrix& cm) {
+        return m.checkIncompatibleHals(cm);
+    }
+    bool hasIncompatibleHals(const HalManifest& m, const CompatibilityMatrix& cm) {
+        return m.hasIncompatibleHals(cm);
+    }
     Level getLevel(const KernelInfo& ki) { return ki.level(); }
+    void setConfigs(KernelInfo* ki, std::map<std::string, std::string> configs) {
+        ki->mConfigs = std::move(configs);
+    }
     static status_t parseGkiKernelRelease(RuntimeInfo::FetchFlags flags,
                                           const std::string& kernelRelease, KernelVersion* version,
                                           Level* kernelLevel) {
         return RuntimeInfo::parseGkiKernelRelease(flags, kernelRelease, version, kernelLevel);
     }
 
-    std::map<std::string, HalInterface> testHalInterfaces() {
+    std::pmr::map<std::string, HalInterface> testHalInterfaces() {
         HalInterface intf("IFoo", {"default"});
-        std::map<std::string, HalInterface> map;
+        std::pmr::map<std::string, HalInterface> map;
         map[intf.name()] = intf;
         return map;
     }
@@ -716,7 +746,7 @@ TEST_F(LibVintfTest, VersionConverter) {
     EXPECT_EQ(v3, v4);
 }
 
-static bool insert(std::map<std::string, HalInterface>* map, HalInterface&& intf) {
+static bool insert(std::pmr::map<std::string, HalInterface>* map, HalInterface&& intf) {
     std::string name{intf.name()};
     return map->emplace(std::move(name), std::move(intf)).second;
 }
@@ -748,6 +778,50 @@ TEST_F(LibVintfTest, MatrixHalConverter) {
     EXPECT_EQ(mh, mh2);
 }
 
+TEST_F(LibVintfTest, MatrixHalConverterInterleavedChildren) {
+    std::string xml =
+        "<hal format=\"native\" optional=\"false\">\n"
+        "    <interface>\n"
+        "        <instance>great</instance>\n"
+        "        <name>IBetterCamera</name>\n"
+        "        <instance>default</instance>\n"
+        "    </interface>\n"
+        "    <version>1.2-3</version>\n"
+        "    <name>android.hardware.camera</name>\n"
+        "    <interface>\n"
+        "        <name>ICamera</name>\n"
+        "        <instance>default</instance>\n"
+        "    </interface>\n"
+        "    <version>4.5-6</version>\n"
+        "</hal>\n";
+    MatrixHal mh;
+    ASSERT_TRUE(fromXml(&mh, xml));
+    EXPECT_EQ("android.hardware.camera", mh.name);
+    EXPECT_EQ((std::vector<VersionRange>{VersionRange(1, 2, 3), VersionRange(4, 5, 6)}),
+              mh.versionRanges);
+    EXPECT_EQ(toXml(mh),
+        "<hal format=\"native\" optional=\"false\">\n"
+        "    <name>android.hardware.camera</name>\n"
+        "    <version>1.2-3</version>\n"
+        "    <version>4.5-6</version>\n"
+        "    <interface>\n"
+        "        <name>IBetterCamera</name>\n"
+        "        <instance>default</instance>\n"
+        "        <instance>great</instance>\n"
+        "    </interface>\n"
+        "    <interface>\n"
+        "        <name>ICamera</name>\n"
+        "        <instance>default</instance>\n"
+        "    </interface>\n"
+        "</hal>\n");
+
+    // The first missing element in buildObject() order is reported, regardless of the
+    // order of the children in the document.
+    std::string error;
+    EXPECT_FALSE(fromXml(&mh, "<hal><version>1.0</version><interface/></hal>", &error));
+    EXPECT_IN("Could not find element with name <name> in element <hal>", error);
+}
+
 TEST_F(LibVintfTest, KernelConfigTypedValueConverter) {
 
     KernelConfigTypedValue converted;
@@ -2481,6 +2555,187 @@ TEST_F(LibVintfTest, KernelConfigConditionMatch) {
     EXPECT_FALSE(runtime.checkCompatibility(cm, &error)) << "all fragments should be used";
 }
 
+TEST_F(LibVintfTest, KernelRequirementIndex) {
+    RuntimeInfo runtime = testRuntimeInfo();
+    std::string error;
+    std::string xml =
+        "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\">\n"
+        "    <kernel version=\"3.18.22\"/>\n"
+        "    <kernel version=\"3.18.22\">\n"
+        "        <conditions>\n"
+        "            <config>\n"
+        "                <key>CONFIG_64BIT</key>\n"
+        "                <value type=\"tristate\">y</value>\n"
+        "            </config>\n"
+        "        </conditions>\n"
+        "        <config>\n"
+        "            <key>CONFIG_ARCH_MMAP_RND_BITS</key>\n"
+        "            <value type=\"int\">24</value>\n"
+        "        </config>\n"
+        "    </kernel>\n"
+        "    <kernel version=\"4.4.1\"/>\n"
+        "    <kernel version=\"4.4.1\">\n"
+        "        <conditions>\n"
+        "            <config>\n"
+        "                <key>CONFIG_64BIT</key>\n"
+        "                <value type=\"tristate\">y</value>\n"
+        "            </config>\n"
+        "            <config>\n"
+        "                <key>CONFIG_ARM64</key>\n"
+        "                <value type=\"tristate\">y</value>\n"
+        "            </config>\n"
+        "        </conditions>\n"
+        "    </kernel>\n"
+        "    <sepolicy>\n"
+        "        <kernel-sepolicy-version>30</kernel-sepolicy-version>\n"
+        "    </sepolicy>\n"
+        "    <avb><vbmeta-version>2.1</vbmeta-version></avb>\n"
+        "</compatibility-matrix>\n";
+    CompatibilityMatrix cm;
+    ASSERT_TRUE(fromXml(&cm, xml, &error)) << error;
+
+    const details::KernelRequirementIndex& index = kernelRequirementIndex(cm);
+    EXPECT_EQ(&index, &kernelRequirementIndex(cm)) << "index should be reused";
+    EXPECT_EQ(nullptr, index.find({5, 4, 0}));
+    const auto* branch = index.find({3, 18, 31});
+    ASSERT_NE(nullptr, branch);
+    ASSERT_EQ(1u, branch->levels.size());
+    EXPECT_EQ(2u, branch->levels[0].requirements.size());
+    // CONFIG_64BIT and CONFIG_ARCH_MMAP_RND_BITS
+    EXPECT_EQ(2u, branch->keys.size());
+    branch = index.find({4, 4, 0});
+    ASSERT_NE(nullptr, branch);
+    // CONFIG_64BIT and CONFIG_ARM64
+    EXPECT_EQ(2u, branch->keys.size());
+
+    EXPECT_TRUE(runtime.checkCompatibility(cm, &error)) << error;
+    EXPECT_TRUE(runtime.checkCompatibility(cm, &error)) << error;
+
+    // Changing the kernels of the matrix drops the index.
+    ASSERT_TRUE(add(cm, MatrixKernel(KernelVersion{4, 9, 0}, {})));
+    EXPECT_NE(nullptr, kernelRequirementIndex(cm).find({4, 9, 0}));
+    std::vector<KernelConfig> configs;
+    configs.emplace_back(std::string("CONFIG_ARM64"), Tristate::YES);
+    ASSERT_TRUE(add(cm, MatrixKernel(KernelVersion{3, 18, 22}, std::move(configs))));
+    EXPECT_FALSE(runtime.checkCompatibility(cm, &error));
+    EXPECT_IN("Missing config CONFIG_ARM64", error);
+}
+
+TEST_F(LibVintfTest, CompiledKernelConfigsMatchLikeKernelInfo) {
+    std::vector<KernelConfigTypedValue> requirements{
+        KernelConfigTypedValue(std::string("foo")),
+        KernelConfigTypedValue(KernelConfigIntValue{24}),
+        KernelConfigTypedValue(KernelConfigIntValue{-1}),
+        KernelConfigTypedValue(KernelConfigRangeValue{1, 0x20}),
+        KernelConfigTypedValue(Tristate::YES),
+        KernelConfigTypedValue(Tristate::MODULE),
+        KernelConfigTypedValue(Tristate::NO),
+    };
+    std::vector<std::optional<std::string>> kernelValues{
+        std::nullopt, "\"foo\"", "foo", "\"fo\"", "24", "0x18", "-1", "0xffffffffffffffff",
+        "1-0x20", "1-32", "1-31", "y", "m", "n", "",
+    };
+    for (const auto& requirement : requirements) {
+        for (const auto& kernelValue : kernelValues) {
+            std::vector<KernelConfig> configs;
+            configs.emplace_back(std::string("CONFIG_FOO"), KernelConfigTypedValue(requirement));
+            std::vector<MatrixKernel> kernels;
+            kernels.emplace_back(KernelVersion{4, 19, 0}, std::vector<KernelConfig>(configs));
+
+            std::map<std::string, std::string> kernelConfigs;
+            if (kernelValue) kernelConfigs["CONFIG_FOO"] = *kernelValue;
+            KernelInfo kernelInfo;
+            setConfigs(&kernelInfo, kernelConfigs);
+
+            details::KernelRequirementIndex index(kernels);
+            const auto* branch = index.find({4, 19, 0});
+            ASSERT_NE(nullptr, branch);
+            details::KernelConfigValues values(*branch, kernelConfigs);
+            const auto& compiled = branch->levels[0].requirements[0].configs;
+            EXPECT_EQ(kernelInfo.matchKernelConfigs(configs),
+                      details::findKernelConfigMismatch(compiled, &values) == compiled.size())
+                << "required " << requirement << ", kernel value "
+                << kernelValue.value_or("(missing)");
+        }
+    }
+}
+
+TEST_F(LibVintfTest, KernelRequirementTable) {
+    using details::KernelRequirementTable;
+    std::string error;
+    std::string xml = "<compatibility-matrix " + kMetaVersionStr +
+                      R"( type="framework" level="3">
+    <kernel version="4.4.107" level="3">
+        <config>
+            <key>CONFIG_A</key>
+            <value type="tristate">y</value>
+        </config>
+        <config>
+            <key>CONFIG_B</key>
+            <value type="string">"foo bar"</value>
+        </config>
+        <config>
+            <key>CONFIG_C</key>
+            <value type="int">-16</value>
+        </config>
+        <config>
+            <key>CONFIG_D</key>
+            <value type="range">1-0xffffffffffffffff</value>
+        </config>
+    </kernel>
+    <kernel version="4.4.107" level="3">
+        <conditions>
+            <config>
+                <key>CONFIG_ARM</key>
+                <value type="tristate">y</value>
+            </config>
+        </conditions>
+        <config>
+            <key>CONFIG_E</key>
+            <value type="tristate">m</value>
+        </config>
+    </kernel>
+    <kernel version="4.9.0"/>
+</compatibility-matrix>
+)";
+    CompatibilityMatrix expected;
+    ASSERT_TRUE(fromXml(&expected, xml, &error)) << error;
+    std::string table =
+        KernelRequirementTable::write(getKernels(expected), SerializeFlags::EVERYTHING, xml);
+    EXPECT_TRUE(KernelRequirementTable::matches(table, xml));
+    EXPECT_FALSE(KernelRequirementTable::matches(table, xml + "\n"));
+
+    CompatibilityMatrix cm;
+    ASSERT_TRUE(fromXmlWithoutKernels(&cm, xml, &error)) << error;
+    EXPECT_TRUE(getKernels(cm).empty());
+    ASSERT_TRUE(KernelRequirementTable::read(table, &getKernels(cm), &error)) << error;
+    EXPECT_EQ(expected, cm);
+    EXPECT_EQ(toXml(expected), toXml(cm));
+
+    // Flags that change the <kernel>s in the XML change the table the same way.
+    auto flags = SerializeFlags::EVERYTHING.disableKernelConfigs().disableKernelMinorRevision();
+    std::string flagsXml = toXml(expected, flags);
+    ASSERT_TRUE(fromXml(&expected, flagsXml, &error)) << error;
+    table = KernelRequirementTable::write(getKernels(cm), flags, flagsXml);
+    ASSERT_TRUE(KernelRequirementTable::read(table, &getKernels(cm), &error)) << error;
+    EXPECT_EQ(toXml(expected), toXml(cm));
+
+    for (size_t size : {size_t{0}, size_t{8}, table.size() - 1}) {
+        EXPECT_FALSE(KernelRequirementTable::read(table.substr(0, size), &getKernels(cm), &error))
+            << "table truncated to " << size << " bytes should be rejected";
+    }
+    EXPECT_FALSE(KernelRequirementTable::read(table + "x", &getKernels(cm), &error));
+    EXPECT_EQ(toXml(expected), toXml(cm)) << "kernels should be unchanged on error";
+
+    // The level of the first kernel follows the 40-byte header and its three version numbers.
+    std::string unknownLevelTable = table;
+    uint64_t unknownLevel = 12345;
+    memcpy(unknownLevelTable.data() + 40 + 3 * sizeof(uint64_t), &unknownLevel,
+           sizeof(unknownLevel));
+    EXPECT_FALSE(KernelRequirementTable::read(unknownLevelTable, &getKernels(cm), &error));
+    EXPECT_IN("unknown level 12345", error);
+}
+
 // Run KernelConfigParserInvalidTest on processComments = {true, false}
 class KernelConfigParserInvalidTest : public ::testing::TestWithParam<bool> {};
 
@@ -3784,6 +4039,62 @@ TEST_F(LibVintfTest, ParsingHalsInetTransport) {
     EXPECT_EQ(12, *foo.front()->port());
 }
 
+TEST_F(LibVintfTest, PackedManifestInstances) {
+    std::string error;
+    HalManifest manifest;
+    std::string manifestXml =
+        "<manifest " + kMetaVersionStr + " type=\"device\">\n"
+        "    <hal format=\"hidl\">\n"
+        "        <name>android.hardware.foo</name>\n"
+        "        <transport arch=\"32+64\">passthrough</transport>\n"
+        "        <fqname>@1.0::IFoo/default</fqname>\n"
+        "        <fqname>@1.1::IFoo/slot1</fqname>\n"
+        "    </hal>\n"
+        "    <hal format=\"aidl\" updatable-via-apex=\"com.android.bar\">\n"
+        "        <name>android.hardware.bar</name>\n"
+        "        <accessor>android.os.IAccessor/android.hardware.bar.IBar/default</accessor>\n"
+        "        <version>2</version>\n"
+        "        <fqname>IBar/default</fqname>\n"
+        "    </hal>\n"
+        "    <hal format=\"aidl\">\n"
+        "        <name>android.hardware.baz</name>\n"
+        "        <transport ip=\"1.2.3.4\" port=\"12\">inet</transport>\n"
+        "        <fqname>IBaz/default</fqname>\n"
+        "    </hal>\n"
+        "    <hal format=\"native\">\n"
+        "        <name>mapper</name>\n"
+        "        <version>5.0</version>\n"
+        "        <interface>\n"
+        "            <instance>minigbm</instance>\n"
+        "        </interface>\n"
+        "    </hal>\n"
+        "</manifest>\n";
+    ASSERT_TRUE(fromXml(&manifest, manifestXml, &error)) << error;
+
+    details::PackedManifestInstances packed;
+    std::vector<ManifestInstance> instances;
+    manifest.forEachInstance([&](const ManifestInstance& manifestInstance) {
+        auto index = packed.add(manifestInstance);
+        EXPECT_TRUE(index.has_value()) << manifestInstance.description();
+        EXPECT_EQ(instances.size(), index);
+        instances.push_back(manifestInstance);
+        return true;
+    });
+    ASSERT_EQ(5u, packed.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        ManifestInstance unpacked = packed.get(i);
+        EXPECT_TRUE(instances[i] == unpacked)
+            << instances[i].description() << " vs. " << unpacked.description();
+        EXPECT_EQ(instances[i].ip(), unpacked.ip());
+        EXPECT_EQ(instances[i].port(), unpacked.port());
+    }
+    EXPECT_LT(packed.memoryUsage(), details::unpackedMemoryUsage(instances));
+
+    // Versions must fit in 16 bits.
+    auto tooLarge = instances.front().withVersion(Version{1, 70000});
+    EXPECT_FALSE(packed.add(tooLarge).has_value());
+}
+
 TEST_F(LibVintfTest, ParsingHalsInetTransportWithInterface) {
     std::string error;
 
@@ -4412,6 +4723,172 @@ TEST_F(LibVintfTest, RegexInstanceCompat) {
     }
 }
 
+// Each provided instance must satisfy the minimum minor version on its own.
+TEST_F(LibVintfTest, RegexInstanceCompatMinorVersion) {
+    CompatibilityMatrix matrix;
+    std::string error;
+
+    std::string matrixXml =
+        "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\">\n"
+        "    <hal format=\"hidl\" optional=\"false\">\n"
+        "        <name>android.hardware.foo</name>\n"
+        "        <version>3.1-2</version>\n"
+        "        <interface>\n"
+        "            <name>IFoo</name>\n"
+        "            <instance>default</instance>\n"
+        "            <regex-instance>legacy/[0-9]+</regex-instance>\n"
+        "        </interface>\n"
+        "    </hal>\n"
+        "    <sepolicy>\n"
+        "        <kernel-sepolicy-version>0</kernel-sepolicy-version>\n"
+        "        <sepolicy-version>0</sepolicy-version>\n"
+        "    </sepolicy>\n"
+        "</compatibility-matrix>\n";
+    EXPECT_TRUE(fromXml(&matrix, matrixXml, &error)) << error;
+
+    auto manifestXml = [](const std::string& fqnames) {
+        return "<manifest " + kMetaVersionStr + " type=\"device\">\n"
+               "    <hal format=\"hidl\">\n"
+               "        <name>android.hardware.foo</name>\n"
+               "        <transport>hwbinder</transport>\n" +
+               fqnames +
+               "    </hal>\n"
+               "</manifest>\n";
+    };
+
+    {
+        HalManifest manifest;
+        EXPECT_TRUE(fromXml(&manifest,
+                            manifestXml("        <fqname>@3.2::IFoo/default</fqname>\n"
+                                        "        <fqname>@3.0::IFoo/legacy/0</fqname>\n"
+                                        "        <fqname>@4.1::IFoo/legacy/1</fqname>\n"),
+                            &error))
+            << error;
+        EXPECT_FALSE(manifest.checkCompatibility(matrix, &error))
+            << "Should not be compatible because legacy/[0-9]+ is not provided at 3.1+";
+        EXPECT_IN("required: (@3.1-2::IFoo/default AND @3.1-2::IFoo/legacy/[0-9]+)", error);
+        EXPECT_IN("provided: \n"
+                  "        @3.0::IFoo/legacy/0\n"
+                  "        @3.2::IFoo/default\n"
+                  "        @4.1::IFoo/legacy/1",
+                  error);
+    }
+
+    {
+        HalManifest manifest;
+        EXPECT_TRUE(fromXml(&manifest,
+                            manifestXml("        <fqname>@3.2::IFoo/default</fqname>\n"
+                                        "        <fqname>@3.0::IFoo/legacy/0</fqname>\n"
+                                        "        <fqname>@3.3::IFoo/legacy/5</fqname>\n"),
+                            &error))
+            << error;
+        EXPECT_TRUE(manifest.checkCompatibility(matrix, &error)) << error;
+    }
+}
+
+// Only HALs that are not compatible are described.
+TEST_F(LibVintfTest, CheckIncompatibleHalsOnlyDescribesFailures) {
+    std::string error;
+    CompatibilityMatrix matrix;
+    std::string matrixXml =
+        "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\">\n"
+        "    <hal format=\"aidl\" optional=\"false\">\n"
+        "        <name>android.hardware.bar</name>\n"
+        "        <interface>\n"
+        "            <name>IBar</name>\n"
+        "            <instance>default</instance>\n"
+        "        </interface>\n"
+        "    </hal>\n"
+        "    <hal format=\"aidl\" optional=\"false\">\n"
+        "        <name>android.hardware.foo</name>\n"
+        "        <interface>\n"
+        "            <name>IFoo</name>\n"
+        "            <instance>default</instance>\n"
+        "        </interface>\n"
+        "    </hal>\n"
+        "    <hal format=\"aidl\" optional=\"true\">\n"
+        "        <name>android.hardware.optional</name>\n"
+        "        <interface>\n"
+        "            <name>IOptional</name>\n"
+        "            <instance>default</instance>\n"
+        "        </interface>\n"
+        "    </hal>\n"
+        "</compatibility-matrix>\n";
+    ASSERT_TRUE(fromXml(&matrix, matrixXml, &error)) << error;
+
+    HalManifest manifest;
+    std::string manifestXml =
+        "<manifest " + kMetaVersionStr + " type=\"device\">\n"
+        "    <hal format=\"aidl\">\n"
+        "        <name>android.hardware.foo</name>\n"
+        "        <fqname>IFoo/default</fqname>\n"
+        "    </hal>\n"
+        "</manifest>\n";
+    ASSERT_TRUE(fromXml(&manifest, manifestXml, &error)) << error;
+
+    EXPECT_TRUE(hasIncompatibleHals(manifest, matrix));
+    auto incompatibleHals = checkIncompatibleHals(manifest, matrix);
+    ASSERT_EQ(1u, incompatibleHals.size());
+    EXPECT_IN("android.hardware.bar:\n    required: IBar/default (@1)", incompatibleHals[0]);
+
+    ASSERT_TRUE(fromXml(&manifest,
+                        "<manifest " + kMetaVersionStr + " type=\"device\">\n"
+                        "    <hal format=\"aidl\">\n"
+                        "        <name>android.hardware.bar</name>\n"
+                        "        <fqname>IBar/default</fqname>\n"
+                        "    </hal>\n"
+                        "</manifest>\n",
+                        &error))
+        << error;
+    EXPECT_FALSE(hasIncompatibleHals(manifest, matrix));
+    EXPECT_TRUE(checkIncompatibleHals(manifest, matrix).empty());
+}
+
+TEST_F(LibVintfTest, FqInstanceParseAndCompare) {
+    std::vector<std::string> strings = {
+        "android.hardware.foo@1.0::IFoo/default",
+        "android.hardware.foo@1.0::IFoo/default1",
+        "android.hardware.foo@1.0::IFoo.Type/default",
+        "android.hardware.foo@1.0/default",
+        "android.hardware.foo@1.10::IFoo/default",
+        "android.hardware.foo@1.2::IFoo/default",
+        "android.hardware.foo@10.0::IFoo/default",
+        "android.hardware.foo.bar@1.0::IFoo/default",
+        "@1.0::IFoo/default",
+        "@1.0/default",
+        "IFoo/default",
+    };
+    std::vector<FqInstance> fqInstances;
+    for (const auto& s : strings) {
+        auto fqInstance = FqInstance::from(s);
+        ASSERT_TRUE(fqInstance.has_value()) << s;
+        EXPECT_EQ(s, fqInstance->string());
+        fqInstances.push_back(*fqInstance);
+    }
+    for (const auto& a : fqInstances) {
+        for (const auto& b : fqInstances) {
+            EXPECT_EQ(a.string() < b.string(), a < b) << a.string() << " < " << b.string();
+            EXPECT_EQ(a.string() == b.string(), a == b) << a.string() << " == " << b.string();
+        }
+    }
+
+    for (const auto& s : {"android.hardware.foo@1.0::IFoo", "android.hardware.foo@01.0::IFoo",
+                          "android.hardware.foo::IFoo/default", "android.hardware.foo@1.0:IFoo",
+                          "android.hardware.foo@99999999999999999999.0::IFoo/default",
+                          "@1.0::IFoo", "IFoo/", "/default", ""}) {
+        EXPECT_FALSE(FqInstance::from(s).has_value()) << s;
+    }
+
+    auto fqInstance = FqInstance::from("android.hardware.foo@1.0::IFoo/default");
+    ASSERT_TRUE(fqInstance.has_value());
+    EXPECT_EQ("IFoo", fqInstance->getInterface());
+    EXPECT_TRUE(fqInstance->inPackage("android"));
+    EXPECT_TRUE(fqInstance->inPackage("android.hardware.foo"));
+    EXPECT_FALSE(fqInstance->inPackage("android.hardware.fo"));
+    EXPECT_FALSE(fqInstance->inPackage("android.hardware.foo.bar"));
+    EXPECT_EQ("", FqInstance::from("android.hardware.foo@1.0/default")->getInterface());
+}
+
 TEST_F(LibVintfTest, Regex) {
     details::Regex regex;
 
@@ -6133,6 +6610,149 @@ INSTANTIATE_TEST_SUITE_P(LibVintfTest, AllowDupMajorVersionTest,
                          ::testing::ValuesIn(AllowDupMajorVersionTest::createParams()),
                          &AllowDupMajorVersionTest::getTestSuffix);
 
+// Conflicts are detected against HALs that were added before the manifest is copied or
+// before HALs are overridden.
+TEST_F(LibVintfTest, AddAllConflictAfterCopyAndOverride) {
+    auto fragment = [](const std::string& hal) {
+        HalManifest manifest;
+        std::string error;
+        EXPECT_TRUE(fromXml(&manifest,
+                            "<manifest " + kMetaVersionStr + " type=\"device\">" + hal +
+                                "</manifest>",
+                            &error))
+            << error;
+        return manifest;
+    };
+    auto nfc = [](const std::string& fqname, bool override = false) {
+        return std::string("<hal") + (override ? " override=\"true\"" : "") +
+               "><name>android.hardware.nfc</name><transport>hwbinder</transport>"
+               "<fqname>" + fqname + "</fqname></hal>";
+    };
+    std::string error;
+
+    HalManifest manifest = fragment(nfc("@1.0::INfc/default"));
+    for (const auto& fqname : {"@2.0::INfc/default", "@3.0::INfc/default"}) {
+        HalManifest other = fragment(nfc(fqname));
+        ASSERT_TRUE(manifest.addAll(&other, &error)) << error;
+    }
+
+    HalManifest copy = manifest;
+    HalManifest conflicting = fragment(nfc("@1.1::INfc/default"));
+    EXPECT_FALSE(copy.addAll(&conflicting, &error));
+    EXPECT_IN("Conflicting FqInstance: @1.0::INfc/default vs. @1.1::INfc/default", error);
+
+    HalManifest overriding = fragment(nfc("@1.1::INfc/default", true /* override */));
+    ASSERT_TRUE(manifest.addAll(&overriding, &error)) << error;
+    conflicting = fragment(nfc("@1.2::INfc/default"));
+    EXPECT_FALSE(manifest.addAll(&conflicting, &error));
+    EXPECT_IN("Conflicting FqInstance: @1.1::INfc/default vs. @1.2::INfc/default", error);
+
+    HalManifest compatible = fragment(nfc("@1.0::INfc/foo"));
+    EXPECT_TRUE(manifest.addAll(&compatible, &error)) << error;
+    EXPECT_EQ((std::set<std::string>{"default", "foo"}),
+              manifest.getHidlInstances("android.hardware.nfc", {1, 0}, "INfc"));
+
+    // Instances inserted into an existing HAL are seen by later conflict checks.
+    FqInstance fqInstance;
+    ASSERT_TRUE(fqInstance.setTo("android.hardware.nfc@4.0::INfc/default"));
+    ASSERT_TRUE(manifest.insertInstance(fqInstance, Transport::HWBINDER, Arch::ARCH_EMPTY,
+                                        HalFormat::HIDL, &error))
+        << error;
+    conflicting = fragment(nfc("@4.1::INfc/default"));
+    EXPECT_FALSE(manifest.addAll(&conflicting, &error));
+    EXPECT_IN("Conflicting FqInstance: @4.0::INfc/default vs. @4.1::INfc/default", error);
+}
+
+TEST_F(LibVintfTest, AddAllConflictAfterMove) {
+    auto fragment = [](const std::string& fqname) {
+        HalManifest manifest;
+        std::string error;
+        EXPECT_TRUE(fromXml(&manifest,
+                            "<manifest " + kMetaVersionStr +
+                                " type=\"device\"><hal><name>android.hardware.nfc</name>"
+                                "<transport>hwbinder</transport><fqname>" +
+                                fqname + "</fqname></hal></manifest>",
+                            &error))
+            << error;
+        return manifest;
+    };
+    std::string error;
+
+    // Adding @2.0 builds the conflict index of |manifest|.
+    HalManifest manifest = fragment("@1.0::INfc/default");
+    HalManifest other = fragment("@2.0::INfc/default");
+    ASSERT_TRUE(manifest.addAll(&other, &error)) << error;
+
+    {
+        HalManifest moved = std::move(manifest);
+        HalManifest conflicting = fragment("@1.1::INfc/default");
+        EXPECT_FALSE(moved.addAll(&conflicting, &error));
+        EXPECT_IN("Conflicting FqInstance: @1.0::INfc/default vs. @1.1::INfc/default", error);
+
+        // The moved-from manifest has no HALs and must not check conflicts against the HALs
+        // of |moved|.
+        HalManifest notConflicting = fragment("@1.1::INfc/default");
+        EXPECT_TRUE(manifest.addAll(&notConflicting, &error)) << error;
+
+        HalManifest assigned;
+        assigned = std::move(moved);
+        conflicting = fragment("@2.1::INfc/default");
+        EXPECT_FALSE(assigned.addAll(&conflicting, &error));
+        EXPECT_IN("Conflicting FqInstance: @2.0::INfc/default vs. @2.1::INfc/default", error);
+    }
+
+    // The HALs of |moved| are gone; the index of |manifest| only refers to its own HALs.
+    HalManifest conflicting = fragment("@1.2::INfc/default");
+    EXPECT_FALSE(manifest.addAll(&conflicting, &error));
+    EXPECT_IN("Conflicting FqInstance: @1.1::INfc/default vs. @1.2::INfc/default", error);
+    HalManifest notConflicting = fragment("@2.0::INfc/default");
+    EXPECT_TRUE(manifest.addAll(&notConflicting, &error)) << error;
+}
+
+TEST_F(LibVintfTest, AddAllFromArena) {
+    // The fragments must fit in |buffer|, which is scribbled over once the arena is gone.
+    constexpr std::byte kScribble{0xa5};
+    std::vector<std::byte> buffer(64 * 1024, kScribble);
+    auto bufferUsed = [&buffer] {
+        return std::any_of(buffer.begin(), buffer.end(), [](auto b) { return b != kScribble; });
+    };
+    std::string manifestXml =
+        "<manifest " + kMetaVersionStr + " type=\"device\">"
+        "<hal format=\"aidl\"><name>android.hardware.foo</name><fqname>IFoo/default</fqname>"
+        "</hal><hal><name>android.hardware.nfc</name><transport>hwbinder</transport>"
+        "<fqname>@1.0::INfc/default</fqname><fqname>@1.0::INfc/nfc</fqname></hal></manifest>";
+    std::string matrixXml =
+        "<compatibility-matrix " + kMetaVersionStr + " type=\"framework\">"
+        "<hal format=\"aidl\"><name>android.hardware.foo</name><interface><name>IFoo</name>"
+        "<instance>default</instance><regex-instance>.*</regex-instance></interface></hal>"
+        "</compatibility-matrix>";
+    std::string error;
+
+    HalManifest manifest;
+    CompatibilityMatrix matrix;
+    {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(),
+                                                  std::pmr::null_memory_resource());
+        HalManifest manifestFragment(&arena);
+        ASSERT_TRUE(fromXml(&manifestFragment, manifestXml, &error)) << error;
+        CompatibilityMatrix matrixFragment(&arena);
+        ASSERT_TRUE(fromXml(&matrixFragment, matrixXml, &error)) << error;
+        EXPECT_TRUE(bufferUsed());
+
+        ASSERT_TRUE(manifest.addAll(&manifestFragment, &error)) << error;
+        ASSERT_TRUE(addAll(&matrix, &matrixFragment, &error)) << error;
+    }
+    std::fill(buffer.begin(), buffer.end(), kScribble);
+
+    HalManifest expectedManifest;
+    ASSERT_TRUE(fromXml(&expectedManifest, manifestXml, &error)) << error;
+    EXPECT_EQ(toXml(expectedManifest), toXml(manifest));
+    CompatibilityMatrix expectedMatrix;
+    ASSERT_TRUE(fromXml(&expectedMatrix, matrixXml, &error)) << error;
+    EXPECT_EQ(toXml(expectedMatrix), toXml(matrix));
+    EXPECT_FALSE(bufferUsed());
+}
+
 struct InterfaceMissingInstanceTestParam {
     HalFormat format;
     std::string footer;
@@ -6275,6 +6895,7 @@ struct FrameworkCompatibilityMatrixCombineTest : public LibVintfTest {
                                                  std::string* errorPtr) {
         return CompatibilityMatrix::combine(deviceLevel, kernellevel, theMatrices, errorPtr);
     }
+    using Combiner = CompatibilityMatrix::Combiner;
 
     std::vector<CompatibilityMatrix> matrices;
     std::string error;
@@ -6544,6 +7165,67 @@ TEST_P(FcmCombineKernelTest, OlderKernel) {
     if (::testing::Test::HasFailure()) ADD_FAILURE() << "Resulting matrix is \n" << combinedXml;
 }
 
+// Combining fragments one at a time gives the same matrix as combining all of them at once.
+TEST_P(FcmCombineKernelTest, Combiner) {
+    auto [deviceLevelNum, kernelLevelNum] = GetParam();
+
+    constexpr auto fmt = R"(
+        <compatibility-matrix %s type="framework" level="%zu">
+            <hal format="hidl" optional="false">
+                <name>android.system.foo</name>
+                <version>%zu.0</version>
+                <interface>
+                    <name>IFoo</name>
+                    <instance>default</instance>
+                    <instance>slot%zu</instance>
+                </interface>
+            </hal>
+            <kernel version="%zu.0.0">
+                <config>
+                    <key>CONFIG_%zu</key>
+                    <value type="tristate">y</value>
+                </config>
+            </kernel>
+        </compatibility-matrix>
+    )";
+    std::string error;
+    std::vector<CompatibilityMatrix> matrices;
+    Combiner combiner{Level(deviceLevelNum), Level(kernelLevelNum)};
+    // Add in reverse order to check that fragments are sorted.
+    for (size_t levelNum = kMaxLevel; levelNum >= kMinLevel; --levelNum) {
+        auto xml = StringPrintf(fmt, kMetaVersionStr.c_str(), levelNum, levelNum, levelNum,
+                                levelNum, levelNum);
+        CompatibilityMatrix& matrix = matrices.emplace_back();
+        ASSERT_TRUE(fromXml(&matrix, xml, &error)) << error;
+        CompatibilityMatrix fragment;
+        ASSERT_TRUE(fromXml(&fragment, xml, &error)) << error;
+        ASSERT_TRUE(combiner.add(std::move(fragment), &error)) << error;
+    }
+
+    auto expected = combine(Level(deviceLevelNum), Level(kernelLevelNum), &matrices, &error);
+    ASSERT_NE(nullptr, expected) << error;
+    auto combined = combiner.combine(&error);
+    ASSERT_NE(nullptr, combined) << error;
+    EXPECT_EQ(toXml(*expected), toXml(*combined));
+
+    // combine() leaves the input sorted by level.
+    for (size_t i = 1; i < matrices.size(); ++i) {
+        EXPECT_LE(matrices[i - 1].level(), matrices[i].level());
+    }
+}
+
+TEST_F(FrameworkCompatibilityMatrixCombineTest, CombinerRejectsDeviceMatrix) {
+    Combiner combiner(Level{1}, Level::UNSPECIFIED);
+    CompatibilityMatrix deviceMatrix;
+    ASSERT_TRUE(fromXml(&deviceMatrix,
+                        "<compatibility-matrix " + kMetaVersionStr + " type=\"device\"/>",
+                        &error))
+        << error;
+    deviceMatrix.setFileName("device_compatibility_matrix.xml");
+    EXPECT_FALSE(combiner.add(std::move(deviceMatrix), &error));
+    EXPECT_IN("\"device_compatibility_matrix.xml\" is not a framework compatibility matrix", error);
+}
+
 INSTANTIATE_TEST_CASE_P(
     FrameworkCompatibilityMatrixCombineTest, FcmCombineKernelTest,
     Combine(Range(FcmCombineKernelTest::kMinLevel, FcmCombineKernelTest::kMaxLevel + 1),
@@ -6658,6 +7340,712 @@ TEST_F(DeviceCompatibilityMatrixCombineTest, AidlAndHidlNames) {
 
 // clang-format on
 
+// details::XmlWriter must produce the same output as tinyxml2::XMLPrinter, which was used
+// by toXml() before.
+TEST_F(LibVintfTest, XmlWriterMatchesTinyXml2Printer) {
+    tinyxml2::XMLDocument doc;
+    tinyxml2::XMLElement* root = doc.NewElement("root");
+    doc.InsertEndChild(root);
+    root->SetAttribute("escaped", "&<>\"'");
+    tinyxml2::XMLElement* text = doc.NewElement("text");
+    text->InsertEndChild(doc.NewText("a & b < c > d \" e ' f \xE4\xB8\xAD"));
+    root->InsertEndChild(text);
+    root->InsertEndChild(doc.NewElement("empty"));
+    tinyxml2::XMLElement* emptyText = doc.NewElement("empty-text");
+    emptyText->InsertEndChild(doc.NewText(""));
+    root->InsertEndChild(emptyText);
+    tinyxml2::XMLElement* nested = doc.NewElement("nested");
+    tinyxml2::XMLElement* inner = doc.NewElement("inner");
+    inner->SetAttribute("x", "1");
+    inner->InsertEndChild(doc.NewText("in"));
+    nested->InsertEndChild(inner);
+    nested->SetAttribute("after-child", "2");
+    root->InsertEndChild(nested);
+    root->SetAttribute("after-children", "3");
+    tinyxml2::XMLPrinter printer;
+    doc.Print(&printer);
+
+    details::XmlWriter writer;
+    auto writerRoot = writer.openElement("root");
+    writer.addAttribute(writerRoot, "escaped", "&<>\"'");
+    auto writerText = writer.openElement("text");
+    writer.addText(writerText, "a & b < c > d \" e ' f \xE4\xB8\xAD");
+    writer.closeElement(writerText);
+    writer.closeElement(writer.openElement("empty"));
+    auto writerEmptyText = writer.openElement("empty-text");
+    writer.addText(writerEmptyText, "");
+    writer.closeElement(writerEmptyText);
+    auto writerNested = writer.openElement("nested");
+    auto writerInner = writer.openElement("inner");
+    writer.addAttribute(writerInner, "x", "1");
+    writer.addText(writerInner, "in");
+    writer.closeElement(writerInner);
+    writer.addAttribute(writerNested, "after-child", "2");
+    writer.closeElement(writerNested);
+    writer.addAttribute(writerRoot, "after-children", "3");
+    writer.closeElement(writerRoot);
+
+    EXPECT_EQ(printer.CStr(), writer.release());
+}
+
+// Differential tests between tinyxml2 and details::XmlPullDocument, the two
+// backends of fromXml(). Each input must either be rejected by both, or produce
+// the same element tree as seen through the parse_xml.cpp accessors.
+struct XmlPullParserDiffTest : public ::testing::TestWithParam<std::string> {
+    void expectSameElement(const tinyxml2::XMLElement* expected,
+                           const details::XmlPullElement* actual, const std::string& path) {
+        ASSERT_NE(nullptr, actual) << path;
+        EXPECT_EQ(expected->Name(), actual->name()) << path;
+
+        std::vector<std::pair<std::string, std::string>> expectedAttrs, actualAttrs;
+        for (auto a = expected->FirstAttribute(); a != nullptr; a = a->Next()) {
+            expectedAttrs.emplace_back(a->Name(), a->Value());
+        }
+        for (auto a = actual->firstAttribute(); a != nullptr; a = a->next()) {
+            actualAttrs.emplace_back(a->name(), a->value());
+        }
+        EXPECT_EQ(expectedAttrs, actualAttrs) << path;
+
+        const char* expectedText = expected->GetText();
+        const std::string_view* actualText = actual->text();
+        EXPECT_EQ(expectedText != nullptr, actualText != nullptr) << path;
+        if (expectedText != nullptr && actualText != nullptr) {
+            EXPECT_EQ(expectedText, *actualText) << path;
+        }
+
+        auto actualChild = actual->firstChildElement();
+        for (auto child = expected->FirstChildElement(); child != nullptr;
+             child = child->NextSiblingElement()) {
+            expectSameElement(child, actualChild, path + "/" + child->Name());
+            if (actualChild == nullptr) return;
+            actualChild = actualChild->nextSiblingElement();
+        }
+        EXPECT_EQ(nullptr, actualChild) << path << ": extra element <" << actualChild->name()
+                                        << ">";
+    }
+};
+
+TEST_P(XmlPullParserDiffTest, SameTree) {
+    const std::string& xml = GetParam();
+    tinyxml2::XMLDocument expected;
+    bool expectedOk = expected.Parse(xml.c_str()) == tinyxml2::XML_SUCCESS;
+    details::XmlPullDocument actual;
+    bool actualOk = actual.parse(xml);
+    ASSERT_EQ(expectedOk, actualOk) << xml;
+    if (!expectedOk) return;
+
+    const tinyxml2::XMLElement* expectedRoot = expected.FirstChildElement();
+    const details::XmlPullElement* actualRoot = actual.rootElement();
+    ASSERT_EQ(expectedRoot != nullptr, actualRoot != nullptr) << xml;
+    if (expectedRoot != nullptr) {
+        expectSameElement(expectedRoot, actualRoot, expectedRoot->Name());
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    LibVintfTest, XmlPullParserDiffTest,
+    ::testing::Values(
+        // well-formed
+        "<manifest " + kMetaVersionStr + " type=\"device\">\n"
+        "    <hal format=\"hidl\">\n"
+        "        <name>android.hardware.foo</name>\n"
+        "        <transport arch=\"32+64\">passthrough</transport>\n"
+        "        <fqname>@1.0::IFoo/default</fqname>\n"
+        "    </hal>\n"
+        "    <sepolicy>\n"
+        "        <version>25.5</version>\n"
+        "    </sepolicy>\n"
+        "</manifest>\n",
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<!-- comment -->\n"
+        "<compatibility-matrix " + kMetaVersionStr + " type='framework' level=\"1\">\n"
+        "    <kernel version=\"3.18.22\">\n"
+        "        <config><key>CONFIG_FOO</key><value type=\"int\">0x10</value></config>\n"
+        "    </kernel>\n"
+        "</compatibility-matrix>",
+        "\xEF\xBB\xBF<a/>",
+        "<a b = \"1\"c='2'/>",
+        "< a></a >",
+        "<a>&lt;&gt;&amp;&quot;&apos;&#65;&#x42;&#x4e2d;&unknown;&#xZZ;</a>",
+        "<a v=\"&lt;x&gt; &amp;amp; \r\n\"/>",
+        "<a>  leading and trailing  </a>",
+        "<a>line1\r\nline2\rline3\n\rline4</a>",
+        "<a><![CDATA[<b>&amp;</b>]]></a>",
+        "<a><!-- comment first -->text</a>",
+        "<a>text<!-- comment -->more</a>",
+        "<a>\n    <b/>text after child</a>",
+        "<a><!DOCTYPE whatever><b/></a>",
+        "<a><b><c>1</c><c>2</c></b><b/><d x=\"y\"/></a>",
+        "<a/><b/>",
+        "text before<a/>",
+        "<!-- only a comment -->",
+        "<a>\xE4\xB8\xAD</a>",
+        std::string("<a>x</a>\0<b>", 12),
+        // malformed
+        "", "   \n", "<a>", "<a></b>", "<a><b></a></b>", "<a b=\"1\" b=\"2\"/>",
+        "<a b=1/>", "<a b/>", "<a b=\"1/>", "<1a/>", "</ a>", "<a/></a>", "<a><?pi?></a>",
+        "<a/><?xml version=\"1.0\"?>", "<a><!-- unterminated </a>",
+        "<a><![CDATA[ unterminated </a>", "<a/>trailing text"));
+
+TEST_F(LibVintfTest, DiffManifests) {
+    std::string error;
+    HalManifest oldManifest;
+    std::string oldXml = "<manifest " + kMetaVersionStr +
+                         R"( type="device" target-level="5">
+    <hal format="hidl">
+        <name>android.hardware.foo</name>
+        <transport>hwbinder</transport>
+        <fqname>@1.0::IFoo/default</fqname>
+        <fqname>@2.0::IFoo/default</fqname>
+    </hal>
+    <hal format="aidl">
+        <name>android.hardware.bar</name>
+        <version>2</version>
+        <fqname>IBar/default</fqname>
+        <fqname>IBar/slot1</fqname>
+    </hal>
+    <sepolicy>
+        <version>202404</version>
+    </sepolicy>
+    <kernel version="4.19.0">
+        <config>
+            <key>CONFIG_A</key>
+            <value>y</value>
+        </config>
+    </kernel>
+</manifest>
+)";
+    ASSERT_TRUE(fromXml(&oldManifest, oldXml, &error)) << error;
+    HalManifest newManifest;
+    std::string newXml = "<manifest " + kMetaVersionStr +
+                         R"( type="device" target-level="5">
+    <hal format="hidl">
+        <name>android.hardware.foo</name>
+        <transport>hwbinder</transport>
+        <fqname>@1.1::IFoo/default</fqname>
+    </hal>
+    <hal format="aidl">
+        <name>android.hardware.bar</name>
+        <version>2</version>
+        <fqname>IBar/default</fqname>
+        <fqname>IBar/slot2</fqname>
+    </hal>
+    <sepolicy>
+        <version>202504</version>
+    </sepolicy>
+    <kernel version="4.19.0">
+        <config>
+            <key>CONFIG_A</key>
+            <value>m</value>
+        </config>
+    </kernel>
+    <xmlfile>
+        <name>media_profile</name>
+        <version>1.0</version>
+    </xmlfile>
+</manifest>
+)";
+    ASSERT_TRUE(fromXml(&newManifest, newXml, &error)) << error;
+
+    EXPECT_TRUE(diff(oldManifest, oldManifest).empty());
+
+    std::vector<std::string> actual;
+    for (const auto& entry : diff(oldManifest, newManifest)) {
+        actual.push_back(to_string(entry));
+    }
+    EXPECT_THAT(actual, ElementsAre(
+        "~ hal hidl android.hardware.foo: versions=1.0,2.0 -> versions=1.1",
+        "- instance aidl android.hardware.bar.IBar/slot1: version=2",
+        "+ instance aidl android.hardware.bar.IBar/slot2: version=2",
+        "~ instance hidl android.hardware.foo@1::IFoo/default: version=1.0 transport=hwbinder"
+        " -> version=1.1 transport=hwbinder",
+        "- instance hidl android.hardware.foo@2::IFoo/default: version=2.0 transport=hwbinder",
+        "~ sepolicy version: 202404 -> 202504",
+        "~ kernel-config CONFIG_A: y -> m",
+        "+ xmlfile media_profile@1.0"));
+
+    auto reversed = diff(newManifest, oldManifest);
+    ASSERT_EQ(actual.size(), reversed.size());
+    EXPECT_EQ(DiffEntry::Type::ADDED, reversed[1].type);
+    EXPECT_EQ(DiffEntry::Type::REMOVED, reversed.back().type);
+}
+
+TEST_F(LibVintfTest, DiffManifestsInAnyOrder) {
+    auto manifest = [](const std::string& fqnames, const std::string& vendorNdks,
+                       const std::string& systemSdk) {
+        std::string xml = "<manifest " + kMetaVersionStr + R"( type="framework">
+    <hal format="hidl">
+        <name>android.hardware.foo</name>
+        <transport>hwbinder</transport>
+        )" + fqnames + R"(
+    </hal>
+    <hal format="aidl">
+        <name>android.hardware.foo</name>
+        <fqname>IFoo/default</fqname>
+    </hal>
+    )" + vendorNdks + R"(
+    <system-sdk>
+        )" + systemSdk + R"(
+    </system-sdk>
+</manifest>
+)";
+        HalManifest ret;
+        std::string error;
+        EXPECT_TRUE(fromXml(&ret, xml, &error)) << error;
+        return ret;
+    };
+    // Instances are stored by version, but keyed by interface before the minor version.
+    HalManifest oldManifest =
+        manifest("<fqname>@1.0::IFoo/default</fqname><fqname>@1.1::IBar/default</fqname>",
+                 "<vendor-ndk><version>28</version></vendor-ndk>"
+                 "<vendor-ndk><version>27</version></vendor-ndk>",
+                 "<version>28</version>");
+    HalManifest reordered =
+        manifest("<fqname>@1.1::IBar/default</fqname><fqname>@1.0::IFoo/default</fqname>",
+                 "<vendor-ndk><version>27</version></vendor-ndk>"
+                 "<vendor-ndk><version>28</version></vendor-ndk>",
+                 "<version>28</version>");
+    EXPECT_TRUE(diff(oldManifest, reordered).empty());
+
+    HalManifest newManifest =
+        manifest("<fqname>@1.0::IFoo/default</fqname><fqname>@1.2::IBar/default</fqname>",
+                 "<vendor-ndk><version>28</version></vendor-ndk>",
+                 "<version>28</version><version>29</version>");
+    std::vector<std::string> actual;
+    for (const auto& entry : diff(oldManifest, newManifest)) {
+        actual.push_back(to_string(entry));
+    }
+    EXPECT_THAT(actual, ElementsAre(
+        "~ hal hidl android.hardware.foo: versions=1.0,1.1 -> versions=1.0,1.2",
+        "~ instance hidl android.hardware.foo@1::IBar/default: version=1.1 transport=hwbinder"
+        " -> version=1.2 transport=hwbinder",
+        "- vendor-ndk 27",
+        "+ system-sdk 29"));
+}
+
+TEST_F(LibVintfTest, DiffMatrices) {
+    std::string error;
+    CompatibilityMatrix oldMatrix;
+    std::string oldXml = "<compatibility-matrix " + kMetaVersionStr +
+                         R"( type="framework" level="8">
+    <hal format="aidl">
+        <name>android.hardware.foo</name>
+        <version>1-2</version>
+        <interface>
+            <name>IFoo</name>
+            <instance>default</instance>
+            <regex-instance>slot[0-9]+</regex-instance>
+        </interface>
+    </hal>
+    <kernel version="5.15.0">
+        <config>
+            <key>CONFIG_A</key>
+            <value type="tristate">y</value>
+        </config>
+    </kernel>
+    <sepolicy>
+        <kernel-sepolicy-version>30</kernel-sepolicy-version>
+        <sepolicy-version>202404</sepolicy-version>
+    </sepolicy>
+</compatibility-matrix>
+)";
+    ASSERT_TRUE(fromXml(&oldMatrix, oldXml, &error)) << error;
+    CompatibilityMatrix newMatrix;
+    std::string newXml = "<compatibility-matrix " + kMetaVersionStr +
+                         R"( type="framework" level="8">
+    <hal format="aidl">
+        <name>android.hardware.foo</name>
+        <version>1-3</version>
+        <interface>
+            <name>IFoo</name>
+            <instance>default</instance>
+        </interface>
+    </hal>
+    <kernel version="5.15.0">
+        <config>
+            <key>CONFIG_A</key>
+            <value type="tristate">y</value>
+        </config>
+    </kernel>
+    <kernel version="5.15.0">
+        <conditions>
+            <config>
+                <key>CONFIG_ARM64</key>
+                <value type="tristate">y</value>
+            </config>
+        </conditions>
+        <config>
+            <key>CONFIG_B</key>
+            <value type="int">16</value>
+        </config>
+    </kernel>
+    <sepolicy>
+        <kernel-sepolicy-version>30</kernel-sepolicy-version>
+        <sepolicy-version>202404</sepolicy-version>
+    </sepolicy>
+</compatibility-matrix>
+)";
+    ASSERT_TRUE(fromXml(&newMatrix, newXml, &error)) << error;
+
+    EXPECT_TRUE(diff(newMatrix, newMatrix).empty());
+
+    std::vector<std::string> actual;
+    for (const auto& entry : diff(oldMatrix, newMatrix)) {
+        actual.push_back(to_string(entry));
+    }
+    EXPECT_THAT(actual, ElementsAre(
+        "~ hal aidl android.hardware.foo: versions=1-2 optional -> versions=1-3 optional",
+        "~ instance aidl android.hardware.foo.IFoo/default: version=1-2 optional"
+        " -> version=1-3 optional",
+        "- instance aidl android.hardware.foo.IFoo/regex:slot[0-9]+: version=1-2 optional",
+        "+ kernel 5.15.0 if CONFIG_ARM64=y",
+        "+ kernel-config 5.15.0 if CONFIG_ARM64=y CONFIG_B: 16"));
+
+    // Kernels are told apart by the level of the matrix they come from.
+    auto kernelsAtLevels = [](const std::vector<Level>& levels) {
+        std::string xml = "<compatibility-matrix " + kMetaVersionStr + R"( type="framework">)";
+        for (Level level : levels) {
+            xml += "<kernel version=\"5.15.0\" level=\"" + to_string(level) + "\"/>";
+        }
+        xml += "</compatibility-matrix>";
+        CompatibilityMatrix matrix;
+        std::string error;
+        EXPECT_TRUE(fromXml(&matrix, xml, &error)) << error;
+        return matrix;
+    };
+    actual.clear();
+    for (const auto& entry :
+         diff(kernelsAtLevels({Level::U, Level::V}), kernelsAtLevels({Level::V, Level::W}))) {
+        if (entry.section == "kernel") actual.push_back(to_string(entry));
+    }
+    // Kernels are ordered by version and then by level.
+    EXPECT_THAT(actual, ElementsAre("- kernel 5.15.0 level=" + to_string(Level::U),
+                                    "+ kernel 5.15.0 level=" + to_string(Level::W)));
+}
+
+// Records each visited value as "path=value", where path is the list of enclosing names.
+class PathRecorder : public ContentVisitor {
+   public:
+    std::vector<std::string> values;
+
+    void beginObject(std::string_view name) override { mPath.emplace_back(name); }
+    void endObject() override { mPath.pop_back(); }
+    void beginArray(std::string_view name) override { mPath.emplace_back(name); }
+    void endArray() override { mPath.pop_back(); }
+    void visitString(std::string_view name, std::string_view value) override {
+        record(name, std::string(value));
+    }
+    void visitUint(std::string_view name, uint64_t value) override {
+        record(name, std::to_string(value));
+    }
+    void visitBool(std::string_view name, bool value) override {
+        record(name, value ? "true" : "false");
+    }
+
+   private:
+    void record(std::string_view name, const std::string& value) {
+        std::string path = android::base::Join(mPath, "/");
+        values.push_back(path + "/" + std::string(name) + "=" + value);
+    }
+    std::vector<std::string> mPath;
+};
+
+std::string contentManifestXml() {
+    return "<manifest " + kMetaVersionStr + R"( type="device" target-level="5">
+    <hal format="aidl">
+        <name>android.hardware.foo</name>
+        <version>2</version>
+        <fqname>IFoo/default</fqname>
+    </hal>
+    <kernel version="5.10.1">
+        <config>
+            <key>CONFIG_A</key>
+            <value>y</value>
+        </config>
+    </kernel>
+</manifest>
+)";
+}
+
+std::string contentMatrixXml() {
+    return "<compatibility-matrix " + kMetaVersionStr + R"( type="framework" level="8">
+    <hal format="aidl" optional="true">
+        <name>android.hardware.foo</name>
+        <version>1-2</version>
+        <interface>
+            <name>IFoo</name>
+            <regex-instance>slot[0-9]+</regex-instance>
+        </interface>
+    </hal>
+    <kernel version="5.15.0">
+        <config>
+            <key>CONFIG_B</key>
+            <value type="int">16</value>
+        </config>
+    </kernel>
+    <sepolicy>
+        <kernel-sepolicy-version>30</kernel-sepolicy-version>
+        <sepolicy-version>202404</sepolicy-version>
+    </sepolicy>
+</compatibility-matrix>
+)";
+}
+
+TEST_F(LibVintfTest, VisitManifestContent) {
+    std::string error;
+    HalManifest manifest;
+    ASSERT_TRUE(fromXml(&manifest, contentManifestXml(), &error)) << error;
+
+    PathRecorder recorder;
+    visitContent(manifest, &recorder);
+    EXPECT_THAT(recorder.values, IsSupersetOf({
+        "manifest/type=device",
+        "manifest/target-level=5",
+        "manifest/hals//format=aidl",
+        "manifest/hals//name=android.hardware.foo",
+        "manifest/hals//versions/=2",
+        "manifest/hals//instances//version=2",
+        "manifest/hals//instances//interface=IFoo",
+        "manifest/hals//instances//instance=default",
+        "manifest/kernel/version=5.10.1",
+        "manifest/kernel/configs//key=CONFIG_A",
+        "manifest/kernel/configs//value=y",
+    }));
+}
+
+TEST_F(LibVintfTest, VisitMatrixContent) {
+    std::string error;
+    CompatibilityMatrix matrix;
+    ASSERT_TRUE(fromXml(&matrix, contentMatrixXml(), &error)) << error;
+
+    PathRecorder recorder;
+    visitContent(matrix, &recorder);
+    EXPECT_THAT(recorder.values, IsSupersetOf({
+        "compatibility-matrix/type=framework",
+        "compatibility-matrix/level=8",
+        "compatibility-matrix/hals//optional=true",
+        "compatibility-matrix/hals//versions/=1-2",
+        "compatibility-matrix/hals//instances//regex-instance=slot[0-9]+",
+        "compatibility-matrix/kernels//version=5.15.0",
+        "compatibility-matrix/kernels//configs//key=CONFIG_B",
+        "compatibility-matrix/kernels//configs//type=int",
+        "compatibility-matrix/kernels//configs//value=16",
+        "compatibility-matrix/sepolicy/kernel-sepolicy-version=30",
+        "compatibility-matrix/sepolicy/sepolicy-versions/=202404",
+    }));
+}
+
+// Records |value| in the format of PathRecorder, where |path| is the path of |value| itself.
+void recordJson(const Json::Value& value, const std::string& path,
+                std::vector<std::string>* values) {
+    if (value.isObject()) {
+        for (const auto& name : value.getMemberNames()) {
+            recordJson(value[name], path + "/" + name, values);
+        }
+    } else if (value.isArray()) {
+        for (const auto& element : value) {
+            recordJson(element, path + "/", values);
+        }
+    } else if (value.isBool()) {
+        values->push_back(path + "=" + (value.asBool() ? "true" : "false"));
+    } else if (value.isUInt64() && !value.isString()) {
+        values->push_back(path + "=" + std::to_string(value.asUInt64()));
+    } else {
+        values->push_back(path + "=" + value.asString());
+    }
+}
+
+// Encodes the content of |object| as JSON text, parses it back and records it. The root
+// object is named |rootName|, because its name is not part of the JSON.
+template <typename T>
+std::vector<std::string> roundTripJson(const T& object, const std::string& rootName) {
+    details::JsonContentVisitor visitor;
+    visitContent(object, &visitor);
+    std::string text = Json::writeString(Json::StreamWriterBuilder(), visitor.root());
+
+    Json::Value parsed;
+    std::string error;
+    std::istringstream in(text);
+    EXPECT_TRUE(Json::parseFromStream(Json::CharReaderBuilder(), in, &parsed, &error)) << error;
+    std::vector<std::string> values;
+    recordJson(parsed, rootName, &values);
+    return values;
+}
+
+// Encodes the content of |object| with BinaryContentWriter, reads it back and records it.
+template <typename T>
+std::vector<std::string> roundTripBinary(const T& object) {
+    std::ostringstream out;
+    BinaryContentWriter writer(out);
+    visitContent(object, &writer);
+
+    PathRecorder recorder;
+    std::string error;
+    EXPECT_TRUE(readBinaryContent(out.str(), &recorder, &error)) << error;
+    return recorder.values;
+}
+
+template <typename T>
+std::vector<std::string> recordContent(const T& object) {
+    PathRecorder recorder;
+    visitContent(object, &recorder);
+    return recorder.values;
+}
+
+TEST_F(LibVintfTest, BinaryContentRoundTrip) {
+    std::string error;
+    HalManifest manifest;
+    ASSERT_TRUE(fromXml(&manifest, contentManifestXml(), &error)) << error;
+    CompatibilityMatrix matrix;
+    ASSERT_TRUE(fromXml(&matrix, contentMatrixXml(), &error)) << error;
+
+    EXPECT_EQ(recordContent(manifest), roundTripBinary(manifest));
+    EXPECT_EQ(recordContent(matrix), roundTripBinary(matrix));
+}
+
+TEST_F(LibVintfTest, BinaryContentMalformed) {
+    std::ostringstream out;
+    BinaryContentWriter writer(out);
+    writer.beginObject("manifest");
+    writer.visitUint("level", 300);
+    writer.visitBool("optional", true);
+    writer.endObject();
+    std::string data = out.str();
+
+    std::string error;
+    PathRecorder recorder;
+    ASSERT_TRUE(readBinaryContent(data, &recorder, &error)) << error;
+    EXPECT_THAT(recorder.values, ElementsAre("manifest/level=300", "manifest/optional=true"));
+
+    EXPECT_FALSE(readBinaryContent("<manifest/>", &recorder, &error));
+    EXPECT_THAT(error, HasSubstr("Not binary VINTF content"));
+
+    std::string badVersion = data;
+    badVersion[kBinaryContentMagic.size()] = 2;
+    EXPECT_FALSE(readBinaryContent(badVersion, &recorder, &error));
+    EXPECT_THAT(error, HasSubstr("Unsupported binary VINTF content version 2"));
+
+    // A header without records is empty content. Cutting the content anywhere else truncates
+    // the header or a record, or leaves the object open.
+    size_t headerSize = kBinaryContentMagic.size() + 1;
+    for (size_t size = 0; size < data.size(); ++size) {
+        PathRecorder partial;
+        EXPECT_EQ(size == headerSize, readBinaryContent(data.substr(0, size), &partial, &error))
+                << size;
+    }
+
+    std::string badBool = data;
+    badBool[data.size() - 2] = 2;
+    EXPECT_FALSE(readBinaryContent(badBool, &recorder, &error));
+    EXPECT_THAT(error, HasSubstr("Invalid bool"));
+
+    EXPECT_FALSE(readBinaryContent(data + "A", &recorder, &error));
+    EXPECT_THAT(error, HasSubstr("Unbalanced end tag"));
+    EXPECT_FALSE(readBinaryContent(data + "x", &recorder, &error));
+    EXPECT_THAT(error, HasSubstr("Unknown tag"));
+}
+
+TEST_F(LibVintfTest, JsonContentRoundTrip) {
+    std::string error;
+    HalManifest manifest;
+    ASSERT_TRUE(fromXml(&manifest, contentManifestXml(), &error)) << error;
+    CompatibilityMatrix matrix;
+    ASSERT_TRUE(fromXml(&matrix, contentMatrixXml(), &error)) << error;
+
+    // JSON objects do not keep the order of their members.
+    auto sorted = [](std::vector<std::string> values) {
+        std::sort(values.begin(), values.end());
+        return values;
+    };
+    EXPECT_EQ(sorted(recordContent(manifest)), sorted(roundTripJson(manifest, "manifest")));
+    EXPECT_EQ(sorted(recordContent(matrix)),
+              sorted(roundTripJson(matrix, "compatibility-matrix")));
+}
+
+TEST_F(LibVintfTest, ManifestInstanceIndex) {
+    std::string error;
+    auto device = std::make_shared<HalManifest>();
+    std::string deviceXml = "<manifest " + kMetaVersionStr + R"( type="device">
+    <hal format="aidl">
+        <name>android.hardware.foo</name>
+        <version>3</version>
+        <fqname>IFoo/default</fqname>
+        <fqname>IFoo/slot1</fqname>
+    </hal>
+    <hal format="aidl" updatable-via-apex="com.android.bar">
+        <name>android.hardware.bar</name>
+        <accessor>android.os.IAccessor/android.hardware.bar.IBar/default</accessor>
+        <fqname>IBar/default</fqname>
+    </hal>
+    <hal format="hidl">
+        <name>android.hardware.baz</name>
+        <transport>hwbinder</transport>
+        <fqname>@1.1::IBaz/default</fqname>
+        <fqname>@2.0::IBaz/default</fqname>
+    </hal>
+</manifest>
+)";
+    ASSERT_TRUE(fromXml(device.get(), deviceXml, &error)) << error;
+    auto framework = std::make_shared<HalManifest>();
+    std::string frameworkXml = "<manifest " + kMetaVersionStr + R"( type="framework">
+    <hal format="aidl">
+        <name>android.frameworks.qux</name>
+        <fqname>IQux/default</fqname>
+    </hal>
+</manifest>
+)";
+    ASSERT_TRUE(fromXml(framework.get(), frameworkXml, &error)) << error;
+
+    ManifestInstanceIndex index(device, framework);
+    EXPECT_EQ(device, index.deviceManifest());
+    EXPECT_EQ(framework, index.frameworkManifest());
+    EXPECT_EQ(6u, index.size());
+
+    std::vector<std::string> instances;
+    for (const ManifestInstance& e : index.getAidlInstances("android.hardware.foo", "IFoo")) {
+        instances.push_back(e.instance());
+    }
+    EXPECT_THAT(instances, ElementsAre("default", "slot1"));
+    EXPECT_TRUE(index.getAidlInstances("android.hardware.foo", "IBar").empty());
+
+    EXPECT_TRUE(index.hasAidlInstance("android.hardware.foo", "IFoo", "slot1"));
+    EXPECT_TRUE(index.hasAidlInstance("android.hardware.foo", 3, "IFoo", "slot1"));
+    EXPECT_FALSE(index.hasAidlInstance("android.hardware.foo", 4, "IFoo", "slot1"));
+    EXPECT_FALSE(index.hasAidlInstance("android.hardware.foo", "IFoo", "slot2"));
+    EXPECT_TRUE(index.hasAidlInstance("android.frameworks.qux", "IQux", "default"));
+
+    const ManifestInstance* bar = index.getAidlInstance("android.hardware.bar", "IBar", "default");
+    ASSERT_NE(nullptr, bar);
+    EXPECT_EQ(std::make_optional<std::string>("com.android.bar"), bar->updatableViaApex());
+    EXPECT_EQ(std::make_optional<std::string>(
+                  "android.os.IAccessor/android.hardware.bar.IBar/default"),
+              bar->accessor());
+
+    EXPECT_EQ(2u, index.getInstances(HalFormat::HIDL, "android.hardware.baz", "IBaz",
+                                     "default").size());
+    EXPECT_TRUE(index.hasHidlInstance("android.hardware.baz", {1, 0}, "IBaz", "default"));
+    EXPECT_TRUE(index.hasHidlInstance("android.hardware.baz", {2, 0}, "IBaz", "default"));
+    EXPECT_FALSE(index.hasHidlInstance("android.hardware.baz", {1, 2}, "IBaz", "default"));
+    EXPECT_FALSE(index.hasHidlInstance("android.hardware.baz", {3, 0}, "IBaz", "default"));
+
+    // Lookups agree with HalManifest.
+    device->forEachInstance([&](const ManifestInstance& e) {
+        if (e.format() == HalFormat::AIDL) {
+            EXPECT_EQ(device->hasAidlInstance(e.package(), e.version().minorVer, e.interface(),
+                                              e.instance()),
+                      index.hasAidlInstance(e.package(), e.version().minorVer, e.interface(),
+                                            e.instance()))
+                << e.description();
+        } else {
+            EXPECT_EQ(device->hasHidlInstance(e.package(), e.version(), e.interface(),
+                                              e.instance()),
+                      index.hasHidlInstance(e.package(), e.version(), e.interface(),
+                                            e.instance()))
+                << e.description();
+        }
+        return true;
+    });
+}
+
 } // namespace vintf
 } // namespace android
 
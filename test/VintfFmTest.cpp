@@ -238,11 +238,12 @@ std::string createMatrixHal(HalFormat format, const std::string& package) {
         versionRanges.emplace_back(1, 0);
     }
     auto interface = format == HalFormat::AIDL ? "IAidl" : "IHidl";
-    MatrixHal matrixHal{.format = format,
-                        .name = package,
-                        .versionRanges = versionRanges,
-                        .optional = false,
-                        .interfaces = {{interface, HalInterface{interface, {"default"}}}}};
+    MatrixHal matrixHal{format,
+                        package,
+                        versionRanges,
+                        false /* optional */,
+                        false /* updatableViaApex */,
+                        {{interface, HalInterface{interface, {"default"}}}}};
     return toXml(matrixHal);
 }
 
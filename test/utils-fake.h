@@ -19,6 +19,7 @@
 #include <vintf/Apex.h>
 #include <vintf/ObjectFactory.h>
 #include <vintf/PropertyFetcher.h>
+#include <vintf/Tracer.h>
 #include "utils.h"
 
 using ::testing::_;
@@ -91,6 +92,28 @@ class MockPropertyFetcher : public PropertyFetcher {
     MOCK_CONST_METHOD3(getUintProperty, uint64_t(const std::string&, uint64_t, uint64_t));
 };
 
+// Records finished spans in the order they end.
+class FakeTracer : public Tracer {
+   public:
+    struct Span {
+        std::string name;
+        Attributes attributes;
+        // Number of spans that were open when this span began.
+        size_t depth;
+    };
+
+    void beginSpan(const char*) override { mDepth++; }
+    void endSpan(const char* name, const Attributes& attributes) override {
+        mDepth--;
+        mSpans.push_back({name, attributes, mDepth});
+    }
+    const std::vector<Span>& spans() const { return mSpans; }
+
+   private:
+    size_t mDepth = 0;
+    std::vector<Span> mSpans;
+};
+
 }  // namespace details
 }  // namespace vintf
 }  // namespace android
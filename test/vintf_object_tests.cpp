@@ -18,7 +18,9 @@
 #include "gmock-logging-compat.h"
 
 #include <stdio.h>
+#include <atomic>
 #include <optional>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -30,6 +32,8 @@
 #include <vintf/VintfObject.h>
 #include <vintf/parse_string.h>
 #include <vintf/parse_xml.h>
+#include "FakeFileSystem.h"
+#include "KernelRequirementTable.h"
 #include "constants-private.h"
 #include "parse_xml_internal.h"
 #include "test_constants.h"
@@ -621,6 +625,145 @@ TEST_F(VintfObjectCompatibleTest, TestDeviceCompatibility) {
     ASSERT_STREQ(error.c_str(), "");
 }
 
+// Tests that results of checks that are already done are used instead of running them again.
+TEST_F(VintfObjectCompatibleTest, TestDeviceCompatibilityWithResults) {
+    std::string error;
+
+    expectVendorManifest();
+    expectSystemManifest();
+    expectVendorMatrix();
+    expectSystemMatrix();
+
+    VintfObject::CompatibilityCheckResults results;
+    results.deviceManifest.emplace().error = "reused error";
+    EXPECT_EQ(INCOMPATIBLE, vintfObject->checkCompatibility(results, &error));
+    EXPECT_EQ("Device manifest and framework compatibility matrix are incompatible: reused error",
+              error);
+
+    // The framework manifest is still checked against the device matrix.
+    error.clear();
+    results.deviceManifest->compatible = true;
+    EXPECT_EQ(COMPATIBLE, vintfObject->checkCompatibility(results, &error)) << error;
+}
+
+// Calls the getters of VintfObject from many threads while the HAL manifests are reloaded.
+// Run under TSan to check the locking of the caches of VintfObject.
+TEST(VintfObjectStressTest, ConcurrentGettersDuringReload) {
+    auto files = std::make_unique<FakeFileSystem>();
+    files->add(kVendorLegacyManifest, vendorManifestXml1);
+    files->add(kSystemManifest, systemManifestXml1);
+    files->add(kVendorLegacyMatrix, vendorMatrixXml1);
+    files->add(kSystemLegacyMatrix, systemMatrixXml1);
+    // The modified time of the list of APEXes decides when HAL manifests are reloaded.
+    files->add(kApexInfoFile, "<apex-info-list></apex-info-list>");
+    files->add(kBootstrapApexInfoFile, "<apex-info-list></apex-info-list>");
+    files->setModifiedTimeInterval(100us);
+    const FakeFileSystem* fileSystem = files.get();
+    auto vintfObject =
+        VintfObject::Builder()
+            .setFileSystem(std::move(files))
+            .setRuntimeInfoFactory(std::make_unique<NiceMock<MockRuntimeInfoFactory>>(
+                std::make_shared<NiceMock<MockRuntimeInfo>>()))
+            .setPropertyFetcher(std::make_unique<NiceMock<MockPropertyFetcher>>())
+            .build();
+    ASSERT_NE(nullptr, vintfObject->getDeviceHalManifest());
+    size_t fetchCount = fileSystem->fetchCount();
+
+    constexpr size_t kNumThreads = 8;
+    constexpr size_t kNumIterations = 20;
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (size_t j = 0; j < kNumIterations; ++j) {
+                std::string error;
+                if (vintfObject->getDeviceHalManifest() == nullptr ||
+                    vintfObject->getFrameworkHalManifest() == nullptr ||
+                    vintfObject->getDeviceCompatibilityMatrix() == nullptr ||
+                    vintfObject->getFrameworkCompatibilityMatrix() == nullptr ||
+                    vintfObject->getRuntimeInfo() == nullptr ||
+                    vintfObject->getManifestInstanceIndex() == nullptr ||
+                    vintfObject->checkCompatibility(&error) != COMPATIBLE) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(0u, failures);
+    // The manifests are reloaded at least once.
+    EXPECT_LT(fetchCount, fileSystem->fetchCount());
+}
+
+// Test fixture that records spans while loading compatible metadata from the mock device.
+class VintfObjectTracerTest : public VintfObjectTestBase {
+   protected:
+    virtual void SetUp() {
+        auto tracer = std::make_unique<FakeTracer>();
+        mTracer = tracer.get();
+        vintfObject = VintfObject::Builder()
+                          .setFileSystem(std::make_unique<NiceMock<MockFileSystem>>())
+                          .setRuntimeInfoFactory(std::make_unique<NiceMock<MockRuntimeInfoFactory>>(
+                              std::make_shared<NiceMock<MockRuntimeInfo>>()))
+                          .setPropertyFetcher(std::make_unique<NiceMock<MockPropertyFetcher>>())
+                          .setTracer(std::move(tracer))
+                          .build();
+        ON_CALL(propertyFetcher(), getBoolProperty("apex.all.ready", _))
+            .WillByDefault(Return(true));
+        setupMockFetcher(vendorManifestXml1, systemMatrixXml1, systemManifestXml1, vendorMatrixXml1);
+        noApex();
+    }
+
+    // Return the first span with the given name and "path" attribute, or nullptr.
+    const FakeTracer::Span* findSpan(const std::string& name, const std::string& path) {
+        for (const auto& span : mTracer->spans()) {
+            if (span.name != name) continue;
+            for (const auto& [key, value] : span.attributes) {
+                if (key == "path" && value == path) return &span;
+            }
+        }
+        return nullptr;
+    }
+
+    FakeTracer* mTracer = nullptr;
+};
+
+TEST_F(VintfObjectTracerTest, Spans) {
+    expectVendorManifest();
+    expectSystemManifest();
+    expectVendorMatrix();
+    expectSystemMatrix();
+
+    std::string error;
+    ASSERT_EQ(COMPATIBLE, vintfObject->checkCompatibility(&error)) << error;
+
+    auto fetch = findSpan("FileSystem::fetch", kVendorLegacyManifest);
+    ASSERT_NE(nullptr, fetch);
+    EXPECT_THAT(fetch->attributes,
+                Contains(Pair("bytes", std::to_string(vendorManifestXml1.size()))));
+
+    auto parse = findSpan("fromXml", kVendorLegacyManifest);
+    ASSERT_NE(nullptr, parse);
+    EXPECT_THAT(parse->attributes,
+                Contains(Pair("bytes", std::to_string(vendorManifestXml1.size()))));
+    EXPECT_LT(0u, parse->depth) << "fromXml should be nested in a fetch* span";
+
+    auto listFiles = findSpan("FileSystem::listFiles", kSystemManifestFragmentDir);
+    ASSERT_NE(nullptr, listFiles);
+    EXPECT_THAT(listFiles->attributes, Contains(Pair("files", "0")));
+
+    std::vector<std::string> names;
+    std::vector<std::string> topLevelNames;
+    for (const auto& span : mTracer->spans()) {
+        names.push_back(span.name);
+        if (span.depth == 0) topLevelNames.push_back(span.name);
+    }
+    EXPECT_THAT(names, Contains("VintfObject::fetchDeviceHalManifest"));
+    EXPECT_THAT(names, Contains("VintfObject::fetchFrameworkHalManifest"));
+    EXPECT_THAT(names, Contains("VintfObject::fetchDeviceMatrix"));
+    EXPECT_THAT(topLevelNames, Contains("VintfObject::checkCompatibility"));
+}
+
 // Test fixture that provides incompatible metadata from the mock device.
 class VintfObjectIncompatibleTest : public VintfObjectTestBase {
    protected:
@@ -996,6 +1139,29 @@ TEST_F(DeviceManifestTest, Combine5) {
     ASSERT_EQ(p2,p3);
 }
 
+// The instance index follows reloads of the device manifest.
+TEST_F(DeviceManifestTest, ManifestInstanceIndex) {
+    expectFileNotExist(StartsWith("/system/"));
+    expectVendorManifest();
+    noOdmManifest();
+    expectApex();
+    auto index = vintfObject->getManifestInstanceIndex();
+    ASSERT_NE(nullptr, index);
+    const ManifestInstance* instance = index->getAidlInstance(apexHalName, "IApex", "default");
+    ASSERT_NE(nullptr, instance);
+    EXPECT_EQ(std::make_optional<std::string>("com.test"), instance->updatableViaApex());
+
+    // The second call reloads the manifest because APEX info is updated.
+    auto index2 = vintfObject->getManifestInstanceIndex();
+    ASSERT_NE(nullptr, index2);
+    EXPECT_NE(index, index2);
+    EXPECT_EQ(get(), index2->deviceManifest());
+    EXPECT_TRUE(index2->hasAidlInstance(apexHalName, "IApex", "default"));
+
+    // No more updates.
+    EXPECT_EQ(index2, vintfObject->getManifestInstanceIndex());
+}
+
 // Tests for valid/invalid APEX defined HAL
 // For a HAL to be defined within an APEX it must not have
 // the update-via-apex attribute defined in the HAL manifest
@@ -1880,6 +2046,41 @@ TEST_F(KernelTest, Level1AndLevel2) {
     EXPECT_IN(FAKE_KERNEL("2.0.0", "B2", 2), xml) << "\nShould see <kernel> from new matrices";
 }
 
+TEST_F(KernelTest, KernelRequirementTable) {
+    const std::string& xml1 = systemMatrixKernelXmls[0];
+    const std::string& xml2 = systemMatrixKernelXmls[1];
+    // The table of 1.xml has other requirements than its <kernel>s, to tell which ones are
+    // loaded. The table of 2.xml is out of date.
+    std::vector<MatrixKernel> tableKernels;
+    tableKernels.emplace_back(KernelVersion{1, 0, 0},
+                              std::vector<KernelConfig>{{"CONFIG_T1"s, Tristate::YES}});
+    std::string table1 = KernelRequirementTable::write(tableKernels, SerializeFlags::EVERYTHING,
+                                                       xml1);
+    std::string table2 = KernelRequirementTable::write(tableKernels, SerializeFlags::EVERYTHING,
+                                                       xml1);
+
+    EXPECT_CALL(fetcher(), listFiles(StrEq(kSystemVintfDir), _, _))
+        .WillRepeatedly(Invoke([](const auto&, auto* out, auto*) {
+            *out = {getFileName(1), getFileName(1) + ".kernels", getFileName(2),
+                    getFileName(2) + ".kernels"};
+            return ::android::OK;
+        }));
+    expectFetchRepeatedly(kSystemVintfDir + getFileName(1), xml1);
+    expectFetchRepeatedly(kSystemVintfDir + getFileName(1) + ".kernels", table1);
+    expectFetchRepeatedly(kSystemVintfDir + getFileName(2), xml2);
+    expectFetchRepeatedly(kSystemVintfDir + getFileName(2) + ".kernels", table2);
+
+    expectTargetFcmVersion(1);
+    auto matrix = vintfObject->getFrameworkCompatibilityMatrix();
+    ASSERT_NE(nullptr, matrix);
+    std::string xml = toXml(*matrix);
+
+    EXPECT_IN("CONFIG_T1", xml) << "\nShould load <kernel>s of 1.xml from its table";
+    EXPECT_NOT_IN("CONFIG_A1", xml);
+    EXPECT_NOT_IN("CONFIG_B1", xml);
+    EXPECT_IN(FAKE_KERNEL("3.0.0", "C2", 2), xml) << "\nShould ignore out-of-date table of 2.xml";
+}
+
 // Assume that we are developing level 3. Test that old <kernel> requirements should
 // not change and new <kernel> versions are added.
 TEST_F(KernelTest, Level1AndMore) {
@@ -17,13 +17,17 @@
 #ifndef ANDROID_VINTF_UTILS_H
 #define ANDROID_VINTF_UTILS_H
 
+#include <stdint.h>
+
 #include <memory>
 #include <mutex>
+#include <string_view>
 
 #include <utils/Errors.h>
 #include <vintf/FileSystem.h>
 #include <vintf/PropertyFetcher.h>
 #include <vintf/RuntimeInfo.h>
+#include <vintf/Tracer.h>
 #include <vintf/parse_xml.h>
 
 // Equality for timespec. This should be in global namespace where timespec
@@ -41,9 +45,35 @@ namespace android {
 namespace vintf {
 namespace details {
 
+// FileSystem::fetch with a span reported to |tracer| if it is not null.
+inline status_t tracedFetch(Tracer* tracer, const FileSystem* fileSystem, const std::string& path,
+                            std::string* fetched, std::string* error) {
+    ScopedSpan span(tracer, "FileSystem::fetch");
+    status_t status = fileSystem->fetch(path, fetched, error);
+    if (span.isEnabled()) {
+        span.addAttribute("path", path);
+        span.addAttribute("bytes", status == OK ? fetched->size() : 0);
+    }
+    return status;
+}
+
+// FileSystem::listFiles with a span reported to |tracer| if it is not null.
+inline status_t tracedListFiles(Tracer* tracer, const FileSystem* fileSystem,
+                                const std::string& path, std::vector<std::string>* out,
+                                std::string* error) {
+    ScopedSpan span(tracer, "FileSystem::listFiles");
+    status_t status = fileSystem->listFiles(path, out, error);
+    if (span.isEnabled()) {
+        span.addAttribute("path", path);
+        span.addAttribute("files", status == OK ? out->size() : 0);
+    }
+    return status;
+}
+
+// Spans for fetching the file and parsing it are reported to |tracer| if it is not null.
 template <typename T>
 status_t fetchAllInformation(const FileSystem* fileSystem, const std::string& path, T* outObject,
-                             std::string* error) {
+                             std::string* error, Tracer* tracer = nullptr) {
     if (outObject->fileName().empty()) {
         outObject->setFileName(path);
     } else {
@@ -51,13 +81,21 @@ status_t fetchAllInformation(const FileSystem* fileSystem, const std::string& pa
     }
 
     std::string info;
-    status_t result = fileSystem->fetch(path, &info, error);
+    status_t result = tracedFetch(tracer, fileSystem, path, &info, error);
 
     if (result != OK) {
         return result;
     }
 
-    bool success = fromXml(outObject, info, error);
+    bool success;
+    {
+        ScopedSpan span(tracer, "fromXml");
+        if (span.isEnabled()) {
+            span.addAttribute("path", path);
+            span.addAttribute("bytes", info.size());
+        }
+        success = fromXml(outObject, info, error);
+    }
     if (!success) {
         if (error) {
             *error = "Illformed file: " + path + ": " + *error;
@@ -104,6 +142,15 @@ static bool mergeField(T* dst, T* src, const T& empty = T{}) {
     return false;
 }
 
+// 64-bit FNV-1a hash of |data|. Continue hashing more data by passing the previous result as
+// |hash|.
+inline uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 // Check legacy instances (i.e. <version> + <interface> + <instance>) can be
 // converted into FqInstance because forEachInstance relies on FqInstance.
 // If error and appendedError is not null, error message is appended to appendedError.